@@ -0,0 +1,41 @@
+#!/bin/sh
+# Compares each native builtin with an equivalent ASML routine.
+#
+# usage: bench/builtins.sh [CI_BINARY] [RUNS] [-- CI_FLAGS...]
+#
+# Every bench/builtins/NAME.builtin.s has a NAME.asml.s twin that differs only
+# in calling an ASML routine instead of __builtin_NAME. Each program runs RUNS
+# times; the fastest wall time of each is reported.
+
+CI=bin/ci
+RUNS=5
+if [ $# -gt 0 ] && [ "$1" != "--" ]; then CI=$1; shift; fi
+if [ $# -gt 0 ] && [ "$1" != "--" ]; then RUNS=$1; shift; fi
+if [ $# -gt 0 ]; then shift; fi
+DIR=$(dirname "$0")/builtins
+
+# Prints the fastest of $RUNS wall times of one program, in microseconds
+best_time() {
+    best=
+    i=0
+    while [ "$i" -lt "$RUNS" ]; do
+        start=$(date +%s%N)
+        "$CI" -i "$1" "$@" >/dev/null 2>&1 || { echo "failed: $1" >&2; exit 1; }
+        end=$(date +%s%N)
+        elapsed=$(( (end - start) / 1000 ))
+        if [ -z "$best" ] || [ "$elapsed" -lt "$best" ]; then
+            best=$elapsed
+        fi
+        i=$((i + 1))
+    done
+    echo "$best"
+}
+
+printf "%-10s %12s %12s %9s\n" builtin "asml (us)" "native (us)" speedup
+for asml in "$DIR"/*.asml.s; do
+    name=$(basename "$asml" .asml.s)
+    slow=$(best_time "$asml" "$@") || exit 1
+    fast=$(best_time "$DIR/$name.builtin.s" "$@") || exit 1
+    printf "%-10s %12s %12s %8sx\n" "$name" "$slow" "$fast" \
+        "$(awk "BEGIN { printf \"%.1f\", $slow / ($fast > 0 ? $fast : 1) }")"
+done
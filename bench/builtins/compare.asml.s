@@ -0,0 +1,36 @@
+// Compares two strings that differ in their last character 20000 times
+    put "the quick brown fox jumps over the lazy dog, again and again!!" 0
+    put "the quick brown fox jumps over the lazy dog, again and again!?" 100
+    mov x20, 20000
+loop:
+    mov x0, 0
+    mov x1, 100
+    call compare
+    sub x20, x20, 1
+    cmp x20, 0
+    b.gt loop
+    ret
+
+// x0 = -1, 0 or 1 as the string at x0 sorts before, equal to or after the
+// string at x1
+compare:
+    load x2, 1, x0
+    load x3, 1, x1
+    cmp x2, x3
+    b.ne .compare_differ
+    cmp x2, 0
+    b.eq .compare_equal
+    add x0, x0, 1
+    add x1, x1, 1
+    b compare
+.compare_differ:
+    b.lt .compare_less
+    mov x0, 1
+    ret
+.compare_less:
+    mov x0, 0
+    sub x0, x0, 1
+    ret
+.compare_equal:
+    mov x0, 0
+    ret
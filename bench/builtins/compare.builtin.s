@@ -0,0 +1,12 @@
+// Compares two strings that differ in their last character 20000 times
+    put "the quick brown fox jumps over the lazy dog, again and again!!" 0
+    put "the quick brown fox jumps over the lazy dog, again and again!?" 100
+    mov x20, 20000
+loop:
+    mov x0, 0
+    mov x1, 100
+    call __builtin_compare
+    sub x20, x20, 1
+    cmp x20, 0
+    b.gt loop
+    ret
@@ -0,0 +1,26 @@
+// Copies a 256-byte buffer 5000 times
+    mov x20, 5000
+loop:
+    mov x0, 512
+    mov x1, 0
+    mov x2, 256
+    call copy
+    sub x20, x20, 1
+    cmp x20, 0
+    b.gt loop
+    ret
+
+// Copies x2 bytes from x1 to x0
+copy:
+    add x3, x0, 0
+.copy_loop:
+    cmp x2, 0
+    b.eq .copy_done
+    load x4, 1, x1
+    store x4, x3, 1
+    add x3, x3, 1
+    add x1, x1, 1
+    sub x2, x2, 1
+    b .copy_loop
+.copy_done:
+    ret
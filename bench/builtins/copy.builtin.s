@@ -0,0 +1,11 @@
+// Copies a 256-byte buffer 5000 times
+    mov x20, 5000
+loop:
+    mov x0, 512
+    mov x1, 0
+    mov x2, 256
+    call __builtin_copy
+    sub x20, x20, 1
+    cmp x20, 0
+    b.gt loop
+    ret
@@ -0,0 +1,42 @@
+// Hashes a 256-byte buffer 2000 times
+    mov x20, 2000
+loop:
+    mov x0, 0
+    mov x1, 256
+    call hash
+    sub x20, x20, 1
+    cmp x20, 0
+    b.gt loop
+    ret
+
+// x0 = 64-bit FNV-1a hash of the x1 bytes at x0
+hash:
+    // The offset basis 0xcbf29ce484222325 does not fit an immediate
+    mov x2, 0x4bf29ce484222325
+    mov x3, 1
+    lsl x3, x3, 63
+    orr x2, x2, x3
+    add x1, x0, x1
+.hash_loop:
+    cmp x0, x1
+    b.ge .hash_done
+    load x3, 1, x0
+    eor x2, x2, x3
+    // Multiply by the prime 2^40 + 2^8 + 0xb3 with shifts
+    lsl x3, x2, 40
+    lsl x4, x2, 8
+    add x3, x3, x4
+    lsl x4, x2, 7
+    add x3, x3, x4
+    lsl x4, x2, 5
+    add x3, x3, x4
+    lsl x4, x2, 4
+    add x3, x3, x4
+    lsl x4, x2, 1
+    add x3, x3, x4
+    add x2, x3, x2
+    add x0, x0, 1
+    b .hash_loop
+.hash_done:
+    add x0, x2, 0
+    ret
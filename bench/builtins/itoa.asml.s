@@ -0,0 +1,95 @@
+// Converts 5000 descending integers to decimal strings
+    // Powers of ten, largest first, for itoa
+    mov x0, 1000000000000000000
+    store x0, 800, 8
+    mov x0, 100000000000000000
+    store x0, 808, 8
+    mov x0, 10000000000000000
+    store x0, 816, 8
+    mov x0, 1000000000000000
+    store x0, 824, 8
+    mov x0, 100000000000000
+    store x0, 832, 8
+    mov x0, 10000000000000
+    store x0, 840, 8
+    mov x0, 1000000000000
+    store x0, 848, 8
+    mov x0, 100000000000
+    store x0, 856, 8
+    mov x0, 10000000000
+    store x0, 864, 8
+    mov x0, 1000000000
+    store x0, 872, 8
+    mov x0, 100000000
+    store x0, 880, 8
+    mov x0, 10000000
+    store x0, 888, 8
+    mov x0, 1000000
+    store x0, 896, 8
+    mov x0, 100000
+    store x0, 904, 8
+    mov x0, 10000
+    store x0, 912, 8
+    mov x0, 1000
+    store x0, 920, 8
+    mov x0, 100
+    store x0, 928, 8
+    mov x0, 10
+    store x0, 936, 8
+    mov x0, 1
+    store x0, 944, 8
+    mov x20, 5000
+loop:
+    mov x0, 1234567
+    add x0, x0, x20
+    mov x1, 0
+    call itoa
+    sub x20, x20, 1
+    cmp x20, 0
+    b.gt loop
+    ret
+
+// Writes the decimal string of x0 to x1; x0 = its length. Without a divide
+// instruction each digit is found by subtracting powers of ten from the table
+// at 800.
+itoa:
+    add x2, x1, 0
+    cmp x0, 0
+    b.ge .itoa_magnitude
+    mov x3, 45
+    store x3, x2, 1
+    add x2, x2, 1
+    mov x3, 0
+    sub x0, x3, x0
+.itoa_magnitude:
+    mov x6, 800
+    mov x5, 0
+.itoa_power:
+    load x4, 8, x6
+    mov x3, 48
+.itoa_digit:
+    cmp_u x0, x4
+    b.lt .itoa_emit
+    sub x0, x0, x4
+    add x3, x3, 1
+    b .itoa_digit
+.itoa_emit:
+    // Leading zeros are skipped, except for the units digit
+    cmp x3, 48
+    b.ne .itoa_write
+    cmp x5, 0
+    b.ne .itoa_write
+    cmp x4, 1
+    b.ne .itoa_next
+.itoa_write:
+    store x3, x2, 1
+    add x2, x2, 1
+    mov x5, 1
+.itoa_next:
+    add x6, x6, 8
+    cmp x6, 952
+    b.lt .itoa_power
+    mov x3, 0
+    store x3, x2, 1
+    sub x0, x2, x1
+    ret
@@ -0,0 +1,11 @@
+// Converts 5000 descending integers to decimal strings
+    mov x20, 5000
+loop:
+    mov x0, 1234567
+    add x0, x0, x20
+    mov x1, 0
+    call __builtin_itoa
+    sub x20, x20, 1
+    cmp x20, 0
+    b.gt loop
+    ret
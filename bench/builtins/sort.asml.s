@@ -0,0 +1,45 @@
+// Sorts 64 descending integers 100 times
+    mov x20, 100
+loop:
+    mov x0, 0
+    mov x1, 64
+fill:
+    sub x1, x1, 1
+    store x1, x0, 8
+    add x0, x0, 8
+    cmp x1, 0
+    b.gt fill
+    mov x0, 0
+    mov x1, 64
+    call sort
+    sub x20, x20, 1
+    cmp x20, 0
+    b.gt loop
+    ret
+
+// Sorts the x1 8-byte signed integers at x0 ascending (insertion sort)
+sort:
+    mov x2, 8
+    lsl x3, x1, 3
+.sort_outer:
+    cmp x2, x3
+    b.ge .sort_done
+    add x4, x0, x2
+    load x5, 8, x4
+    add x6, x4, 0
+.sort_inner:
+    cmp x6, x0
+    b.le .sort_place
+    sub x7, x6, 8
+    load x8, 8, x7
+    cmp x8, x5
+    b.le .sort_place
+    store x8, x6, 8
+    add x6, x7, 0
+    b .sort_inner
+.sort_place:
+    store x5, x6, 8
+    add x2, x2, 8
+    b .sort_outer
+.sort_done:
+    ret
@@ -0,0 +1,18 @@
+// Sorts 64 descending integers 100 times
+    mov x20, 100
+loop:
+    mov x0, 0
+    mov x1, 64
+fill:
+    sub x1, x1, 1
+    store x1, x0, 8
+    add x0, x0, 8
+    cmp x1, 0
+    b.gt fill
+    mov x0, 0
+    mov x1, 64
+    call __builtin_sort
+    sub x20, x20, 1
+    cmp x20, 0
+    b.gt loop
+    ret
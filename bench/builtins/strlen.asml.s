@@ -0,0 +1,23 @@
+// Measures the length of a 62-character string 20000 times
+    put "the quick brown fox jumps over the lazy dog, again and again!!" 0
+    mov x20, 20000
+loop:
+    mov x0, 0
+    call strlen
+    sub x20, x20, 1
+    cmp x20, 0
+    b.gt loop
+    ret
+
+// x0 = length of the string at x0
+strlen:
+    add x1, x0, 0
+.strlen_loop:
+    load x2, 1, x1
+    cmp x2, 0
+    b.eq .strlen_done
+    add x1, x1, 1
+    b .strlen_loop
+.strlen_done:
+    sub x0, x1, x0
+    ret
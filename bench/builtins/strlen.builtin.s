@@ -0,0 +1,10 @@
+// Measures the length of a 62-character string 20000 times
+    put "the quick brown fox jumps over the lazy dog, again and again!!" 0
+    mov x20, 20000
+loop:
+    mov x0, 0
+    call __builtin_strlen
+    sub x20, x20, 1
+    cmp x20, 0
+    b.gt loop
+    ret
@@ -0,0 +1,18 @@
+// Interpreter throughput: arithmetic, logic and a compare-and-branch per turn
+    mov x1, 0
+    mov x2, 7
+    mov x3, 12345
+    mov x10, 1023
+loop:
+    add x2, x2, x1
+    eor x4, x2, x3
+    lsl x5, x4, 3
+    lsr x6, x5, 5
+    and x7, x6, x10
+    orr x8, x7, x1
+    asr x9, x8, 1
+    sub x2, x9, x4
+    add x1, x1, 1
+    cmp x1, 1500000
+    b.lt loop
+    ret
@@ -0,0 +1,17 @@
+// Interpreter throughput: calls and returns of a function that writes memory,
+// so its calls cannot be memoized
+    mov x1, 0
+loop:
+    add x0, x1, 0
+    call step
+    add x1, x1, 1
+    cmp x1, 500000
+    b.lt loop
+    ret
+
+// x0 = x0 * 4 + 1, also stored at address 512
+step:
+    lsl x0, x0, 2
+    add x0, x0, 1
+    store x0, 512, 8
+    ret
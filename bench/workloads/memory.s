@@ -0,0 +1,13 @@
+// Interpreter throughput: loads and stores walking a 256-byte window
+    mov x1, 0
+    mov x4, 0
+    mov x10, 255
+loop:
+    and x2, x1, x10
+    store x1, x2, 8
+    load x3, 8, x2
+    add x4, x4, x3
+    add x1, x1, 1
+    cmp x1, 1000000
+    b.lt loop
+    ret
@@ -0,0 +1,16 @@
+#!/bin/sh
+# Checks that generated programs with deep loops and call chains stay near
+# the commands `--gen-budget` allows them.
+#
+# usage: check/gen_budget.sh CI_BINARY
+
+CI=$1
+program=$(mktemp) || exit 1
+trap 'rm -f "$program"' EXIT
+
+# The budget is an estimate, so a run may go somewhat past it
+for seed in 1 5 9 13 44; do
+    "$CI" --gen --seed $seed --gen-calls 6 --gen-loops 3 --gen-trips 60 --gen-budget 20000 > "$program"
+    "$CI" --no-tier --max-instructions 25000 -i "$program" | grep -Fxq "Error: 0" ||
+        { echo "seed $seed: ran past 25000 commands"; exit 1; }
+done
@@ -0,0 +1,43 @@
+#!/bin/sh
+# Checks that an included module is compiled once, loaded from the cache
+# afterwards and compiled again once its source changes.
+#
+# usage: check/link_cache.sh CI_BINARY
+
+CI=$1
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT
+
+cat > "$dir/main.s" <<'ASML'
+.include "module.s"
+.extern scale
+.callmode return
+mov x1, 5
+call scale
+print x1 d
+ASML
+cat > "$dir/module.s" <<'ASML'
+.global scale
+scale:
+    add x1, x1, x1
+    ret
+ASML
+
+# Prints an error unless the run prints `value` and links one module, `cached`
+# of them from the cache
+expect() {
+    value=$("$CI" --stats --cache-dir "$dir/cache" -i "$dir/main.s" 2>"$dir/stats" | head -n 1)
+    [ "$value" = "$1" ] || { echo "$2: expected $1, got $value"; exit 1; }
+    grep -Fxq "Modules linked: 1 ($3 from cache)" "$dir/stats" ||
+        { echo "$2: expected $3 module(s) from the cache"; exit 1; }
+}
+
+expect 10 "first run" 0
+expect 10 "second run" 1
+
+# The object is only stale once the source is newer than it
+sed 's/add x1, x1, x1/lsl x1, x1, 2/' "$dir/module.s" > "$dir/module.new"
+mv "$dir/module.new" "$dir/module.s"
+touch -d "@$(($(date +%s) + 2))" "$dir/module.s"
+expect 20 "run after the module changed" 0
+expect 20 "run after recompiling" 1
@@ -0,0 +1,14 @@
+// Falling off the end of the program ends it, even inside a call and even
+// when modules are linked after it.
+// Flags: --no-cache
+// Expect: Error: 0
+// Reject: 10
+// Reject: 11
+.include "../week4/include_module.s"
+.callmode return
+mov x1, 9
+call f
+print x1 d
+
+f:
+    add x1, x1, 1
@@ -0,0 +1,25 @@
+// Repeated calls of a pure function are answered from the cache.
+// Flags: --stats
+// Expect: 89
+// Expect: Memoized calls: 9 hits of 21 (42.9%), 1 functions, 0 evictions
+mov x0, 11
+call fib
+print x0 d
+b end
+
+fib:
+    cmp x0, 1
+    b.le base
+    add x1, x0, 0
+    sub x0, x0, 1
+    call fib
+    add x2, x0, 0
+    sub x0, x1, 2
+    call fib
+    add x0, x0, x2
+    ret
+base:
+    ret
+
+end:
+    mov x1, 0
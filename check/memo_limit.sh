@@ -0,0 +1,18 @@
+#!/bin/sh
+# Checks that cache hits are charged the commands their call ran, so that
+# memo.s needs the same instruction limit with and without memoization.
+#
+# usage: check/memo_limit.sh CI_BINARY
+
+CI=$1
+program=$(dirname "$0")/memo.s
+needed=1867
+
+for flags in "" --no-memo --no-tier "--tier-threshold 1"; do
+    # shellcheck disable=SC2086
+    "$CI" $flags --max-instructions $needed -i "$program" | grep -Fxq "Error: 0" ||
+        { echo "${flags:-default}: $needed commands were not enough"; exit 1; }
+    # shellcheck disable=SC2086
+    "$CI" $flags --max-instructions $((needed - 1)) -i "$program" | grep -Fxq "Error: 1" ||
+        { echo "${flags:-default}: $((needed - 1)) commands were enough"; exit 1; }
+done
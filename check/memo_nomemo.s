@@ -0,0 +1,39 @@
+// .nomemo keeps the calls of a pure function out of the cache; only twice
+// is cached here.
+// Flags: --stats
+// Expect: 89
+// Expect: 22
+// Expect: Memoized calls: 1 hits of 2 (50.0%), 1 functions, 0 evictions
+.nomemo fib
+mov x0, 11
+call fib
+print x0 d
+mov x0, 11
+call twice
+mov x0, 11
+call twice
+print x0 d
+b end
+
+// Sets the flags, so that its result does not depend on the caller's
+twice:
+    cmp x0, 0
+    add x0, x0, x0
+    ret
+
+fib:
+    cmp x0, 1
+    b.le base
+    add x1, x0, 0
+    sub x0, x0, 1
+    call fib
+    add x2, x0, 0
+    sub x0, x1, 2
+    call fib
+    add x0, x0, x2
+    ret
+base:
+    ret
+
+end:
+    mov x1, 0
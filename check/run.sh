@@ -0,0 +1,52 @@
+#!/bin/sh
+# Runs every check and reports the ones that fail.
+#
+# usage: check/run.sh [CI_BINARY]
+#
+# A check/NAME.s program lists the flags it runs with on a `// Flags:` line.
+# Its output, standard error included, must contain every `// Expect:` line
+# and no `// Reject:` line. A check/NAME.sh script gets the binary as its
+# argument and passes when it exits with 0.
+
+CI=${1:-bin/ci}
+DIR=$(dirname "$0")
+failed=0
+
+# Prints each `// Expect:` line of program $1 missing from $output and each
+# `// Reject:` line present in it
+verify() {
+    sed -n 's#^// \(Expect\|Reject\): #\1 #p' "$1" | while read -r kind line; do
+        if printf '%s\n' "$output" | grep -Fxq -- "$line"; then
+            [ "$kind" = Reject ] && echo "unexpected: $line"
+        else
+            [ "$kind" = Expect ] && echo "missing: $line"
+        fi
+    done
+}
+
+for check in "$DIR"/*.s "$DIR"/*.sh; do
+    name=$(basename "$check")
+    [ "$name" = run.sh ] && continue
+
+    case $check in
+    *.s)
+        # Flags are split on spaces on purpose
+        # shellcheck disable=SC2046
+        output=$("$CI" $(sed -n 's|^// Flags: ||p' "$check") -i "$check" 2>&1)
+        problems=$(verify "$check")
+        ;;
+    *.sh)
+        problems=$(sh "$check" "$CI" 2>&1) && problems=
+        ;;
+    esac
+
+    if [ -n "$problems" ]; then
+        echo "FAIL $name"
+        printf '%s\n' "$problems" | sed 's/^/    /'
+        failed=$((failed + 1))
+    else
+        echo "ok   $name"
+    fi
+done
+
+[ "$failed" -eq 0 ] || { echo "$failed check(s) failed"; exit 1; }
@@ -0,0 +1,29 @@
+#!/bin/sh
+# Checks the binary state of state_json.s field by field.
+#
+# usage: check/state_bin.sh CI_BINARY
+
+CI=$1
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT
+state=$dir/state.bin
+
+"$CI" --state-format=bin --state-out "$state" -i "$(dirname "$0")/state_json.s" >/dev/null
+
+# Prints an error unless `od` shows `expected` for the given fields
+field() {
+    name=$1
+    expected=$2
+    shift 2
+    actual=$(od -A n "$@" "$state" | tr -s ' \n' ' ' | sed 's/^ //; s/ $//')
+    [ "$actual" = "$expected" ] || { echo "$name: expected $expected, got $actual"; exit 1; }
+}
+
+size=$(wc -c < "$state")
+[ "$size" -eq 1304 ] || { echo "size: expected 1304, got $size"; exit 1; }
+# Magic, version 1, the equal flag and 1024 bytes of memory
+field header "43 49 53 54 01 00 00 00 04 00 00 00 00 04 00 00" -t x1 -N 16
+field registers "0 64 -1 -16 171 0" -t d8 -j 16 -N 48
+field sp 1024 -t d8 -j 272 -N 8
+field memory "$(sed -n 's/.*"hex":"\([0-9a-f]*\)".*/\1/p' "$(dirname "$0")/state_json.s" |
+                sed 's/../& /g; s/ $//')" -t x1 -j 344 -N 48
@@ -0,0 +1,14 @@
+// The JSON state lists registers, flags and the 16-byte chunks of memory
+// that hold a nonzero byte.
+// Flags: --state-format=json
+// Expect: {"error":false,"flags":{"greater":false,"equal":true,"less":false},"registers":[0,64,-1,-16,171,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0],"sp":1024,"memory":[{"address":64,"hex":"414a5aff00000000f0ffffffffffffff0000000000000000ffff000000000000ab000000000000000000000000000000"}]}
+mov x1, 64
+put "AJZ", x1
+sub x2, x2, 1
+store x2 67 1
+lsl x3, x2, 4
+store x3 72 8
+mov x4, 0xab
+store x4 96 1
+store x2 88 2
+cmp x1, x1
@@ -0,0 +1,388 @@
+#define _POSIX_C_SOURCE 200809L
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_MAX_LEN 4096
+#define MAX_MUTATIONS 4
+#define CRASH_PATH "crash-input"
+
+/**
+ * @brief One input of the corpus.
+ */
+typedef struct {
+    uint8_t *data;  // Input bytes
+    size_t   size;  // Number of input bytes
+} Input;
+
+/**
+ * @brief The inputs mutations are derived from.
+ */
+typedef struct {
+    Input *inputs;    // Loaded inputs
+    int    count;     // Number of loaded inputs
+    int    capacity;  // Allocated slots in `inputs`
+} Corpus;
+
+int LLVMFuzzerInitialize(int *argc, char ***argv);
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+#ifdef FUZZ_SANITIZER
+void __sanitizer_set_death_callback(void (*callback)(void));
+#endif
+
+// Tokens that are likely to form valid programs when inserted
+static const char *const dictionary[] = {
+    "add ", "sub ", "and ", "eor ", "orr ", "asr ", "lsl ", "lsr ", "mov ", "cmp ",
+    "cmp_u ", "load ", "store ", "put ", "print ", "b ", "b.eq ", "b.ne ", "b.gt ", "b.lt ",
+    "b.ge ", "b.le ", "call ", "ret", "x0", "x1", "x31", "x32", ", ", ":", "\n",
+    "\"", "0x", "0b", "1", "8", "1023", "1024", " d", " x", " s", " b", "loop", "//",
+    ".macro ", ".endm", ".rept ", ".endr", ".equ ", ".set ",
+    "__builtin_itoa", "__builtin_strlen", "__builtin_copy", "__builtin_compare",
+    "__builtin_hash", "__builtin_sort", "alloc ", "free ", "realloc ",
+    "push ", "pop ", "{x1-x4}", "sp", ".callmode return",
+};
+
+// The input being executed, written out if the process dies
+static const uint8_t *current_data;
+static size_t         current_size;
+
+static bool     corpus_add_path(Corpus *corpus, const char *path);
+static bool     corpus_add_file(Corpus *corpus, const char *path);
+static void     corpus_free(Corpus *corpus);
+static uint64_t next_random(uint64_t *state);
+static size_t   mutate(uint8_t *buf, size_t size, size_t max_len, const Corpus *corpus,
+                       uint64_t *state);
+static void     run_one(const uint8_t *data, size_t size);
+static void     save_crash(void);
+static void     on_signal(int sig);
+static double   now_seconds(void);
+
+/**
+ * @brief Standalone persistent-mode fuzzing driver.
+ *
+ * Replays every corpus input once and then runs `-runs` mutated inputs in the
+ * same process, without forking. Accepts a subset of libFuzzer's flags so the
+ * same command lines work with both: `-runs=N`, `-seed=N` and `-max_len=N`.
+ * Positional arguments are corpus files or directories. If the process
+ * crashes, the offending input is written to `crash-input`.
+ */
+int main(int argc, char **argv) {
+    long     runs    = 0;
+    uint64_t seed    = (uint64_t) time(NULL);
+    size_t   max_len = DEFAULT_MAX_LEN;
+    Corpus   corpus  = {NULL, 0, 0};
+
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "-runs=", 6) == 0) {
+            runs = strtol(argv[i] + 6, NULL, 10);
+        } else if (strncmp(argv[i], "-seed=", 6) == 0) {
+            seed = strtoull(argv[i] + 6, NULL, 10);
+        } else if (strncmp(argv[i], "-max_len=", 9) == 0) {
+            max_len = strtoul(argv[i] + 9, NULL, 10);
+        } else if (argv[i][0] == '-') {
+            fprintf(stderr, "Ignoring unknown flag %s\n", argv[i]);
+        } else if (!corpus_add_path(&corpus, argv[i])) {
+            corpus_free(&corpus);
+            return 1;
+        }
+    }
+    if (max_len == 0) {
+        max_len = DEFAULT_MAX_LEN;
+    }
+
+    signal(SIGSEGV, on_signal);
+    signal(SIGBUS, on_signal);
+    signal(SIGFPE, on_signal);
+    signal(SIGILL, on_signal);
+    signal(SIGABRT, on_signal);
+#ifdef FUZZ_SANITIZER
+    __sanitizer_set_death_callback(save_crash);
+#endif
+
+    LLVMFuzzerInitialize(&argc, &argv);
+
+    double start = now_seconds();
+    for (int i = 0; i < corpus.count; i++) {
+        run_one(corpus.inputs[i].data, corpus.inputs[i].size);
+    }
+    fprintf(stderr, "Replayed %d corpus inputs\n", corpus.count);
+
+    uint8_t *buf = malloc(max_len);
+    if (!buf) {
+        fprintf(stderr, "Could not allocate the mutation buffer\n");
+        corpus_free(&corpus);
+        return 1;
+    }
+
+    uint64_t state = seed;
+    for (long run = 0; run < runs; run++) {
+        size_t size = 0;
+        if (corpus.count > 0) {
+            const Input *base = &corpus.inputs[next_random(&state) % (uint64_t) corpus.count];
+            size              = base->size < max_len ? base->size : max_len;
+            memcpy(buf, base->data, size);
+        }
+
+        int mutations = 1 + (int) (next_random(&state) % MAX_MUTATIONS);
+        for (int m = 0; m < mutations; m++) {
+            size = mutate(buf, size, max_len, &corpus, &state);
+        }
+        run_one(buf, size);
+    }
+
+    double elapsed = now_seconds() - start;
+    long   execs   = runs + corpus.count;
+    fprintf(stderr, "%ld execs in %.2f s (%.0f execs/s), seed %llu\n", execs, elapsed,
+            elapsed > 0 ? execs / elapsed : 0.0, (unsigned long long) seed);
+
+    free(buf);
+    corpus_free(&corpus);
+    return 0;
+}
+
+/**
+ * @brief Adds a file, or every regular file in a directory, to the corpus.
+ *
+ * @param corpus The corpus to extend.
+ * @param path The file or directory.
+ * @return True on success.
+ */
+static bool corpus_add_path(Corpus *corpus, const char *path) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return false;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        return corpus_add_file(corpus, path);
+    }
+
+    DIR *dir = opendir(path);
+    if (!dir) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return false;
+    }
+
+    bool           ok = true;
+    struct dirent *entry;
+    while (ok && (entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+
+        size_t length = strlen(path) + strlen(entry->d_name) + 2;
+        char  *child  = malloc(length);
+        if (!child) {
+            ok = false;
+            break;
+        }
+        snprintf(child, length, "%s/%s", path, entry->d_name);
+        if (stat(child, &st) == 0 && S_ISREG(st.st_mode)) {
+            ok = corpus_add_file(corpus, child);
+        }
+        free(child);
+    }
+    closedir(dir);
+    return ok;
+}
+
+/**
+ * @brief Reads a file into the corpus.
+ *
+ * @param corpus The corpus to extend.
+ * @param path The file to read.
+ * @return True on success.
+ */
+static bool corpus_add_file(Corpus *corpus, const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return false;
+    }
+
+    fseek(file, 0L, SEEK_END);
+    long size = ftell(file);
+    rewind(file);
+
+    if (corpus->count == corpus->capacity) {
+        int    capacity = corpus->capacity ? corpus->capacity * 2 : 64;
+        Input *inputs   = realloc(corpus->inputs, capacity * sizeof(Input));
+        if (!inputs) {
+            fclose(file);
+            return false;
+        }
+        corpus->inputs   = inputs;
+        corpus->capacity = capacity;
+    }
+
+    Input *input = &corpus->inputs[corpus->count];
+    input->data  = malloc(size > 0 ? (size_t) size : 1);
+    input->size  = size > 0 ? fread(input->data, 1, (size_t) size, file) : 0;
+    fclose(file);
+    if (!input->data) {
+        return false;
+    }
+
+    corpus->count++;
+    return true;
+}
+
+/**
+ * @brief Releases every input of the corpus.
+ *
+ * @param corpus The corpus to release.
+ */
+static void corpus_free(Corpus *corpus) {
+    for (int i = 0; i < corpus->count; i++) {
+        free(corpus->inputs[i].data);
+    }
+    free(corpus->inputs);
+    corpus->inputs   = NULL;
+    corpus->count    = 0;
+    corpus->capacity = 0;
+}
+
+/**
+ * @brief Advances a pseudo-random generator (splitmix64).
+ *
+ * @param state The generator state.
+ * @return The next pseudo-random value.
+ */
+static uint64_t next_random(uint64_t *state) {
+    uint64_t z = (*state += 0x9e3779b97f4a7c15u);
+    z          = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9u;
+    z          = (z ^ (z >> 27)) * 0x94d049bb133111ebu;
+    return z ^ (z >> 31);
+}
+
+/**
+ * @brief Applies one random mutation to an input.
+ *
+ * @param buf The input to mutate, with room for `max_len` bytes.
+ * @param size The input's current size.
+ * @param max_len The largest size the input may grow to.
+ * @param corpus Inputs to splice from.
+ * @param state The pseudo-random generator state.
+ * @return The input's new size.
+ */
+static size_t mutate(uint8_t *buf, size_t size, size_t max_len, const Corpus *corpus,
+                     uint64_t *state) {
+    uint64_t r   = next_random(state);
+    size_t   pos = size > 0 ? (size_t) (next_random(state) % size) : 0;
+
+    switch (r % 6) {
+        case 0:  // Flip a bit
+            if (size > 0) {
+                buf[pos] ^= (uint8_t) (1u << (r >> 8) % 8);
+            }
+            return size;
+        case 1:  // Overwrite a byte
+            if (size > 0) {
+                buf[pos] = (uint8_t) (r >> 8);
+            }
+            return size;
+        case 2: {  // Delete a range
+            size_t length = 1 + (size_t) ((r >> 8) % 16);
+            if (pos + length > size) {
+                length = size - pos;
+            }
+            memmove(buf + pos, buf + pos + length, size - pos - length);
+            return size - length;
+        }
+        case 3:
+        case 4: {  // Insert a dictionary token
+            const char *token  = dictionary[(r >> 8) % (sizeof(dictionary) / sizeof(dictionary[0]))];
+            size_t      length = strlen(token);
+            if (size + length > max_len) {
+                return size;
+            }
+            memmove(buf + pos + length, buf + pos, size - pos);
+            memcpy(buf + pos, token, length);
+            return size + length;
+        }
+        default: {  // Splice in the tail of another input
+            if (corpus->count == 0) {
+                return size;
+            }
+            const Input *other = &corpus->inputs[(r >> 8) % (uint64_t) corpus->count];
+            if (other->size == 0) {
+                return size;
+            }
+            size_t from   = (size_t) (next_random(state) % other->size);
+            size_t length = other->size - from;
+            if (pos + length > max_len) {
+                length = max_len - pos;
+            }
+            memcpy(buf + pos, other->data + from, length);
+            return pos + length;
+        }
+    }
+}
+
+/**
+ * @brief Executes one input, remembering it in case the process dies.
+ *
+ * @param data The input bytes.
+ * @param size The number of input bytes.
+ */
+static void run_one(const uint8_t *data, size_t size) {
+    current_data = data;
+    current_size = size;
+    LLVMFuzzerTestOneInput(data, size);
+    current_data = NULL;
+}
+
+/**
+ * @brief Writes the input being executed to CRASH_PATH.
+ *
+ * Only uses async-signal-safe functions.
+ */
+static void save_crash(void) {
+    if (!current_data) {
+        return;
+    }
+
+    int fd = open(CRASH_PATH, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return;
+    }
+    ssize_t written = write(fd, current_data, current_size);
+    close(fd);
+    if (written >= 0) {
+        static const char message[] = "Crashing input written to " CRASH_PATH "\n";
+        written = write(STDERR_FILENO, message, sizeof(message) - 1);
+    }
+    (void) written;
+}
+
+/**
+ * @brief Saves the crashing input and re-raises the fatal signal.
+ *
+ * @param sig The signal that was received.
+ */
+static void on_signal(int sig) {
+    save_crash();
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+/**
+ * @brief Returns a monotonic timestamp in seconds.
+ *
+ * @return The current value of the monotonic clock.
+ */
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
@@ -0,0 +1,96 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "command.h"
+#include "heap.h"
+#include "interpreter.h"
+#include "label_map.h"
+#include "lexer.h"
+#include "link.h"
+#include "macro.h"
+#include "mem.h"
+#include "parser.h"
+
+#define FUZZ_INSTRUCTION_LIMIT 100000  // Commands per input before giving up
+#define FUZZ_TIER_THRESHOLD 2          // Low thresholds so short inputs reach the tiers
+#define FUZZ_TRACE_THRESHOLD 2
+#define FUZZ_LABEL_BUCKETS 16          // Inputs define few labels; keeps per-input setup cheap
+
+int LLVMFuzzerInitialize(int *argc, char ***argv);
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+int LLVMFuzzerInitialize(int *argc, char ***argv) {
+    (void) argc;
+    (void) argv;
+    // Programs print freely; writing that to a terminal would dominate the run time
+    if (!freopen("/dev/null", "w", stdout)) {
+        perror("Failed to silence stdout");
+    }
+    // Programs that read must see the end of the input rather than wait for it
+    if (!freopen("/dev/null", "r", stdin)) {
+        perror("Failed to detach stdin");
+    }
+    return 0;
+}
+
+/**
+ * @brief Lexes, parses and interprets one input in-process.
+ *
+ * Memory is reset before every input and execution stops after
+ * FUZZ_INSTRUCTION_LIMIT commands, so inputs are independent and always
+ * terminate. The native backend is left disabled because it is only reachable
+ * on x86-64 and shares the compiled tier's lowering.
+ *
+ * @param data The input bytes; a NUL byte ends the program early.
+ * @param size The number of input bytes.
+ * @return Always 0.
+ */
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    char *src = malloc(size + 1);
+    if (!src) {
+        return 0;
+    }
+    memcpy(src, data, size);
+    src[size] = '\0';
+
+    mem_reset();
+    heap_reset(false);
+
+    LabelMap lbm;
+    if (!label_map_init(&lbm, FUZZ_LABEL_BUCKETS)) {
+        free(src);
+        return 0;
+    }
+
+    Lexer      l;
+    TokenArray tokens;
+    lexer_init(&l, src);
+    MacroError macro_error;
+    if (!lexer_tokenize(&l, &tokens) || !expand_macros(&tokens, &macro_error)) {
+        token_array_free(&tokens);
+        label_map_free(&lbm);
+        free(src);
+        return 0;
+    }
+
+    Parser p;
+    parser_init(&p, &tokens, &lbm);
+    Command *commands = parse_commands(&p);
+    token_array_free(&tokens);
+
+    if (!p.had_error && link_builtins(commands)) {
+        Interpreter i;
+        interpreter_init(&i, &lbm);
+        i.tier_threshold    = FUZZ_TIER_THRESHOLD;
+        i.trace_threshold   = FUZZ_TRACE_THRESHOLD;
+        i.instruction_limit = FUZZ_INSTRUCTION_LIMIT;
+        interpret(&i, commands);
+    }
+
+    free_command(commands);
+    label_map_free(&lbm);
+    free(src);
+    return 0;
+}
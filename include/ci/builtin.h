@@ -0,0 +1,54 @@
+#ifndef CI_BUILTIN_H
+#define CI_BUILTIN_H
+#include <stdbool.h>
+#include "interpreter.h"
+
+#define BUILTIN_PREFIX "__builtin_"  // Calls to labels starting with this run builtins
+
+/**
+ * @brief Routines implemented natively and invoked with `call __builtin_name`.
+ *
+ * Arguments are passed in x0, x1, ... and the result is returned in x0. Like
+ * an ordinary call, a builtin leaves x1 through x31 untouched.
+ */
+typedef enum {
+    BUILTIN_ITOA,     // x0 = length of the decimal string of x0 written at x1
+    BUILTIN_STRLEN,   // x0 = length of the string at x0
+    BUILTIN_COPY,     // copies x2 bytes from x1 to x0 (ranges may overlap), x0 unchanged
+    BUILTIN_COMPARE,  // x0 = -1, 0 or 1 as the string at x0 sorts before, equal to or
+                      // after the string at x1
+    BUILTIN_HASH,     // x0 = 64-bit FNV-1a hash of the x1 bytes at x0
+    BUILTIN_SORT,     // sorts the x1 8-byte signed integers at x0 ascending, x0 unchanged
+    BUILTIN_COUNT,    // Number of builtins
+} Builtin;
+
+/**
+ * @brief Looks up a builtin by the label used to call it.
+ *
+ * @param label The called label, e.g. `__builtin_strlen`.
+ * @return The builtin, or -1 if there is no builtin of that name.
+ */
+int builtin_lookup(const char *label);
+
+/**
+ * @brief Determines whether a label is reserved for builtins.
+ *
+ * @param label The label to check.
+ * @return True if `label` starts with `BUILTIN_PREFIX`.
+ */
+bool builtin_reserved(const char *label);
+
+/**
+ * @brief Runs a builtin on the interpreter's registers and memory.
+ *
+ * Every memory range a builtin accesses is checked before anything is
+ * written, so a failed builtin has no effect and may be retried.
+ *
+ * @param intr The interpreter whose state the builtin operates on.
+ * @param builtin The builtin to run.
+ * @return True on success, false if the builtin accessed memory out of
+ * bounds or, when debugging the heap, in a freed block.
+ */
+bool builtin_run(Interpreter *intr, int builtin);
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef CI_CFG_H
+#define CI_CFG_H
+#include <stdbool.h>
+#include <stdint.h>
+#include "command.h"
+#include "label_map.h"
+
+struct tier_code;
+
+/**
+ * @brief Represents a basic block: a straight-line run of commands with a
+ * single entry (its leader) and a single exit (its last command).
+ */
+typedef struct basic_block {
+    Command            *first;         // The leader of the block.
+    Command            *last;          // The final command of the block.
+    int                 length;        // The number of commands in the block.
+    int                 id;            // The index of this block within its CFG.
+    struct basic_block *taken;         // Successor when the final branch/call is taken.
+    struct basic_block *fallthrough;   // Successor when execution falls through.
+    bool                loop_header;   // Set if a backward branch targets this block.
+    uint64_t            exec_count;    // How often the interpreter entered this block.
+    uint64_t            loop_count;    // How often the interpreter arrived at this loop header.
+    bool                tier_failed;   // Set if the block could not be compiled.
+    bool                trace_failed;  // Set if no trace could be recorded from this header.
+    struct tier_code   *code;          // Compiled code for this block, or NULL.
+    struct tier_code   *trace;         // Trace compiled from this loop header, or NULL.
+} BasicBlock;
+
+/**
+ * @brief Represents the control flow graph of a parsed program.
+ */
+typedef struct {
+    BasicBlock *blocks;  // The blocks of the program, in source order.
+    int         count;   // The number of blocks.
+} Cfg;
+
+/**
+ * @brief Splits a list of commands into basic blocks.
+ *
+ * A command leads a block if it is the first command, is marked by a label,
+ * or follows a branch, call or return. Each leader's `block` field is set to
+ * its block; all other commands have their `block` field cleared. Blocks
+ * targeted by a branch at or after them in source order are loop headers.
+ *
+ * @param cfg Pointer to the `Cfg` to initialize.
+ * @param commands Pointer to the first `Command` of the program.
+ * @param map Pointer to the `LabelMap` used to resolve branch targets.
+ * @return True if the graph was built, false if allocation failed.
+ */
+bool cfg_build(Cfg *cfg, Command *commands, LabelMap *map);
+
+/**
+ * @brief Frees the blocks of a control flow graph and any compiled code they
+ * own, clearing the `block` field of every leader.
+ *
+ * @param cfg Pointer to the `Cfg` to free.
+ */
+void cfg_free(Cfg *cfg);
+
+/**
+ * @brief Determines whether the given command ends a basic block.
+ *
+ * @param cmd The command to check.
+ * @return True if control may leave the straight-line sequence after `cmd`.
+ */
+bool cfg_ends_block(const Command *cmd);
+
+#endif
@@ -1,15 +1,44 @@
 #ifndef CI_CMD_ARGS_CONFIG_H
 #define CI_CMD_ARGS_CONFIG_H
 #include <stdbool.h>
+#include "gen.h"
+#include "state.h"
 
 typedef struct {
-    bool  print_lex;     // Lex; do not parse
-    bool  print_parse;   // Print result of parsing. Implicitly performs lexing
-    bool  repl;          // Set when no arguments are supplied
-    char *in_filename;   // What are we running?
-    char *out_filename;  // File to output to
+    bool  print_lex;           // Lex; do not parse
+    bool  print_parse;         // Print result of parsing. Implicitly performs lexing
+    bool  repl;                // Set when no arguments are supplied
+    char *in_filename;         // What are we running?
+    char *out_filename;        // File to output to
+    bool  stats;               // Print execution statistics to stderr
+    int   tier_threshold;      // Block entries before compiling a block; 0 disables the tier
+    int   trace_threshold;     // Loop iterations before recording a trace; 0 disables tracing,
+                               // TRACE_AUTO_THRESHOLD traces only with --native
+    bool  native;              // Translate compiled blocks into native code
+    bool  no_bce;              // Check every memory access instead of proving some in bounds
+    bool  no_gvn;              // Run the program as written, without value numbering
+    bool  no_memo;             // Run every call instead of caching results of pure functions
+    int   max_instructions;    // Commands to execute before stopping; 0 is unlimited
+    bool  diff_test;           // Cross-check every execution engine on the inputs
+    char *reference_path;      // Reference binary used by the differential tester
+    char **inputs;             // Programs given as positional arguments
+    int   input_count;         // Number of positional arguments
+    bool  gen;                 // Print a random program instead of running one
+    GenConfig gen_config;      // Knobs of the program generator
+    char *cache_dir;           // Where compiled library modules are cached
+    bool  no_cache;            // Always compile included modules from source
+    char *object_path;         // Compile the input into this object file instead of running it
+    bool  heap_debug;          // Detect double frees and uses of freed heap blocks
+    StateFormat state_format;  // Format of the final state
+    char *state_path;          // File the final state is written to instead of stdout
+    bool  watch;               // Re-run the input every time it changes, without value numbering
+    char *profile_out;         // File execution counts are written to
+    char *profile_in;          // Profile the code layout is optimized for
+    int   workers;             // Threads the inputs are scheduled on; 0 runs a single input
+    int   slice;               // Commands a scheduled program of priority 1 runs per turn
 } CmdArgsConfig;
 
+void config_init(CmdArgsConfig *conf);
 void config_free(CmdArgsConfig *conf);
 bool parse_cmd_args(CmdArgsConfig *conf, char **args, int arg_count);
 
@@ -4,6 +4,8 @@
 #include <stdint.h>
 #include "command_type.h"
 
+#define REG_SP 32  // Register number of sp, the stack pointer
+
 /**
  * @brief Enum representing different branching conditions for commands.
  */
@@ -44,6 +46,14 @@ typedef struct cmd {
     bool            is_a_string;       // Indicates if the first operand is a string.
     bool            is_b_string;       // Indicates if the second operand is a string.
     BranchCondition branch_condition;  // The branching condition for the command.
+    struct basic_block *block;         // The basic block this command leads, or NULL if
+                                       // the command is not a block leader.
+    int64_t address;                   // Position in the program, counting from 1; used as
+                                       // a return address by `.callmode return`.
+    bool in_bounds;                    // Set if range analysis proved this load, store or
+                                       // put stays within memory, so it is not checked.
+    const struct memo_function *memo;  // Set on calls of a pure function, whose results
+                                       // are cached.
 } Command;
 
 /**
@@ -89,6 +89,56 @@ typedef enum {
     // sub x0 x1 5
     // Can either be variable variable variable or variable variable number
     CMD_SUB,
+
+    // call __builtin_strlen
+    // A call the linker resolved to a builtin; the builtin is in val_a
+    // Kept last so the numbers of the other commands stay stable
+    CMD_BUILTIN,
+
+    // ccall crc32
+    // Always followed by a function imported with .import; the linker puts
+    // the function's index in val_a
+    CMD_CCALL,
+
+    // alloc x0 x1
+    // alloc x0 16
+    // Always variable followed by a variable or number: the size in bytes
+    CMD_ALLOC,
+
+    // free x0
+    // Always followed by a variable holding a block from alloc or realloc
+    CMD_FREE,
+
+    // realloc x0 x1 x2
+    // realloc x0 x1 32
+    // Always variable variable, then a variable or number: the new size
+    CMD_REALLOC,
+
+    // push x0
+    // push {x1-x4}
+    // Always a variable or a range of variables: the first in val_a, the last
+    // in val_b
+    CMD_PUSH,
+
+    // pop x0
+    // pop {x1-x4}
+    // Same operands as push, except that sp cannot be popped
+    CMD_POP,
+
+    // write 1 x0 x1
+    // write 1 x0 64
+    // Always a file descriptor number, a variable holding the address, then a
+    // variable or number: the length in bytes
+    CMD_WRITE,
+
+    // read 0 x0 x1
+    // read 0 x0 64
+    // Same operands as write; the length is the most bytes to read
+    CMD_READ,
+
+    // Has no mnemonic; ends the program. The linker appends one after the
+    // main module so that falling off its end does not run into a module
+    CMD_HALT,
 } CommandType;
 
 #endif
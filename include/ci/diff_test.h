@@ -0,0 +1,30 @@
+#ifndef CI_DIFF_TEST_H
+#define CI_DIFF_TEST_H
+#include "cmd_args_config.h"
+
+#define DIFF_TEST_TIMEOUT 5                 // Seconds an engine may run one program
+#define DIFF_TEST_MAX_OUTPUT (16u << 20)    // Bytes of output kept per engine run
+#define DIFF_TEST_DEFAULT_REFERENCE "./ci_reference"
+
+/**
+ * @brief Runs every input program through every execution engine and compares
+ * the results.
+ *
+ * Each engine (the plain interpreter, the compiled tier, the tracing tier, the
+ * native backend and the reference binary) runs in its own process so crashes
+ * and infinite loops are contained. Program output, the final register and flag
+ * state and the memory dump must match across engines. When two engines
+ * disagree the program is minimized by deleting lines for as long as the
+ * divergence persists, and the minimized program is printed. Programs only the
+ * reference fails to parse are reported as unsupported by the reference rather
+ * than as divergences.
+ *
+ * @param conf The configuration holding the inputs and the reference path.
+ * @param self_path Path used to re-execute this binary if /proc/self/exe is
+ * unavailable.
+ * @return 0 if all engines agreed on every program, 1 if any diverged, -1 if
+ * the harness itself failed.
+ */
+int run_diff_test(const CmdArgsConfig *conf, const char *self_path);
+
+#endif
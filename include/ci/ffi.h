@@ -0,0 +1,91 @@
+#ifndef CI_FFI_H
+#define CI_FFI_H
+#include <stdbool.h>
+#include "interpreter.h"
+
+#define FFI_MAX_ARGS 8  // Registers passed to a foreign function, x0 through x7
+
+/**
+ * @brief A foreign function bound with .import.
+ *
+ * The signature describes x0, x1, ... in order, one letter per register:
+ *
+ * - `i` an integer, passed unchanged (the default for unlisted registers)
+ * - `p` an address of a buffer in memory, optionally followed by the digit of
+ *   the register holding the buffer's length; without a digit the length is
+ *   in the next register
+ * - `s` an address of a NUL-terminated string in memory
+ *
+ * Addresses are checked against the memory backend on every call and passed
+ * as host pointers.
+ */
+typedef struct {
+    char *symbol;                 // Name of the function in its library
+    char  kinds[FFI_MAX_ARGS];    // Kind of each argument register: 'i', 'p' or 's'
+    int   lengths[FFI_MAX_ARGS];  // Register holding the length of each 'p' argument
+    void (*function)(void);       // Address of the function
+} FfiFunction;
+
+/**
+ * @brief The libraries and functions a program imports.
+ */
+typedef struct ffi_table {
+    FfiFunction *functions;      // Imported functions, in import order
+    int          count;          // Number of functions
+    void       **libraries;      // Handles of the opened libraries
+    int          library_count;  // Number of libraries
+} FfiTable;
+
+/**
+ * @brief Initializes an empty table.
+ *
+ * @param ffi The table to initialize.
+ */
+void ffi_init(FfiTable *ffi);
+
+/**
+ * @brief Opens a library and binds one of its functions.
+ *
+ * @param ffi The table to add the function to.
+ * @param library The library, as passed to dlopen.
+ * @param symbol The function's name.
+ * @param signature The kinds of the function's arguments; see `FfiFunction`.
+ * @param error Set to a description of the failure, valid until the next call.
+ * @return True on success, false if the library or function could not be
+ * loaded or the signature is malformed.
+ */
+bool ffi_import(FfiTable *ffi, const char *library, const char *symbol, const char *signature,
+                const char **error);
+
+/**
+ * @brief Finds an imported function by name.
+ *
+ * @param ffi The table to search.
+ * @param symbol The function's name.
+ * @return The index of the function, or -1 if it was not imported.
+ */
+int ffi_lookup(const FfiTable *ffi, const char *symbol);
+
+/**
+ * @brief Calls an imported function with x0 through x7 as its arguments.
+ *
+ * The arguments are passed as 64-bit integers in the order of the System V
+ * calling convention and the function's integer result is stored in x0.
+ *
+ * @param intr The interpreter making the call.
+ * @param ffi The table holding the function.
+ * @param index The index of the function.
+ * @return True on success, false if an address argument was out of bounds or,
+ * when debugging the heap, touched a freed block, in which case the function
+ * was not called and an error was printed.
+ */
+bool ffi_call(Interpreter *intr, const FfiTable *ffi, int index);
+
+/**
+ * @brief Closes the libraries and releases the table.
+ *
+ * @param ffi The table to release.
+ */
+void ffi_free(FfiTable *ffi);
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef CI_GEN_H
+#define CI_GEN_H
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define GEN_MAX_LOOP_DEPTH 4  // One reserved counter register per nesting level
+#define GEN_OP_NONE -1        // `op` of a random program
+#define GEN_OP_LIST -2        // `op` that lists the microbenchmarked command forms
+
+/**
+ * @brief Instruction classes whose relative frequency can be configured.
+ */
+typedef enum {
+    GEN_ALU,    // mov, add, sub, and, eor, orr
+    GEN_SHIFT,  // asr, lsl, lsr
+    GEN_CMP,    // cmp, cmp_u, and forward conditional branches
+    GEN_MEM,    // load, store
+    GEN_PRINT,  // print
+    GEN_CLASS_COUNT,
+} GenClass;
+
+/**
+ * @brief Knobs controlling the shape of generated programs.
+ */
+typedef struct {
+    uint64_t seed;                  // Seed of the pseudo-random generator
+    int      length;                // Static instructions to emit, excluding scaffolding
+    int      labels;                // Forward branch targets to emit
+    int      loop_depth;            // Maximum loop nesting depth
+    int      max_trips;             // Maximum iterations of a single loop
+    int      call_depth;            // Length of the chain of called functions
+    int      exec_budget;           // Estimated commands a run may execute; loops past it
+                                    // run fewer trips
+    int      mem_footprint;         // Bytes of memory accessed, starting at address 0
+    int      mix[GEN_CLASS_COUNT];  // Relative weight of each instruction class
+    int      op;                    // Command form to microbenchmark, or GEN_OP_NONE
+} GenConfig;
+
+/**
+ * @brief Sets every knob of the generator to its default.
+ *
+ * @param cfg The configuration to initialize.
+ */
+void gen_config_init(GenConfig *cfg);
+
+/**
+ * @brief Sets a generator knob from a command line option.
+ *
+ * Recognized options are `--seed`, `--gen-length`, `--gen-labels`,
+ * `--gen-loops`, `--gen-trips`, `--gen-calls`, `--gen-budget`, `--gen-mem`,
+ * `--gen-mix` and `--gen-op`. The instruction mix is given as a comma-separated list of
+ * `class=weight` pairs, where class is one of alu, shift, cmp, mem and print.
+ * `--gen-op` takes the name of a command form, such as `add.imm`, or `list`.
+ *
+ * @param cfg The configuration to modify.
+ * @param option The option name, including the leading dashes.
+ * @param value The option's value.
+ * @return True if the option was recognized and its value is valid.
+ */
+bool gen_set_option(GenConfig *cfg, const char *option, const char *value);
+
+/**
+ * @brief Generates a random program, or a microbenchmark of one command form.
+ *
+ * Generated programs always parse and always terminate: loops count a
+ * reserved register up to a constant, conditional branches only jump forward,
+ * and functions only call functions defined after them. Nested loops and
+ * calls from loops multiply the commands a run executes, so each loop's trips
+ * are cut down once the estimate would pass `exec_budget`. Memory accesses
+ * stay within the configured footprint and shift amounts stay below 64.
+ *
+ * When `op` names a command form, the program instead runs a loop of
+ * `max_trips` turns whose body repeats the form `length` times; the form
+ * `loop` repeats nothing, and times the loop alone. Some forms are pairs of
+ * commands, such as `call.ret` or `alloc.free`. Forms that write or read do
+ * so on stdout and stdin. With GEN_OP_LIST, the names of the forms are
+ * written one per line.
+ *
+ * @param cfg The knobs to generate with. The same configuration always
+ * produces the same program.
+ * @param out The stream to write the program to.
+ * @return True on success, false if the configuration is invalid.
+ */
+bool gen_program(const GenConfig *cfg, FILE *out);
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef CI_GVN_H
+#define CI_GVN_H
+
+#include <stdbool.h>
+#include "command.h"
+#include "label_map.h"
+
+#define GVN_EXPRESSIONS 64  // Computations remembered along a path of blocks
+
+/**
+ * @brief What value numbering changed in a program.
+ */
+typedef struct {
+    int removed;     // Computations whose result was already in place, deleted.
+    int cmps;        // Comparisons whose flags were already set, deleted.
+    int folded;      // Computations replaced by a `mov` of their constant result.
+    int reused;      // Computations replaced by a copy of a register holding the result.
+    int propagated;  // Operands replaced by an equal register or an immediate.
+} GvnStats;
+
+/**
+ * @brief Removes redundant computations from a program by value numbering.
+ *
+ * Every register is given the number of the value it holds, and equal
+ * computations of equal values get equal numbers. Numbers flow from a block
+ * into each successor it is the only predecessor of: across a call into its
+ * callee, and across the return into the command after the call, where
+ * `x1`..`x31` are restored but `x0`, sp and the flags are not.
+ *
+ * A computation whose result its destination already holds is deleted, as
+ * is a `cmp` of values whose comparison set the flags last. Other
+ * computations become a `mov` of their result when it is constant, or a copy
+ * of a register that holds it, and their operands are replaced by the first
+ * register holding the same value, or an immediate where one is allowed.
+ * Block leaders are never deleted, so labels stay valid.
+ *
+ * Programs using `.callmode return` must not be optimized: their `ret` may
+ * continue at any command.
+ *
+ * @param commands The first command of the program.
+ * @param map The program's labels.
+ * @param stats Receives what changed.
+ * @return True on success, false if memory ran out; the program is still
+ * correct then, but may be only partly optimized.
+ */
+bool gvn_optimize(Command *commands, LabelMap *map, GvnStats *stats);
+
+#endif
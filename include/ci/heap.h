@@ -0,0 +1,139 @@
+#ifndef CI_HEAP_H
+#define CI_HEAP_H
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "mem.h"
+
+#define HEAP_BASE 512                 // First byte of memory managed by `alloc`
+#define HEAP_END STACK_BASE           // One past the last byte of the heap
+#define HEAP_GRANULE 8                // Size and alignment of the smallest block
+#define HEAP_CLASSES 6                // Size classes: 8, 16, ..., 256 bytes
+#define HEAP_QUARANTINE 8             // Freed blocks held back from reuse in debug mode
+#define HEAP_GRANULES ((HEAP_END - HEAP_BASE) / HEAP_GRANULE)
+
+/**
+ * @brief Allocation statistics, reported by --stats.
+ */
+typedef struct {
+    uint64_t allocs;       // Successful alloc and realloc allocations
+    uint64_t frees;        // Blocks freed, including by realloc
+    uint64_t reallocs;     // realloc instructions executed
+    uint64_t failures;     // Allocations that ran out of memory
+    uint64_t reused;       // Allocations served from a free list
+    uint64_t splits;       // Larger free blocks split to serve an allocation
+    uint64_t in_use;       // Bytes currently allocated, by requested size
+    uint64_t peak_in_use;  // Highest value of `in_use`
+} HeapStats;
+
+/**
+ * @brief The bookkeeping of one heap.
+ *
+ * It lives outside ASML memory, so a program that overruns a block cannot
+ * corrupt it. Lists store granule + 1; 0 ends a list, so a zeroed heap is
+ * empty.
+ */
+typedef struct {
+    uint8_t   states[HEAP_GRANULES];        // BlockState of each granule
+    uint8_t   classes[HEAP_GRANULES];       // Size class of each block
+    uint16_t  sizes[HEAP_GRANULES];         // Requested size of each allocated block
+    uint16_t  next_free[HEAP_GRANULES];     // Next block of the same free list
+    uint16_t  free_lists[HEAP_CLASSES];     // First free block of each class
+    bool      poisoned[HEAP_GRANULES];      // Granules of freed blocks, while debugging
+    uint16_t  quarantine[HEAP_QUARANTINE];  // Quarantined blocks, oldest first
+    int       quarantine_first;             // Index of the oldest quarantined block
+    int       quarantine_count;             // Number of quarantined blocks
+    int       top;                          // First granule never carved into a block
+    bool      debug;                        // Whether freed blocks are tracked
+    HeapStats stats;                        // Statistics since the last reset
+} Heap;
+
+/**
+ * @brief Makes every heap operation of the calling thread use the given heap.
+ *
+ * Threads start bound to one heap they all share. The heap manages the memory
+ * the thread bound with `mem_bind`.
+ *
+ * @param bound The heap, or NULL for the shared heap.
+ */
+void heap_bind(Heap *bound);
+
+/**
+ * @brief Empties the bound heap, as if nothing had been allocated.
+ *
+ * @param debug_mode Quarantine freed blocks and report accesses to them; see
+ * `heap_check`.
+ */
+void heap_reset(bool debug_mode);
+
+/**
+ * @brief Allocates a block of memory.
+ *
+ * Requests are rounded up to a power-of-two size class. A block is taken
+ * from the class's free list, carved from unused heap memory, or split from
+ * a free block of a larger class, in that order.
+ *
+ * @param size The number of bytes requested.
+ * @return The address of the block, or 0 if `size` is 0 or the heap is
+ * exhausted.
+ */
+uint64_t heap_alloc(int64_t size);
+
+/**
+ * @brief Frees a block returned by `heap_alloc` or `heap_realloc`.
+ *
+ * @param address The block, or 0 to do nothing.
+ * @return True on success, false if `address` is not an allocated block (an
+ * error message has been printed).
+ */
+bool heap_free(uint64_t address);
+
+/**
+ * @brief Resizes a block, moving it if it no longer fits its size class.
+ *
+ * An address of 0 allocates a new block; a size of 0 frees the block.
+ *
+ * @param address The block to resize, or 0.
+ * @param size The new size in bytes.
+ * @param result Set to the address of the resized block, or to 0 if the heap
+ * is exhausted, in which case the original block is left untouched.
+ * @return True on success, false if `address` is not an allocated block (an
+ * error message has been printed).
+ */
+bool heap_realloc(uint64_t address, int64_t size, uint64_t *result);
+
+/**
+ * @brief Checks that a memory access does not touch a freed block.
+ *
+ * Only blocks freed while debugging are tracked; without debugging every
+ * access passes.
+ *
+ * @param address The first byte accessed.
+ * @param bytes The number of bytes accessed.
+ * @return True if the access is allowed, false if it is a use after free (an
+ * error message has been printed).
+ */
+bool heap_check(uint64_t address, uint64_t bytes);
+
+/**
+ * @brief Returns whether freed blocks are being tracked.
+ *
+ * @return True if the heap was reset in debug mode.
+ */
+bool heap_debugging(void);
+
+/**
+ * @brief Returns the allocation statistics collected since the last reset.
+ *
+ * @return The statistics.
+ */
+const HeapStats *heap_stats(void);
+
+/**
+ * @brief Prints the allocation statistics in a human-readable format.
+ *
+ * @param out The stream to print to.
+ */
+void heap_print_stats(FILE *out);
+
+#endif
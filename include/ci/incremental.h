@@ -0,0 +1,97 @@
+#ifndef CI_INCREMENTAL_H
+#define CI_INCREMENTAL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "command.h"
+#include "label_map.h"
+
+/**
+ * @brief A run of source lines that lexes and parses independently of the
+ * rest of the program.
+ *
+ * Units end at a newline that closes a statement, so a label on a line of its
+ * own belongs to the unit of the command it marks.
+ */
+typedef struct {
+    int       first_line;  // First line of the unit (0-based).
+    int       lines;       // Number of lines the unit spans.
+    Command  *head;        // First command parsed from the unit, or NULL.
+    Command  *tail;        // Last command parsed from the unit, or NULL.
+    LabelMap *labels;      // Labels the unit defines, or NULL if it defines none.
+    bool      directive;   // Whether the unit uses a directive or macro.
+    bool      failed;      // Whether the unit did not lex or parse.
+    bool      open;        // Whether the unit ends in a label that marks no command yet.
+} SourceUnit;
+
+/**
+ * @brief A parsed program that can be brought up to date with an edited
+ * version of its source by lexing and parsing only the lines that changed.
+ *
+ * Only programs without directives and macros are kept as commands; those
+ * need the whole token stream and are left to the regular pipeline.
+ */
+typedef struct {
+    char       *text;           // The source the program was last built from.
+    uint32_t   *line_starts;    // Offset of each line in `text`, followed by its length.
+    int         line_count;     // Number of lines in `text`.
+    SourceUnit *units;          // The units covering every line, in order.
+    int         unit_count;     // Number of units.
+    int         directives;     // Units that use directives or macros.
+    int         failures;       // Units that did not lex or parse.
+    Command    *commands;       // Commands of all units, linked in source order.
+    LabelMap    label_map;      // Labels of all units, as a cold parse registers them.
+    bool        has_label_map;  // Whether `label_map` is initialized.
+} IncrementalProgram;
+
+/**
+ * @brief What an update of an incremental program had to redo.
+ */
+typedef struct {
+    int      lines_total;    // Lines in the new source.
+    int      lines_rebuilt;  // Lines lexed and parsed again.
+    int      units_rebuilt;  // Units lexed and parsed again.
+    bool     cold;           // Whether every line was rebuilt.
+    uint64_t build_ns;       // Wall time spent on the update.
+} IncrementalReport;
+
+/**
+ * @brief Initializes an empty incremental program.
+ *
+ * @param prog The program to initialize.
+ */
+void incremental_init(IncrementalProgram *prog);
+
+/**
+ * @brief Brings a program up to date with a new version of its source.
+ *
+ * Lines shared with the previous version at the start and end are kept; the
+ * units covering the rest are lexed and parsed again and spliced in, and
+ * their labels replace those of the units they replace. Commands of units
+ * that changed are freed, so they must not be kept across an update.
+ *
+ * @param prog The program to update.
+ * @param text The new source text.
+ * @param report Receives what the update did.
+ * @return True on success, false if memory ran out or the source is larger
+ * than 2 GiB. The program is empty afterwards.
+ */
+bool incremental_update(IncrementalProgram *prog, const char *text, IncrementalReport *report);
+
+/**
+ * @brief Returns whether the program's commands can be run as they are.
+ *
+ * @param prog The program.
+ * @return False if the source uses directives or macros, or has errors; the
+ * regular pipeline must build it instead.
+ */
+bool incremental_runnable(const IncrementalProgram *prog);
+
+/**
+ * @brief Releases the memory owned by an incremental program.
+ *
+ * @param prog The program to release. It is empty afterwards.
+ */
+void incremental_free(IncrementalProgram *prog);
+
+#endif
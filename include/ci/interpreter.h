@@ -1,25 +1,36 @@
 #ifndef CI_INTERPRETER_H
 #define CI_INTERPRETER_H
+#include <stdio.h>
 #include "command.h"
 #include "label_map.h"
+#include "memo.h"
+#include "profile.h"
+#include "stats.h"
 
-#define NUM_VARIABLES 32  // Maximum number of defined variables.
+#define NUM_VARIABLES 32                   // Maximum number of defined variables.
+#define NUM_REGISTERS (NUM_VARIABLES + 1)  // The variables followed by sp.
+
+struct ffi_table;
 
 /**
  * @brief Represents a single entry in the interpreter's call stack.
  */
 typedef struct st_entry {
-    Command         *command;                   // The command stored in this stack entry.
-    int64_t          variables[NUM_VARIABLES];  // Variables in this stack frame.
-    struct st_entry *next;                      // Pointer to the next stack entry.
+    Command            *command;                   // The command stored in this stack entry.
+    int64_t             variables[NUM_VARIABLES];  // Variables in this stack frame.
+    struct st_entry    *next;                      // Pointer to the next stack entry.
+    const MemoFunction *memo;                      // Function whose result is cached on
+                                                   // return, or NULL.
+    uint64_t            executed;                  // Commands executed when the call
+                                                   // was made.
 } StackEntry;
 
 /**
  * @brief Represents the state of the interpreter during execution.
  */
 typedef struct {
-    int64_t variables[NUM_VARIABLES];  // Array of variables used in the
-                                       // interpreter.
+    int64_t variables[NUM_REGISTERS];  // Array of variables used in the
+                                       // interpreter, followed by sp.
     bool had_error;                    // Flag indicating if an error occurred during
                                        // interpretation.
     LabelMap *label_map;               // Pointer to the map of labels for branch resolution.
@@ -27,7 +38,34 @@ typedef struct {
                                        //  (greater).
     bool        is_less;               // Flag indicating the result of the last comparison (less).
     bool        is_equal;              // Flag indicating the result of the last comparison (equal).
-    StackEntry *the_stack;             // Pointer to the top of the interpreter's stack.
+    StackEntry *the_stack;             // Pointer to the top of the interpreter's stack; each
+                                       // entry links to the frame below it.
+    int         tier_threshold;        // Block entries before a block is compiled; 0 disables
+                                       // the compiled tier.
+    int         trace_threshold;       // Loop header arrivals before a trace is recorded; 0
+                                       // disables tracing.
+    bool        native;                // Translate compiled blocks into native code.
+    uint64_t    instruction_limit;     // Commands to execute before stopping with an error; 0
+                                       // means unlimited.
+    uint64_t    executed;              // Commands executed so far, counted while a limit or
+                                       // slice is set.
+    ExecStats   stats;                 // Statistics collected during execution.
+    bool        heap_debug;            // Check loads and stores for uses of freed heap blocks.
+    struct ffi_table *ffi;             // Functions `ccall` can call, or NULL if none were
+                                       // imported.
+    bool        return_calls;          // Calls push only a return address onto the stack
+                                       // instead of saving every variable.
+    Command   **code;                  // The commands by address, while interpreting with
+                                       // `return_calls`.
+    int64_t     code_length;           // Number of entries in `code`.
+    Profile    *profile;               // Counts executed commands and taken branches, or
+                                       // NULL when not profiling.
+    MemoTable  *memo;                  // Caches the results of pure functions, or NULL when
+                                       // calls are not memoized.
+    uint64_t    slice;                 // Commands to execute before yielding at a backward
+                                       // branch or call; 0 runs the program to its end.
+    Command    *resume;                // Where the program continues after its slice ended,
+                                       // or NULL once it has stopped.
 } Interpreter;
 
 /**
@@ -41,12 +79,76 @@ void interpreter_init(Interpreter *intr, LabelMap *map);
 /**
  * @brief Executes a list of commands using the interpreter.
  *
+ * With a `slice`, only the interpreter runs, and it returns at the first
+ * backward branch or call taken after `slice` more commands, setting
+ * `resume`. Interpreting again continues from there, with the registers,
+ * flags and call stack the program had.
+ *
  * @param intr Pointer to the `Interpreter` that will execute the commands.
  * @param commands Pointer to the first `Command` in the list of commands to
  * interpret.
  */
 void interpret(Interpreter *intr, Command *commands);
 
+/**
+ * @brief Charges executed commands against the interpreter's instruction limit.
+ *
+ * Compiled code calls this once per block or loop iteration so that programs
+ * that never return to the interpreter still stop at the limit.
+ *
+ * @param intr Pointer to the `Interpreter` executing the commands.
+ * @param count Number of commands executed.
+ * @return True if execution may continue, false if the limit was exceeded.
+ */
+bool charge_instructions(Interpreter *intr, uint64_t count);
+
+/**
+ * @brief Determines whether a given branch condition holds.
+ *
+ * @param intr The pointer to the interpreter holding the result of the
+ * comparison.
+ * @param cond The condition to check.
+ * @return True if the given condition holds, false otherwise.
+ */
+bool cond_holds(Interpreter *intr, BranchCondition cond);
+
+/**
+ * @brief Pushes a call frame, saving the current variables.
+ *
+ * With `return_calls` only the return address is pushed, onto the memory
+ * stack at sp, and no variables are saved.
+ *
+ * @param intr Pointer to the `Interpreter` making the call.
+ * @param return_to The command to resume at once the callee returns.
+ * @return True if the frame was pushed, false if allocation failed or the
+ * stack overflowed.
+ */
+bool push_frame(Interpreter *intr, Command *return_to);
+
+/**
+ * @brief Pops the top call frame, restoring variables x1 through x31.
+ *
+ * x0 is left untouched so that it can carry a return value. With
+ * `return_calls` the return address is popped from the memory stack and
+ * nothing is restored.
+ *
+ * @param intr Pointer to the `Interpreter` returning from a call.
+ * @return The command to resume at, or NULL if the stack was empty or, with
+ * `return_calls`, the return address was invalid, in which case `had_error`
+ * is set.
+ */
+Command *pop_frame(Interpreter *intr);
+
+/**
+ * @brief Finds the command the top call frame returns to, without popping it.
+ *
+ * @param intr Pointer to the `Interpreter` inspecting its stack.
+ * @param return_to Set to the command `pop_frame` would resume at.
+ * @return True on success, false if the stack is empty or the return address
+ * is invalid.
+ */
+bool peek_frame(Interpreter *intr, Command **return_to);
+
 /**
  * @brief Prints the current state of the interpreter.
  *
@@ -54,7 +156,8 @@ void interpret(Interpreter *intr, Command *commands);
  * information in a human-readable format.
  *
  * @param intr Pointer to the `Interpreter` whose state is to be printed.
+ * @param out The stream to print to.
  */
-void print_interpreter_state(Interpreter *intr);
+void print_interpreter_state(Interpreter *intr, FILE *out);
 
 #endif
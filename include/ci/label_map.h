@@ -65,4 +65,29 @@ bool put_label(LabelMap *map, char *id, Command *command);
  */
 Entry *get_label(LabelMap *map, char *id);
 
+/**
+ * @brief Resolves a label to the command it marks.
+ *
+ * Unlike `get_label`, this walks the collision chain and only returns a
+ * command whose label matches `id` exactly.
+ *
+ * @param map Pointer to the label map.
+ * @param id The identifier for the label to resolve.
+ * @return The `Command` marked by the label, or NULL if the label is undefined.
+ */
+Command *find_label(LabelMap *map, char *id);
+
+/**
+ * @brief Removes a label from the map.
+ *
+ * Only the entry for `id` that marks `command` is removed, so a label defined
+ * more than once keeps its other definitions.
+ *
+ * @param map Pointer to the label map.
+ * @param id The identifier for the label to remove.
+ * @param command The `Command` the label marks.
+ * @return true if the label was found and removed, false otherwise.
+ */
+bool remove_label(LabelMap *map, char *id, Command *command);
+
 #endif
@@ -0,0 +1,42 @@
+#ifndef CI_LAYOUT_H
+#define CI_LAYOUT_H
+
+#include <stdbool.h>
+#include "command.h"
+#include "label_map.h"
+#include "profile.h"
+
+#define LAYOUT_LABEL_PREFIX "$pgo"  // Prefix of labels the layout adds; no source label has it
+
+/**
+ * @brief What a profile-guided layout changed.
+ */
+typedef struct {
+    int blocks;             // Basic blocks in the program.
+    int blocks_moved;       // Blocks no longer placed after their source predecessor.
+    int branches_inverted;  // Conditional branches inverted so the likely side falls through.
+    int jumps_inserted;     // Unconditional branches added to keep a fall-through edge.
+    int jumps_removed;      // Unconditional branches to the block placed next, dropped.
+} LayoutStats;
+
+/**
+ * @brief Reorders the basic blocks of a program so its hot paths fall
+ * through.
+ *
+ * Blocks are chained along their most frequent edges, hottest first, with the
+ * entry block first and the block that ends the program last. A conditional
+ * branch whose taken side is placed next is inverted when the inverse is
+ * exact: `b.eq` and `b.ne` always, the others once a `cmp` has run on every
+ * path. Unconditional branches are added where a fall-through edge is broken
+ * and dropped where their target is placed next.
+ *
+ * @param commands The first command of the program; updated to the new order.
+ * @param map The program's labels; labels for blocks that had none are added.
+ * @param profile Counts collected from this program by `--profile-out`.
+ * @param stats Receives what changed.
+ * @return True on success, false if memory ran out; the program is unchanged
+ * then.
+ */
+bool layout_apply(Command **commands, LabelMap *map, const Profile *profile, LayoutStats *stats);
+
+#endif
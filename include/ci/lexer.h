@@ -1,5 +1,7 @@
 #ifndef CI_LEXER_H
 #define CI_LEXER_H
+#include <stdbool.h>
+#include <stdint.h>
 #include "token.h"
 
 /**
@@ -17,6 +19,25 @@ typedef struct {
     int current_column;  // The current column number in the source string.
 } Lexer;
 
+/**
+ * @brief Every token of a source text, stored as a structure of arrays.
+ *
+ * Lexemes are stored as 32-bit offsets into the source text rather than
+ * pointers. Error tokens do not refer to the source; their offset indexes the
+ * lexer's table of error messages instead.
+ */
+typedef struct {
+    const char *text;        // The source text the offsets refer to.
+    char       *owned_text;  // `text` if the array owns it, NULL otherwise.
+    uint8_t    *types;       // TokenType of each token.
+    uint32_t   *offsets;     // Offset of each lexeme in `text`.
+    uint32_t   *lengths;     // Length of each lexeme.
+    uint32_t   *lines;       // Line of each token (1-based).
+    uint32_t   *columns;     // Column of each token (1-based).
+    int         count;       // Number of tokens, including the final TOK_EOF.
+    int         capacity;    // Allocated slots in each array.
+} TokenArray;
+
 /**
  * @brief Initializes the given lexer with the passed in string.
  *
@@ -33,6 +54,61 @@ void lexer_init(Lexer *lex, const char *text);
  */
 Token lexer_next_token(Lexer *lex);
 
+/**
+ * @brief Lexes the whole input stream into a token array.
+ *
+ * Lexing continues past error tokens so that the array holds exactly the
+ * tokens repeated calls to `lexer_next_token` would yield, up to and including
+ * the first TOK_EOF.
+ *
+ * @param lex A pointer to the lexer, the input stream. It is consumed.
+ * @param tokens The array to fill. Must be released with `token_array_free`,
+ * even on failure.
+ * @return True on success, false if memory ran out or the source is larger
+ * than 4 GiB.
+ */
+bool lexer_tokenize(Lexer *lex, TokenArray *tokens);
+
+/**
+ * @brief Returns the token at the given index of a token array.
+ *
+ * @param tokens The token array.
+ * @param index The index of the token. Indices past the end yield the final
+ * TOK_EOF token.
+ * @return The token at `index`.
+ */
+Token token_array_get(const TokenArray *tokens, int index);
+
+/**
+ * @brief Appends a token to a token array.
+ *
+ * @param tokens The token array to extend.
+ * @param type The token's type.
+ * @param offset The offset of the lexeme in the array's text, or the error
+ * message index of an error token.
+ * @param length The length of the lexeme.
+ * @param line The token's line (1-based).
+ * @param column The token's column (1-based).
+ * @return True on success, false if memory ran out.
+ */
+bool token_array_push(TokenArray *tokens, TokenType type, uint32_t offset, uint32_t length,
+                      uint32_t line, uint32_t column);
+
+/**
+ * @brief Releases the memory owned by a token array.
+ *
+ * @param tokens The token array to release. The source text is only freed if
+ * the array owns it.
+ */
+void token_array_free(TokenArray *tokens);
+
+/**
+ * @brief Prints the tokens of a token array, up to the first error or the end.
+ *
+ * @param tokens The token array to print.
+ */
+void print_token_array(const TokenArray *tokens);
+
 /**
  * @brief Prints the lexed tokens, consuming the input stream.
  *
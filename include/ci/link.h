@@ -0,0 +1,148 @@
+#ifndef CI_LINK_H
+#define CI_LINK_H
+#include <stdbool.h>
+#include "command.h"
+#include "ffi.h"
+#include "label_map.h"
+#include "lexer.h"
+
+#define LINK_DEFAULT_CACHE_DIR ".ci-cache"  // Where compiled library modules are kept
+
+/**
+ * @brief A foreign function named by .import.
+ */
+typedef struct {
+    char *library;    // The library, as written
+    char *symbol;     // The function
+    char *signature;  // Kinds of the function's arguments, "" if all are integers
+} LinkImport;
+
+/**
+ * @brief The linking directives of one module.
+ */
+typedef struct {
+    char      **includes;       // Paths named by .include, as written
+    int         include_count;  // Number of entries in `includes`
+    char      **globals;        // Labels exported by .global
+    int         global_count;   // Number of entries in `globals`
+    char      **externs;        // Labels declared by .extern
+    int         extern_count;   // Number of entries in `externs`
+    LinkImport *imports;        // Functions imported by .import
+    int         import_count;   // Number of entries in `imports`
+    bool        has_call_mode;  // Whether a .callmode directive was given
+    bool        return_calls;   // .callmode return: calls push only a return address
+    char      **nomemo;         // Functions named by .nomemo, whose calls are not cached
+    int         nomemo_count;   // Number of entries in `nomemo`
+} LinkDirectives;
+
+/**
+ * @brief Settings and results of a link.
+ */
+typedef struct {
+    const char *cache_dir;  // Directory of cached objects, or NULL to disable caching
+    int         modules;    // Set to the number of library modules linked
+    int         cached;     // Set to the number of those loaded from the cache
+} LinkOptions;
+
+/**
+ * @brief Removes the linking directives from a module's tokens.
+ *
+ * `.include "path"` links the module at `path`, relative to the including
+ * module. `.global label...` exports labels to other modules and
+ * `.extern label...` declares labels another module must export.
+ * `.import library symbol ["signature"]` binds a function of a shared library
+ * for `ccall`; see `FfiFunction` for the signature. `.callmode return` makes
+ * calls push only their return address onto the stack at sp, leaving saving
+ * registers to the callee; `.callmode frame`, the default, saves every
+ * register on each call. `.nomemo label...` keeps the calls of the named
+ * functions from being memoized. Each directive must be alone on its line.
+ *
+ * @param tokens The module's tokens. Directive lines are removed.
+ * @param dirs Filled with the directives found. Must be released with
+ * `link_directives_free`, even on failure.
+ * @return True on success, false if a directive is malformed or memory ran
+ * out. An error message has been printed on failure.
+ */
+bool link_collect_directives(TokenArray *tokens, LinkDirectives *dirs);
+
+/**
+ * @brief Determines whether a module is linked with other modules.
+ *
+ * @param dirs The module's directives.
+ * @return True if the module includes, exports and declares nothing, in which
+ * case `link_program` need not run. Imports do not count.
+ */
+bool link_directives_empty(const LinkDirectives *dirs);
+
+/**
+ * @brief Releases the memory owned by a module's directives.
+ *
+ * @param dirs The directives to release.
+ */
+void link_directives_free(LinkDirectives *dirs);
+
+/**
+ * @brief Links the modules a program includes into the program.
+ *
+ * Every included module is loaded once, from the cache if its compiled
+ * object is newer than its source and compiled (and cached) otherwise. Its
+ * commands are appended after the program's, behind a `ret` that ends the
+ * program where it used to fall off the end. Labels a library module does
+ * not export are renamed so they cannot clash across modules. References to
+ * labels a module does not define are relocations: they must name a label
+ * another module exports, or linking fails.
+ *
+ * @param commands The program's commands, extended in place.
+ * @param map The program's labels, extended with the modules' labels.
+ * @param dirs The program's directives.
+ * @param path The program's path, or NULL if it has none.
+ * @param options Link settings; receives the link statistics.
+ * @return True on success, false if linking failed. An error message has
+ * been printed on failure.
+ */
+bool link_program(Command **commands, LabelMap *map, const LinkDirectives *dirs,
+                  const char *path, LinkOptions *options);
+
+/**
+ * @brief Binds calls to builtins, which take precedence over labels.
+ *
+ * Every `call` whose label starts with `BUILTIN_PREFIX` becomes a
+ * `CMD_BUILTIN` that runs the builtin directly, without a call frame or a
+ * label lookup.
+ *
+ * @param commands The linked program's commands, rewritten in place.
+ * @return True on success, false if a call names an unknown builtin. An error
+ * message has been printed on failure.
+ */
+bool link_builtins(Command *commands);
+
+/**
+ * @brief Loads the program's imported functions and binds `ccall`s to them.
+ *
+ * Libraries whose name contains a slash are found relative to the program;
+ * other names are searched for like any shared library.
+ *
+ * @param commands The linked program's commands, rewritten in place.
+ * @param dirs The program's directives.
+ * @param path The program's path, or NULL if it has none.
+ * @param ffi Receives the imported functions. Must be released with
+ * `ffi_free`, even on failure.
+ * @return True on success, false if an import failed or a `ccall` names a
+ * function that was not imported. An error message has been printed on
+ * failure.
+ */
+bool link_imports(Command *commands, const LinkDirectives *dirs, const char *path,
+                  FfiTable *ffi);
+
+/**
+ * @brief Compiles a module into an object file that can be included.
+ *
+ * @param src The module's source text.
+ * @param path The module's path, used in error messages.
+ * @param object_path The object file to write.
+ * @return True on success, false otherwise. An error message has been
+ * printed on failure.
+ */
+bool link_emit_object(const char *src, const char *path, const char *object_path);
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef CI_MACRO_H
+#define CI_MACRO_H
+#include <stdbool.h>
+#include <stdint.h>
+#include "lexer.h"
+
+#define MACRO_MAX_DEPTH 64            // Nested macro invocations and .rept blocks
+#define MACRO_MAX_TOKENS (1 << 24)    // Tokens a program may expand to
+
+/**
+ * @brief Describes why macro expansion failed.
+ */
+typedef struct {
+    const char *message;  // Description of the error, or NULL if there was none.
+    uint32_t    line;     // Line of the offending token (1-based).
+} MacroError;
+
+/**
+ * @brief Expands assembler directives in a token array before it is parsed.
+ *
+ * Supported directives, each of which must start a line (optionally after a
+ * label):
+ *
+ * - `.macro name [params...]` ... `.endm` defines a macro. A line starting
+ *   with `name` is replaced by the macro's body, with every identifier
+ *   matching a parameter replaced by the corresponding argument. Macros must
+ *   be defined at the top level, before they are used.
+ * - `.rept count` ... `.endr` repeats its body `count` times.
+ * - `.equ name, value` defines a constant that replaces every later use of
+ *   `name`. `.set` does the same but may redefine an existing constant.
+ *
+ * Labels defined inside a macro or .rept body are local to each expansion,
+ * so a body containing a loop can be expanded any number of times.
+ *
+ * @param tokens The tokens to expand, replaced by the expanded tokens on
+ * success. Arrays without directives are left untouched.
+ * @param error Filled in on failure.
+ * @return True on success, false on a malformed directive or if memory ran
+ * out. `tokens` is unchanged on failure.
+ */
+bool expand_macros(TokenArray *tokens, MacroError *error);
+
+#endif
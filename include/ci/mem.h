@@ -3,8 +3,11 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
 
 #define MEM_CAPACITY 1024  // Maximum capacity of available memory.
+#define STACK_SIZE 256     // Bytes at the top of memory reserved for push, pop and calls
+#define STACK_BASE (MEM_CAPACITY - STACK_SIZE)  // Lowest address of the stack
 
 /**
  * @brief Loads the value from memory into the given destination.
@@ -27,8 +30,83 @@ bool mem_load(uint8_t *destination, size_t offset, size_t bytes);
 bool mem_store(uint8_t *source, size_t offset, size_t bytes);
 
 /**
- * @brief Prints the memory state to the console
+ * @brief Loads a little-endian value of the given width from memory.
+ *
+ * Unlike `mem_load`, the value is returned rather than written through a
+ * pointer, so callers need not pass the address of a register.
+ *
+ * @param addr The offset in memory where to start loading from.
+ * @param width The width of the value in bytes: 1, 2, 4 or 8.
+ * @param ok Set to true if the value could be loaded, false otherwise.
+ * @return The value, zero-extended, or 0 if it could not be loaded.
+ */
+uint64_t mem_load_value(uint64_t addr, int width, bool *ok);
+
+/**
+ * @brief Stores the low bytes of a value in memory.
+ *
+ * @param addr The offset in memory where to start storing.
+ * @param width The number of bytes to store: 1, 2, 4 or 8.
+ * @param value The value.
+ * @return True if the value was stored, false otherwise.
+ */
+bool mem_store_value(uint64_t addr, int width, uint64_t value);
+
+/**
+ * @brief Loads a value from memory without checking the access.
+ *
+ * Only for accesses proven to stay within memory with a valid width, such as
+ * those `range_analyze` marks `in_bounds`.
+ *
+ * @param destination The buffer to load the value into.
+ * @param offset The offset in memory where to start loading from.
+ * @param bytes The amount of bytes to load.
+ */
+void mem_load_unchecked(uint8_t *destination, size_t offset, size_t bytes);
+
+/**
+ * @brief Stores a value in memory without checking the access.
+ *
+ * Only for accesses proven to stay within memory, such as those
+ * `range_analyze` marks `in_bounds`.
+ *
+ * @param source The buffer to read the value from.
+ * @param offset The offset in memory where to start storing.
+ * @param bytes The amount of bytes to store.
+ */
+void mem_store_unchecked(const uint8_t *source, size_t offset, size_t bytes);
+
+/**
+ * @brief Returns the start of the memory backend.
+ *
+ * Intended for code generators that access memory directly; such code must
+ * perform the same bounds checks as `mem_load` and `mem_store`.
+ *
+ * @return A pointer to the first of `MEM_CAPACITY` bytes of memory.
+ */
+uint8_t *mem_base(void);
+
+/**
+ * @brief Makes every memory access of the calling thread use the given
+ * memory.
+ *
+ * Threads start bound to one memory they all share. Code compiled to native
+ * code keeps the memory that was bound when it was compiled.
+ *
+ * @param memory `MEM_CAPACITY` bytes, or NULL for the shared memory.
+ */
+void mem_bind(uint8_t *memory);
+
+/**
+ * @brief Clears every byte of memory, as if no program had run.
+ */
+void mem_reset(void);
+
+/**
+ * @brief Prints the memory state in a human-readable format.
+ *
+ * @param out The stream to print to.
  */
-void mem_print(void);
+void mem_print(FILE *out);
 
 #endif
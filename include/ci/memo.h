@@ -0,0 +1,109 @@
+#ifndef CI_MEMO_H
+#define CI_MEMO_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "command.h"
+#include "label_map.h"
+
+#define MEMO_CAPACITY 4096  // Results the cache holds; a power of two
+#define MEMO_MAX_INPUTS 8   // Registers a cached function may read on entry
+
+/**
+ * @brief A function whose calls are cached: its result depends only on the
+ * registers it reads on entry.
+ */
+typedef struct memo_function {
+    int     id;                       // Index of the function in its table.
+    int     input_count;              // Number of registers read on entry.
+    uint8_t inputs[MEMO_MAX_INPUTS];  // The registers read on entry; REG_SP is sp.
+} MemoFunction;
+
+/**
+ * @brief The result of one call, keyed by the function and its inputs.
+ */
+typedef struct {
+    const MemoFunction *function;                 // The function called, or NULL if unused.
+    int64_t             inputs[MEMO_MAX_INPUTS];  // Values of its inputs at the call.
+    int64_t             result;                   // x0 on return.
+    uint64_t            cost;                     // Commands the call ran, its ret included.
+    bool                is_greater;               // Flags on return.
+    bool                is_less;
+    bool                is_equal;
+} MemoEntry;
+
+/**
+ * @brief The cached functions of a program and the results of their calls.
+ */
+typedef struct {
+    MemoFunction *functions;       // Every cached function.
+    int           function_count;  // Number of entries in `functions`.
+    MemoEntry    *entries;         // MEMO_CAPACITY slots, each holding one result.
+    uint64_t      lookups;         // Calls looked up.
+    uint64_t      hits;            // Calls answered from the cache.
+    uint64_t      evictions;       // Results replaced by the result of another call.
+} MemoTable;
+
+/**
+ * @brief Finds the pure functions of a program and marks the calls to them.
+ *
+ * A function is pure if every command it can reach before returning is
+ * arithmetic, a comparison, a branch, or a call of a pure function; it must
+ * not touch memory, the stack pointer or the outside world, and must not run
+ * off the end of the program. Since `ret` restores x1..x31, such a call
+ * changes only x0 and the flags, and both depend only on the registers the
+ * function reads before writing them. Functions that read more than
+ * MEMO_MAX_INPUTS registers, or the flags, on entry are not cached.
+ *
+ * Calls of cached functions get their `memo` field set; all other commands
+ * have it cleared. Only `.callmode frame` programs may be memoized.
+ *
+ * @param table The table to initialize. Must be released with `memo_free`,
+ * even on failure.
+ * @param commands The first command of the program.
+ * @param map The program's labels.
+ * @param excluded Labels of functions that must not be cached.
+ * @param excluded_count Number of entries in `excluded`.
+ * @return True on success, false if memory ran out; no call is marked then.
+ */
+bool memo_init(MemoTable *table, Command *commands, LabelMap *map, char *const *excluded,
+               int excluded_count);
+
+/**
+ * @brief Looks up the result of a call.
+ *
+ * @param table The cache.
+ * @param function The function called.
+ * @param regs The registers at the call, followed by sp.
+ * @return The cached result, or NULL if the call has not been seen.
+ */
+const MemoEntry *memo_lookup(MemoTable *table, const MemoFunction *function,
+                             const int64_t *regs);
+
+/**
+ * @brief Caches the result of a call that returned.
+ *
+ * @param table The cache.
+ * @param function The function called.
+ * @param saved x0..x31 as saved by the call.
+ * @param regs The registers on return, followed by sp, which a pure function
+ * leaves as it was at the call.
+ * @param is_greater The greater flag on return.
+ * @param is_less The less flag on return.
+ * @param is_equal The equal flag on return.
+ * @param cost The commands the call ran, charged again on every hit so that
+ * instruction counts do not depend on the cache.
+ */
+void memo_store(MemoTable *table, const MemoFunction *function, const int64_t *saved,
+                const int64_t *regs, bool is_greater, bool is_less, bool is_equal,
+                uint64_t cost);
+
+/**
+ * @brief Releases a table and clears the marks it left on the calls.
+ *
+ * @param table The table to release.
+ * @param commands The first command of the program the table was built for.
+ */
+void memo_free(MemoTable *table, Command *commands);
+
+#endif
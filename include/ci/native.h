@@ -0,0 +1,51 @@
+#ifndef CI_NATIVE_H
+#define CI_NATIVE_H
+#include <stdbool.h>
+#include "command.h"
+#include "interpreter.h"
+#include "tier.h"
+
+/**
+ * @brief Determines whether native code generation is supported on this host.
+ *
+ * @return True on x86-64 Linux, false otherwise.
+ */
+bool native_available(void);
+
+/**
+ * @brief Translates compiled block or trace code into native machine code.
+ *
+ * Each instruction is translated by copying its precompiled machine-code
+ * stencil into an executable buffer and patching the stencil's holes with
+ * register offsets, immediates and exit targets. A root trace loops within
+ * its native code until a guard fails or the instruction limit is reached.
+ *
+ * @param code The compiled code to translate. On success its `native`
+ * and `native_size` fields are set.
+ * @return True if native code was generated, false if the code contains
+ * instructions without a stencil or the host is unsupported.
+ */
+bool native_compile(TierCode *code);
+
+/**
+ * @brief Runs the native code of a compiled block or trace.
+ *
+ * @param intr The interpreter whose state the code operates on.
+ * @param code The code to run; must have been translated by `native_compile`.
+ * @param exit Set to the guard or side trace loop control left through, whose
+ * `link` the caller continues in if it is set, to the instruction that
+ * deoptimized, or to NULL for other exits.
+ * @param deopt Set to true if a runtime check failed, in which case the
+ * returned command has not been executed.
+ * @return The command control leaves the code to.
+ */
+Command *native_run(Interpreter *intr, const TierCode *code, TierInsn **exit, bool *deopt);
+
+/**
+ * @brief Releases the native code of a compiled block, if any.
+ *
+ * @param code The code whose native translation to release.
+ */
+void native_free(TierCode *code);
+
+#endif
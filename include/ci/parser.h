@@ -8,30 +8,33 @@
 /**
  * @brief Represents a parser for processing tokens and generating commands.
  *
- * The `Parser` structure is responsible for consuming tokens from a `Lexer`,
- * maintaining state during parsing, and handling label-to-command mapping.
+ * The `Parser` structure is responsible for consuming tokens from a
+ * `TokenArray`, maintaining state during parsing, and handling label-to-command
+ * mapping.
  */
 typedef struct {
-    Lexer    *lexer;      // Pointer to the lexer providing tokens.
-    bool      had_error;  // Flag indicating if an error occurred during parsing.
-    Token     current;    // The current token being processed.
-    Token     next;       // The next token to be processed.
-    LabelMap *label_map;  // Pointer to the label map mapping labels to commands.
+    const TokenArray *tokens;     // Pointer to the lexed tokens.
+    int               position;   // Index of the current token in `tokens`.
+    bool              had_error;  // Flag indicating if an error occurred during parsing.
+    Token             current;    // The current token being processed.
+    Token             next;       // The next token to be processed.
+    LabelMap         *label_map;  // Pointer to the label map mapping labels to commands.
 } Parser;
 
 /**
  * @brief Initializes a `Parser` structure.
  *
  * @param parser Pointer to the `Parser` structure to initialize.
- * @param lexer Pointer to the `Lexer` to be used for tokenizing input.
+ * @param tokens Pointer to the tokens to parse, as produced by `lexer_tokenize`.
+ * Must outlive the parser.
  * @param map Pointer to the `LabelMap` for associating labels with commands.
  */
-void parser_init(Parser *parser, Lexer *lexer, LabelMap *map);
+void parser_init(Parser *parser, const TokenArray *tokens, LabelMap *map);
 
 /**
  * @brief Parses commands from the input token stream.
  *
- * Reads tokens from the associated `Lexer` and builds a linked list of
+ * Reads tokens from the associated `TokenArray` and builds a linked list of
  * commands. Updates the label map for any labels encountered during parsing. If
  * an error occurs, sets `parser->had_error` to `true`.
  *
@@ -0,0 +1,74 @@
+#ifndef CI_PROFILE_H
+#define CI_PROFILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "command.h"
+
+#define PROFILE_MAGIC "ci-profile"  // First word of a profile file
+#define PROFILE_VERSION 1           // Version of the profile file format
+
+/**
+ * @brief Execution counts of a program, collected by `--profile-out` and
+ * consumed by `--profile-in`.
+ *
+ * Commands are identified by their position in the linked program, counting
+ * from 1, so a profile only applies to the program it was collected from.
+ */
+typedef struct {
+    uint64_t *executed;  // How often each command ran, by position - 1.
+    uint64_t *taken;     // How often each branch was taken, by position - 1.
+    int64_t   count;     // Number of commands in the program.
+    uint64_t  checksum;  // Fingerprint of the program the counts belong to.
+} Profile;
+
+/**
+ * @brief Initializes an empty profile for a program.
+ *
+ * @param profile The profile to initialize.
+ * @param commands The first command of the program.
+ * @return True on success, false if memory ran out.
+ */
+bool profile_init(Profile *profile, Command *commands);
+
+/**
+ * @brief Determines whether a profile was collected from a program.
+ *
+ * @param profile The profile.
+ * @param commands The first command of the program.
+ * @return True if the program has the length and fingerprint of the one the
+ * profile was collected from.
+ */
+bool profile_matches(const Profile *profile, Command *commands);
+
+/**
+ * @brief Writes a profile to a file.
+ *
+ * The file is text: a header line, a line with the command count and
+ * fingerprint, and one line `position executed taken` per command that ran.
+ *
+ * @param profile The profile to write.
+ * @param path The file to write.
+ * @return True on success, false if the file could not be written.
+ */
+bool profile_write(const Profile *profile, const char *path);
+
+/**
+ * @brief Reads a profile written by `profile_write`.
+ *
+ * @param profile The profile to fill. Must be released with `profile_free`,
+ * even on failure.
+ * @param path The file to read.
+ * @return True on success, false if the file could not be read or is not a
+ * profile.
+ */
+bool profile_read(Profile *profile, const char *path);
+
+/**
+ * @brief Releases the counts of a profile.
+ *
+ * @param profile The profile to release.
+ */
+void profile_free(Profile *profile);
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef CI_RANGE_H
+#define CI_RANGE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "command.h"
+#include "label_map.h"
+
+/**
+ * @brief What bounds-check elimination proved about a program.
+ */
+typedef struct {
+    uint64_t accesses;  // Loads, stores and puts in the program.
+    uint64_t proven;    // Accesses proven to stay within memory.
+} RangeStats;
+
+/**
+ * @brief Computes the range of every register before each command and marks
+ * the memory accesses it proves in bounds.
+ *
+ * The analysis interprets the program over integer intervals, starting from
+ * the cleared registers of a fresh run. Loops are widened to reach a fixed
+ * point and then narrowed, and a conditional branch right after a `cmp`
+ * narrows the compared registers on both of its edges. Loads, stores and
+ * puts whose whole access lies in memory on every path get `in_bounds` set;
+ * all others have it cleared.
+ *
+ * With `.callmode return` a `ret` may continue at any command, so only
+ * accesses at immediate addresses are proven.
+ *
+ * @param commands The first command of the program.
+ * @param map The program's labels.
+ * @param return_calls Whether the program uses `.callmode return`.
+ * @param stats Receives how many accesses were proven.
+ * @return True on success, false if memory ran out; no access is marked then.
+ */
+bool range_analyze(Command *commands, LabelMap *map, bool return_calls, RangeStats *stats);
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef CI_SCHEDULER_H
+#define CI_SCHEDULER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "command.h"
+#include "heap.h"
+#include "interpreter.h"
+#include "mem.h"
+
+#define SCHED_DEFAULT_SLICE 10000  // Commands a program of priority 1 runs per turn
+#define SCHED_MAX_PRIORITY 16      // Highest priority a program may be given
+#define SCHED_MAX_WORKERS 256      // Most worker threads a scheduler may start
+
+/**
+ * @brief A program run by the scheduler, with its own memory, heap and
+ * accounting.
+ */
+typedef struct sched_program {
+    Interpreter           intr;                  // State of the program; its `slice` is
+                                                 // set by the scheduler.
+    Command              *commands;              // The first command of the program.
+    int                   priority;              // 1..SCHED_MAX_PRIORITY; a turn lasts
+                                                 // `priority` slices.
+    uint8_t               memory[MEM_CAPACITY];  // Memory the program loads and stores.
+    Heap                  heap;                  // Blocks the program allocated.
+    uint64_t              cpu_ns;                // CPU time spent running the program.
+    uint64_t              turns;                 // Times the program was run.
+    uint64_t              migrations;            // Turns run by another worker than the last.
+    int                   worker;                // Worker that ran the last turn, or -1.
+    struct sched_program *next;                  // Next program in the same run queue.
+} SchedProgram;
+
+/**
+ * @brief Prepares a program to be scheduled, with zeroed memory and an empty
+ * heap.
+ *
+ * The interpreter is initialized and may be configured further before the
+ * program is run; the compiled tier and tracing are never used.
+ *
+ * @param program The program to prepare.
+ * @param commands The first command of the program.
+ * @param map The program's labels.
+ * @param priority The program's priority, 1..SCHED_MAX_PRIORITY.
+ * @param heap_debug Quarantine freed blocks and report accesses to them.
+ */
+void sched_program_init(SchedProgram *program, Command *commands, LabelMap *map, int priority,
+                        bool heap_debug);
+
+/**
+ * @brief Runs programs to completion on a pool of worker threads.
+ *
+ * Programs are dealt to the workers' run queues in turn. A worker runs the
+ * program at the head of its queue for one turn and puts it back at the
+ * tail; a worker whose queue is empty steals the program that has waited
+ * longest in another's. A
+ * turn ends at the first backward branch or call after `slice` times the
+ * program's priority commands, so every program makes progress and gets CPU
+ * time in proportion to its priority.
+ *
+ * @param programs The programs to run.
+ * @param count Number of entries in `programs`.
+ * @param workers Number of worker threads, 1..SCHED_MAX_WORKERS.
+ * @param slice Commands a program of priority 1 runs per turn.
+ * @return True on success, false if the workers could not be started; every
+ * program that could be run then has been run to completion.
+ */
+bool sched_run(SchedProgram **programs, int count, int workers, uint64_t slice);
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef CI_STATE_H
+#define CI_STATE_H
+#include <stdbool.h>
+#include <stdint.h>
+#include "interpreter.h"
+#include "mem.h"
+
+#define STATE_MAGIC "CIST"  // First bytes of a binary state image
+#define STATE_VERSION 1     // Layout version of `StateImage`
+
+#define STATE_FLAG_ERROR 1u    // The program stopped with an error
+#define STATE_FLAG_GREATER 2u  // The last comparison found greater
+#define STATE_FLAG_EQUAL 4u    // The last comparison found equal
+#define STATE_FLAG_LESS 8u     // The last comparison found less
+
+/**
+ * @brief The formats the final state can be exported in.
+ */
+typedef enum {
+    STATE_TEXT,  // The human-readable dump of registers, flags and memory
+    STATE_JSON,  // One JSON object; memory as hex-encoded ranges of touched bytes
+    STATE_BIN,   // A `StateImage`
+} StateFormat;
+
+/**
+ * @brief The binary state format.
+ *
+ * Every field is naturally aligned and there is no padding, so a file can be
+ * mapped and read through this struct directly. Integers are in the byte
+ * order of the machine that ran the program.
+ */
+typedef struct {
+    char     magic[4];                  // `STATE_MAGIC`, not NUL-terminated
+    uint32_t version;                   // `STATE_VERSION`
+    uint32_t flags;                     // `STATE_FLAG_*` bits
+    uint32_t memory_size;               // Number of bytes in `memory`
+    int64_t  registers[NUM_REGISTERS];  // x0 through x31, then sp
+    uint8_t  memory[MEM_CAPACITY];      // The whole memory backend
+} StateImage;
+
+/**
+ * @brief Looks up a state format by name.
+ *
+ * @param name "text", "json" or "bin".
+ * @param format Set to the format on success.
+ * @return True if `name` is a format, false otherwise.
+ */
+bool state_parse_format(const char *name, StateFormat *format);
+
+/**
+ * @brief Writes the interpreter's final registers, flags and memory.
+ *
+ * JSON and binary states are serialized into one buffer and written with a
+ * single call.
+ *
+ * @param intr The interpreter that ran the program.
+ * @param format The format to write.
+ * @param path The file to write, or NULL for standard output.
+ * @return True on success, false if the state could not be written (an
+ * error message has been printed).
+ */
+bool state_export(Interpreter *intr, StateFormat format, const char *path);
+
+#endif
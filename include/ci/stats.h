@@ -0,0 +1,47 @@
+#ifndef CI_STATS_H
+#define CI_STATS_H
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * @brief Execution statistics collected while interpreting a program.
+ */
+typedef struct {
+    bool     enabled;           // Whether timing information is being collected.
+    uint64_t blocks_compiled;   // Basic blocks promoted to the compiled tier.
+    uint64_t native_blocks;     // Compiled blocks translated into native code.
+    uint64_t compile_failures;  // Hot blocks that could not be compiled.
+    uint64_t tier_entries;      // Transitions from the interpreter into compiled code.
+    uint64_t tier_exits;        // Transitions from compiled code back to the interpreter.
+    uint64_t deopts;            // Exits caused by a failed runtime check (deoptimization).
+    uint64_t total_ns;          // Wall time spent in `interpret`.
+    uint64_t tier_ns;           // Wall time spent executing compiled code.
+    uint64_t compile_ns;        // Wall time spent compiling hot blocks and traces.
+    uint64_t traces_compiled;   // Loop traces compiled from hot loop headers.
+    uint64_t side_traces;       // Side traces compiled from frequently failing guards.
+    uint64_t native_traces;     // Traces translated into native code.
+    uint64_t trace_aborts;      // Trace recordings abandoned before closing the loop.
+    uint64_t trace_entries;     // Transitions from the interpreter into traces.
+    uint64_t guard_exits;       // Traces left through a failed guard.
+    uint64_t trace_ns;          // Wall time spent executing traces.
+    uint64_t mem_accesses;      // Loads, stores and puts in the program.
+    uint64_t checks_elided;     // Accesses proven in bounds, which run unchecked.
+} ExecStats;
+
+/**
+ * @brief Returns a monotonic timestamp in nanoseconds.
+ *
+ * @return The current value of the monotonic clock.
+ */
+uint64_t stats_now_ns(void);
+
+/**
+ * @brief Prints the collected statistics in a human-readable format.
+ *
+ * @param stats Pointer to the statistics to print.
+ * @param out The stream to print to.
+ */
+void print_exec_stats(const ExecStats *stats, FILE *out);
+
+#endif
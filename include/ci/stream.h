@@ -0,0 +1,45 @@
+#ifndef CI_STREAM_H
+#define CI_STREAM_H
+#include <stdbool.h>
+#include <stdint.h>
+#include "interpreter.h"
+
+#define STREAM_STDIN 0   // File descriptor `read` reads from
+#define STREAM_STDOUT 1  // File descriptor of the output `print` writes to
+#define STREAM_STDERR 2  // File descriptor of the error output
+
+/**
+ * @brief Writes a range of memory to an output, for `write fd, xaddr, xlen`.
+ *
+ * Standard output goes through the same buffer as `print`, so the two
+ * interleave in program order; large ranges reach the file descriptor in a
+ * single write. Standard output is flushed before writing to standard error.
+ *
+ * @param intr The interpreter executing the instruction; x0 is set to the
+ * number of bytes written.
+ * @param fd The file descriptor, `STREAM_STDOUT` or `STREAM_STDERR`.
+ * @param address The first byte to write.
+ * @param length The number of bytes to write.
+ * @return True on success, false if the range is out of bounds or `fd` is
+ * not an output (an error message has been printed).
+ */
+bool stream_write(Interpreter *intr, int64_t fd, uint64_t address, int64_t length);
+
+/**
+ * @brief Reads input into a range of memory, for `read fd, xaddr, xlen`.
+ *
+ * Standard output is flushed first so that prompts are visible. At most
+ * `length` bytes are read with a single read, which returns early at the end
+ * of a line on a terminal.
+ *
+ * @param intr The interpreter executing the instruction; x0 is set to the
+ * number of bytes read, 0 at the end of the input or -1 if reading failed.
+ * @param fd The file descriptor, `STREAM_STDIN`.
+ * @param address The first byte to read into.
+ * @param length The most bytes to read.
+ * @return True on success, false if the range is out of bounds or `fd` is
+ * not an input (an error message has been printed).
+ */
+bool stream_read(Interpreter *intr, int64_t fd, uint64_t address, int64_t length);
+
+#endif
@@ -0,0 +1,154 @@
+#ifndef CI_TIER_H
+#define CI_TIER_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "cfg.h"
+#include "command.h"
+#include "interpreter.h"
+#include "label_map.h"
+
+#define TIER_DEFAULT_THRESHOLD 50  // Block entries before a block is compiled.
+
+/**
+ * @brief Specialized operations executed by the compiled tier.
+ *
+ * Each operation has its operand forms (register or immediate) resolved at
+ * compile time, so no operand flags are tested while executing.
+ */
+typedef enum {
+    TOP_MOV,            // dst = imm
+    TOP_ADD_RR,         // dst = a + b
+    TOP_ADD_RI,         // dst = a + imm
+    TOP_SUB_RR,         // dst = a - b
+    TOP_SUB_RI,         // dst = a - imm
+    TOP_AND,            // dst = a & b
+    TOP_EOR,            // dst = a ^ b
+    TOP_ORR,            // dst = a | b
+    TOP_ASR,            // dst = a >> imm (arithmetic)
+    TOP_LSL,            // dst = a << imm
+    TOP_LSR,            // dst = a >> imm (logical)
+    TOP_CMP_RR,         // flags = cmp(a, b)
+    TOP_CMP_RI,         // flags = cmp(a, imm)
+    TOP_CMP_U_RR,       // flags = cmp_u(a, b)
+    TOP_CMP_U_RI,       // flags = cmp_u(a, imm)
+    TOP_LOAD_R,         // dst = mem[b], width bytes
+    TOP_LOAD_I,         // dst = mem[imm], width bytes
+    TOP_STORE_R,        // mem[b] = dst, width bytes
+    TOP_STORE_I,        // mem[imm] = dst, width bytes
+    TOP_BRANCH,         // exit to target if cond holds, otherwise to next
+    TOP_CMP_BRANCH_RR,  // superinstruction: TOP_CMP_RR followed by TOP_BRANCH
+    TOP_CMP_BRANCH_RI,  // superinstruction: TOP_CMP_RI followed by TOP_BRANCH
+    TOP_EXIT,           // exit to target
+    TOP_GUARD,          // continue if cond holds == expect, otherwise charge imm commands
+                        // and continue at the start of link, or exit to target
+    TOP_CALL,           // push a call frame returning to target
+    TOP_BUILTIN,        // run the builtin imm
+    TOP_RET,            // pop a call frame whose return command must be target
+    TOP_LOOP,           // charge imm commands, continue at the start of link
+                        // or leave to target once the instruction limit is hit
+} TierOp;
+
+/**
+ * @brief A single instruction of compiled code.
+ */
+typedef struct {
+    uint8_t           op;      // The `TierOp` to perform.
+    uint8_t           dst;     // Destination (or stored) register.
+    uint8_t           a;       // First source register.
+    uint8_t           b;       // Second source register.
+    uint8_t           width;   // Access width in bytes for loads and stores.
+    bool              expect;  // The branch outcome a guard expects.
+    bool              proven;  // Whether a load or store was proven in bounds.
+    BranchCondition   cond;    // Condition for branching operations.
+    uint32_t          exits;   // How often a guard has failed.
+    uint32_t          before;  // Commands of the block or trip run before this one.
+    int64_t           imm;     // Immediate operand.
+    Command          *target;  // Exit destination when a branch is taken or the block ends.
+    Command          *next;    // Exit destination when a branch is not taken.
+    Command          *source;  // The command this was lowered from; the deoptimization point.
+    struct tier_code *link;    // Code to continue in for loops and guards with side traces.
+} TierInsn;
+
+/**
+ * @brief Compiled code for a single basic block or trace.
+ */
+typedef struct tier_code {
+    TierInsn         *insns;        // The instructions, always terminated by an exit or loop.
+    int               count;        // The number of instructions.
+    int               commands;     // The number of commands a block's code covers.
+    struct tier_code *chain;        // Further code owned by this code, freed along with it.
+    void             *native;       // Native translation of the instructions, or NULL.
+    size_t            native_size;  // The size of the native translation in bytes.
+} TierCode;
+
+/**
+ * @brief Lowers a single command into a specialized instruction.
+ *
+ * Only straight-line commands and branches can be lowered; calls, returns,
+ * prints and puts cannot.
+ *
+ * @param cmd The command to lower.
+ * @param map The label map used to resolve branch targets.
+ * @param insn The instruction to fill in.
+ * @return True if the command was lowered, false if the tier cannot execute
+ * it.
+ */
+bool tier_lower(Command *cmd, LabelMap *map, TierInsn *insn);
+
+/**
+ * @brief Compiles a basic block into specialized instructions.
+ *
+ * Compilation stops at the first command the tier cannot execute (calls,
+ * returns, prints and puts), which becomes the exit of the compiled code.
+ *
+ * @param block The block to compile.
+ * @param map The label map used to resolve branch targets.
+ * @return The compiled code, or NULL if not even the first command of the
+ * block could be compiled.
+ *
+ * @note The caller owns the returned code and must release it with
+ * `tier_free`.
+ */
+TierCode *tier_compile(BasicBlock *block, LabelMap *map);
+
+/**
+ * @brief Runs compiled instructions until control leaves them.
+ *
+ * @param intr The interpreter whose state the code operates on.
+ * @param ip The first instruction to run.
+ * @param exit Set to the instruction control left through.
+ * @param deopt Set to true if the exit was caused by a failed runtime check,
+ * in which case the returned command has not been executed.
+ * @return The command control leaves the code to.
+ */
+Command *tier_run(Interpreter *intr, TierInsn *ip, TierInsn **exit, bool *deopt);
+
+/**
+ * @brief Executes compiled code starting at the given block.
+ *
+ * Execution continues directly into successor blocks that are compiled as
+ * well. Blocks with a native translation run natively. If a runtime check
+ * fails (e.g. an out-of-bounds memory access), the tier deoptimizes: it
+ * returns the offending command unexecuted so the interpreter can run it and
+ * report the error.
+ *
+ * Every block whose code runs to its end is charged for the commands the code
+ * covers before execution moves on; past the instruction limit, the
+ * interpreter's error is set.
+ *
+ * @param intr The interpreter whose state the code operates on.
+ * @param block A block with compiled code.
+ * @return The command the interpreter should resume at, or NULL if the program
+ * ended.
+ */
+Command *tier_execute(Interpreter *intr, BasicBlock *block);
+
+/**
+ * @brief Frees compiled code and any code chained to it.
+ *
+ * @param code The code to free, may be NULL.
+ */
+void tier_free(TierCode *code);
+
+#endif
@@ -1,5 +1,7 @@
 #ifndef CI_TOKEN_H
 #define CI_TOKEN_H
+#include <stdbool.h>
+
 #include "token_type.h"
 
 /**
@@ -36,4 +38,15 @@ void token_init(Token *tok, TokenType tok_type, const char *lexeme, int lexeme_l
  */
 void print_token(Token tok);
 
+/**
+ * @brief Determines if a token of the given type can name a label.
+ *
+ * Keywords are only reserved where a mnemonic is expected, so `read:` defines
+ * and `b read` targets a label like any identifier does.
+ *
+ * @param type The token type to check.
+ * @return True for identifiers and keywords, false otherwise.
+ */
+bool token_is_name(TokenType type);
+
 #endif
@@ -38,6 +38,17 @@ typedef enum {
     TOK_STORE,       // store
     TOK_STR,         // "string"
     TOK_SUB,         // sub
+    TOK_CCALL,       // ccall
+    TOK_ALLOC,       // alloc
+    TOK_FREE,        // free
+    TOK_REALLOC,     // realloc
+    TOK_PUSH,        // push
+    TOK_POP,         // pop
+    TOK_LBRACE,      // {
+    TOK_RBRACE,      // }
+    TOK_DASH,        // -
+    TOK_WRITE,       // write
+    TOK_READ,        // read
 } TokenType;
 
 #endif
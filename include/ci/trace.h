@@ -0,0 +1,83 @@
+#ifndef CI_TRACE_H
+#define CI_TRACE_H
+#include <stdbool.h>
+#include "cfg.h"
+#include "command.h"
+#include "interpreter.h"
+#include "tier.h"
+
+#define TRACE_DEFAULT_THRESHOLD 16  // Arrivals at a loop header before recording a trace.
+#define TRACE_AUTO_THRESHOLD    -1  // Trace at the default threshold only with native code.
+#define TRACE_SIDE_THRESHOLD    8   // Failures of a guard before recording a side trace.
+#define TRACE_MAX_LENGTH        512 // Commands recorded before a recording is abandoned.
+
+/**
+ * @brief Records the path the interpreter takes through a hot loop.
+ *
+ * A root trace starts at a loop header and closes when execution arrives back
+ * at it. A side trace starts at the exit of a frequently failing guard and
+ * closes at the same header, where it continues into the root trace.
+ */
+typedef struct {
+    bool        active;    // Whether a recording is in progress.
+    BasicBlock *header;    // The loop header the recording closes at.
+    TierInsn   *guard;     // The guard a side trace is recorded for, or NULL.
+    Command   **commands;  // The commands executed so far, in order.
+    int         length;    // The number of recorded commands.
+    int         capacity;  // The capacity of `commands`.
+} TraceRecorder;
+
+/**
+ * @brief Initializes an inactive trace recorder.
+ *
+ * @param rec Pointer to the `TraceRecorder` to initialize.
+ */
+void trace_recorder_init(TraceRecorder *rec);
+
+/**
+ * @brief Frees the resources held by a trace recorder.
+ *
+ * @param rec Pointer to the `TraceRecorder` to free.
+ */
+void trace_recorder_free(TraceRecorder *rec);
+
+/**
+ * @brief Starts recording a trace.
+ *
+ * @param rec Pointer to the recorder.
+ * @param header The loop header the trace closes at.
+ * @param guard The guard to attach the trace to, or NULL for a root trace.
+ */
+void trace_start(TraceRecorder *rec, BasicBlock *header, TierInsn *guard);
+
+/**
+ * @brief Records a command the interpreter is about to execute.
+ *
+ * Recording is abandoned if the trace grows too long or reaches a command
+ * traces cannot execute (prints and puts). When the command is the loop
+ * header, the recorded path is compiled: calls are inlined, every conditional
+ * branch becomes a guard on the recorded direction, and the trace loops back
+ * to the start of the root trace.
+ *
+ * @param rec Pointer to the recorder.
+ * @param intr The interpreter executing the command.
+ * @param cmd The command about to be executed.
+ * @return True if a trace was installed and the interpreter should dispatch
+ * `cmd` again, false otherwise.
+ */
+bool trace_record(TraceRecorder *rec, Interpreter *intr, Command *cmd);
+
+/**
+ * @brief Executes the trace compiled for a loop header.
+ *
+ * When a guard without a side trace fails often enough, recording of a side
+ * trace is started at the guard's exit.
+ *
+ * @param intr The interpreter whose state the trace operates on.
+ * @param rec The recorder used for side traces.
+ * @param header The loop header whose trace to run.
+ * @return The command the interpreter should resume at.
+ */
+Command *trace_execute(Interpreter *intr, TraceRecorder *rec, BasicBlock *header);
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef CI_WATCH_H
+#define CI_WATCH_H
+
+#include <stdbool.h>
+
+#define WATCH_SETTLE_MS 50  // Quiet time after a change before the file is read
+
+/**
+ * @brief Watches a file for changes with inotify.
+ *
+ * The directory holding the file is watched rather than the file itself, so
+ * that editors which save by writing a new file and renaming it over the old
+ * one are noticed as well.
+ */
+typedef struct {
+    int   fd;    // The inotify instance.
+    char *name;  // Name of the file within its directory.
+} FileWatch;
+
+/**
+ * @brief Starts watching a file.
+ *
+ * @param watch The watch to initialize.
+ * @param path The path of the file.
+ * @return True on success, false if the directory could not be watched.
+ */
+bool watch_init(FileWatch *watch, const char *path);
+
+/**
+ * @brief Blocks until the file has been written or replaced.
+ *
+ * Bursts of events, such as an editor writing the file in pieces, are
+ * merged: the call returns once no event arrived for `WATCH_SETTLE_MS`.
+ *
+ * @param watch The watch.
+ * @return True once the file changed, false if reading events failed.
+ */
+bool watch_next(FileWatch *watch);
+
+/**
+ * @brief Stops watching a file.
+ *
+ * @param watch The watch to release.
+ */
+void watch_free(FileWatch *watch);
+
+#endif
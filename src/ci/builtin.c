@@ -0,0 +1,179 @@
+#include "builtin.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "heap.h"
+#include "mem.h"
+
+/**
+ * @brief Maps the name of a builtin to the builtin.
+ */
+typedef struct {
+    const char *name;     // The label that calls the builtin, without `BUILTIN_PREFIX`.
+    Builtin     builtin;  // The builtin.
+} BuiltinEntry;
+
+static const BuiltinEntry builtins[] = {
+    {"itoa", BUILTIN_ITOA},       {"strlen", BUILTIN_STRLEN}, {"copy", BUILTIN_COPY},
+    {"compare", BUILTIN_COMPARE}, {"hash", BUILTIN_HASH},     {"sort", BUILTIN_SORT},
+};
+
+static bool in_bounds(uint64_t address, uint64_t bytes);
+static bool accessible(const Interpreter *intr, uint64_t address, uint64_t bytes);
+static bool string_length(uint64_t address, uint64_t *length);
+static int  compare_words(const void *a, const void *b);
+
+int builtin_lookup(const char *label) {
+    if (!builtin_reserved(label)) {
+        return -1;
+    }
+
+    const char *name = label + strlen(BUILTIN_PREFIX);
+    for (size_t i = 0; i < sizeof(builtins) / sizeof(builtins[0]); i++) {
+        if (strcmp(builtins[i].name, name) == 0) {
+            return (int) builtins[i].builtin;
+        }
+    }
+    return -1;
+}
+
+bool builtin_reserved(const char *label) {
+    return strncmp(label, BUILTIN_PREFIX, strlen(BUILTIN_PREFIX)) == 0;
+}
+
+/**
+ * @brief Determines whether a range of memory lies within the memory backend.
+ *
+ * @param address The first byte of the range.
+ * @param bytes The length of the range.
+ * @return True if every byte of the range can be accessed.
+ */
+static bool in_bounds(uint64_t address, uint64_t bytes) {
+    return address <= MEM_CAPACITY && bytes <= MEM_CAPACITY - address;
+}
+
+/**
+ * @brief Determines whether a builtin may access a range of memory.
+ *
+ * @param intr The interpreter running the builtin.
+ * @param address The first byte of the range.
+ * @param bytes The length of the range.
+ * @return True if the range is in bounds and, when debugging the heap, touches
+ * no freed block (which `heap_check` reports).
+ */
+static bool accessible(const Interpreter *intr, uint64_t address, uint64_t bytes) {
+    return in_bounds(address, bytes) && (!intr->heap_debug || heap_check(address, bytes));
+}
+
+/**
+ * @brief Measures the NUL-terminated string at the given address.
+ *
+ * @param address The first byte of the string.
+ * @param length Set to the length of the string, excluding the terminator.
+ * @return True on success, false if memory ends before the terminator.
+ */
+static bool string_length(uint64_t address, uint64_t *length) {
+    if (address >= MEM_CAPACITY) {
+        return false;
+    }
+
+    const uint8_t *start = mem_base() + address;
+    const uint8_t *end   = memchr(start, '\0', MEM_CAPACITY - address);
+    if (!end) {
+        return false;
+    }
+    *length = (uint64_t) (end - start);
+    return true;
+}
+
+/**
+ * @brief Orders two 8-byte signed integers, which need not be aligned.
+ *
+ * @param a The first integer.
+ * @param b The second integer.
+ * @return A negative, zero or positive value as `a` is less than, equal to or
+ * greater than `b`.
+ */
+static int compare_words(const void *a, const void *b) {
+    int64_t x, y;
+    memcpy(&x, a, sizeof(x));
+    memcpy(&y, b, sizeof(y));
+    return (x > y) - (x < y);
+}
+
+bool builtin_run(Interpreter *intr, int builtin) {
+    int64_t *regs = intr->variables;
+    uint8_t *mem  = mem_base();
+
+    switch ((Builtin) builtin) {
+        case BUILTIN_ITOA: {
+            char     digits[24];
+            uint64_t magnitude = regs[0] < 0 ? 0 - (uint64_t) regs[0] : (uint64_t) regs[0];
+            int      n         = (int) sizeof(digits);
+            digits[--n]        = '\0';
+            do {
+                digits[--n] = (char) ('0' + magnitude % 10);
+                magnitude /= 10;
+            } while (magnitude);
+            if (regs[0] < 0) {
+                digits[--n] = '-';
+            }
+
+            uint64_t length = sizeof(digits) - (size_t) n;
+            if (!accessible(intr, (uint64_t) regs[1], length)) {
+                return false;
+            }
+            memcpy(mem + regs[1], digits + n, length);
+            regs[0] = (int64_t) length - 1;
+            return true;
+        }
+        case BUILTIN_STRLEN: {
+            uint64_t length;
+            if (!string_length((uint64_t) regs[0], &length) ||
+                !accessible(intr, (uint64_t) regs[0], length + 1)) {
+                return false;
+            }
+            regs[0] = (int64_t) length;
+            return true;
+        }
+        case BUILTIN_COPY:
+            if (!accessible(intr, (uint64_t) regs[0], (uint64_t) regs[2]) ||
+                !accessible(intr, (uint64_t) regs[1], (uint64_t) regs[2])) {
+                return false;
+            }
+            memmove(mem + regs[0], mem + regs[1], (size_t) regs[2]);
+            return true;
+        case BUILTIN_COMPARE: {
+            uint64_t a, b;
+            if (!string_length((uint64_t) regs[0], &a) || !string_length((uint64_t) regs[1], &b) ||
+                !accessible(intr, (uint64_t) regs[0], a + 1) ||
+                !accessible(intr, (uint64_t) regs[1], b + 1)) {
+                return false;
+            }
+            int order = strcmp((const char *) mem + regs[0], (const char *) mem + regs[1]);
+            regs[0]   = (order > 0) - (order < 0);
+            return true;
+        }
+        case BUILTIN_HASH: {
+            if (!accessible(intr, (uint64_t) regs[0], (uint64_t) regs[1])) {
+                return false;
+            }
+            uint64_t hash = 14695981039346656037ULL;
+            for (int64_t i = 0; i < regs[1]; i++) {
+                hash = (hash ^ mem[regs[0] + i]) * 1099511628211ULL;
+            }
+            regs[0] = (int64_t) hash;
+            return true;
+        }
+        case BUILTIN_SORT:
+            if ((uint64_t) regs[1] > MEM_CAPACITY / sizeof(int64_t) ||
+                !accessible(intr, (uint64_t) regs[0], (uint64_t) regs[1] * sizeof(int64_t))) {
+                return false;
+            }
+            qsort(mem + regs[0], (size_t) regs[1], sizeof(int64_t), compare_words);
+            return true;
+        case BUILTIN_COUNT:
+            break;
+    }
+    return false;
+}
@@ -0,0 +1,122 @@
+#include "cfg.h"
+#include <stdlib.h>
+#include "tier.h"
+
+static void    mark_leader(Command *cmd, BasicBlock *marker);
+static Command *branch_target(LabelMap *map, Command *cmd);
+
+// Placeholder stored in `Command.block` while leaders are being discovered.
+static BasicBlock leader_marker;
+
+bool cfg_ends_block(const Command *cmd) {
+    return cmd->type == CMD_BRANCH || cmd->type == CMD_CALL || cmd->type == CMD_RET ||
+           cmd->type == CMD_HALT;
+}
+
+/**
+ * @brief Marks the given command as the leader of a block.
+ *
+ * @param cmd The command to mark, may be NULL.
+ * @param marker The placeholder block to mark it with.
+ */
+static void mark_leader(Command *cmd, BasicBlock *marker) {
+    if (cmd) {
+        cmd->block = marker;
+    }
+}
+
+/**
+ * @brief Resolves the command a branch or call transfers control to.
+ *
+ * @param map The label map used for resolution.
+ * @param cmd The branch or call command.
+ * @return The target command, or NULL if the label is undefined.
+ */
+static Command *branch_target(LabelMap *map, Command *cmd) {
+    if (cmd->type != CMD_BRANCH && cmd->type != CMD_CALL) {
+        return NULL;
+    }
+    return find_label(map, cmd->destination.str_val);
+}
+
+bool cfg_build(Cfg *cfg, Command *commands, LabelMap *map) {
+    cfg->blocks = NULL;
+    cfg->count  = 0;
+
+    for (Command *cmd = commands; cmd; cmd = cmd->next) {
+        cmd->block = NULL;
+    }
+
+    mark_leader(commands, &leader_marker);
+    for (int i = 0; map && i < map->capacity; i++) {
+        for (Entry *e = map->entries[i]; e != NULL; e = e->next) {
+            mark_leader(e->command, &leader_marker);
+        }
+    }
+    for (Command *cmd = commands; cmd; cmd = cmd->next) {
+        if (cfg_ends_block(cmd)) {
+            mark_leader(cmd->next, &leader_marker);
+        }
+    }
+
+    int count = 0;
+    for (Command *cmd = commands; cmd; cmd = cmd->next) {
+        count += cmd->block != NULL;
+    }
+    if (count == 0) {
+        return true;
+    }
+
+    cfg->blocks = (BasicBlock *) calloc(count, sizeof(BasicBlock));
+    if (!cfg->blocks) {
+        for (Command *cmd = commands; cmd; cmd = cmd->next) {
+            cmd->block = NULL;
+        }
+        return false;
+    }
+    cfg->count = count;
+
+    BasicBlock *bb = NULL;
+    int         id = 0;
+    for (Command *cmd = commands; cmd; cmd = cmd->next) {
+        if (cmd->block) {
+            bb         = &cfg->blocks[id];
+            bb->id     = id++;
+            bb->first  = cmd;
+            cmd->block = bb;
+        }
+        bb->last = cmd;
+        bb->length++;
+    }
+
+    for (int i = 0; i < cfg->count; i++) {
+        BasicBlock *block  = &cfg->blocks[i];
+        Command    *last   = block->last;
+        Command    *target = branch_target(map, last);
+
+        block->taken = (target && target->block) ? target->block : NULL;
+        if (block->taken && last->type == CMD_BRANCH && block->taken->id <= block->id) {
+            block->taken->loop_header = true;
+        }
+        if (last->type != CMD_RET && last->type != CMD_HALT &&
+            !(last->type == CMD_BRANCH && last->branch_condition == BRANCH_NONE) && last->next) {
+            block->fallthrough = last->next->block;
+        }
+    }
+    return true;
+}
+
+void cfg_free(Cfg *cfg) {
+    if (!cfg) {
+        return;
+    }
+
+    for (int i = 0; i < cfg->count; i++) {
+        cfg->blocks[i].first->block = NULL;
+        tier_free(cfg->blocks[i].code);
+        tier_free(cfg->blocks[i].trace);
+    }
+    free(cfg->blocks);
+    cfg->blocks = NULL;
+    cfg->count  = 0;
+}
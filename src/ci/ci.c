@@ -1,26 +1,85 @@
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "cmd_args_config.h"
 #include "command.h"
+#include "diff_test.h"
+#include "ffi.h"
+#include "gen.h"
+#include "gvn.h"
+#include "heap.h"
+#include "incremental.h"
 #include "interpreter.h"
 #include "label_map.h"
+#include "layout.h"
 #include "lexer.h"
+#include "link.h"
+#include "macro.h"
 #include "mem.h"
+#include "memo.h"
+#include "native.h"
 #include "parser.h"
+#include "profile.h"
+#include "range.h"
+#include "scheduler.h"
+#include "state.h"
+#include "stats.h"
 #include "token.h"
 #include "token_type.h"
+#include "trace.h"
+#include "watch.h"
 #include <ctype.h>
 
 #define CAPACITY 50
 
-static int   run_interpreter(CmdArgsConfig *conf);
-static char *run_repl(void);
-static char *read_file(const char *path);
-static int   run_file(const char *src, bool print_lex, bool print_parse);
+/**
+ * @brief A source that has been lexed, parsed and linked.
+ */
+typedef struct {
+    Command       *commands;  // The first command of the program.
+    LabelMap       lbm;       // The program's labels.
+    LinkDirectives dirs;      // The program's directives.
+    LinkOptions    link;      // Where modules were cached, and how many were linked.
+    FfiTable       ffi;       // The program's imported functions.
+} LoadedProgram;
+
+/**
+ * @brief One of the inputs of a scheduled run.
+ */
+typedef struct {
+    char         *path;   // The file, without its priority suffix.
+    LoadedProgram prog;   // The program read from it.
+    MemoTable     memo;   // Cached results of its pure functions.
+    SchedProgram *sched;  // The program's state while it is scheduled.
+} ScheduledInput;
+
+static int      run_interpreter(CmdArgsConfig *conf);
+static char    *run_repl(void);
+static char    *read_file(const char *path);
+static int      run_file(const char *src, const char *path, CmdArgsConfig *conf);
+static bool     load_program(const char *src, const char *path, CmdArgsConfig *conf,
+                             LoadedProgram *prog);
+static void     unload_program(LoadedProgram *prog);
+static int      run_scheduled(CmdArgsConfig *conf);
+static bool     prepare_input(ScheduledInput *input, const char *arg, CmdArgsConfig *conf);
+static void     release_input(ScheduledInput *input);
+static void     print_sched_stats(const ScheduledInput *inputs, int count, CmdArgsConfig *conf);
+static void     print_front_end_stats(const Command *commands, int token_count, uint64_t lex_ns,
+                                      uint64_t parse_ns);
+static bool     optimize(Command *commands, LabelMap *lbm, CmdArgsConfig *conf);
+static bool     apply_profile(Command **commands, LabelMap *lbm, bool return_calls,
+                              CmdArgsConfig *conf);
+static int      run_watch(const char *path, CmdArgsConfig *conf);
+static int      run_built(IncrementalProgram *prog, CmdArgsConfig *conf);
+static uint64_t time_cold_build(const char *src);
+static int      execute(Command *commands, LabelMap *lbm, FfiTable *ffi,
+                        const LinkDirectives *dirs, const LinkOptions *link,
+                        CmdArgsConfig *conf);
 
 int main(int argc, char **argv) {
-    CmdArgsConfig conf = {false, false, false, NULL, NULL};
+    CmdArgsConfig conf;
+    config_init(&conf);
     if (!parse_cmd_args(&conf, argv + 1, argc - 1)) {
         printf("Aborting\n");
         config_free(&conf);
@@ -35,7 +94,14 @@ int main(int argc, char **argv) {
         }
     }
 
-    int status = run_interpreter(&conf);
+    int status;
+    if (conf.gen) {
+        status = gen_program(&conf.gen_config, stdout) ? 0 : 1;
+    } else if (conf.diff_test) {
+        status = run_diff_test(&conf, argv[0]);
+    } else {
+        status = run_interpreter(&conf);
+    }
     config_free(&conf);
     if (file) {
         fclose(file);
@@ -44,25 +110,39 @@ int main(int argc, char **argv) {
 }
 
 static int run_interpreter(CmdArgsConfig *conf) {
-    char *src;
-    int   status;
+    char       *src;
+    const char *path = NULL;
+    int         status;
 
     if (conf->repl) {
         src = run_repl();
         if (!src) {
             return -1;
         }
+    } else if (conf->workers > 0) {
+        return run_scheduled(conf);
     } else {
-        if (conf->in_filename == NULL) {
+        path = conf->in_filename;
+        if (path == NULL && conf->input_count > 0) {
+            path = conf->inputs[0];
+        }
+        if (path == NULL) {
             printf("No file specified.\n");
             return -1;
         }
-        src = read_file(conf->in_filename);
+        if (conf->watch && !conf->object_path) {
+            return run_watch(path, conf);
+        }
+        src = read_file(path);
         if (!src) {
             return -1;
         }
     }
-    status = run_file(src, conf->print_lex, conf->print_parse);
+    if (conf->object_path) {
+        status = link_emit_object(src, path ? path : "<stdin>", conf->object_path) ? 0 : -1;
+    } else {
+        status = run_file(src, path, conf);
+    }
     free(src);
     return status;
 }
@@ -151,26 +231,87 @@ static char *read_file(const char *path) {
     return buffer;
 }
 
-static int run_file(const char *src, bool print_lex, bool print_parse) {
-    Lexer l;
+static int run_file(const char *src, const char *path, CmdArgsConfig *conf) {
+    LoadedProgram prog;
+    if (!load_program(src, path, conf, &prog)) {
+        return -1;
+    }
+
+    // `.callmode return` programs may return to any command, so they cannot
+    // rely on what the commands before it computed
+    int  status       = -1;
+    bool return_calls = prog.dirs.return_calls;
+    bool optimized    = return_calls || conf->no_gvn || optimize(prog.commands, &prog.lbm, conf);
+    if (optimized
+        && (!conf->profile_in || apply_profile(&prog.commands, &prog.lbm, return_calls, conf))) {
+        status = execute(prog.commands, &prog.lbm, &prog.ffi, &prog.dirs, &prog.link, conf);
+    }
+    unload_program(&prog);
+
+    return status;
+}
+
+/**
+ * @brief Lexes, expands, parses and links a source into a runnable program.
+ *
+ * Errors are reported on stdout.
+ *
+ * @param src The source.
+ * @param path The file the source was read from, or NULL; included modules
+ * and imports are found relative to it.
+ * @param conf The configuration of the run.
+ * @param prog The program to fill in. Must be released with `unload_program`
+ * on success; nothing needs releasing on failure.
+ * @return True on success, false otherwise.
+ */
+static bool load_program(const char *src, const char *path, CmdArgsConfig *conf,
+                         LoadedProgram *prog) {
+    // Lex once; the token dump and the parser share the result
+    Lexer      l;
+    TokenArray tokens;
+    uint64_t   lex_start = stats_now_ns();
     lexer_init(&l, src);
-    if (print_lex) {
-        print_lexed_tokens(&l);
-        // Reset so we can parse
-        lexer_init(&l, src);
+    bool     lexed  = lexer_tokenize(&l, &tokens);
+    uint64_t lex_ns = stats_now_ns() - lex_start;
+    if (!lexed) {
+        printf("Unable to allocate tokens. Aborting\n");
+        token_array_free(&tokens);
+        return false;
+    }
+    if (conf->print_lex) {
+        print_token_array(&tokens);
+    }
+
+    MacroError macro_error;
+    if (!expand_macros(&tokens, &macro_error)) {
+        printf("Macro expansion encountered an error:\n");
+        printf("On line %u: %s\n", macro_error.line, macro_error.message);
+        token_array_free(&tokens);
+        return false;
+    }
+
+    if (!link_collect_directives(&tokens, &prog->dirs)) {
+        link_directives_free(&prog->dirs);
+        token_array_free(&tokens);
+        return false;
     }
 
-    LabelMap lbm;
-    if (!label_map_init(&lbm, 100)) {
+    if (!label_map_init(&prog->lbm, 100)) {
         printf("Unable to allocate label hashmap. Aborting\n");
-        return -1;
+        link_directives_free(&prog->dirs);
+        token_array_free(&tokens);
+        return false;
     }
 
-    Parser p;
-    parser_init(&p, &l, &lbm);
-    Command *commands = parse_commands(&p);
-    if (print_parse) {
-        print_commands(commands);
+    Parser   p;
+    uint64_t parse_start = stats_now_ns();
+    parser_init(&p, &tokens, &prog->lbm);
+    prog->commands       = parse_commands(&p);
+    uint64_t parse_ns    = stats_now_ns() - parse_start;
+    int      token_count = tokens.count;
+    token_array_free(&tokens);
+    if (conf->print_parse) {
+        print_commands(prog->commands);
     }
 
     if (p.had_error) {
@@ -178,20 +319,535 @@ static int run_file(const char *src, bool print_lex, bool print_parse) {
         printf("At ");
         print_token(p.current);
         printf("\nParsed commands up to this point:\n");
-        print_commands(commands);
-        free_command(commands);
+        print_commands(prog->commands);
+        free_command(prog->commands);
+        label_map_free(&prog->lbm);
+        link_directives_free(&prog->dirs);
+        return false;
+    }
+    if (conf->stats) {
+        print_front_end_stats(prog->commands, token_count, lex_ns, parse_ns);
+    }
+
+    prog->link = (LinkOptions) {conf->no_cache ? NULL : conf->cache_dir, 0, 0};
+    if (!link_directives_empty(&prog->dirs)) {
+        if (prog->link.cache_dir == NULL && !conf->no_cache) {
+            prog->link.cache_dir = LINK_DEFAULT_CACHE_DIR;
+        }
+        bool linked = link_program(&prog->commands, &prog->lbm, &prog->dirs, path, &prog->link);
+        if (!linked) {
+            free_command(prog->commands);
+            label_map_free(&prog->lbm);
+            link_directives_free(&prog->dirs);
+            return false;
+        }
+    }
+    ffi_init(&prog->ffi);
+    bool bound = link_builtins(prog->commands)
+                 && link_imports(prog->commands, &prog->dirs, path, &prog->ffi);
+    if (!bound) {
+        unload_program(prog);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Releases a program built by `load_program`.
+ *
+ * @param prog The program to release.
+ */
+static void unload_program(LoadedProgram *prog) {
+    link_directives_free(&prog->dirs);
+    free_command(prog->commands);
+    label_map_free(&prog->lbm);
+    ffi_free(&prog->ffi);
+}
+
+/**
+ * @brief Runs every input at once on `--workers` threads, then prints the
+ * final state of each in the order given.
+ *
+ * An input may end in a priority, as in `prog.s@4`: that program then runs
+ * four times as many commands per turn as one of priority 1. Each program
+ * has its own memory and heap and runs in the interpreter only.
+ *
+ * @param conf The configuration of every run.
+ * @return 0 if every program ran without error, -1 otherwise.
+ */
+static int run_scheduled(CmdArgsConfig *conf) {
+    int count = conf->input_count + (conf->in_filename ? 1 : 0);
+    if (count == 0) {
+        printf("No file specified.\n");
+        return -1;
+    }
+    ScheduledInput *inputs   = calloc((size_t) count, sizeof(ScheduledInput));
+    SchedProgram  **programs = calloc((size_t) count, sizeof(SchedProgram *));
+    if (!inputs || !programs) {
+        printf("Could not allocate the scheduled programs\n");
+        free(inputs);
+        free(programs);
+        return -1;
+    }
+
+    int prepared = 0;
+    while (prepared < count) {
+        const char *arg = conf->in_filename && prepared == 0
+                              ? conf->in_filename
+                              : conf->inputs[prepared - (conf->in_filename ? 1 : 0)];
+        if (!prepare_input(&inputs[prepared], arg, conf)) {
+            break;
+        }
+        programs[prepared] = inputs[prepared].sched;
+        prepared++;
+    }
+
+    int status = -1;
+    if (prepared == count) {
+        status = sched_run(programs, count, conf->workers, (uint64_t) conf->slice) ? 0 : -1;
+        for (int i = 0; i < count; i++) {
+            SchedProgram *program = inputs[i].sched;
+            mem_bind(program->memory);
+            heap_bind(&program->heap);
+            if (count > 1) {
+                printf("==> %s <==\n", inputs[i].path);
+            }
+            if (!state_export(&program->intr, conf->state_format, NULL)
+                || program->intr.had_error) {
+                status = -1;
+            }
+            heap_bind(NULL);
+            mem_bind(NULL);
+        }
+        if (conf->stats) {
+            fflush(stdout);
+            print_sched_stats(inputs, count, conf);
+        }
+    }
+
+    for (int i = 0; i < prepared; i++) {
+        release_input(&inputs[i]);
+    }
+    free(inputs);
+    free(programs);
+    return status;
+}
+
+/**
+ * @brief Reads, links and optimizes one input of a scheduled run, and
+ * prepares it to be scheduled.
+ *
+ * @param input The input to fill in. Must be released with `release_input`
+ * on success; nothing needs releasing on failure.
+ * @param arg The input as given: a file, optionally followed by `@` and a
+ * priority.
+ * @param conf The configuration of the run.
+ * @return True on success, false if the input could not be read, linked or
+ * allocated.
+ */
+static bool prepare_input(ScheduledInput *input, const char *arg, CmdArgsConfig *conf) {
+    long        priority = 1;
+    size_t      length   = strlen(arg);
+    const char *suffix   = strrchr(arg, '@');
+    if (suffix && suffix[1] != '\0') {
+        char *endptr;
+        long  value = strtol(suffix + 1, &endptr, 10);
+        if (*endptr == '\0') {
+            if (value < 1 || value > SCHED_MAX_PRIORITY) {
+                printf("Priority of %s must be 1 to %d\n", arg, SCHED_MAX_PRIORITY);
+                return false;
+            }
+            priority = value;
+            length   = (size_t) (suffix - arg);
+        }
+    }
+
+    input->path  = calloc(length + 1, sizeof(char));
+    input->sched = malloc(sizeof(SchedProgram));
+    char *src    = NULL;
+    if (input->path && input->sched) {
+        memcpy(input->path, arg, length);
+        src = read_file(input->path);
+    } else {
+        printf("Could not allocate %s\n", arg);
+    }
+    if (!src || !load_program(src, input->path, conf, &input->prog)) {
+        free(src);
+        free(input->path);
+        free(input->sched);
+        return false;
+    }
+    free(src);
+
+    // The same passes `execute` runs, for a run without a profile
+    Command  *commands     = input->prog.commands;
+    LabelMap *lbm          = &input->prog.lbm;
+    bool      return_calls = input->prog.dirs.return_calls;
+    memset(&input->memo, 0, sizeof(input->memo));
+    if (!return_calls && !conf->no_gvn && !optimize(commands, lbm, conf)) {
+        release_input(input);
+        return false;
+    }
+    if (!return_calls && !conf->no_memo
+        && !memo_init(&input->memo, commands, lbm, input->prog.dirs.nomemo,
+                      input->prog.dirs.nomemo_count)) {
+        printf("Could not allocate the memoization table\n");
+        release_input(input);
+        return false;
+    }
+
+    SchedProgram *program = input->sched;
+    sched_program_init(program, commands, lbm, (int) priority, conf->heap_debug);
+    RangeStats ranges = {0, 0};
+    if (!conf->no_bce) {
+        range_analyze(commands, lbm, return_calls, &ranges);
+    }
+    program->intr.stats.enabled       = conf->stats;
+    program->intr.stats.mem_accesses  = ranges.accesses;
+    program->intr.stats.checks_elided = ranges.proven;
+    program->intr.instruction_limit   = (uint64_t) conf->max_instructions;
+    program->intr.ffi                 = &input->prog.ffi;
+    program->intr.return_calls        = return_calls;
+    program->intr.memo                = input->memo.function_count > 0 ? &input->memo : NULL;
+    return true;
+}
+
+/**
+ * @brief Releases an input prepared by `prepare_input`.
+ *
+ * @param input The input to release.
+ */
+static void release_input(ScheduledInput *input) {
+    memo_free(&input->memo, input->prog.commands);
+    unload_program(&input->prog);
+    free(input->sched);
+    free(input->path);
+}
+
+/**
+ * @brief Prints how much of the machine every scheduled program used, for
+ * `--stats`.
+ *
+ * @param inputs The inputs, after they ran.
+ * @param count Number of entries in `inputs`.
+ * @param conf The configuration of the run.
+ */
+static void print_sched_stats(const ScheduledInput *inputs, int count, CmdArgsConfig *conf) {
+    fprintf(stderr, "Scheduler: %d programs on %d workers, %d commands per slice\n", count,
+            conf->workers, conf->slice);
+    fprintf(stderr, "  %-24s %8s %14s %10s %10s %10s  %s\n", "program", "priority", "commands",
+            "turns", "migrations", "cpu ms", "status");
+    for (int i = 0; i < count; i++) {
+        const SchedProgram *program = inputs[i].sched;
+        fprintf(stderr, "  %-24s %8d %14" PRIu64 " %10" PRIu64 " %10" PRIu64 " %10.3f  %s\n",
+                inputs[i].path, program->priority, program->intr.executed, program->turns,
+                program->migrations, program->cpu_ns / 1e6,
+                program->intr.had_error ? "error" : "ok");
+    }
+}
+
+/**
+ * @brief Prints how long lexing and parsing a program took, for `--stats`.
+ *
+ * @param commands The first command of the parsed program.
+ * @param token_count Number of tokens lexed, including the final TOK_EOF.
+ * @param lex_ns Time spent lexing, in nanoseconds.
+ * @param parse_ns Time spent parsing, in nanoseconds.
+ */
+static void print_front_end_stats(const Command *commands, int token_count, uint64_t lex_ns,
+                                  uint64_t parse_ns) {
+    int command_count = 0;
+    for (const Command *cmd = commands; cmd != NULL; cmd = cmd->next) {
+        command_count++;
+    }
+    fprintf(stderr, "Front end: lexed %d tokens in %.3f ms, parsed %d commands in %.3f ms\n",
+            token_count, lex_ns / 1e6, command_count, parse_ns / 1e6);
+}
+
+/**
+ * @brief Removes redundant computations from a linked program by value
+ * numbering.
+ *
+ * Runs before profiles are collected or applied, so both see the same
+ * program.
+ *
+ * @param commands The first command of the program.
+ * @param lbm The program's labels.
+ * @param conf The configuration of the run.
+ * @return True on success, false if memory ran out.
+ */
+static bool optimize(Command *commands, LabelMap *lbm, CmdArgsConfig *conf) {
+    GvnStats gvn;
+    if (!gvn_optimize(commands, lbm, &gvn)) {
+        printf("Could not allocate the value numbering\n");
+        return false;
+    }
+    if (conf->stats) {
+        fprintf(stderr,
+                "Value numbering: %d commands removed, %d comparisons removed, %d folded, "
+                "%d reused, %d operands propagated\n",
+                gvn.removed, gvn.cmps, gvn.folded, gvn.reused, gvn.propagated);
+    }
+    return true;
+}
+
+/**
+ * @brief Reorders a linked program's blocks for the profile given with
+ * `--profile-in`.
+ *
+ * A profile collected from a different program is ignored with a warning, as
+ * is any profile of a `.callmode return` program: its return addresses are
+ * positions in the program, which the program can see on its stack.
+ *
+ * @param commands The first command of the program; updated to the new order.
+ * @param lbm The program's labels.
+ * @param return_calls Whether the program uses `.callmode return`.
+ * @param conf The configuration of the run.
+ * @return True on success, false if the profile could not be read or memory
+ * ran out.
+ */
+static bool apply_profile(Command **commands, LabelMap *lbm, bool return_calls,
+                          CmdArgsConfig *conf) {
+    Profile profile;
+    bool    ok = profile_read(&profile, conf->profile_in);
+    if (ok && return_calls) {
+        fprintf(stderr, "Ignoring profile %s: .callmode return programs keep their layout\n",
+                conf->profile_in);
+    } else if (ok && !profile_matches(&profile, *commands)) {
+        fprintf(stderr, "Profile %s was collected from a different program; ignoring it\n",
+                conf->profile_in);
+    } else if (ok) {
+        LayoutStats layout;
+        ok = layout_apply(commands, lbm, &profile, &layout);
+        if (ok && conf->stats) {
+            fprintf(stderr,
+                    "Layout: %d blocks, %d moved, %d branches inverted, %d jumps inserted, "
+                    "%d jumps removed\n",
+                    layout.blocks, layout.blocks_moved, layout.branches_inverted,
+                    layout.jumps_inserted, layout.jumps_removed);
+        }
+    }
+    profile_free(&profile);
+    return ok;
+}
+
+/**
+ * @brief Runs a file, then runs it again every time it changes.
+ *
+ * Programs without directives and macros are rebuilt incrementally: only the
+ * lines that changed are lexed and parsed again. After every run, a line on
+ * stderr compares the rebuild with the last cold build. Value numbering would
+ * rewrite the commands rebuilds keep, so no run is optimized.
+ *
+ * @param path The file to run.
+ * @param conf The configuration of every run.
+ * @return The status of the last run, or -1 if the file could not be watched.
+ */
+static int run_watch(const char *path, CmdArgsConfig *conf) {
+    FileWatch watch;
+    if (!watch_init(&watch, path)) {
+        return -1;
+    }
+
+    IncrementalProgram prog;
+    uint64_t           cold_ns = 0;
+    int                status  = -1;
+    incremental_init(&prog);
+    conf->no_gvn = true;
+    do {
+        char *src = read_file(path);
+        if (!src) {
+            fflush(stdout);
+            continue;
+        }
+
+        IncrementalReport report;
+        bool              built    = incremental_update(&prog, src, &report);
+        bool              runnable = built && incremental_runnable(&prog);
+        if (runnable && report.cold) {
+            cold_ns = time_cold_build(src);
+        }
+        // Directives, macros and errors are left to the regular pipeline
+        status = runnable ? run_built(&prog, conf) : run_file(src, path, conf);
+        free(src);
+        fflush(stdout);
+
+        double build_ms = report.build_ns / 1e6;
+        if (!runnable) {
+            fprintf(stderr, "Watch: rebuilt %s with the full pipeline\n", path);
+        } else if (report.cold) {
+            fprintf(stderr, "Watch: built %d lines in %.3f ms\n", report.lines_total, build_ms);
+        } else if (report.build_ns < cold_ns) {
+            fprintf(stderr,
+                    "Watch: rebuilt %d of %d lines (%d units) in %.3f ms, "
+                    "%.3f ms less than a cold lex and parse (%.3f ms)\n",
+                    report.lines_rebuilt, report.lines_total, report.units_rebuilt, build_ms,
+                    (double) (cold_ns - report.build_ns) / 1e6, cold_ns / 1e6);
+        } else {
+            fprintf(stderr,
+                    "Watch: rebuilt %d of %d lines (%d units) in %.3f ms, "
+                    "no faster than a cold lex and parse (%.3f ms)\n",
+                    report.lines_rebuilt, report.lines_total, report.units_rebuilt, build_ms,
+                    cold_ns / 1e6);
+        }
+    } while (watch_next(&watch));
+
+    incremental_free(&prog);
+    watch_free(&watch);
+    return status;
+}
+
+/**
+ * @brief Times lexing and parsing a whole source the way a run without
+ * `--watch` does, as the baseline incremental rebuilds are compared with.
+ *
+ * @param src The source.
+ * @return The wall time taken, in nanoseconds.
+ */
+static uint64_t time_cold_build(const char *src) {
+    uint64_t   start = stats_now_ns();
+    Lexer      l;
+    TokenArray tokens;
+    LabelMap   lbm;
+    lexer_init(&l, src);
+    if (lexer_tokenize(&l, &tokens) && label_map_init(&lbm, 100)) {
+        Parser p;
+        parser_init(&p, &tokens, &lbm);
+        free_command(parse_commands(&p));
         label_map_free(&lbm);
+    }
+    token_array_free(&tokens);
+    return stats_now_ns() - start;
+}
+
+/**
+ * @brief Runs the commands of an incrementally built program.
+ *
+ * @param prog The program, which uses no directives, so only builtins need
+ * linking.
+ * @param conf The configuration of the run.
+ * @return 0 on success, -1 on error.
+ */
+static int run_built(IncrementalProgram *prog, CmdArgsConfig *conf) {
+    if (conf->print_parse) {
+        print_commands(prog->commands);
+    }
+    if (!link_builtins(prog->commands)) {
         return -1;
     }
 
+    FfiTable       ffi;
+    LinkDirectives dirs;
+    LinkOptions    link = {NULL, 0, 0};
+    memset(&dirs, 0, sizeof(dirs));
+    ffi_init(&ffi);
+    int status = execute(prog->commands, &prog->label_map, &ffi, &dirs, &link, conf);
+    ffi_free(&ffi);
+    return status;
+}
+
+/**
+ * @brief Interprets linked commands from a clean machine state and reports
+ * on the run.
+ *
+ * @param commands The program.
+ * @param lbm The program's labels.
+ * @param ffi The program's imported functions.
+ * @param dirs The program's directives: its call mode and the functions it
+ * keeps from being memoized.
+ * @param link What linking did, for the statistics.
+ * @param conf The configuration of the run.
+ * @return 0 on success, -1 if execution or writing the state or profile failed.
+ */
+static int execute(Command *commands, LabelMap *lbm, FfiTable *ffi,
+                   const LinkDirectives *dirs, const LinkOptions *link,
+                   CmdArgsConfig *conf) {
+    bool        return_calls = dirs->return_calls;
     Interpreter i;
-    interpreter_init(&i, &lbm);
-    interpret(&i, commands);
-    print_interpreter_state(&i);
-    mem_print();
+    interpreter_init(&i, lbm);
+    i.tier_threshold    = conf->tier_threshold;
+    i.native            = conf->native && native_available();
+    i.trace_threshold   = conf->trace_threshold;
+    i.stats.enabled     = conf->stats;
+    i.instruction_limit = (uint64_t) conf->max_instructions;
+    i.ffi               = ffi;
+    i.heap_debug        = conf->heap_debug;
+    i.return_calls      = return_calls;
+    if (conf->trace_threshold == TRACE_AUTO_THRESHOLD) {
+        // Portable traces run no faster than the compiled blocks they replace
+        i.trace_threshold = i.native ? TRACE_DEFAULT_THRESHOLD : 0;
+    }
+    if (conf->heap_debug) {
+        // Compiled code accesses memory directly, bypassing the checks
+        i.tier_threshold  = 0;
+        i.trace_threshold = 0;
+        i.native          = false;
+    }
+    Profile profile;
+    if (conf->profile_out) {
+        if (!profile_init(&profile, commands)) {
+            printf("Could not allocate the profile\n");
+            profile_free(&profile);
+            return -1;
+        }
+        // Compiled code does not count the commands it runs
+        i.profile         = &profile;
+        i.tier_threshold  = 0;
+        i.trace_threshold = 0;
+        i.native          = false;
+    }
+    // Without the analysis every access simply stays checked
+    RangeStats ranges = {0, 0};
+    if (!conf->no_bce) {
+        range_analyze(commands, lbm, return_calls, &ranges);
+    }
+    i.stats.mem_accesses  = ranges.accesses;
+    i.stats.checks_elided = ranges.proven;
 
-    free_command(commands);
-    label_map_free(&lbm);
+    // `.callmode return` callees save and restore registers themselves, so
+    // no call is known to leave x1..x31 alone
+    MemoTable memo;
+    memset(&memo, 0, sizeof(memo));
+    if (!return_calls && !conf->no_memo) {
+        if (!memo_init(&memo, commands, lbm, dirs->nomemo, dirs->nomemo_count)) {
+            printf("Could not allocate the memoization table\n");
+            memo_free(&memo, commands);
+            if (conf->profile_out) {
+                profile_free(&profile);
+            }
+            return -1;
+        }
+        i.memo = &memo;
+    }
+
+    mem_reset();
+    heap_reset(conf->heap_debug);
+    interpret(&i, commands);
+    bool exported = state_export(&i, conf->state_format, conf->state_path);
+    if (conf->profile_out) {
+        exported = profile_write(&profile, conf->profile_out) && exported;
+        profile_free(&profile);
+    }
+    if (conf->stats) {
+        fflush(stdout);
+        print_exec_stats(&i.stats, stderr);
+        const HeapStats *heap = heap_stats();
+        if (heap->allocs > 0 || heap->failures > 0 || heap->reallocs > 0) {
+            heap_print_stats(stderr);
+        }
+        if (link->modules > 0) {
+            fprintf(stderr, "Modules linked: %d (%d from cache)\n", link->modules, link->cached);
+        }
+        if (memo.function_count > 0) {
+            fprintf(stderr,
+                    "Memoized calls: %" PRIu64 " hits of %" PRIu64
+                    " (%.1f%%), %d functions, %" PRIu64 " evictions\n",
+                    memo.hits, memo.lookups,
+                    memo.lookups ? 100.0 * (double) memo.hits / (double) memo.lookups : 0.0,
+                    memo.function_count, memo.evictions);
+        }
+    }
+    memo_free(&memo, commands);
 
-    return (i.had_error) ? -1 : 0;
+    return (i.had_error || !exported) ? -1 : 0;
 }
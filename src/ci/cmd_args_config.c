@@ -2,6 +2,25 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include "scheduler.h"
+#include "tier.h"
+#include "trace.h"
+
+static bool parse_count(const char *arg, int *result);
+static bool add_input(CmdArgsConfig *conf, char *arg);
+static bool copy_arg(char **field, const char *arg);
+
+void config_init(CmdArgsConfig *conf) {
+    if (!conf) {
+        return;
+    }
+
+    memset(conf, 0, sizeof(*conf));
+    conf->tier_threshold  = TIER_DEFAULT_THRESHOLD;
+    conf->trace_threshold = TRACE_AUTO_THRESHOLD;
+    conf->slice           = SCHED_DEFAULT_SLICE;
+    gen_config_init(&conf->gen_config);
+}
 
 void config_free(CmdArgsConfig *conf) {
     if (!conf) {
@@ -10,8 +29,23 @@ void config_free(CmdArgsConfig *conf) {
 
     free(conf->in_filename);
     free(conf->out_filename);
-    conf->in_filename  = NULL;
-    conf->out_filename = NULL;
+    free(conf->reference_path);
+    free(conf->cache_dir);
+    free(conf->object_path);
+    free(conf->state_path);
+    free(conf->profile_out);
+    free(conf->profile_in);
+    free(conf->inputs);
+    conf->in_filename    = NULL;
+    conf->out_filename   = NULL;
+    conf->reference_path = NULL;
+    conf->cache_dir      = NULL;
+    conf->object_path    = NULL;
+    conf->state_path     = NULL;
+    conf->profile_out    = NULL;
+    conf->profile_in     = NULL;
+    conf->inputs         = NULL;
+    conf->input_count    = 0;
 }
 
 bool parse_cmd_args(CmdArgsConfig *conf, char **args, int arg_count) {
@@ -24,7 +58,129 @@ bool parse_cmd_args(CmdArgsConfig *conf, char **args, int arg_count) {
     }
 
     for (int i = 0; i < arg_count; i++) {
-        if (strncmp(args[i], "-l", 2) == 0) {
+        if (strcmp(args[i], "--stats") == 0) {
+            conf->stats = true;
+        } else if (strcmp(args[i], "--no-tier") == 0) {
+            conf->tier_threshold = 0;
+        } else if (strcmp(args[i], "--tier-threshold") == 0) {
+            i++;
+            if (i >= arg_count || !parse_count(args[i], &conf->tier_threshold)) {
+                printf("Expected a non-negative threshold after --tier-threshold\n");
+                return false;
+            }
+        } else if (strcmp(args[i], "--native") == 0) {
+            conf->native = true;
+        } else if (strcmp(args[i], "--no-bce") == 0) {
+            conf->no_bce = true;
+        } else if (strcmp(args[i], "--no-gvn") == 0) {
+            conf->no_gvn = true;
+        } else if (strcmp(args[i], "--no-memo") == 0) {
+            conf->no_memo = true;
+        } else if (strcmp(args[i], "--no-trace") == 0) {
+            conf->trace_threshold = 0;
+        } else if (strcmp(args[i], "--trace-threshold") == 0) {
+            i++;
+            if (i >= arg_count || !parse_count(args[i], &conf->trace_threshold)) {
+                printf("Expected a non-negative threshold after --trace-threshold\n");
+                return false;
+            }
+        } else if (strcmp(args[i], "--max-instructions") == 0) {
+            i++;
+            if (i >= arg_count || !parse_count(args[i], &conf->max_instructions)) {
+                printf("Expected a non-negative count after --max-instructions\n");
+                return false;
+            }
+        } else if (strcmp(args[i], "--diff-test") == 0) {
+            conf->diff_test = true;
+        } else if (strcmp(args[i], "--reference") == 0) {
+            i++;
+            if (i >= arg_count) {
+                printf("Reference binary not specified\n");
+                return false;
+            }
+
+            free(conf->reference_path);
+            conf->reference_path = calloc(strlen(args[i]) + 1, sizeof(char));
+            if (!conf->reference_path) {
+                printf("Failed to allocate space for filename\n");
+                return false;
+            }
+
+            strcpy(conf->reference_path, args[i]);
+        } else if (strcmp(args[i], "--cache-dir") == 0) {
+            i++;
+            if (i >= arg_count || !copy_arg(&conf->cache_dir, args[i])) {
+                printf("Expected a directory after --cache-dir\n");
+                return false;
+            }
+        } else if (strncmp(args[i], "--state-format=", 15) == 0) {
+            if (!state_parse_format(args[i] + 15, &conf->state_format)) {
+                printf("Expected text, json or bin after --state-format=\n");
+                return false;
+            }
+        } else if (strcmp(args[i], "--state-format") == 0) {
+            i++;
+            if (i >= arg_count || !state_parse_format(args[i], &conf->state_format)) {
+                printf("Expected text, json or bin after --state-format\n");
+                return false;
+            }
+        } else if (strcmp(args[i], "--state-out") == 0) {
+            i++;
+            if (i >= arg_count || !copy_arg(&conf->state_path, args[i])) {
+                printf("Expected a file after --state-out\n");
+                return false;
+            }
+        } else if (strcmp(args[i], "--profile-out") == 0) {
+            i++;
+            if (i >= arg_count || !copy_arg(&conf->profile_out, args[i])) {
+                printf("Expected a file after --profile-out\n");
+                return false;
+            }
+        } else if (strcmp(args[i], "--profile-in") == 0) {
+            i++;
+            if (i >= arg_count || !copy_arg(&conf->profile_in, args[i])) {
+                printf("Expected a file after --profile-in\n");
+                return false;
+            }
+        } else if (strcmp(args[i], "--heap-debug") == 0) {
+            conf->heap_debug = true;
+        } else if (strcmp(args[i], "--watch") == 0) {
+            conf->watch = true;
+        } else if (strcmp(args[i], "--workers") == 0) {
+            i++;
+            if (i >= arg_count || !parse_count(args[i], &conf->workers) || conf->workers < 1 ||
+                conf->workers > SCHED_MAX_WORKERS) {
+                printf("Expected 1 to %d workers after --workers\n", SCHED_MAX_WORKERS);
+                return false;
+            }
+        } else if (strcmp(args[i], "--slice") == 0) {
+            i++;
+            if (i >= arg_count || !parse_count(args[i], &conf->slice) || conf->slice < 1) {
+                printf("Expected a positive count after --slice\n");
+                return false;
+            }
+        } else if (strcmp(args[i], "--no-cache") == 0) {
+            conf->no_cache = true;
+        } else if (strcmp(args[i], "--emit-object") == 0) {
+            i++;
+            if (i >= arg_count || !copy_arg(&conf->object_path, args[i])) {
+                printf("Expected a file after --emit-object\n");
+                return false;
+            }
+        } else if (strcmp(args[i], "--gen") == 0) {
+            conf->gen = true;
+        } else if (strcmp(args[i], "--seed") == 0 || strncmp(args[i], "--gen-", 6) == 0) {
+            i++;
+            if (i >= arg_count || !gen_set_option(&conf->gen_config, args[i - 1], args[i])) {
+                printf("Invalid or missing value for %s\n", args[i - 1]);
+                return false;
+            }
+        } else if (args[i][0] != '-') {
+            if (!add_input(conf, args[i])) {
+                printf("Failed to allocate space for inputs\n");
+                return false;
+            }
+        } else if (strncmp(args[i], "-l", 2) == 0) {
             conf->print_lex = true;
         } else if (strncmp(args[i], "-p", 2) == 0) {
             conf->print_parse = true;
@@ -59,5 +215,77 @@ bool parse_cmd_args(CmdArgsConfig *conf, char **args, int arg_count) {
         }
     }
 
+    if (conf->profile_in && conf->profile_out) {
+        // Counts of a reordered program do not apply to its source
+        printf("--profile-in and --profile-out cannot be combined\n");
+        return false;
+    }
+    if (conf->profile_in && conf->watch) {
+        // Rebuilds keep the source order of the commands they did not reparse
+        printf("--profile-in cannot be combined with --watch\n");
+        return false;
+    }
+    if (conf->workers && (conf->state_path || conf->profile_in || conf->profile_out ||
+                          conf->watch || conf->object_path || conf->diff_test)) {
+        // Each scheduled program prints its own state after all have stopped
+        printf("--workers cannot be combined with --state-out, --profile-in, --profile-out, "
+               "--watch, --emit-object or --diff-test\n");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Parses a non-negative decimal count from a command line argument.
+ *
+ * @param arg The argument to parse.
+ * @param result A pointer to the value to modify on success.
+ * @return True if `arg` was a valid count, false otherwise.
+ */
+static bool parse_count(const char *arg, int *result) {
+    char *endptr;
+    long  value = strtol(arg, &endptr, 10);
+    if (*arg == '\0' || *endptr != '\0' || value < 0 || value > 1000000000L) {
+        return false;
+    }
+
+    *result = (int) value;
+    return true;
+}
+
+/**
+ * @brief Appends a positional argument to the list of inputs.
+ *
+ * @param conf The configuration to modify.
+ * @param arg The argument to append; it is referenced, not copied.
+ * @return True if the argument was appended, false if allocation failed.
+ */
+static bool add_input(CmdArgsConfig *conf, char *arg) {
+    char **inputs = realloc(conf->inputs, (conf->input_count + 1) * sizeof(char *));
+    if (!inputs) {
+        return false;
+    }
+
+    inputs[conf->input_count++] = arg;
+    conf->inputs                = inputs;
+    return true;
+}
+
+/**
+ * @brief Replaces a string option with a copy of an argument.
+ *
+ * @param field The option to set; its previous value is freed.
+ * @param arg The argument to copy.
+ * @return True on success, false if allocation failed.
+ */
+static bool copy_arg(char **field, const char *arg) {
+    char *copy = calloc(strlen(arg) + 1, sizeof(char));
+    if (!copy) {
+        return false;
+    }
+
+    strcpy(copy, arg);
+    free(*field);
+    *field = copy;
     return true;
 }
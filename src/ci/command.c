@@ -9,9 +9,11 @@ void free_command(Command *command) {
         command = command->next;
         
         if (temp->type == CMD_BRANCH || temp->type == CMD_CALL 
-           || temp->type == CMD_RET) {
+           || temp->type == CMD_BUILTIN || temp->type == CMD_CCALL || temp->type == CMD_RET) {
             char* id = temp->destination.str_val;
             free(id);
+        } else if (temp->type == CMD_PUT) {
+            free(temp->val_a.str_val);
         }
         free(temp);
     }
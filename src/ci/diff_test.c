@@ -0,0 +1,612 @@
+#define _POSIX_C_SOURCE 200809L
+#include "diff_test.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "native.h"
+
+#define MAX_ENGINE_FLAGS 6
+#define PARSE_ERROR "Parser encountered an error"  // How an engine reports a parse error
+
+/**
+ * @brief An execution engine and the flags that select it.
+ */
+typedef struct {
+    const char *name;                     // Name used in reports
+    const char *flags[MAX_ENGINE_FLAGS];  // Flags passed before `-i`, NULL-terminated
+    bool        reference;                // Runs the reference binary instead of this one
+    bool        native;                   // Requires native code generation
+} Engine;
+
+/**
+ * @brief The observable result of running one program on one engine.
+ */
+typedef struct {
+    char  *output;     // Everything written to stdout
+    size_t length;     // Number of bytes in `output`
+    int    status;     // Exit status, or 128 + signal number
+    bool   timed_out;  // Killed after DIFF_TEST_TIMEOUT seconds
+} RunResult;
+
+/**
+ * @brief A program split into lines, the unit the minimizer deletes.
+ */
+typedef struct {
+    char **lines;  // Line contents without terminators
+    int    count;  // Number of lines
+    char  *text;   // Buffer the lines point into
+} Program;
+
+/**
+ * @brief State shared by the runs of one differential test.
+ */
+typedef struct {
+    const char *self;       // This binary
+    const char *reference;  // The reference binary, NULL if unavailable
+} Harness;
+
+static const Engine engines[] = {
+    {"interpreter", {"--no-tier", "--no-trace", "--no-gvn", "--no-memo", NULL}, false, false},
+    {"compiled", {"--tier-threshold", "1", "--no-trace", NULL}, false, false},
+    {"trace", {"--no-tier", "--trace-threshold", "1", NULL}, false, false},
+    {"native", {"--native", "--tier-threshold", "1", "--no-trace", NULL}, false, true},
+    {"reference", {NULL}, true, false},
+};
+
+#define ENGINE_COUNT ((int) (sizeof(engines) / sizeof(engines[0])))
+
+static bool        engine_usable(const Harness *h, const Engine *engine);
+static bool        run_engine(const Harness *h, const Engine *engine, const char *path,
+                              RunResult *result);
+static void        result_free(RunResult *result);
+static bool        results_equal(const RunResult *a, const RunResult *b);
+static bool        parse_failed(const RunResult *result);
+static const char *divergence_section(const RunResult *a, const RunResult *b);
+static bool        diverges(const Harness *h, const Engine *a, const Engine *b, const char *path);
+static int         test_program(const Harness *h, const char *path);
+static void        minimize(const Harness *h, const Engine *a, const Engine *b, const char *path);
+static bool        program_load(Program *program, const char *path);
+static bool        program_write(const Program *program, const bool *keep, const char *path);
+static void        program_free(Program *program);
+
+int run_diff_test(const CmdArgsConfig *conf, const char *self_path) {
+    Harness h;
+    h.self      = access("/proc/self/exe", X_OK) == 0 ? "/proc/self/exe" : self_path;
+    h.reference = conf->reference_path ? conf->reference_path : DIFF_TEST_DEFAULT_REFERENCE;
+    if (access(h.reference, X_OK) != 0) {
+        printf("Skipping reference engine: %s is not executable\n", h.reference);
+        h.reference = NULL;
+    }
+
+    int total = conf->input_count + (conf->in_filename != NULL);
+    if (total == 0) {
+        printf("No programs to test.\n");
+        return -1;
+    }
+
+    int diverged    = 0;
+    int unsupported = 0;
+    int failed      = 0;
+    for (int i = 0; i < total; i++) {
+        const char *path = i < conf->input_count ? conf->inputs[i] : conf->in_filename;
+        int         res  = test_program(&h, path);
+        if (res == 1) {
+            diverged++;
+        } else if (res == 2) {
+            unsupported++;
+        } else if (res < 0) {
+            failed++;
+        }
+    }
+
+    printf("%d program(s) tested, %d diverged, %d unsupported by reference, %d could not be run\n",
+           total, diverged, unsupported, failed);
+    if (failed > 0) {
+        return -1;
+    }
+    return diverged > 0 ? 1 : 0;
+}
+
+/**
+ * @brief Runs one program on every usable engine and reports the first
+ * divergence from the plain interpreter, minimizing the program if found.
+ *
+ * A program only the reference fails to parse uses syntax the reference
+ * predates; the reference is left out of its comparison.
+ *
+ * @param h The harness state.
+ * @param path Path of the program to test.
+ * @return 0 if all engines agreed, 1 if they diverged, 2 if all but the
+ * reference agreed and the reference could not parse the program, -1 on
+ * harness failure.
+ */
+static int test_program(const Harness *h, const char *path) {
+    RunResult results[ENGINE_COUNT];
+    bool      ran[ENGINE_COUNT] = {false};
+    int       used              = 0;
+    int       status            = 0;
+
+    for (int e = 0; e < ENGINE_COUNT; e++) {
+        if (!engine_usable(h, &engines[e])) {
+            continue;
+        }
+        if (!run_engine(h, &engines[e], path, &results[e])) {
+            status = -1;
+            break;
+        }
+        ran[e] = true;
+        used++;
+    }
+
+    // Engine 0, the plain interpreter, is the baseline every other engine must match
+    bool unsupported = false;
+    int  culprit     = -1;
+    for (int e = 1; status == 0 && e < ENGINE_COUNT; e++) {
+        if (ran[e] && engines[e].reference && parse_failed(&results[e]) &&
+            !parse_failed(&results[0])) {
+            unsupported = true;
+        } else if (ran[e] && !results_equal(&results[0], &results[e])) {
+            culprit = e;
+            status  = 1;
+        }
+    }
+
+    if (status == 0 && unsupported) {
+        printf("%s: ok (%d engines), unsupported by reference\n", path, used - 1);
+        status = 2;
+    } else if (status == 0) {
+        printf("%s: ok (%d engines)\n", path, used);
+    } else if (status > 0) {
+        printf("%s: %s and %s diverge in %s\n", path, engines[0].name, engines[culprit].name,
+               divergence_section(&results[0], &results[culprit]));
+        minimize(h, &engines[0], &engines[culprit], path);
+    } else {
+        printf("%s: could not run engines\n", path);
+    }
+
+    for (int e = 0; e < ENGINE_COUNT; e++) {
+        if (ran[e]) {
+            result_free(&results[e]);
+        }
+    }
+    return status;
+}
+
+/**
+ * @brief Determines whether an engine can run on this host.
+ *
+ * @param h The harness state.
+ * @param engine The engine to check.
+ * @return True if the engine's requirements are met.
+ */
+static bool engine_usable(const Harness *h, const Engine *engine) {
+    if (engine->reference) {
+        return h->reference != NULL;
+    }
+    return !engine->native || native_available();
+}
+
+/**
+ * @brief Runs a program in a child process and captures its output and status.
+ *
+ * The child's stdin and stderr are redirected to /dev/null and it is killed by
+ * SIGALRM after DIFF_TEST_TIMEOUT seconds.
+ *
+ * @param h The harness state.
+ * @param engine The engine to run.
+ * @param path Path of the program to run.
+ * @param result Receives the output and status. Must be released with
+ * `result_free` on success.
+ * @return True if the child was run, false if it could not be started.
+ */
+static bool run_engine(const Harness *h, const Engine *engine, const char *path,
+                       RunResult *result) {
+    const char *argv[MAX_ENGINE_FLAGS + 4];
+    int         argc = 0;
+
+    argv[argc++] = engine->reference ? h->reference : h->self;
+    for (int f = 0; engine->flags[f] != NULL; f++) {
+        argv[argc++] = engine->flags[f];
+    }
+    argv[argc++] = "-i";
+    argv[argc++] = path;
+    argv[argc]   = NULL;
+
+    int pipe_fds[2];
+    if (pipe(pipe_fds) != 0) {
+        perror("pipe");
+        return false;
+    }
+
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+        return false;
+    }
+
+    if (pid == 0) {
+        int null_fd = open("/dev/null", O_RDWR);
+        if (null_fd >= 0) {
+            dup2(null_fd, STDIN_FILENO);
+            dup2(null_fd, STDERR_FILENO);
+            close(null_fd);
+        }
+        dup2(pipe_fds[1], STDOUT_FILENO);
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+        alarm(DIFF_TEST_TIMEOUT);
+        execv(argv[0], (char *const *) argv);
+        _exit(127);
+    }
+
+    close(pipe_fds[1]);
+    result->output    = NULL;
+    result->length    = 0;
+    result->timed_out = false;
+
+    size_t capacity = 0;
+    char   chunk[4096];
+    for (;;) {
+        ssize_t got = read(pipe_fds[0], chunk, sizeof(chunk));
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            break;
+        }
+
+        // Keep draining a runaway child but stop storing its output
+        size_t keep = (size_t) got;
+        if (result->length + keep > DIFF_TEST_MAX_OUTPUT) {
+            keep = DIFF_TEST_MAX_OUTPUT - result->length;
+        }
+        if (result->length + keep > capacity) {
+            size_t new_capacity = capacity ? capacity * 2 : sizeof(chunk);
+            while (new_capacity < result->length + keep) {
+                new_capacity *= 2;
+            }
+            char *output = realloc(result->output, new_capacity);
+            if (!output) {
+                printf("Could not allocate space for engine output\n");
+                break;
+            }
+            result->output = output;
+            capacity       = new_capacity;
+        }
+        if (keep > 0) {
+            memcpy(result->output + result->length, chunk, keep);
+            result->length += keep;
+        }
+    }
+    close(pipe_fds[0]);
+
+    int wstatus = 0;
+    while (waitpid(pid, &wstatus, 0) < 0) {
+        if (errno != EINTR) {
+            perror("waitpid");
+            result_free(result);
+            return false;
+        }
+    }
+
+    if (WIFSIGNALED(wstatus)) {
+        result->status    = 128 + WTERMSIG(wstatus);
+        result->timed_out = WTERMSIG(wstatus) == SIGALRM;
+    } else {
+        result->status = WEXITSTATUS(wstatus);
+    }
+    return true;
+}
+
+/**
+ * @brief Releases the output captured by `run_engine`.
+ *
+ * @param result The result to release.
+ */
+static void result_free(RunResult *result) {
+    free(result->output);
+    result->output = NULL;
+    result->length = 0;
+}
+
+/**
+ * @brief Compares two engine results.
+ *
+ * Two runs that both time out are considered equal, as the amount of output
+ * produced before the deadline depends on the engine's speed.
+ *
+ * @param a The first result.
+ * @param b The second result.
+ * @return True if the results are indistinguishable.
+ */
+static bool results_equal(const RunResult *a, const RunResult *b) {
+    if (a->timed_out && b->timed_out) {
+        return true;
+    }
+    return a->status == b->status && a->length == b->length &&
+           (a->length == 0 || memcmp(a->output, b->output, a->length) == 0);
+}
+
+/**
+ * @brief Determines whether a run stopped because its program could not be
+ * parsed.
+ *
+ * @param result The result.
+ * @return True if the output reports a parse error.
+ */
+static bool parse_failed(const RunResult *result) {
+    size_t length = strlen(PARSE_ERROR);
+    for (size_t i = 0; i + length <= result->length; i++) {
+        if (memcmp(result->output + i, PARSE_ERROR, length) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Names the part of the output in which two results first differ.
+ *
+ * The output of a run consists of the program's own output, followed by the
+ * register and flag state (starting at "Error: ") and the memory dump
+ * (starting at "Memory state:").
+ *
+ * @param a The first result.
+ * @param b The second result.
+ * @return A description of the first difference.
+ */
+static const char *divergence_section(const RunResult *a, const RunResult *b) {
+    if (a->timed_out != b->timed_out) {
+        return "termination (one engine timed out)";
+    }
+
+    size_t shorter = a->length < b->length ? a->length : b->length;
+    size_t offset  = 0;
+    while (offset < shorter && a->output[offset] == b->output[offset]) {
+        offset++;
+    }
+    if (offset == a->length && offset == b->length) {
+        return "exit status";
+    }
+
+    // Locate the last state header in the baseline so program output that
+    // happens to contain the same text does not confuse the classification
+    size_t state = a->length;
+    size_t mem   = a->length;
+    for (size_t i = 0; i < a->length; i++) {
+        bool line_start = i == 0 || a->output[i - 1] == '\n';
+        if (line_start && a->length - i >= 7 && memcmp(a->output + i, "Error: ", 7) == 0) {
+            state = i;
+        } else if (line_start && a->length - i >= 13 &&
+                   memcmp(a->output + i, "Memory state:", 13) == 0) {
+            mem = i;
+        }
+    }
+
+    if (offset < state) {
+        return "program output";
+    }
+    if (offset < mem) {
+        return "register and flag state";
+    }
+    return "memory state";
+}
+
+/**
+ * @brief Determines whether two engines disagree on a program.
+ *
+ * @param h The harness state.
+ * @param a The first engine.
+ * @param b The second engine.
+ * @param path Path of the program to run.
+ * @return True if both engines ran and produced different results.
+ */
+static bool diverges(const Harness *h, const Engine *a, const Engine *b, const char *path) {
+    RunResult ra, rb;
+    if (!run_engine(h, a, path, &ra)) {
+        return false;
+    }
+    if (!run_engine(h, b, path, &rb)) {
+        result_free(&ra);
+        return false;
+    }
+
+    bool differ = !results_equal(&ra, &rb);
+    result_free(&ra);
+    result_free(&rb);
+    return differ;
+}
+
+/**
+ * @brief Shrinks a diverging program and prints the result.
+ *
+ * Runs of lines are deleted, halving the run length whenever no run of the
+ * current length can be removed, for as long as the two engines keep
+ * disagreeing. Deletions that break the program make both engines report the
+ * same parse error and are therefore rejected automatically.
+ *
+ * @param h The harness state.
+ * @param a The first diverging engine.
+ * @param b The second diverging engine.
+ * @param path Path of the diverging program.
+ */
+static void minimize(const Harness *h, const Engine *a, const Engine *b, const char *path) {
+    Program program;
+    if (!program_load(&program, path)) {
+        return;
+    }
+
+    char scratch[] = "/tmp/ci-diff-XXXXXX";
+    int  fd        = mkstemp(scratch);
+    bool *keep     = calloc(program.count > 0 ? program.count : 1, sizeof(bool));
+    if (fd < 0 || !keep) {
+        printf("Could not set up minimization\n");
+        if (fd >= 0) {
+            close(fd);
+            unlink(scratch);
+        }
+        free(keep);
+        program_free(&program);
+        return;
+    }
+    close(fd);
+
+    for (int i = 0; i < program.count; i++) {
+        keep[i] = true;
+    }
+
+    int remaining = program.count;
+    for (int chunk = remaining / 2 > 0 ? remaining / 2 : 1; chunk >= 1; chunk /= 2) {
+        bool progress = true;
+        while (progress) {
+            progress = false;
+            for (int start = 0; start < program.count; start++) {
+                if (!keep[start]) {
+                    continue;
+                }
+
+                // Remove the next `chunk` kept lines starting at `start`
+                int removed[chunk];
+                int n = 0;
+                for (int i = start; i < program.count && n < chunk; i++) {
+                    if (keep[i]) {
+                        removed[n++] = i;
+                        keep[i]      = false;
+                    }
+                }
+
+                if (program_write(&program, keep, scratch) && diverges(h, a, b, scratch)) {
+                    remaining -= n;
+                    progress   = true;
+                } else {
+                    for (int i = 0; i < n; i++) {
+                        keep[removed[i]] = true;
+                    }
+                }
+            }
+        }
+    }
+
+    printf("Minimized program (%d of %d lines):\n", remaining, program.count);
+    for (int i = 0; i < program.count; i++) {
+        if (keep[i]) {
+            printf("    %s\n", program.lines[i]);
+        }
+    }
+
+    unlink(scratch);
+    free(keep);
+    program_free(&program);
+}
+
+/**
+ * @brief Reads a program and splits it into lines.
+ *
+ * @param program The program to fill in. Must be released with `program_free`.
+ * @param path Path of the program to read.
+ * @return True on success, false if the file could not be read.
+ */
+static bool program_load(Program *program, const char *path) {
+    program->lines = NULL;
+    program->count = 0;
+    program->text  = NULL;
+
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        printf("Failed to open file %s\n", path);
+        return false;
+    }
+
+    size_t capacity = 4096;
+    size_t length   = 0;
+    char  *text     = malloc(capacity);
+    while (text) {
+        length += fread(text + length, 1, capacity - length - 1, file);
+        if (length < capacity - 1) {
+            break;
+        }
+        capacity *= 2;
+        char *grown = realloc(text, capacity);
+        if (!grown) {
+            free(text);
+        }
+        text = grown;
+    }
+    fclose(file);
+    if (!text) {
+        printf("Could not allocate enough space for %s\n", path);
+        return false;
+    }
+    text[length] = '\0';
+
+    int lines = 1;
+    for (size_t i = 0; i < length; i++) {
+        lines += text[i] == '\n';
+    }
+
+    program->lines = calloc(lines, sizeof(char *));
+    if (!program->lines) {
+        free(text);
+        printf("Could not allocate enough space for %s\n", path);
+        return false;
+    }
+
+    char *line = text;
+    for (char *c = text;; c++) {
+        if (*c == '\n' || *c == '\0') {
+            bool end = *c == '\0';
+            *c       = '\0';
+            if (!end || c != line) {
+                program->lines[program->count++] = line;
+            }
+            if (end) {
+                break;
+            }
+            line = c + 1;
+        }
+    }
+    program->text = text;
+    return true;
+}
+
+/**
+ * @brief Writes the kept lines of a program to a file.
+ *
+ * @param program The program to write.
+ * @param keep Which lines to write.
+ * @param path Path of the file to overwrite.
+ * @return True on success.
+ */
+static bool program_write(const Program *program, const bool *keep, const char *path) {
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        return false;
+    }
+    for (int i = 0; i < program->count; i++) {
+        if (keep[i]) {
+            fprintf(file, "%s\n", program->lines[i]);
+        }
+    }
+    return fclose(file) == 0;
+}
+
+/**
+ * @brief Releases a program loaded by `program_load`.
+ *
+ * @param program The program to release.
+ */
+static void program_free(Program *program) {
+    free(program->lines);
+    free(program->text);
+    program->lines = NULL;
+    program->text  = NULL;
+    program->count = 0;
+}
@@ -0,0 +1,185 @@
+#define _POSIX_C_SOURCE 200809L
+#include "ffi.h"
+#include <dlfcn.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "heap.h"
+#include "mem.h"
+
+// Every function is called as taking eight integers. Under the System V ABI
+// integer and pointer arguments are passed in the same registers whatever the
+// callee's prototype, and surplus arguments are ignored by the callee.
+typedef uint64_t (*ForeignFunction)(uint64_t, uint64_t, uint64_t, uint64_t, uint64_t, uint64_t,
+                                    uint64_t, uint64_t);
+
+static bool parse_signature(const char *signature, FfiFunction *function);
+static bool translate(const Interpreter *intr, const FfiFunction *function, int index,
+                      uint64_t *arg);
+
+void ffi_init(FfiTable *ffi) {
+    ffi->functions     = NULL;
+    ffi->count         = 0;
+    ffi->libraries     = NULL;
+    ffi->library_count = 0;
+}
+
+/**
+ * @brief Fills in the argument kinds of a function from its signature.
+ *
+ * @param signature The signature; see `FfiFunction`.
+ * @param function The function to fill in.
+ * @return True on success, false if the signature is malformed.
+ */
+static bool parse_signature(const char *signature, FfiFunction *function) {
+    for (int i = 0; i < FFI_MAX_ARGS; i++) {
+        function->kinds[i]   = 'i';
+        function->lengths[i] = i + 1;
+    }
+
+    int reg = 0;
+    for (const char *c = signature; *c; c++, reg++) {
+        if (reg >= FFI_MAX_ARGS || (*c != 'i' && *c != 'p' && *c != 's')) {
+            return false;
+        }
+        char kind            = *c;
+        function->kinds[reg] = kind;
+        if (kind == 'p' && c[1] >= '0' && c[1] <= '9') {
+            function->lengths[reg] = *++c - '0';
+        }
+        if (kind == 'p' && function->lengths[reg] >= FFI_MAX_ARGS) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ffi_import(FfiTable *ffi, const char *library, const char *symbol, const char *signature,
+                const char **error) {
+    FfiFunction function;
+    if (!parse_signature(signature, &function)) {
+        *error = "Malformed signature";
+        return false;
+    }
+
+    void **libraries = realloc(ffi->libraries, (size_t) (ffi->library_count + 1) * sizeof(void *));
+    FfiFunction *functions =
+        realloc(ffi->functions, (size_t) (ffi->count + 1) * sizeof(FfiFunction));
+    if (libraries) {
+        ffi->libraries = libraries;
+    }
+    if (functions) {
+        ffi->functions = functions;
+    }
+    function.symbol = malloc(strlen(symbol) + 1);
+    if (!libraries || !functions || !function.symbol) {
+        free(function.symbol);
+        *error = "Out of memory";
+        return false;
+    }
+    strcpy(function.symbol, symbol);
+
+    // dlopen counts references, so importing from a library twice is cheap
+    void *handle = dlopen(library, RTLD_NOW | RTLD_LOCAL);
+    if (!handle) {
+        free(function.symbol);
+        *error = dlerror();
+        return false;
+    }
+    ffi->libraries[ffi->library_count++] = handle;
+
+    dlerror();
+    void *address = dlsym(handle, symbol);
+    if (!address) {
+        free(function.symbol);
+        *error = "Function not found";
+        return false;
+    }
+    // ISO C has no conversion from object to function pointers; POSIX
+    // guarantees dlsym's result can be reinterpreted as one
+    memcpy(&function.function, &address, sizeof(function.function));
+    ffi->functions[ffi->count++] = function;
+    return true;
+}
+
+int ffi_lookup(const FfiTable *ffi, const char *symbol) {
+    for (int i = 0; i < ffi->count; i++) {
+        if (strcmp(ffi->functions[i].symbol, symbol) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Translates an argument register into the value passed to C.
+ *
+ * @param intr The interpreter making the call.
+ * @param function The function being called.
+ * @param index The argument register.
+ * @param arg Set to the value to pass.
+ * @return True on success, false if an address argument is out of bounds or,
+ * when debugging the heap, touches a freed block (an error message has been
+ * printed).
+ */
+static bool translate(const Interpreter *intr, const FfiFunction *function, int index,
+                      uint64_t *arg) {
+    uint64_t address = (uint64_t) intr->variables[index];
+    uint64_t length  = 0;
+    bool     valid   = false;
+    *arg             = address;
+
+    if (function->kinds[index] == 'p') {
+        length = (uint64_t) intr->variables[function->lengths[index]];
+        valid  = address <= MEM_CAPACITY && length <= MEM_CAPACITY - address;
+    } else if (function->kinds[index] == 's') {
+        const uint8_t *end = NULL;
+        if (address < MEM_CAPACITY) {
+            end = memchr(mem_base() + address, '\0', MEM_CAPACITY - address);
+        }
+        // The terminator is read as well
+        valid  = end != NULL;
+        length = valid ? (uint64_t) (end - (mem_base() + address)) + 1 : 0;
+    } else {
+        return true;
+    }
+
+    if (!valid) {
+        printf("Argument x%d of %s is out of bounds\n", index, function->symbol);
+        return false;
+    }
+    if (intr->heap_debug && !heap_check(address, length)) {
+        return false;
+    }
+    *arg = (uint64_t) (uintptr_t) (mem_base() + address);
+    return true;
+}
+
+bool ffi_call(Interpreter *intr, const FfiTable *ffi, int index) {
+    const FfiFunction *function = &ffi->functions[index];
+
+    uint64_t args[FFI_MAX_ARGS];
+    for (int i = 0; i < FFI_MAX_ARGS; i++) {
+        if (!translate(intr, function, i, &args[i])) {
+            return false;
+        }
+    }
+
+    ForeignFunction call = (ForeignFunction) function->function;
+    intr->variables[0] =
+        (int64_t) call(args[0], args[1], args[2], args[3], args[4], args[5], args[6], args[7]);
+    return true;
+}
+
+void ffi_free(FfiTable *ffi) {
+    for (int i = 0; i < ffi->count; i++) {
+        free(ffi->functions[i].symbol);
+    }
+    for (int i = 0; i < ffi->library_count; i++) {
+        dlclose(ffi->libraries[i]);
+    }
+    free(ffi->functions);
+    free(ffi->libraries);
+    ffi_init(ffi);
+}
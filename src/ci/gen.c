@@ -0,0 +1,592 @@
+#include "gen.h"
+#include <stdlib.h>
+#include <string.h>
+#include "mem.h"
+
+#define GEN_DATA_REGS 27    // x0..x26 may be written by generated instructions
+#define GEN_ADDR_REG 27     // Holds addresses for register-addressed loads and stores
+#define GEN_COUNTER_REG 28  // Loop counters occupy x28..x31, one per nesting level
+#define GEN_MAX_SKIP 3      // Maximum instructions jumped over by a forward branch
+
+/**
+ * @brief State of one program generation.
+ */
+typedef struct {
+    const GenConfig *cfg;         // Knobs being generated with
+    FILE            *out;         // Where the program is written
+    uint64_t         state;       // Pseudo-random generator state
+    int              mix_total;   // Sum of the usable class weights
+    int              next_label;  // Suffix of the next label
+    uint64_t         fn_cost;     // Estimated commands of one run of a function, once
+                                  // through each of its loops and without its call
+    uint64_t         spare;       // Estimated commands that extra loop trips may add
+    uint64_t         weight;      // Estimated runs of the code being emitted
+    uint64_t         call_runs;   // Estimated runs of the last call emitted
+} Generator;
+
+static const char *const class_names[GEN_CLASS_COUNT] = {"alu", "shift", "cmp", "mem", "print"};
+static const char *const conditions[]                 = {"b.eq", "b.ne", "b.gt",
+                                                          "b.lt", "b.ge", "b.le"};
+static const char        bases[]                      = {'d', 'x', 'b'};
+
+/**
+ * @brief A command form timed by a microbenchmark, with what it needs to run.
+ */
+typedef struct {
+    const char *name;      // Name given to `--gen-op`.
+    const char *setup;     // Commands run once before the loop.
+    const char *body;      // Commands repeated in the loop; `@` stands for the copy's index.
+    const char *function;  // Commands placed after the program, for calls.
+} GenOp;
+
+// Every form also starts with x1 = 12345 and x2 = 64, an address; `ccall`
+// needs a library to import and is left out
+static const GenOp op_forms[] = {
+    {"loop", "", "", ""},
+    {"mov", "", "    mov x1, 12345\n", ""},
+    {"add.reg", "", "    add x1, x1, x2\n", ""},
+    {"add.imm", "", "    add x1, x1, 3\n", ""},
+    {"sub.reg", "", "    sub x1, x1, x2\n", ""},
+    {"sub.imm", "", "    sub x1, x1, 3\n", ""},
+    {"and", "", "    and x1, x1, x2\n", ""},
+    {"eor", "", "    eor x1, x1, x2\n", ""},
+    {"orr", "", "    orr x1, x1, x2\n", ""},
+    {"asr", "", "    asr x1, x1, 1\n", ""},
+    {"lsl", "", "    lsl x1, x1, 1\n", ""},
+    {"lsr", "", "    lsr x1, x1, 1\n", ""},
+    {"cmp.reg", "", "    cmp x1, x2\n", ""},
+    {"cmp.imm", "", "    cmp x1, 7\n", ""},
+    {"cmp_u.reg", "", "    cmp_u x1, x2\n", ""},
+    {"cmp_u.imm", "", "    cmp_u x1, 7\n", ""},
+    {"branch.untaken", "", "    b.gt end\n", ""},
+    {"branch.taken", "", "    b op_@\nop_@:\n", ""},
+    {"call.ret", "", "    call noop\n", "noop:\n    ret\n"},
+    {"builtin", "    mov x0, 0\n", "    call __builtin_strlen\n", ""},
+    {"load.imm", "", "    load x3, 8, 64\n", ""},
+    {"load.reg", "", "    load x3, 8, x2\n", ""},
+    {"store.imm", "", "    store x1, 64, 8\n", ""},
+    {"store.reg", "", "    store x1, x2, 8\n", ""},
+    {"put.imm", "", "    put \"benchmark\" 64\n", ""},
+    {"put.reg", "", "    put \"benchmark\" x2\n", ""},
+    {"print", "", "    print x1, d\n", ""},
+    {"alloc.free", "", "    alloc x3, 16\n    free x3\n", ""},
+    {"realloc", "    alloc x3, 16\n", "    realloc x3, x3, 16\n", ""},
+    {"push.pop", "", "    push x1\n    pop x1\n", ""},
+    {"push.pop.range", "", "    push {x1-x8}\n    pop {x1-x8}\n", ""},
+    {"write", "", "    write 1 x2 8\n", ""},
+    {"read", "", "    read 0 x2 8\n", ""},
+};
+
+static uint64_t next_random(Generator *g);
+static int      pick(Generator *g, int bound);
+static int      class_weight(const GenConfig *cfg, int cls);
+static bool     parse_option_int(const char *value, int min, int max, int *result);
+static bool     parse_mix(GenConfig *cfg, const char *spec);
+static bool     parse_op(GenConfig *cfg, const char *name);
+static bool     emit_op(const GenConfig *cfg, FILE *out);
+static void     emit_body(Generator *g, int budget, int labels, int depth, int level, bool call);
+static void     emit_loop(Generator *g, int budget, int labels, int depth, int level, bool call);
+static void     emit_skip(Generator *g, int *budget);
+static void     emit_simple(Generator *g);
+static uint64_t body_cost(const Generator *g, int budget, int labels, int depth);
+static void     emit_number(Generator *g, uint64_t value);
+static int      random_reg(Generator *g);
+
+void gen_config_init(GenConfig *cfg) {
+    if (!cfg) {
+        return;
+    }
+
+    cfg->seed           = 1;
+    cfg->length         = 100;
+    cfg->labels         = 4;
+    cfg->loop_depth     = 2;
+    cfg->max_trips      = 8;
+    cfg->call_depth     = 1;
+    cfg->exec_budget    = 10000000;
+    cfg->mem_footprint  = 256;
+    cfg->mix[GEN_ALU]   = 6;
+    cfg->mix[GEN_SHIFT] = 2;
+    cfg->mix[GEN_CMP]   = 1;
+    cfg->mix[GEN_MEM]   = 2;
+    cfg->mix[GEN_PRINT] = 1;
+    cfg->op             = GEN_OP_NONE;
+}
+
+bool gen_set_option(GenConfig *cfg, const char *option, const char *value) {
+    if (strcmp(option, "--seed") == 0) {
+        char *endptr;
+        cfg->seed           = strtoull(value, &endptr, 0);
+        return *value != '\0' && *endptr == '\0';
+    } else if (strcmp(option, "--gen-length") == 0) {
+        return parse_option_int(value, 0, 1000000, &cfg->length);
+    } else if (strcmp(option, "--gen-labels") == 0) {
+        return parse_option_int(value, 0, 1000000, &cfg->labels);
+    } else if (strcmp(option, "--gen-loops") == 0) {
+        return parse_option_int(value, 0, GEN_MAX_LOOP_DEPTH, &cfg->loop_depth);
+    } else if (strcmp(option, "--gen-trips") == 0) {
+        return parse_option_int(value, 1, 1000000, &cfg->max_trips);
+    } else if (strcmp(option, "--gen-calls") == 0) {
+        return parse_option_int(value, 0, 1000, &cfg->call_depth);
+    } else if (strcmp(option, "--gen-budget") == 0) {
+        return parse_option_int(value, 1, 2000000000, &cfg->exec_budget);
+    } else if (strcmp(option, "--gen-mem") == 0) {
+        return parse_option_int(value, 0, MEM_CAPACITY, &cfg->mem_footprint);
+    } else if (strcmp(option, "--gen-mix") == 0) {
+        return parse_mix(cfg, value);
+    } else if (strcmp(option, "--gen-op") == 0) {
+        return parse_op(cfg, value);
+    }
+    return false;
+}
+
+bool gen_program(const GenConfig *cfg, FILE *out) {
+    if (!cfg || !out || cfg->loop_depth > GEN_MAX_LOOP_DEPTH || cfg->max_trips < 1 ||
+        cfg->mem_footprint > MEM_CAPACITY) {
+        return false;
+    }
+    if (cfg->op != GEN_OP_NONE) {
+        return emit_op(cfg, out);
+    }
+
+    Generator g;
+    g.cfg        = cfg;
+    g.out        = out;
+    g.state      = cfg->seed;
+    g.mix_total  = 0;
+    g.next_label = 0;
+    for (int cls = 0; cls < GEN_CLASS_COUNT; cls++) {
+        g.mix_total += class_weight(cfg, cls);
+    }
+
+    // Split the instruction and label budgets evenly between main and each function
+    int parts       = cfg->call_depth + 1;
+    int fn_length   = cfg->length / parts;
+    int fn_labels   = cfg->labels / parts;
+    int main_length = cfg->length - fn_length * cfg->call_depth;
+    int main_labels = cfg->labels - fn_labels * cfg->call_depth;
+
+    // Running every command once is the least a run can cost; only extra loop
+    // trips spend what the budget has beyond that
+    g.fn_cost      = body_cost(&g, fn_length, fn_labels, 0) + 2;
+    uint64_t least = body_cost(&g, main_length, main_labels, 0) + 1 + g.fn_cost * (uint64_t) cfg->call_depth;
+    g.spare        = (uint64_t) cfg->exec_budget > least ? (uint64_t) cfg->exec_budget - least : 0;
+    g.weight       = 1;
+    g.call_runs    = 1;
+
+    fprintf(out, "// Generated by ci --gen --seed %llu\n", (unsigned long long) cfg->seed);
+    fprintf(out, "main:\n");
+    emit_body(&g, main_length, main_labels, 0, 0, cfg->call_depth > 0);
+    fprintf(out, "    b end\n");
+
+    for (int level = 1; level <= cfg->call_depth; level++) {
+        fprintf(out, "func_%d:\n", level - 1);
+        g.weight = g.call_runs;
+        emit_body(&g, fn_length, fn_labels, 0, level, level < cfg->call_depth);
+        fprintf(out, "    ret\n");
+    }
+    fprintf(out, "end:\n");
+    return !ferror(out);
+}
+
+/**
+ * @brief Advances the pseudo-random generator (splitmix64).
+ *
+ * @param g The generator.
+ * @return The next pseudo-random value.
+ */
+static uint64_t next_random(Generator *g) {
+    uint64_t z = (g->state += 0x9e3779b97f4a7c15u);
+    z          = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9u;
+    z          = (z ^ (z >> 27)) * 0x94d049bb133111ebu;
+    return z ^ (z >> 31);
+}
+
+/**
+ * @brief Picks a pseudo-random value in [0, bound).
+ *
+ * @param g The generator.
+ * @param bound The exclusive upper bound; values below 1 are treated as 1.
+ * @return The picked value.
+ */
+static int pick(Generator *g, int bound) {
+    return bound <= 1 ? 0 : (int) (next_random(g) % (uint64_t) bound);
+}
+
+/**
+ * @brief Returns the weight of an instruction class, taking into account
+ * classes that cannot be generated under the configuration.
+ *
+ * @param cfg The configuration.
+ * @param cls The instruction class.
+ * @return The class's weight.
+ */
+static int class_weight(const GenConfig *cfg, int cls) {
+    if (cls == GEN_MEM && cfg->mem_footprint == 0) {
+        return 0;
+    }
+    return cfg->mix[cls];
+}
+
+/**
+ * @brief Parses a bounded decimal option value.
+ *
+ * @param value The value to parse.
+ * @param min The smallest accepted value.
+ * @param max The largest accepted value.
+ * @param result A pointer to the value to modify on success.
+ * @return True if `value` was a valid number within bounds.
+ */
+static bool parse_option_int(const char *value, int min, int max, int *result) {
+    char *endptr;
+    long  parsed = strtol(value, &endptr, 10);
+    if (*value == '\0' || *endptr != '\0' || parsed < min || parsed > max) {
+        return false;
+    }
+
+    *result = (int) parsed;
+    return true;
+}
+
+/**
+ * @brief Parses an instruction mix such as `alu=4,mem=2`.
+ *
+ * Classes that are not mentioned keep their current weight.
+ *
+ * @param cfg The configuration to modify.
+ * @param spec The mix specification.
+ * @return True if every entry named a known class and a valid weight.
+ */
+static bool parse_mix(GenConfig *cfg, const char *spec) {
+    while (*spec != '\0') {
+        const char *eq = strchr(spec, '=');
+        if (!eq) {
+            return false;
+        }
+
+        int cls = 0;
+        while (cls < GEN_CLASS_COUNT && (strlen(class_names[cls]) != (size_t) (eq - spec) ||
+                                         strncmp(spec, class_names[cls], eq - spec) != 0)) {
+            cls++;
+        }
+
+        char *endptr;
+        long  weight = strtol(eq + 1, &endptr, 10);
+        if (cls == GEN_CLASS_COUNT || endptr == eq + 1 || weight < 0 || weight > 1000 ||
+            (*endptr != ',' && *endptr != '\0')) {
+            return false;
+        }
+
+        cfg->mix[cls]       = (int) weight;
+        spec          = *endptr == ',' ? endptr + 1 : endptr;
+    }
+    return true;
+}
+
+/**
+ * @brief Parses the name of a command form to microbenchmark.
+ *
+ * @param cfg The configuration to modify.
+ * @param name The name of the form, or `list`.
+ * @return True if the name was `list` or the name of a form.
+ */
+static bool parse_op(GenConfig *cfg, const char *name) {
+    if (strcmp(name, "list") == 0) {
+        cfg->op = GEN_OP_LIST;
+        return true;
+    }
+    for (size_t i = 0; i < sizeof(op_forms) / sizeof(op_forms[0]); i++) {
+        if (strcmp(op_forms[i].name, name) == 0) {
+            cfg->op = (int) i;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Writes the microbenchmark of the configured command form, or the
+ * names of all forms.
+ *
+ * The loop counts x28 up to `max_trips`, and its body repeats the form
+ * `length` times.
+ *
+ * @param cfg The configuration.
+ * @param out The stream to write the program to.
+ * @return True on success, false if writing failed.
+ */
+static bool emit_op(const GenConfig *cfg, FILE *out) {
+    if (cfg->op == GEN_OP_LIST) {
+        for (size_t i = 0; i < sizeof(op_forms) / sizeof(op_forms[0]); i++) {
+            fprintf(out, "%s\n", op_forms[i].name);
+        }
+        return !ferror(out);
+    }
+
+    const GenOp *op = &op_forms[cfg->op];
+    fprintf(out, "// Generated by ci --gen --gen-op %s --gen-length %d --gen-trips %d\n", op->name,
+            cfg->length, cfg->max_trips);
+    fprintf(out, "    mov x1, 12345\n    mov x2, 64\n%s", op->setup);
+    fprintf(out, "    mov x%d, 0\nloop:\n", GEN_COUNTER_REG);
+    for (int copy = 0; copy < cfg->length; copy++) {
+        for (const char *c = op->body; *c != '\0'; c++) {
+            if (*c == '@') {
+                fprintf(out, "%d", copy);
+            } else {
+                fputc(*c, out);
+            }
+        }
+    }
+    fprintf(out, "    add x%d, x%d, 1\n", GEN_COUNTER_REG, GEN_COUNTER_REG);
+    fprintf(out, "    cmp x%d, %d\n", GEN_COUNTER_REG, cfg->max_trips);
+    fprintf(out, "    b.lt loop\n    b end\n%send:\n", op->function);
+    return !ferror(out);
+}
+
+/**
+ * @brief Emits a sequence of instructions, loops and forward branches.
+ *
+ * @param g The generator.
+ * @param budget Instructions to emit, excluding loop and branch scaffolding.
+ * @param labels Forward branch targets to emit.
+ * @param depth Current loop nesting depth.
+ * @param level 0 for main, n for function n - 1.
+ * @param call Whether to call the function of the next level once.
+ */
+static void emit_body(Generator *g, int budget, int labels, int depth, int level, bool call) {
+    int call_at = pick(g, budget + 1);
+
+    while (budget > 0 || labels > 0 || call) {
+        if (call && budget <= call_at) {
+            fprintf(g->out, "    call func_%d\n", level);
+            g->call_runs = g->weight;
+            call         = false;
+        } else if (budget > 0 && depth < g->cfg->loop_depth && pick(g, 6) == 0) {
+            int  inner        = 1 + pick(g, budget / 2 + 1);
+            int  inner_labels = labels > 0 ? pick(g, labels + 1) : 0;
+            bool inner_call   = call && call_at > budget - inner;
+            emit_loop(g, inner, inner_labels, depth, level, inner_call);
+            budget -= inner;
+            labels -= inner_labels;
+            call    = call && !inner_call;
+        } else if (labels > 0 && (budget == 0 || pick(g, budget / labels + 1) == 0)) {
+            emit_skip(g, &budget);
+            labels--;
+        } else if (budget > 0) {
+            emit_simple(g);
+            budget--;
+        }
+    }
+}
+
+/**
+ * @brief Emits a counted loop.
+ *
+ * The loop counter lives in a register reserved for the nesting depth, which
+ * generated instructions never write, so the loop always terminates. Functions
+ * called from the loop body may reuse the register as `ret` restores it.
+ *
+ * Every trip after the first runs the body, and the chain of functions it
+ * calls, once more for each run of the enclosing code. The trips are cut down
+ * to what the generator's spare budget affords, down to a single trip.
+ *
+ * @param g The generator.
+ * @param budget Instructions to emit in the loop body.
+ * @param labels Forward branch targets to emit in the loop body.
+ * @param depth Nesting depth of the enclosing code.
+ * @param level Function level of the enclosing code.
+ * @param call Whether the loop body calls the function of the next level.
+ */
+static void emit_loop(Generator *g, int budget, int labels, int depth, int level, bool call) {
+    int counter = GEN_COUNTER_REG + depth;
+    int trips   = 1 + pick(g, g->cfg->max_trips);
+    int label   = g->next_label++;
+
+    uint64_t chain     = call ? g->fn_cost * (uint64_t) (g->cfg->call_depth - level) : 0;
+    uint64_t trip_cost = body_cost(g, budget, labels, depth + 1) + 3 + chain;
+    uint64_t extra     = g->spare / g->weight / trip_cost;
+    if ((uint64_t) trips - 1 > extra) {
+        trips = (int) extra + 1;
+    }
+    g->spare -= g->weight * (uint64_t) (trips - 1) * trip_cost;
+
+    uint64_t weight = g->weight;
+    g->weight *= (uint64_t) trips;
+    fprintf(g->out, "    mov x%d, 0\n", counter);
+    fprintf(g->out, "loop_%d:\n", label);
+    emit_body(g, budget, labels, depth + 1, level, call);
+    g->weight = weight;
+    fprintf(g->out, "    add x%d, x%d, 1\n", counter, counter);
+    fprintf(g->out, "    cmp x%d, %d\n", counter, trips);
+    fprintf(g->out, "    b.lt loop_%d\n", label);
+}
+
+/**
+ * @brief Emits a compare followed by a forward branch over a few instructions.
+ *
+ * @param g The generator.
+ * @param budget Remaining instruction budget; decreased by the instructions
+ * emitted between the branch and its target.
+ */
+static void emit_skip(Generator *g, int *budget) {
+    int label   = g->next_label++;
+    int skipped = *budget < GEN_MAX_SKIP ? *budget : 1 + pick(g, GEN_MAX_SKIP);
+
+    if (pick(g, 2) == 0) {
+        fprintf(g->out, "    cmp x%d, x%d\n", random_reg(g), random_reg(g));
+    } else {
+        fprintf(g->out, "    cmp x%d, %d\n", random_reg(g), pick(g, 256));
+    }
+    fprintf(g->out, "    %s skip_%d\n", conditions[pick(g, 6)], label);
+    for (int i = 0; i < skipped; i++) {
+        emit_simple(g);
+    }
+    fprintf(g->out, "skip_%d:\n", label);
+    *budget -= skipped;
+}
+
+/**
+ * @brief Emits one straight-line instruction drawn from the instruction mix.
+ *
+ * Register-addressed memory accesses emit an extra `mov` of the address.
+ *
+ * @param g The generator.
+ */
+static void emit_simple(Generator *g) {
+    int cls = GEN_ALU;
+    if (g->mix_total > 0) {
+        int roll = pick(g, g->mix_total);
+        for (cls = 0; cls < GEN_CLASS_COUNT - 1; cls++) {
+            roll -= class_weight(g->cfg, cls);
+            if (roll < 0) {
+                break;
+            }
+        }
+    }
+
+    int dst = pick(g, GEN_DATA_REGS);
+    switch (cls) {
+        case GEN_ALU: {
+            static const char *const ops[] = {"add", "sub", "and", "eor", "orr"};
+            int                      op    = pick(g, 6);
+            if (op == 5) {
+                fprintf(g->out, "    mov x%d, ", dst);
+                emit_number(g, next_random(g) >> (1 + pick(g, 63)));
+                fputc('\n', g->out);
+            } else if (op < 2 && pick(g, 2) == 0) {
+                fprintf(g->out, "    %s x%d, x%d, %d\n", ops[op], dst, random_reg(g),
+                        pick(g, 4096));
+            } else {
+                fprintf(g->out, "    %s x%d, x%d, x%d\n", ops[op], dst, random_reg(g),
+                        random_reg(g));
+            }
+            break;
+        }
+        case GEN_SHIFT: {
+            static const char *const ops[] = {"asr", "lsl", "lsr"};
+            fprintf(g->out, "    %s x%d, x%d, %d\n", ops[pick(g, 3)], dst, random_reg(g),
+                    pick(g, 64));
+            break;
+        }
+        case GEN_CMP:
+            fprintf(g->out, "    %s x%d, ", pick(g, 2) ? "cmp" : "cmp_u", random_reg(g));
+            if (pick(g, 2) == 0) {
+                fprintf(g->out, "x%d\n", random_reg(g));
+            } else {
+                emit_number(g, (uint64_t) pick(g, 4096));
+                fputc('\n', g->out);
+            }
+            break;
+        case GEN_MEM: {
+            int width = 8;
+            while (width > g->cfg->mem_footprint) {
+                width /= 2;
+            }
+            width >>= pick(g, 4);
+            width = width > 0 ? width : 1;
+
+            int  addr      = pick(g, g->cfg->mem_footprint - width + 1);
+            bool store     = pick(g, 2) == 0;
+            bool via_reg   = pick(g, 2) == 0;
+            char where[16];
+            if (via_reg) {
+                fprintf(g->out, "    mov x%d, %d\n", GEN_ADDR_REG, addr);
+                snprintf(where, sizeof(where), "x%d", GEN_ADDR_REG);
+            } else {
+                snprintf(where, sizeof(where), "%d", addr);
+            }
+
+            if (store) {
+                fprintf(g->out, "    store x%d, %s, %d\n", random_reg(g), where, width);
+            } else {
+                fprintf(g->out, "    load x%d, %d, %s\n", dst, width, where);
+            }
+            break;
+        }
+        default:
+            fprintf(g->out, "    print x%d, %c\n", random_reg(g), bases[pick(g, 3)]);
+            break;
+    }
+}
+
+/**
+ * @brief Estimates the commands one run of a body executes, once through each
+ * of its loops and without its call.
+ *
+ * @param g The generator.
+ * @param budget Instructions of the body, excluding scaffolding.
+ * @param labels Forward branches of the body, each adding a compare and a
+ * branch.
+ * @param depth Loop nesting depth of the body.
+ * @return The estimated number of commands.
+ */
+static uint64_t body_cost(const Generator *g, int budget, int labels, int depth) {
+    uint64_t cost = (uint64_t) budget + 2u * (uint64_t) labels;
+    if (depth < g->cfg->loop_depth) {
+        // emit_body starts a loop at about one in six instructions, and each
+        // loop adds four commands to set, count and test its counter; a short
+        // body is still likely to hold one loop
+        cost += 4u * (((uint64_t) budget + 5u) / 6u);
+    }
+    return cost;
+}
+
+/**
+ * @brief Writes a non-negative number in decimal, hexadecimal or binary.
+ *
+ * @param g The generator.
+ * @param value The number; must not exceed INT64_MAX.
+ */
+static void emit_number(Generator *g, uint64_t value) {
+    switch (pick(g, 3)) {
+        case 0:
+            fprintf(g->out, "%llu", (unsigned long long) value);
+            break;
+        case 1:
+            fprintf(g->out, "0x%llx", (unsigned long long) value);
+            break;
+        default: {
+            char digits[65];
+            int  n = 0;
+            do {
+                digits[n++] = (char) ('0' + (value & 1));
+                value >>= 1;
+            } while (value);
+            fprintf(g->out, "0b");
+            while (n > 0) {
+                fputc(digits[--n], g->out);
+            }
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Picks any register as a source operand.
+ *
+ * @param g The generator.
+ * @return The register number.
+ */
+static int random_reg(Generator *g) {
+    return pick(g, 32);
+}
@@ -0,0 +1,548 @@
+#include "gvn.h"
+#include <stdlib.h>
+#include <string.h>
+#include "cfg.h"
+#include "interpreter.h"
+#include "mem.h"
+
+/**
+ * @brief What is known about one value number.
+ */
+typedef struct {
+    bool    constant;  // Set if the value is known.
+    int64_t value;     // The value, if known.
+} ValueInfo;
+
+/**
+ * @brief A computation seen on the current path and the number of its result.
+ */
+typedef struct {
+    CommandType op;      // The operation.
+    int         a;       // Value number of the first operand.
+    int         b;       // Value number of the second operand or shift count.
+    int         result;  // Value number of the result.
+} Expression;
+
+/**
+ * @brief What value numbering knows at one point of the program.
+ */
+typedef struct {
+    int         regs[NUM_REGISTERS];           // Value number held by each register, and sp.
+    CommandType flags_op;                      // `cmp` or `cmp_u` that set the flags last.
+    int         flags_a;                       // Value number of the register it compared.
+    int         flags_b;                       // Value number it compared against.
+    bool        flags_known;                   // Whether the three fields above are valid.
+    int         count;                         // Number of remembered expressions.
+    Expression  expressions[GVN_EXPRESSIONS];  // Computations available here.
+} GvnState;
+
+/**
+ * @brief A block waiting to be numbered, with the state on entry to it.
+ */
+typedef struct {
+    BasicBlock *block;  // The block.
+    GvnState    state;  // What is known when it is entered.
+} GvnWork;
+
+/**
+ * @brief The value numbering of a whole program.
+ */
+typedef struct {
+    ValueInfo *values;    // What is known about each value number.
+    int        count;     // Value numbers handed out.
+    int        capacity;  // Value numbers `values` has room for.
+    bool       failed;    // Set once memory ran out.
+    GvnStats  *stats;     // What changed.
+} Gvn;
+
+static int     new_value(Gvn *gvn, bool constant, int64_t value);
+static bool    same(const Gvn *gvn, int a, int b);
+static bool    is_constant(const Gvn *gvn, int v, int64_t value);
+static bool    commutative(CommandType op);
+static int64_t fold(CommandType op, int64_t a, int64_t b);
+static int     simplify(Gvn *gvn, CommandType op, int a, int b);
+static int     evaluate(Gvn *gvn, GvnState *state, CommandType op, int a, int b);
+static int     holder(const Gvn *gvn, const GvnState *state, int v);
+static void    forget(Gvn *gvn, GvnState *state);
+static void    propagate(Gvn *gvn, const GvnState *state, Command *cmd);
+static bool    assign(Gvn *gvn, GvnState *state, Command *cmd, int result, bool deletable);
+static bool    visit(Gvn *gvn, GvnState *state, Command *cmd, bool deletable);
+static void    number_block(Gvn *gvn, BasicBlock *block, GvnState *state);
+static bool    push_work(GvnWork **stack, int *count, int *capacity, BasicBlock *block,
+                         const GvnState *state);
+
+bool gvn_optimize(Command *commands, LabelMap *map, GvnStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+
+    Cfg cfg;
+    if (!cfg_build(&cfg, commands, map)) {
+        return false;
+    }
+    if (cfg.count == 0) {
+        return true;
+    }
+
+    // Count the edges into every block; the entry block is also entered by
+    // the start of the program.
+    int *preds = (int *) calloc((size_t) cfg.count, sizeof(int));
+    if (!preds) {
+        cfg_free(&cfg);
+        return false;
+    }
+    preds[0] = 1;
+    for (int i = 0; i < cfg.count; i++) {
+        BasicBlock *block = &cfg.blocks[i];
+        if (block->taken) {
+            preds[block->taken->id]++;
+        }
+        if (block->fallthrough) {
+            preds[block->fallthrough->id]++;
+        }
+    }
+
+    Gvn      gvn      = {NULL, 0, 0, false, stats};
+    GvnWork *stack    = NULL;
+    int      count    = 0;
+    int      capacity = 0;
+
+    // Number 0 is never handed out again, so it can stand in for the numbers
+    // asked for once memory ran out.
+    new_value(&gvn, false, 0);
+
+    // Blocks entered from more than one place start from scratch, and each
+    // passes what it knows on to the successors only it enters. A block with
+    // one predecessor is numbered only through it.
+    for (int i = 0; i < cfg.count && !gvn.failed; i++) {
+        if (preds[i] == 1 && i != 0) {
+            continue;
+        }
+
+        GvnState entry;
+        entry.count       = 0;
+        entry.flags_known = false;
+        if (i == 0 && preds[0] == 1) {
+            for (int r = 0; r < NUM_REGISTERS; r++) {
+                entry.regs[r] = new_value(&gvn, true, r == REG_SP ? MEM_CAPACITY : 0);
+            }
+        } else {
+            forget(&gvn, &entry);
+        }
+        if (!push_work(&stack, &count, &capacity, &cfg.blocks[i], &entry)) {
+            gvn.failed = true;
+        }
+
+        while (count > 0 && !gvn.failed) {
+            GvnWork     work      = stack[--count];
+            BasicBlock *block     = work.block;
+            BasicBlock *taken     = block->taken;
+            BasicBlock *fall      = block->fallthrough;
+            bool        ends_call = block->last->type == CMD_CALL;
+
+            number_block(&gvn, block, &work.state);
+
+            if (taken && preds[taken->id] == 1 && !push_work(&stack, &count, &capacity, taken,
+                                                             &work.state)) {
+                gvn.failed = true;
+            }
+            if (fall && preds[fall->id] == 1) {
+                // The return restores x1..x31; x0 carries the result, and the
+                // callee may have moved sp and compared anything.
+                if (ends_call) {
+                    work.state.regs[0]      = new_value(&gvn, false, 0);
+                    work.state.regs[REG_SP] = new_value(&gvn, false, 0);
+                    work.state.flags_known  = false;
+                }
+                if (!push_work(&stack, &count, &capacity, fall, &work.state)) {
+                    gvn.failed = true;
+                }
+            }
+        }
+    }
+
+    free(stack);
+    free(gvn.values);
+    free(preds);
+    cfg_free(&cfg);
+    return !gvn.failed;
+}
+
+/**
+ * @brief Hands out a new value number.
+ *
+ * @return The number; 0 once memory ran out, which also stops all rewriting.
+ */
+static int new_value(Gvn *gvn, bool constant, int64_t value) {
+    if (gvn->count == gvn->capacity) {
+        int        capacity = gvn->capacity ? gvn->capacity * 2 : 256;
+        ValueInfo *values   = (ValueInfo *) realloc(gvn->values,
+                                                   (size_t) capacity * sizeof(ValueInfo));
+        if (!values) {
+            gvn->failed = true;
+            return 0;
+        }
+        gvn->values   = values;
+        gvn->capacity = capacity;
+    }
+    gvn->values[gvn->count] = (ValueInfo) {constant, value};
+    return gvn->count++;
+}
+
+/**
+ * @brief Determines whether two value numbers stand for the same value.
+ */
+static bool same(const Gvn *gvn, int a, int b) {
+    if (a == b) {
+        return true;
+    }
+    const ValueInfo *x = &gvn->values[a];
+    const ValueInfo *y = &gvn->values[b];
+    return x->constant && y->constant && x->value == y->value;
+}
+
+/**
+ * @brief Determines whether a value number stands for the given constant.
+ */
+static bool is_constant(const Gvn *gvn, int v, int64_t value) {
+    return gvn->values[v].constant && gvn->values[v].value == value;
+}
+
+/**
+ * @brief Determines whether an operation gives the same result with its
+ * operands swapped.
+ */
+static bool commutative(CommandType op) {
+    return op == CMD_ADD || op == CMD_AND || op == CMD_ORR || op == CMD_EOR;
+}
+
+/**
+ * @brief Computes an operation on constants exactly as the interpreter does.
+ */
+static int64_t fold(CommandType op, int64_t a, int64_t b) {
+    switch (op) {
+        case CMD_ADD:
+            return (int64_t) ((uint64_t) a + (uint64_t) b);
+        case CMD_SUB:
+            return (int64_t) ((uint64_t) a - (uint64_t) b);
+        case CMD_AND:
+            return a & b;
+        case CMD_ORR:
+            return a | b;
+        case CMD_EOR:
+            return a ^ b;
+        case CMD_ASR:
+            return a >> (b & 63);
+        case CMD_LSL:
+            return (int64_t) ((uint64_t) a << (b & 63));
+        default:
+            return (int64_t) ((uint64_t) a >> (b & 63));
+    }
+}
+
+/**
+ * @brief Applies the algebraic identities of an operation.
+ *
+ * @return The value number of the result if an identity gives it, or -1.
+ */
+static int simplify(Gvn *gvn, CommandType op, int a, int b) {
+    switch (op) {
+        case CMD_ADD:
+        case CMD_ORR:
+        case CMD_EOR:
+            if (is_constant(gvn, b, 0)) {
+                return a;
+            }
+            if (is_constant(gvn, a, 0)) {
+                return b;
+            }
+            if (op == CMD_ORR && same(gvn, a, b)) {
+                return a;
+            }
+            if (op == CMD_EOR && same(gvn, a, b)) {
+                return new_value(gvn, true, 0);
+            }
+            return -1;
+        case CMD_SUB:
+            if (is_constant(gvn, b, 0)) {
+                return a;
+            }
+            if (same(gvn, a, b)) {
+                return new_value(gvn, true, 0);
+            }
+            return -1;
+        case CMD_AND:
+            if (same(gvn, a, b) || is_constant(gvn, b, -1)) {
+                return a;
+            }
+            if (is_constant(gvn, a, -1)) {
+                return b;
+            }
+            if (is_constant(gvn, a, 0) || is_constant(gvn, b, 0)) {
+                return new_value(gvn, true, 0);
+            }
+            return -1;
+        default:
+            // Shifts by zero keep the value; shifting zero gives zero.
+            if (is_constant(gvn, b, 0)) {
+                return a;
+            }
+            if (is_constant(gvn, a, 0)) {
+                return new_value(gvn, true, 0);
+            }
+            return -1;
+    }
+}
+
+/**
+ * @brief Numbers the result of an operation, reusing the number of an equal
+ * computation already on this path.
+ */
+static int evaluate(Gvn *gvn, GvnState *state, CommandType op, int a, int b) {
+    if (gvn->values[a].constant && gvn->values[b].constant) {
+        return new_value(gvn, true, fold(op, gvn->values[a].value, gvn->values[b].value));
+    }
+
+    int simple = simplify(gvn, op, a, b);
+    if (simple >= 0) {
+        return simple;
+    }
+
+    for (int i = 0; i < state->count; i++) {
+        const Expression *e = &state->expressions[i];
+        if (e->op == op && ((same(gvn, e->a, a) && same(gvn, e->b, b))
+                            || (commutative(op) && same(gvn, e->a, b) && same(gvn, e->b, a)))) {
+            return e->result;
+        }
+    }
+
+    int result = new_value(gvn, false, 0);
+    if (state->count < GVN_EXPRESSIONS) {
+        state->expressions[state->count++] = (Expression) {op, a, b, result};
+    }
+    return result;
+}
+
+/**
+ * @brief Finds the first register holding a value.
+ *
+ * @return The register, or -1 if none holds it.
+ */
+static int holder(const Gvn *gvn, const GvnState *state, int v) {
+    for (int r = 0; r < NUM_REGISTERS; r++) {
+        if (same(gvn, state->regs[r], v)) {
+            return r;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Forgets what every register and the flags hold.
+ */
+static void forget(Gvn *gvn, GvnState *state) {
+    for (int r = 0; r < NUM_REGISTERS; r++) {
+        state->regs[r] = new_value(gvn, false, 0);
+    }
+    state->flags_known = false;
+}
+
+/**
+ * @brief Replaces the register operands of a computation or comparison by
+ * the first register holding the same value, or by an immediate where the
+ * command takes one.
+ */
+static void propagate(Gvn *gvn, const GvnState *state, Command *cmd) {
+    bool     compare = cmd->type == CMD_CMP || cmd->type == CMD_CMP_U;
+    Operand *first   = compare ? &cmd->destination : &cmd->val_a;
+    Operand *second  = compare ? &cmd->val_a : &cmd->val_b;
+    bool    *imm     = compare ? &cmd->is_a_immediate : &cmd->is_b_immediate;
+    bool     shift   = cmd->type == CMD_ASR || cmd->type == CMD_LSL || cmd->type == CMD_LSR;
+
+    int r = holder(gvn, state, state->regs[first->num_val]);
+    if (r != first->num_val) {
+        first->num_val = r;
+        gvn->stats->propagated++;
+    }
+    if (shift || *imm) {
+        return;
+    }
+
+    int v = state->regs[second->num_val];
+    if (gvn->values[v].constant && (compare || cmd->type == CMD_ADD || cmd->type == CMD_SUB)) {
+        second->num_val = gvn->values[v].value;
+        *imm            = true;
+        gvn->stats->propagated++;
+        return;
+    }
+    r = holder(gvn, state, v);
+    if (r != second->num_val) {
+        second->num_val = r;
+        gvn->stats->propagated++;
+    }
+}
+
+/**
+ * @brief Records a computation of `result` into the destination of `cmd`,
+ * rewriting the command into the cheapest form that gives it.
+ *
+ * @return False if the destination already holds the result and the command
+ * can be deleted.
+ */
+static bool assign(Gvn *gvn, GvnState *state, Command *cmd, int result, bool deletable) {
+    int dst = (int) cmd->destination.num_val;
+    if (gvn->failed) {
+        return true;
+    }
+    if (same(gvn, state->regs[dst], result) && deletable) {
+        gvn->stats->removed++;
+        return false;
+    }
+
+    const ValueInfo *info = &gvn->values[result];
+    int              from = holder(gvn, state, result);
+    if (cmd->type == CMD_MOV) {
+        // Already the cheapest form.
+    } else if (info->constant) {
+        cmd->type           = CMD_MOV;
+        cmd->val_a.num_val  = info->value;
+        cmd->is_a_immediate = true;
+        cmd->val_b.num_val  = 0;
+        cmd->is_b_immediate = false;
+        gvn->stats->folded++;
+    } else if (from >= 0 && from != dst) {
+        bool copy = cmd->type == CMD_ADD && cmd->is_b_immediate && cmd->val_b.num_val == 0
+                    && cmd->val_a.num_val == from;
+        if (!copy) {
+            cmd->type           = CMD_ADD;
+            cmd->val_a.num_val  = from;
+            cmd->is_a_immediate = false;
+            cmd->val_b.num_val  = 0;
+            cmd->is_b_immediate = true;
+            gvn->stats->reused++;
+        }
+    } else {
+        propagate(gvn, state, cmd);
+    }
+
+    state->regs[dst] = result;
+    return true;
+}
+
+/**
+ * @brief Numbers one command and simplifies it.
+ *
+ * @param deletable Whether the command may be deleted; leaders may not.
+ * @return False if the command is redundant and should be deleted.
+ */
+static bool visit(Gvn *gvn, GvnState *state, Command *cmd, bool deletable) {
+    switch (cmd->type) {
+        case CMD_MOV:
+            return assign(gvn, state, cmd, new_value(gvn, true, cmd->val_a.num_val), deletable);
+        case CMD_ADD:
+        case CMD_SUB:
+        case CMD_AND:
+        case CMD_ORR:
+        case CMD_EOR: {
+            int a = state->regs[cmd->val_a.num_val];
+            int b = cmd->is_b_immediate ? new_value(gvn, true, cmd->val_b.num_val)
+                                        : state->regs[cmd->val_b.num_val];
+            return assign(gvn, state, cmd, evaluate(gvn, state, cmd->type, a, b), deletable);
+        }
+        case CMD_ASR:
+        case CMD_LSL:
+        case CMD_LSR: {
+            int a = state->regs[cmd->val_a.num_val];
+            int b = new_value(gvn, true, cmd->val_b.num_val & 63);
+            return assign(gvn, state, cmd, evaluate(gvn, state, cmd->type, a, b), deletable);
+        }
+        case CMD_CMP:
+        case CMD_CMP_U: {
+            int a = state->regs[cmd->destination.num_val];
+            int b = cmd->is_a_immediate ? new_value(gvn, true, cmd->val_a.num_val)
+                                        : state->regs[cmd->val_a.num_val];
+            // The same comparison of the same values sets the same flags.
+            if (gvn->failed) {
+                return true;
+            }
+            if (deletable && state->flags_known && state->flags_op == cmd->type
+                && same(gvn, state->flags_a, a) && same(gvn, state->flags_b, b)) {
+                gvn->stats->cmps++;
+                return false;
+            }
+            propagate(gvn, state, cmd);
+            state->flags_op    = cmd->type;
+            state->flags_a     = a;
+            state->flags_b     = b;
+            state->flags_known = true;
+            return true;
+        }
+        case CMD_LOAD:
+        case CMD_ALLOC:
+        case CMD_REALLOC:
+            state->regs[cmd->destination.num_val] = new_value(gvn, false, 0);
+            return true;
+        case CMD_PUSH:
+            state->regs[REG_SP] = new_value(gvn, false, 0);
+            return true;
+        case CMD_POP:
+            for (int64_t r = cmd->val_a.num_val; r <= cmd->val_b.num_val; r++) {
+                state->regs[r] = new_value(gvn, false, 0);
+            }
+            state->regs[REG_SP] = new_value(gvn, false, 0);
+            return true;
+        case CMD_PRINT:
+        case CMD_STORE:
+        case CMD_PUT:
+        case CMD_FREE:
+        case CMD_BRANCH:
+        case CMD_CALL:
+        case CMD_RET:
+            return true;
+        default:
+            // Builtins, foreign calls and I/O may change any register.
+            forget(gvn, state);
+            return true;
+    }
+}
+
+/**
+ * @brief Numbers the commands of a block, deleting the redundant ones.
+ *
+ * @param state What is known on entry; updated to what is known on exit.
+ */
+static void number_block(Gvn *gvn, BasicBlock *block, GvnState *state) {
+    Command *prev = NULL;
+    Command *cmd  = block->first;
+    for (int i = 0; i < block->length && !gvn->failed; i++) {
+        Command *next = cmd->next;
+        if (visit(gvn, state, cmd, cmd != block->first)) {
+            prev = cmd;
+        } else {
+            prev->next = next;
+            cmd->next  = NULL;
+            free_command(cmd);
+        }
+        cmd = next;
+    }
+}
+
+/**
+ * @brief Adds a block to the blocks waiting to be numbered.
+ *
+ * @return False if memory ran out.
+ */
+static bool push_work(GvnWork **stack, int *count, int *capacity, BasicBlock *block,
+                      const GvnState *state) {
+    if (*count == *capacity) {
+        int      grown = *capacity ? *capacity * 2 : 16;
+        GvnWork *items = (GvnWork *) realloc(*stack, (size_t) grown * sizeof(GvnWork));
+        if (!items) {
+            return false;
+        }
+        *stack    = items;
+        *capacity = grown;
+    }
+    (*stack)[*count].block = block;
+    (*stack)[*count].state = *state;
+    (*count)++;
+    return true;
+}
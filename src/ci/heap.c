@@ -0,0 +1,284 @@
+#include "heap.h"
+#include <inttypes.h>
+#include <string.h>
+
+/**
+ * @brief The state of the block starting at a granule.
+ */
+typedef enum {
+    BLOCK_NONE,         // No block starts here
+    BLOCK_USED,         // Allocated
+    BLOCK_FREE,         // On its class's free list
+    BLOCK_QUARANTINED,  // Freed while debugging, not yet reusable
+} BlockState;
+
+static Heap shared;  // Heap of threads that bound none
+
+// Each thread allocates from the heap it bound, like it accesses its own memory
+static _Thread_local Heap *heap = &shared;
+
+static int  size_class(int64_t size);
+static void push_free(int granule, int class);
+static int  pop_free(int class);
+static int  take_block(int class);
+static void release(int granule);
+static void evict_quarantine(void);
+static bool allocated_block(uint64_t address, const char *operation, int *granule);
+
+void heap_bind(Heap *bound) {
+    heap = bound ? bound : &shared;
+}
+
+void heap_reset(bool debug_mode) {
+    memset(heap->states, 0, sizeof(heap->states));
+    memset(heap->free_lists, 0, sizeof(heap->free_lists));
+    memset(heap->poisoned, 0, sizeof(heap->poisoned));
+    memset(&heap->stats, 0, sizeof(heap->stats));
+    heap->quarantine_first = 0;
+    heap->quarantine_count = 0;
+    heap->top              = 0;
+    heap->debug            = debug_mode;
+}
+
+/**
+ * @brief Finds the smallest size class that holds a request.
+ *
+ * @param size The number of bytes requested; must be positive.
+ * @return The class, or -1 if the request is larger than the largest class.
+ */
+static int size_class(int64_t size) {
+    for (int class = 0; class < HEAP_CLASSES; class++) {
+        if (size <= (int64_t) HEAP_GRANULE << class) {
+            return class;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Puts a block on its class's free list.
+ *
+ * @param granule The first granule of the block.
+ * @param class The block's size class.
+ */
+static void push_free(int granule, int class) {
+    heap->states[granule]    = BLOCK_FREE;
+    heap->classes[granule]   = (uint8_t) class;
+    heap->next_free[granule] = heap->free_lists[class];
+    heap->free_lists[class]  = (uint16_t) (granule + 1);
+}
+
+/**
+ * @brief Takes the first block off a free list.
+ *
+ * @param class The size class; its free list must not be empty.
+ * @return The first granule of the block.
+ */
+static int pop_free(int class) {
+    int granule             = heap->free_lists[class] - 1;
+    heap->free_lists[class] = heap->next_free[granule];
+    return granule;
+}
+
+/**
+ * @brief Finds an unused block of a size class.
+ *
+ * @param class The size class.
+ * @return The first granule of the block, or -1 if the heap is exhausted.
+ */
+static int take_block(int class) {
+    if (heap->free_lists[class]) {
+        heap->stats.reused++;
+        return pop_free(class);
+    }
+
+    int granules = 1 << class;
+    if (heap->top + granules <= (int) HEAP_GRANULES) {
+        int granule = heap->top;
+        heap->top += granules;
+        return granule;
+    }
+
+    // Split the smallest larger free block, keeping the upper halves free
+    for (int larger = class + 1; larger < HEAP_CLASSES; larger++) {
+        if (heap->free_lists[larger]) {
+            int granule = pop_free(larger);
+            while (larger > class) {
+                larger--;
+                push_free(granule + (1 << larger), larger);
+            }
+            heap->stats.splits++;
+            return granule;
+        }
+    }
+    return -1;
+}
+
+uint64_t heap_alloc(int64_t size) {
+    if (size <= 0) {
+        return 0;
+    }
+
+    int class   = size_class(size);
+    int granule = class < 0 ? -1 : take_block(class);
+    while (granule < 0 && class >= 0 && heap->quarantine_count > 0) {
+        evict_quarantine();
+        granule = take_block(class);
+    }
+    if (granule < 0) {
+        heap->stats.failures++;
+        return 0;
+    }
+
+    heap->states[granule]  = BLOCK_USED;
+    heap->classes[granule] = (uint8_t) class;
+    heap->sizes[granule]   = (uint16_t) size;
+    memset(&heap->poisoned[granule], 0, (size_t) 1 << class);
+
+    heap->stats.allocs++;
+    heap->stats.in_use += (uint64_t) size;
+    if (heap->stats.in_use > heap->stats.peak_in_use) {
+        heap->stats.peak_in_use = heap->stats.in_use;
+    }
+    return HEAP_BASE + (uint64_t) granule * HEAP_GRANULE;
+}
+
+/**
+ * @brief Frees an allocated block, quarantining it while debugging.
+ *
+ * @param granule The first granule of the block.
+ */
+static void release(int granule) {
+    heap->stats.frees++;
+    heap->stats.in_use -= heap->sizes[granule];
+    if (!heap->debug) {
+        push_free(granule, heap->classes[granule]);
+        return;
+    }
+
+    memset(&heap->poisoned[granule], 1, (size_t) 1 << heap->classes[granule]);
+    if (heap->quarantine_count == HEAP_QUARANTINE) {
+        evict_quarantine();
+    }
+    int slot = (heap->quarantine_first + heap->quarantine_count++) % HEAP_QUARANTINE;
+    heap->quarantine[slot] = (uint16_t) granule;
+    heap->states[granule]  = BLOCK_QUARANTINED;
+}
+
+/**
+ * @brief Makes the oldest quarantined block reusable. It stays poisoned until
+ * it is allocated again.
+ */
+static void evict_quarantine(void) {
+    int granule            = heap->quarantine[heap->quarantine_first];
+    heap->quarantine_first = (heap->quarantine_first + 1) % HEAP_QUARANTINE;
+    heap->quarantine_count--;
+    push_free(granule, heap->classes[granule]);
+}
+
+/**
+ * @brief Finds the block an address passed to free or realloc refers to.
+ *
+ * @param address The address.
+ * @param operation The instruction, for the error message.
+ * @param granule Set to the first granule of the block.
+ * @return True if `address` is an allocated block, false if an error was
+ * printed.
+ */
+static bool allocated_block(uint64_t address, const char *operation, int *granule) {
+    if (address < HEAP_BASE || address >= HEAP_END || (address - HEAP_BASE) % HEAP_GRANULE ||
+        heap->states[(address - HEAP_BASE) / HEAP_GRANULE] == BLOCK_NONE) {
+        printf("Cannot %s address %" PRIu64 ": it was not allocated\n", operation, address);
+        return false;
+    }
+
+    *granule = (int) ((address - HEAP_BASE) / HEAP_GRANULE);
+    if (heap->states[*granule] != BLOCK_USED) {
+        printf("Cannot %s address %" PRIu64 ": it was already freed\n", operation, address);
+        return false;
+    }
+    return true;
+}
+
+bool heap_free(uint64_t address) {
+    int granule;
+    if (address == 0) {
+        return true;
+    }
+    if (!allocated_block(address, "free", &granule)) {
+        return false;
+    }
+    release(granule);
+    return true;
+}
+
+bool heap_realloc(uint64_t address, int64_t size, uint64_t *result) {
+    int granule;
+    heap->stats.reallocs++;
+    if (address == 0) {
+        *result = heap_alloc(size);
+        return true;
+    }
+    if (!allocated_block(address, "realloc", &granule)) {
+        return false;
+    }
+    if (size <= 0) {
+        release(granule);
+        *result = 0;
+        return true;
+    }
+
+    // Blocks that still fit their class stay where they are
+    int class = size_class(size);
+    if (class >= 0 && class <= heap->classes[granule]) {
+        heap->stats.in_use = heap->stats.in_use - heap->sizes[granule] + (uint64_t) size;
+        if (heap->stats.in_use > heap->stats.peak_in_use) {
+            heap->stats.peak_in_use = heap->stats.in_use;
+        }
+        heap->sizes[granule] = (uint16_t) size;
+        *result        = address;
+        return true;
+    }
+
+    uint64_t moved = heap_alloc(size);
+    if (moved) {
+        memmove(mem_base() + moved, mem_base() + address, heap->sizes[granule]);
+        release(granule);
+    }
+    *result = moved;
+    return true;
+}
+
+bool heap_check(uint64_t address, uint64_t bytes) {
+    if (!heap->debug || address >= HEAP_END || bytes == 0) {
+        return true;
+    }
+
+    uint64_t first = address < HEAP_BASE ? HEAP_BASE : address;
+    uint64_t end   = address + bytes > HEAP_END ? HEAP_END : address + bytes;
+    for (uint64_t a = first; a < end; a++) {
+        if (heap->poisoned[(a - HEAP_BASE) / HEAP_GRANULE]) {
+            printf("Use after free: address %" PRIu64 " belongs to a freed block\n", a);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool heap_debugging(void) {
+    return heap->debug;
+}
+
+const HeapStats *heap_stats(void) {
+    return &heap->stats;
+}
+
+void heap_print_stats(FILE *out) {
+    fprintf(out, "Heap allocations: %" PRIu64 " (%" PRIu64 " reused, %" PRIu64 " splits, %" PRIu64
+                 " failed)\n",
+            heap->stats.allocs, heap->stats.reused, heap->stats.splits, heap->stats.failures);
+    fprintf(out, "Heap frees: %" PRIu64 ", reallocs: %" PRIu64 "\n", heap->stats.frees,
+            heap->stats.reallocs);
+    fprintf(out, "Heap in use: %" PRIu64 " bytes (peak %" PRIu64 " of %d)\n", heap->stats.in_use,
+            heap->stats.peak_in_use, HEAP_END - HEAP_BASE);
+}
@@ -0,0 +1,551 @@
+#include "incremental.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lexer.h"
+#include "parser.h"
+#include "stats.h"
+#include "token_type.h"
+
+#define LABEL_BUCKETS 100  // Buckets of the program's label map, as in a cold run
+
+/**
+ * @brief The lines of a source text.
+ */
+typedef struct {
+    char     *text;    // The source text, owned.
+    uint32_t *starts;  // Offset of each line, followed by the length of `text`.
+    int       count;   // Number of lines.
+} LineIndex;
+
+/**
+ * @brief A unit found in freshly lexed tokens, before it is parsed.
+ */
+typedef struct {
+    int  first_line;   // First line of the unit (0-based).
+    int  lines;        // Number of lines it spans.
+    int  first_token;  // Index of its first token.
+    int  end_token;    // Index one past its last token.
+    bool label;        // Whether a statement in it starts with an identifier.
+    bool directive;    // Whether it uses a directive or macro.
+    bool open;         // Whether it ends in a label that marks no command yet.
+} UnitSpan;
+
+static bool     index_lines(LineIndex *index, size_t size);
+static void     free_index(LineIndex *index);
+static bool     same_line(const IncrementalProgram *prog, int old_line, const LineIndex *index,
+                          int new_line);
+static int      unit_at(const IncrementalProgram *prog, int line);
+static bool     split_units(const TokenArray *tokens, int first_line, int end_line,
+                            UnitSpan **spans, int *count, bool *lex_error);
+static bool     build_unit(SourceUnit *unit, const UnitSpan *span, const TokenArray *tokens,
+                           TokenArray *scratch);
+static void     free_unit(SourceUnit *unit);
+static bool     unlink_labels(IncrementalProgram *prog, const SourceUnit *unit);
+static bool     link_labels(IncrementalProgram *prog, const SourceUnit *unit);
+static void     rebuild_labels(IncrementalProgram *prog);
+static void     link_commands(IncrementalProgram *prog);
+
+void incremental_init(IncrementalProgram *prog) {
+    memset(prog, 0, sizeof(*prog));
+}
+
+bool incremental_update(IncrementalProgram *prog, const char *text, IncrementalReport *report) {
+    uint64_t  start = stats_now_ns();
+    size_t    size  = strlen(text);
+    LineIndex index = {NULL, NULL, 0};
+
+    memset(report, 0, sizeof(*report));
+    if (size > INT32_MAX || !(index.text = (char *) malloc(size + 1))) {
+        incremental_free(prog);
+        return false;
+    }
+    memcpy(index.text, text, size + 1);
+    if (!index_lines(&index, size)) {
+        free_index(&index);
+        incremental_free(prog);
+        return false;
+    }
+
+    // Lines both versions share at the start and at the end
+    int old_count = prog->line_count;
+    int prefix    = 0;
+    int suffix    = 0;
+    while (prefix < old_count && prefix < index.count && same_line(prog, prefix, &index, prefix)) {
+        prefix++;
+    }
+    while (suffix < old_count - prefix && suffix < index.count - prefix &&
+           same_line(prog, old_count - 1 - suffix, &index, index.count - 1 - suffix)) {
+        suffix++;
+    }
+
+    // Widen the changed lines to whole units of the previous version
+    int first = prefix < old_count ? unit_at(prog, prefix) : prog->unit_count;
+    if (first > 0 && prog->units[first - 1].open) {
+        first--;
+    }
+    int end = first;
+    while (end < prog->unit_count && prog->units[end].first_line < old_count - suffix) {
+        end++;
+    }
+
+    int        delta = index.count - old_count;
+    int        lo    = 0;
+    int        hi    = 0;
+    TokenArray tokens;
+    UnitSpan  *spans      = NULL;
+    int        span_count = 0;
+    for (;;) {
+        lo = first < prog->unit_count ? prog->units[first].first_line : old_count;
+        hi = (end > first ? prog->units[end - 1].first_line + prog->units[end - 1].lines : lo) +
+             delta;
+
+        // The lexer stops at the end of the changed lines rather than the source
+        char  saved = index.text[index.starts[hi]];
+        Lexer lex;
+        index.text[index.starts[hi]] = '\0';
+        lexer_init(&lex, index.text + index.starts[lo]);
+        lex.current_line = lo + 1;
+        bool lexed       = lexer_tokenize(&lex, &tokens);
+        index.text[index.starts[hi]] = saved;
+
+        bool lex_error = false;
+        if (!lexed || !split_units(&tokens, lo, hi, &spans, &span_count, &lex_error)) {
+            token_array_free(&tokens);
+            free(spans);
+            free_index(&index);
+            incremental_free(prog);
+            return false;
+        }
+
+        // A label still waiting for its command, or a string that may be closed
+        // further down, continues into the lines after the change
+        bool open = span_count > 0 && spans[span_count - 1].open;
+        if ((lex_error || open) && end < prog->unit_count) {
+            end = lex_error ? prog->unit_count : end + 1;
+            token_array_free(&tokens);
+            free(spans);
+            spans = NULL;
+            continue;
+        }
+        break;
+    }
+
+    int         kept  = prog->unit_count - (end - first);
+    SourceUnit *units = (SourceUnit *) calloc((size_t) (kept + span_count ? kept + span_count : 1),
+                                              sizeof(SourceUnit));
+    TokenArray  scratch;
+    memset(&scratch, 0, sizeof(scratch));
+    bool built = units != NULL;
+    for (int i = 0; built && i < span_count; i++) {
+        built = build_unit(&units[first + i], &spans[i], &tokens, &scratch);
+    }
+    token_array_free(&scratch);
+    token_array_free(&tokens);
+    free(spans);
+    if (!built) {
+        for (int i = 0; units && i < span_count; i++) {
+            free_unit(&units[first + i]);
+        }
+        free(units);
+        free_index(&index);
+        incremental_free(prog);
+        return false;
+    }
+
+    // Splice the new units in place of the ones they replace
+    bool labels_kept = prog->has_label_map;
+    for (int i = first; i < end; i++) {
+        labels_kept       = labels_kept && unlink_labels(prog, &prog->units[i]);
+        prog->directives -= prog->units[i].directive;
+        prog->failures   -= prog->units[i].failed;
+        free_unit(&prog->units[i]);
+    }
+    for (int i = first; i < first + span_count; i++) {
+        labels_kept       = labels_kept && link_labels(prog, &units[i]);
+        prog->directives += units[i].directive;
+        prog->failures   += units[i].failed;
+    }
+    if (first > 0) {
+        memcpy(units, prog->units, (size_t) first * sizeof(SourceUnit));
+    }
+    for (int i = end; i < prog->unit_count; i++) {
+        units[i - end + first + span_count]             = prog->units[i];
+        units[i - end + first + span_count].first_line += delta;
+    }
+    free(prog->units);
+    prog->units      = units;
+    prog->unit_count = kept + span_count;
+
+    free(prog->text);
+    free(prog->line_starts);
+    prog->text        = index.text;
+    prog->line_starts = index.starts;
+    prog->line_count  = index.count;
+    link_commands(prog);
+    if (!labels_kept) {
+        rebuild_labels(prog);
+    }
+
+    report->lines_total   = index.count;
+    report->lines_rebuilt = hi - lo;
+    report->units_rebuilt = span_count;
+    report->cold          = lo == 0 && hi == index.count;
+    report->build_ns      = stats_now_ns() - start;
+    return true;
+}
+
+bool incremental_runnable(const IncrementalProgram *prog) {
+    return prog->directives == 0 && prog->failures == 0;
+}
+
+void incremental_free(IncrementalProgram *prog) {
+    for (int i = 0; i < prog->unit_count; i++) {
+        free_unit(&prog->units[i]);
+    }
+    if (prog->has_label_map) {
+        label_map_free(&prog->label_map);
+    }
+    free(prog->units);
+    free(prog->text);
+    free(prog->line_starts);
+    incremental_init(prog);
+}
+
+/**
+ * @brief Finds where each line of a source text starts.
+ *
+ * @param index The index whose `text` to split. Receives the other fields.
+ * @param size The length of the text.
+ * @return True on success, false if memory ran out.
+ */
+static bool index_lines(LineIndex *index, size_t size) {
+    int capacity  = 64;
+    index->starts = (uint32_t *) malloc((size_t) capacity * sizeof(uint32_t));
+    if (!index->starts) {
+        return false;
+    }
+
+    const char *end = index->text + size;
+    for (const char *line = index->text; line < end;) {
+        const char *newline = (const char *) memchr(line, '\n', (size_t) (end - line));
+        if (index->count + 1 == capacity) {
+            uint32_t *grown = (uint32_t *) realloc(index->starts,
+                                                   (size_t) capacity * 2 * sizeof(uint32_t));
+            if (!grown) {
+                return false;
+            }
+            index->starts = grown;
+            capacity     *= 2;
+        }
+        index->starts[index->count++] = (uint32_t) (line - index->text);
+        line                          = newline ? newline + 1 : end;
+    }
+    index->starts[index->count] = (uint32_t) size;
+    return true;
+}
+
+/**
+ * @brief Releases the memory owned by a line index.
+ *
+ * @param index The index to release.
+ */
+static void free_index(LineIndex *index) {
+    free(index->text);
+    free(index->starts);
+}
+
+/**
+ * @brief Compares a line of the program's current source with a line of a
+ * new source.
+ *
+ * @param prog The program holding the current source.
+ * @param old_line The line of the current source.
+ * @param index The lines of the new source.
+ * @param new_line The line of the new source.
+ * @return True if both lines have the same text.
+ */
+static bool same_line(const IncrementalProgram *prog, int old_line, const LineIndex *index,
+                      int new_line) {
+    uint32_t old_start  = prog->line_starts[old_line];
+    uint32_t new_start  = index->starts[new_line];
+    uint32_t old_length = prog->line_starts[old_line + 1] - old_start;
+    uint32_t new_length = index->starts[new_line + 1] - new_start;
+    return old_length == new_length &&
+           memcmp(prog->text + old_start, index->text + new_start, old_length) == 0;
+}
+
+/**
+ * @brief Finds the unit a line belongs to.
+ *
+ * @param prog The program.
+ * @param line A line of the program's current source.
+ * @return The index of the unit.
+ */
+static int unit_at(const IncrementalProgram *prog, int line) {
+    int lo = 0;
+    int hi = prog->unit_count - 1;
+    while (lo < hi) {
+        int mid = lo + (hi - lo + 1) / 2;
+        if (prog->units[mid].first_line <= line) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return lo;
+}
+
+/**
+ * @brief Splits freshly lexed lines into units.
+ *
+ * A unit ends at every newline that closes a statement. Newlines after a label
+ * do not, since the parser attaches the label to the next command.
+ *
+ * @param tokens The tokens of the lines.
+ * @param first_line The first of the lines (0-based).
+ * @param end_line One past the last of the lines.
+ * @param spans Receives the units, which the caller must free.
+ * @param count Receives the number of units.
+ * @param lex_error Set if any token is a lexical error.
+ * @return True on success, false if memory ran out.
+ */
+static bool split_units(const TokenArray *tokens, int first_line, int end_line,
+                        UnitSpan **spans, int *count, bool *lex_error) {
+    int      capacity  = 16;
+    UnitSpan span      = {first_line, 0, 0, 0, false, false, false};
+    bool     statement = true;
+    bool     pending   = false;
+
+    *count     = 0;
+    *lex_error = false;
+    *spans     = (UnitSpan *) malloc((size_t) capacity * sizeof(UnitSpan));
+    if (!*spans) {
+        return false;
+    }
+
+    for (int i = 0; i <= tokens->count - 1; i++) {
+        bool last = i == tokens->count - 1;
+        if (!last) {
+            TokenType type = (TokenType) tokens->types[i];
+            *lex_error     = *lex_error || type == TOK_ERR;
+            if (type == TOK_NL) {
+                statement = statement || !pending;
+                if (pending || tokens->text[tokens->offsets[i]] != '\n') {
+                    continue;
+                }
+            } else {
+                if (type == TOK_IDENT && tokens->text[tokens->offsets[i]] == '.') {
+                    span.directive = true;
+                }
+                if (statement && (type == TOK_IDENT || (token_is_name(type) &&
+                                                        tokens->types[i + 1] == TOK_COLON))) {
+                    span.label = true;
+                    pending    = tokens->types[i + 1] == TOK_COLON;
+                    i         += pending;
+                } else {
+                    pending = false;
+                }
+                statement = false;
+                continue;
+            }
+        } else if (span.first_token == i && span.first_line == end_line) {
+            break;
+        }
+
+        if (*count == capacity) {
+            UnitSpan *grown = (UnitSpan *) realloc(*spans, (size_t) capacity * 2 * sizeof(UnitSpan));
+            if (!grown) {
+                return false;
+            }
+            *spans    = grown;
+            capacity *= 2;
+        }
+
+        // The final unit takes whatever lines are left, newline or not
+        int next_line    = last ? end_line : (int) tokens->lines[i];
+        span.lines       = next_line - span.first_line;
+        span.end_token   = last ? i : i + 1;
+        span.open        = last && pending;
+        (*spans)[(*count)++] = span;
+        span = (UnitSpan) {next_line, 0, i + 1, i + 1, false, false, false};
+    }
+    return true;
+}
+
+/**
+ * @brief Parses the tokens of a unit.
+ *
+ * @param unit The unit to fill.
+ * @param span Where the unit lies in `tokens`.
+ * @param tokens The tokens of the lines the unit was found in.
+ * @param scratch A token array the unit's tokens are copied into for the
+ * parser.
+ * @return True on success, false if memory ran out. A unit that does not
+ * parse is still a success; it is marked as failed.
+ */
+static bool build_unit(SourceUnit *unit, const UnitSpan *span, const TokenArray *tokens,
+                       TokenArray *scratch) {
+    unit->first_line = span->first_line;
+    unit->lines      = span->lines;
+    unit->open       = span->open;
+    unit->directive  = span->directive;
+    if (span->directive || span->first_token == span->end_token) {
+        return true;
+    }
+
+    // The parser needs the unit to end in TOK_EOF
+    scratch->text  = tokens->text;
+    scratch->count = 0;
+    for (int i = span->first_token; i < span->end_token; i++) {
+        if (!token_array_push(scratch, (TokenType) tokens->types[i], tokens->offsets[i],
+                              tokens->lengths[i], tokens->lines[i], tokens->columns[i])) {
+            return false;
+        }
+    }
+    int last = span->end_token - 1;
+    if (!token_array_push(scratch, TOK_EOF, tokens->offsets[last] + tokens->lengths[last], 0,
+                          tokens->lines[last], tokens->columns[last] + tokens->lengths[last])) {
+        return false;
+    }
+
+    if (span->label) {
+        unit->labels = (LabelMap *) malloc(sizeof(LabelMap));
+        if (!unit->labels) {
+            return false;
+        }
+        label_map_init(unit->labels, 1);
+    }
+
+    Parser p;
+    parser_init(&p, scratch, unit->labels);
+    Command *commands = parse_commands(&p);
+    if (p.had_error) {
+        free_command(commands);
+        commands     = NULL;
+        unit->failed = true;
+        if (unit->labels) {
+            label_map_free(unit->labels);
+            free(unit->labels);
+            unit->labels = NULL;
+        }
+    }
+    unit->head = commands;
+    unit->tail = commands;
+    while (unit->tail && unit->tail->next) {
+        unit->tail = unit->tail->next;
+    }
+    return true;
+}
+
+/**
+ * @brief Releases the commands and labels of a unit.
+ *
+ * @param unit The unit to release.
+ */
+static void free_unit(SourceUnit *unit) {
+    if (unit->head) {
+        unit->tail->next = NULL;
+        free_command(unit->head);
+    }
+    if (unit->labels) {
+        label_map_free(unit->labels);
+        free(unit->labels);
+    }
+    memset(unit, 0, sizeof(*unit));
+}
+
+/**
+ * @brief Removes the labels of a unit from the program's label map.
+ *
+ * @param prog The program.
+ * @param unit The unit, whose labels are registered.
+ * @return True on success, false if a label is defined elsewhere as well; the
+ * map must then be rebuilt, since which definition wins depends on the order.
+ */
+static bool unlink_labels(IncrementalProgram *prog, const SourceUnit *unit) {
+    for (Entry *e = unit->labels ? unit->labels->entries[0] : NULL; e; e = e->next) {
+        if (e->id && (!remove_label(&prog->label_map, e->id, e->command) ||
+                      find_label(&prog->label_map, e->id))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Registers the labels of a unit in the program's label map.
+ *
+ * @param prog The program.
+ * @param unit The unit.
+ * @return True on success, false if a label is already defined or memory ran
+ * out; the map must then be rebuilt.
+ */
+static bool link_labels(IncrementalProgram *prog, const SourceUnit *unit) {
+    for (Entry *e = unit->labels ? unit->labels->entries[0] : NULL; e; e = e->next) {
+        if (!e->id) {
+            continue;
+        }
+        size_t length = strlen(e->id);
+        char  *id     = (char *) malloc(length + 1);
+        if (!id || find_label(&prog->label_map, e->id)) {
+            free(id);
+            return false;
+        }
+        memcpy(id, e->id, length + 1);
+        put_label(&prog->label_map, id, e->command);
+    }
+    return true;
+}
+
+/**
+ * @brief Registers the labels of every unit in a fresh label map.
+ *
+ * Labels are registered in source order, so that a label defined twice
+ * resolves like it does after a cold parse.
+ *
+ * @param prog The program.
+ */
+static void rebuild_labels(IncrementalProgram *prog) {
+    if (prog->has_label_map) {
+        label_map_free(&prog->label_map);
+    }
+    prog->has_label_map = label_map_init(&prog->label_map, LABEL_BUCKETS);
+
+    for (int i = 0; i < prog->unit_count; i++) {
+        for (Entry *e = prog->units[i].labels ? prog->units[i].labels->entries[0] : NULL; e;
+             e        = e->next) {
+            size_t length = e->id ? strlen(e->id) : 0;
+            char  *id     = e->id ? (char *) malloc(length + 1) : NULL;
+            if (id) {
+                memcpy(id, e->id, length + 1);
+                put_label(&prog->label_map, id, e->command);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Links the commands of all units into one list.
+ *
+ * @param prog The program.
+ */
+static void link_commands(IncrementalProgram *prog) {
+    Command *last  = NULL;
+    prog->commands = NULL;
+    for (int i = 0; i < prog->unit_count; i++) {
+        SourceUnit *unit = &prog->units[i];
+        if (!unit->head) {
+            continue;
+        }
+        if (last) {
+            last->next = unit->head;
+        } else {
+            prog->commands = unit->head;
+        }
+        last = unit->tail;
+    }
+    if (last) {
+        last->next = NULL;
+    }
+}
@@ -4,13 +4,52 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "builtin.h"
+#include "cfg.h"
 #include "command_type.h"
+#include "ffi.h"
+#include "heap.h"
 #include "mem.h"
+#include "native.h"
+#include "stream.h"
+#include "tier.h"
+#include "trace.h"
 #include <stdlib.h>
 
-static bool    cond_holds(Interpreter *intr, BranchCondition cond);
-static int64_t fetch_number_value(Interpreter *intr, Operand *op, bool is_im);
-static bool    print_base(Interpreter *intr, Command *cmd);
+/**
+ * The registers and flags as interpret() works on them. The dispatch loop
+ * keeps them in a local so that the compiler can hold them across commands
+ * instead of reloading them through `intr` after every store; they are
+ * spilled back to the interpreter before anything else reads or writes them.
+ */
+typedef struct {
+    int64_t regs[NUM_REGISTERS];  // Copy of the interpreter's variables and sp.
+    bool    is_greater;           // Copy of the interpreter's flags.
+    bool    is_equal;
+    bool    is_less;
+} RegisterFile;
+
+/**
+ * What compiled_entry() decided to run for a block.
+ */
+typedef enum {
+    ENTER_NONE,   // Interpret the block.
+    ENTER_TRACE,  // Run the trace recorded for the block.
+    ENTER_BLOCK,  // Run the block's compiled code.
+} CompiledEntry;
+
+static int64_t       fetch_number_value(Interpreter *intr, Operand *op, bool is_im);
+static bool          print_base(Interpreter *intr, Command *cmd, int64_t value);
+static bool          flags_hold(bool greater, bool equal, bool less, BranchCondition cond);
+static void          spill(Interpreter *intr, const RegisterFile *rf);
+static void          reload(RegisterFile *rf, const Interpreter *intr);
+static CompiledEntry compiled_entry(Interpreter *intr, TraceRecorder *rec, BasicBlock *block);
+static Command      *run_block(Interpreter *intr, BasicBlock *block);
+static Command      *run_trace(Interpreter *intr, TraceRecorder *rec, BasicBlock *header);
+static bool          index_commands(Interpreter *intr, Command *commands);
+static bool          stack_push(int64_t *regs, int64_t *values, int64_t count);
+static bool          stack_pop(int64_t *regs, int64_t *values, int64_t count);
+static bool          decode_return(Interpreter *intr, Command **return_to);
 
 
 void interpreter_init(Interpreter *intr, LabelMap *map) {
@@ -24,10 +63,26 @@ void interpreter_init(Interpreter *intr, LabelMap *map) {
     intr->is_equal   = false;
     intr->is_less    = false;
     intr->the_stack  = NULL;
+    intr->tier_threshold    = TIER_DEFAULT_THRESHOLD;
+    intr->trace_threshold   = 0;
+    intr->native            = false;
+    intr->instruction_limit = 0;
+    intr->executed          = 0;
+    intr->ffi               = NULL;
+    intr->heap_debug        = false;
+    intr->return_calls      = false;
+    intr->code              = NULL;
+    intr->code_length       = 0;
+    intr->profile           = NULL;
+    intr->memo              = NULL;
+    intr->slice             = 0;
+    intr->resume            = NULL;
+    memset(&intr->stats, 0, sizeof(intr->stats));
 
     for (size_t i = 0; i < NUM_VARIABLES; i++) {
         intr->variables[i] = 0;
     }
+    intr->variables[REG_SP] = MEM_CAPACITY;  // The stack is empty and grows down
 }
 
 void interpret(Interpreter *intr, Command *commands) {
@@ -36,48 +91,101 @@ void interpret(Interpreter *intr, Command *commands) {
         return;
     }
   
-   
-    Command *current = commands;
+    uint64_t      start = intr->stats.enabled ? stats_now_ns() : 0;
+    Cfg           cfg;
+    TraceRecorder recorder;
+    RegisterFile  rf;
+    // Compiled code runs whole loops, so sliced runs stay in the interpreter
+    bool          tiering = !intr->slice &&
+                   (intr->tier_threshold > 0 || intr->trace_threshold > 0) &&
+                   cfg_build(&cfg, commands, intr->label_map);
+    bool          counting  = intr->instruction_limit || intr->slice;
+    uint64_t      slice_end = intr->slice ? intr->executed + intr->slice : 0;
+
+    trace_recorder_init(&recorder);
+    Command *current = intr->resume ? intr->resume : commands;
+    intr->resume     = NULL;
+    // Slices end at backward branches, which the addresses tell apart
+    if ((intr->return_calls || intr->profile || intr->slice) && !intr->code &&
+        !index_commands(intr, commands)) {
+        printf("Could not allocate the command table\n");
+        intr->had_error = true;
+    }
+    reload(&rf, intr);
   
     while (current && !intr->had_error) {
+        // The linker's halt is not an instruction of the program
+        if (counting && current->type != CMD_HALT) {
+            intr->executed++;
+            if (intr->instruction_limit && intr->executed > intr->instruction_limit) {
+                intr->had_error = true;
+                break;
+            }
+        }
+        if (intr->profile) {
+            intr->profile->executed[current->address - 1]++;
+        }
+
+        if (tiering && current->block && !recorder.active) {
+            CompiledEntry entry = compiled_entry(intr, &recorder, current->block);
+            if (entry != ENTER_NONE) {
+                spill(intr, &rf);
+                Command *resume = entry == ENTER_TRACE ? run_trace(intr, &recorder, current->block)
+                                                       : run_block(intr, current->block);
+                reload(&rf, intr);
+                if (resume != current) {
+                    current = resume;
+                    continue;
+                }
+            }
+        }
+        if (recorder.active && trace_record(&recorder, intr, current)) {
+            // The command is dispatched, and counted, again
+            if (counting) {
+                intr->executed--;
+            }
+            continue;
+        }
+
         switch (current->type) {         
             default:
                 break;
             case CMD_MOV:
             {
-                intr->variables[current->destination.num_val] = current->val_a.num_val;
+                rf.regs[current->destination.num_val] = current->val_a.num_val;
 
                 current = current->next;
                 break;
             }
             case CMD_ADD:
             {
-                int64_t num_1 = intr->variables[current->val_a.num_val];  
+                int64_t num_1 = rf.regs[current->val_a.num_val];  
                 int64_t num_2 = 0;
                 if (current->is_b_immediate) {
                     num_2 = current->val_b.num_val;
                 }
                 else {
-                    num_2 = intr->variables[current->val_b.num_val];
+                    num_2 = rf.regs[current->val_b.num_val];
                 }
               
-                intr->variables[current->destination.num_val] = num_1 + num_2;
+                // Wrap on overflow like the hardware does
+                rf.regs[current->destination.num_val] = (int64_t) ((uint64_t) num_1 + (uint64_t) num_2);
 
                 current = current->next;
                 break;
             }
             case CMD_SUB:
             {
-                int64_t num_1 = intr->variables[current->val_a.num_val];  
+                int64_t num_1 = rf.regs[current->val_a.num_val];  
                 int64_t num_2 = 0;
                 if (current->is_b_immediate) {
                     num_2 = current->val_b.num_val;
                 }
                 else {
-                    num_2 = intr->variables[current->val_b.num_val];
+                    num_2 = rf.regs[current->val_b.num_val];
                 }
               
-                intr->variables[current->destination.num_val] = num_1 - num_2;
+                rf.regs[current->destination.num_val] = (int64_t) ((uint64_t) num_1 - (uint64_t) num_2);
 
                 current = current->next;
                 break;
@@ -85,30 +193,18 @@ void interpret(Interpreter *intr, Command *commands) {
             case CMD_CMP:
             {
                 int64_t first_val = 0;
-                int64_t dest_val = intr->variables[current->destination.num_val];
+                int64_t dest_val = rf.regs[current->destination.num_val];
                 
                 if (current->is_a_immediate) {
                     first_val = current->val_a.num_val;
                 }
                 else {
-                    first_val = intr->variables[current->val_a.num_val];
+                    first_val = rf.regs[current->val_a.num_val];
                 }
              
-                if (dest_val > first_val) {
-                    intr->is_greater = true;
-                    intr->is_less = false;
-                    intr->is_equal = false;
-                }
-                else if (dest_val < first_val) {
-                    intr->is_less = true;
-                    intr->is_greater = false;
-                    intr->is_equal = false;
-                }
-                else {
-                    intr->is_equal = true;
-                    intr->is_greater = false;
-                    intr->is_less = false;
-                }
+                rf.is_greater = dest_val > first_val;
+                rf.is_less    = dest_val < first_val;
+                rf.is_equal   = dest_val == first_val;
                 
                 current = current->next;
                 break;
@@ -116,79 +212,67 @@ void interpret(Interpreter *intr, Command *commands) {
             case CMD_CMP_U:
             {
                 uint64_t first_val = 0;
-                uint64_t dest_val = intr->variables[current->destination.num_val];
+                uint64_t dest_val = rf.regs[current->destination.num_val];
                 
                 if (current->is_a_immediate) {
                    
                     first_val = current->val_a.num_val;
                 }
                 else {
-                    first_val = intr->variables[current->val_a.num_val];
+                    first_val = rf.regs[current->val_a.num_val];
                 }
                
-                if (dest_val > first_val) {
-                    intr->is_greater = true;
-                    intr->is_less = false;
-                    intr->is_equal = false;
-                }
-                else if (dest_val < first_val) {
-                    intr->is_less = true;
-                    intr->is_greater = false;
-                    intr->is_equal = false;
-                }
-                else {
-                    intr->is_equal = true;
-                    intr->is_greater = false;
-                    intr->is_less = false;
-                }
+                rf.is_greater = dest_val > first_val;
+                rf.is_less    = dest_val < first_val;
+                rf.is_equal   = dest_val == first_val;
                 
                 current = current->next;
                 break;
             }
             case CMD_AND: {
-                int64_t val_1 = intr->variables[current->val_a.num_val];
-                int64_t val_2 = intr->variables[current->val_b.num_val];
-                intr->variables[current->destination.num_val] = val_1 & val_2;
+                int64_t val_1 = rf.regs[current->val_a.num_val];
+                int64_t val_2 = rf.regs[current->val_b.num_val];
+                rf.regs[current->destination.num_val] = val_1 & val_2;
 
                 current = current->next;
                 break;
             }
             case CMD_EOR: {
-                int64_t val_1 = intr->variables[current->val_a.num_val];
-                int64_t val_2 = intr->variables[current->val_b.num_val];
-                intr->variables[current->destination.num_val] = val_1 ^ val_2;
+                int64_t val_1 = rf.regs[current->val_a.num_val];
+                int64_t val_2 = rf.regs[current->val_b.num_val];
+                rf.regs[current->destination.num_val] = val_1 ^ val_2;
 
                 current = current->next;
                 break;
             }
             case CMD_ASR: {
-                int64_t val_1 = intr->variables[current->val_a.num_val];
-                int64_t val_2 = current->val_b.num_val;
-                intr->variables[current->destination.num_val] = val_1 >> val_2;
+                int64_t val_1 = rf.regs[current->val_a.num_val];
+                int64_t val_2 = current->val_b.num_val & 63;
+                rf.regs[current->destination.num_val] = val_1 >> val_2;
 
                 current = current->next;
                 break;
             }
             case CMD_LSL: {
-                int64_t val_1 = intr->variables[current->val_a.num_val];
-                int64_t val_2 = current->val_b.num_val;
+                int64_t val_1 = rf.regs[current->val_a.num_val];
+                int64_t val_2 = current->val_b.num_val & 63;
                
-                intr->variables[current->destination.num_val] = val_1 << val_2;
+                rf.regs[current->destination.num_val] = (int64_t) ((uint64_t) val_1 << val_2);
 
                 current = current->next;
                 break;
             }
             case CMD_LSR: {
                 
-                intr->variables[current->destination.num_val] = (uint64_t) intr->variables[current->val_a.num_val] >> current->val_b.num_val;
+                rf.regs[current->destination.num_val] = (uint64_t) rf.regs[current->val_a.num_val] >> (current->val_b.num_val & 63);
 
                 current = current->next;
                 break;
             }
             case CMD_ORR: {
-                int64_t val_1 = intr->variables[current->val_a.num_val];
-                int64_t val_2 = intr->variables[current->val_b.num_val];
-                intr->variables[current->destination.num_val] = val_1 | val_2;
+                int64_t val_1 = rf.regs[current->val_a.num_val];
+                int64_t val_2 = rf.regs[current->val_b.num_val];
+                rf.regs[current->destination.num_val] = val_1 | val_2;
 
                 current = current->next;
                 break;
@@ -202,10 +286,18 @@ void interpret(Interpreter *intr, Command *commands) {
                     startingMemAddress = (unsigned long) current->val_a.num_val;
                 }
                 else {
-                    startingMemAddress = (unsigned long) intr->variables[current->val_a.num_val];
+                    startingMemAddress = (unsigned long) rf.regs[current->val_a.num_val];
                 }
 
-                if (!mem_store((uint8_t*)&intr->variables[current->destination.num_val], startingMemAddress, numBytesToStore)) {
+                // The value is copied out so that no pointer into the register file escapes
+                int64_t value = rf.regs[current->destination.num_val];
+                if (intr->heap_debug && !heap_check(startingMemAddress, numBytesToStore)) {
+                    intr->had_error = true;
+                }
+                else if (current->in_bounds) {
+                    mem_store_unchecked((uint8_t*)&value, startingMemAddress, numBytesToStore);
+                }
+                else if (!mem_store_value(startingMemAddress, (int) numBytesToStore, (uint64_t) value)) {
                     intr->had_error = true;
                 }
                
@@ -216,80 +308,82 @@ void interpret(Interpreter *intr, Command *commands) {
 
                 unsigned long numBytesToLoad =  current->val_a.num_val;
 
-                int64_t imCopy = current->val_b.num_val; 
-                int64_t valCopy = intr->variables[current->val_b.num_val];
-                intr->variables[current->destination.num_val] = 0;
                 unsigned long startingMemAddress = 0;  
-                
 
                 if (current->is_b_immediate) {
-                    startingMemAddress =  imCopy;
+                    startingMemAddress = current->val_b.num_val;
                 }
                 else {
-                    startingMemAddress =  valCopy;
+                    startingMemAddress = rf.regs[current->val_b.num_val];
                 }
               
-                if (!mem_load((uint8_t*)&intr->variables[current->destination.num_val], startingMemAddress, numBytesToLoad)) {
+                int64_t value = 0;
+                bool    ok    = true;
+                if (intr->heap_debug && !heap_check(startingMemAddress, numBytesToLoad)) {
                     intr->had_error = true;
                 }
+                else if (current->in_bounds) {
+                    mem_load_unchecked((uint8_t*)&value, startingMemAddress, numBytesToLoad);
+                }
+                else {
+                    value = (int64_t) mem_load_value(startingMemAddress, (int) numBytesToLoad, &ok);
+                    intr->had_error = !ok;
+                }
+                rf.regs[current->destination.num_val] = value;
                 current = current->next;
                 break;
             }
             case CMD_PUT: {
                 unsigned long startingMemAddress = 0;
-                if (current->is_a_immediate) {
-                    startingMemAddress = current->val_a.num_val;
+                if (current->is_b_immediate) {
+                    startingMemAddress = current->val_b.num_val;
                 }
                 else {
-                    startingMemAddress = intr->variables[current->val_a.num_val];
+                    startingMemAddress = rf.regs[current->val_b.num_val];
                 }
-                char* strVal = current->val_b.str_val;
+                char* strVal = current->val_a.str_val;
                 int length = strlen(strVal);
-                
-                for (int i = 0; i < length + 1; i++) {
+                if (current->in_bounds && !intr->heap_debug) {
+                    mem_store_unchecked((const uint8_t*)strVal, startingMemAddress, length + 1);
+                    current = current->next;
+                    break;
+                }
+
+                // The whole string is checked at once, so a freed block is reported once
+                if (intr->heap_debug && !heap_check(startingMemAddress, (uint64_t) length + 1)) {
+                    intr->had_error = true;
+                }
+                for (int i = 0; !intr->had_error && i < length + 1; i++) {
                     uint8_t charVal = (uint8_t) strVal[i];
-              
-                    if (!mem_store(&charVal, 
-                     (startingMemAddress + i),  1)) {
+                    if (!mem_store(&charVal, startingMemAddress + i, 1)) {
                         intr->had_error = true;
+                    }
                 }
-            }
 
-                free(strVal);
                 current = current->next;
                 break;
                 
             }
             case CMD_BRANCH: {
-                if (   (current->branch_condition == BRANCH_EQUAL && intr->is_equal && !intr->is_greater && !intr->is_less)
-                    || (current->branch_condition == BRANCH_GREATER && intr->is_greater && !intr->is_equal)
-                    || (current->branch_condition == BRANCH_GREATER_EQUAL && (intr->is_greater || intr->is_equal))
-                    || (current->branch_condition == BRANCH_LESS && intr->is_less && !intr->is_equal)
-                    || (current->branch_condition == BRANCH_LESS_EQUAL && (intr->is_less || intr->is_equal))
-                    || (current->branch_condition == BRANCH_NOT_EQUAL && (!intr->is_equal)) || 
-                       (current->branch_condition == BRANCH_NONE)) {
-
-                    char* id = current->destination.str_val;
-                
-                    Entry* entry = get_label(intr->label_map, id);
-                    if (entry->id == NULL) {
+                if (flags_hold(rf.is_greater, rf.is_equal, rf.is_less, current->branch_condition)) {
+                    char    *id     = current->destination.str_val;
+                    Command *target = find_label(intr->label_map, id);
+                    if (target == NULL) {
                         intr->had_error = true;
                         printf("Label not found: %s\n", id);
                         break;
                     }
-                
-                    if (strcmp(id, entry->id) != 0) {
-                        while (strcmp(id, entry->id) != 0 && entry->next != NULL) {                 
-                            entry = entry->next;
-                        }
+                    if (intr->profile) {
+                        intr->profile->taken[current->address - 1]++;
                     }
-
-                    if (entry->command == NULL) {
-                        intr->had_error = true;
-                        
+                    if (slice_end && intr->executed >= slice_end &&
+                        target->address <= current->address) {
+                        intr->resume = target;
+                        current      = NULL;
+                        break;
                     }
-                    
-                    current = entry->command;
+
+                    current = target;
                 }
                 else {
                     current = current->next;
@@ -299,86 +393,153 @@ void interpret(Interpreter *intr, Command *commands) {
                 break;
             }
             case CMD_CALL: {
-                
-                StackEntry* st = (StackEntry*) calloc(1, sizeof(StackEntry));
-                for (int i = 0; i < NUM_VARIABLES; i++) {
-                    st->variables[i] = intr->variables[i];
+                if (current->memo && intr->memo) {
+                    const MemoEntry *hit = memo_lookup(intr->memo, current->memo, rf.regs);
+                    // A hit is charged what the call ran; one that would pass
+                    // the limit runs the call, which stops where it would have
+                    if (hit && (!intr->instruction_limit ||
+                                intr->executed + hit->cost <= intr->instruction_limit)) {
+                        if (counting) {
+                            intr->executed += hit->cost;
+                        }
+                        rf.regs[0]    = hit->result;
+                        rf.is_greater = hit->is_greater;
+                        rf.is_less    = hit->is_less;
+                        rf.is_equal   = hit->is_equal;
+                        current       = current->next;
+                        break;
+                    }
                 }
 
-                st->command = current->next;
-                if (intr->the_stack == NULL) {
-                    intr->the_stack = st;
+                spill(intr, &rf);
+                bool pushed = push_frame(intr, current->next);
+                reload(&rf, intr);
+                if (!pushed) {
+                    intr->had_error = true;
+                    printf(intr->return_calls ? "Stack overflow\n"
+                                              : "Could not allocate a stack frame\n");
+                    break;
                 }
-                else {
-                    StackEntry* temp = intr->the_stack;
-                    while (temp->next != NULL) {
-                        temp = temp->next;
-                    }
-                    temp->next = st;
+                if (current->memo && intr->memo) {
+                    intr->the_stack->memo = current->memo;
                 }
 
-                char* id = current->destination.str_val;
-                Entry* entry = get_label(intr->label_map, id);  
+                char    *id     = current->destination.str_val;
+                Command *target = find_label(intr->label_map, id);
 
-                if (entry == NULL || entry->command == NULL) {
+                if (target == NULL) {
                     intr->had_error = true;
                     printf("Label not found: %s\n", id);
                     break;
                 }
-
-                if (strcmp(id, entry->id) != 0) {
-                    while (strcmp(id, entry->id) != 0 && entry->next != NULL) {
-                            entry = entry->next;
-                    }
+                if (slice_end && intr->executed >= slice_end) {
+                    intr->resume = target;
+                    current      = NULL;
+                    break;
                 }
 
-                
-
-                current = entry->command; 
+                current = target; 
                 break;
             }
-            case CMD_RET: {
-                
-                if (intr->the_stack == NULL) {
-                    current = NULL;
-                    break;
+            case CMD_BUILTIN: {
+                spill(intr, &rf);
+                if (!builtin_run(intr, (int) current->val_a.num_val)) {
+                    intr->had_error = true;
                 }
-                
-            
-                StackEntry* temp = intr->the_stack;
-                if (temp->next == NULL) {
-                    for (int i = 1; i < NUM_VARIABLES; i++) {
-                        intr->variables[i] = temp->variables[i];
-                    }
-                    
-                    current = temp->command;
-                    free(intr->the_stack);
-                    intr->the_stack = NULL;
-                    break;
+                reload(&rf, intr);
+                current = current->next;
+                break;
+            }
+            case CMD_CCALL: {
+                spill(intr, &rf);
+                if (!intr->ffi || !ffi_call(intr, intr->ffi, (int) current->val_a.num_val)) {
+                    intr->had_error = true;
+                }
+                reload(&rf, intr);
+                current = current->next;
+                break;
+            }
+            case CMD_ALLOC: {
+                int64_t size = current->is_a_immediate ? current->val_a.num_val
+                                                       : rf.regs[current->val_a.num_val];
+                rf.regs[current->destination.num_val] = (int64_t) heap_alloc(size);
+                current = current->next;
+                break;
+            }
+            case CMD_FREE: {
+                if (!heap_free((uint64_t) rf.regs[current->val_a.num_val])) {
+                    intr->had_error = true;
                 }
-                while (temp->next != NULL) {
-                    temp = temp->next;
+                current = current->next;
+                break;
+            }
+            case CMD_REALLOC: {
+                int64_t  size = current->is_b_immediate ? current->val_b.num_val
+                                                        : rf.regs[current->val_b.num_val];
+                uint64_t block;
+                if (!heap_realloc((uint64_t) rf.regs[current->val_a.num_val], size, &block)) {
+                    intr->had_error = true;
                 }
-                
-              
-                for (int i = 1; i < NUM_VARIABLES; i++) {
-                    intr->variables[i] = temp->variables[i];
+                else {
+                    rf.regs[current->destination.num_val] = (int64_t) block;
                 }
-
-                current = temp->command;
-                temp = intr->the_stack;
-                while (temp->next != NULL && temp->next->next != NULL) {
-                    temp = temp->next;
+                current = current->next;
+                break;
+            }
+            case CMD_PUSH: {
+                int64_t first = current->val_a.num_val;
+                int64_t count = current->val_b.num_val - first + 1;
+                if (!stack_push(rf.regs, &rf.regs[first], count)) {
+                    intr->had_error = true;
+                    printf("Stack overflow\n");
+                }
+                current = current->next;
+                break;
+            }
+            case CMD_POP: {
+                int64_t first = current->val_a.num_val;
+                int64_t count = current->val_b.num_val - first + 1;
+                if (!stack_pop(rf.regs, &rf.regs[first], count)) {
+                    intr->had_error = true;
+                    printf("Stack underflow\n");
+                }
+                current = current->next;
+                break;
+            }
+            case CMD_WRITE:
+            case CMD_READ: {
+                uint64_t address = (uint64_t) rf.regs[current->val_a.num_val];
+                int64_t  fd      = current->destination.num_val;
+                int64_t  length  = current->val_b.num_val;
+                if (!current->is_b_immediate) {
+                    length = rf.regs[length];
+                }
+                spill(intr, &rf);
+                if (!(current->type == CMD_WRITE ? stream_write(intr, fd, address, length)
+                                                 : stream_read(intr, fd, address, length))) {
+                    intr->had_error = true;
                 }
+                reload(&rf, intr);
+                current = current->next;
+                break;
+            }
+            case CMD_HALT:
+                current = NULL;
+                break;
 
-                free(temp->next);
-                temp->next = NULL;
+            case CMD_RET: {
+                // Returning with an empty stack ends the program
+                spill(intr, &rf);
+                current = pop_frame(intr);
+                reload(&rf, intr);
                 break;
             }
             
             case CMD_PRINT:
             {
-                print_base(intr, current);
+                int64_t value = current->is_a_immediate ? current->val_a.num_val
+                                                        : rf.regs[current->val_a.num_val];
+                print_base(intr, current, value);
                 current = current->next; 
                 break;
             }
@@ -386,47 +547,332 @@ void interpret(Interpreter *intr, Command *commands) {
         }    
                   
     }
+    spill(intr, &rf);
    
-    if (intr->the_stack != NULL)
-    {
-        while (intr->the_stack->next != NULL) {
-            StackEntry* temp = intr->the_stack;
-            intr->the_stack = intr->the_stack->next;
-            free(temp);
+    // A program whose slice ended keeps its frames and addresses until it
+    // is resumed
+    if (intr->had_error) {
+        intr->resume = NULL;
+    }
+    while (!intr->resume && intr->the_stack != NULL) {
+        // Calls still running when the program stopped have no result
+        intr->the_stack->memo = NULL;
+        pop_frame(intr);
+    }
+
+    trace_recorder_free(&recorder);
+    if (!intr->resume) {
+        free(intr->code);
+        intr->code        = NULL;
+        intr->code_length = 0;
+    }
+    if (tiering) {
+        cfg_free(&cfg);
+    }
+    if (intr->stats.enabled) {
+        intr->stats.total_ns += stats_now_ns() - start;
+    }
+}
+
+/**
+ * @brief Copies the dispatch loop's registers and flags back to the
+ * interpreter.
+ *
+ * @param intr The interpreter that receives the values.
+ * @param rf The register file the loop has been working on.
+ */
+static inline void spill(Interpreter *intr, const RegisterFile *rf) {
+    memcpy(intr->variables, rf->regs, sizeof(rf->regs));
+    intr->is_greater = rf->is_greater;
+    intr->is_equal   = rf->is_equal;
+    intr->is_less    = rf->is_less;
+}
+
+/**
+ * @brief Copies the interpreter's registers and flags into the dispatch loop's
+ * register file.
+ *
+ * @param rf The register file to fill.
+ * @param intr The interpreter holding the current values.
+ */
+static inline void reload(RegisterFile *rf, const Interpreter *intr) {
+    memcpy(rf->regs, intr->variables, sizeof(rf->regs));
+    rf->is_greater = intr->is_greater;
+    rf->is_equal   = intr->is_equal;
+    rf->is_less    = intr->is_less;
+}
+
+/**
+ * @brief Decides whether execution entering a block should run compiled code.
+ *
+ * Loop headers are counted towards recording a trace; once a trace exists it
+ * takes precedence over the block's own compiled code. Blocks are counted and
+ * compiled here, so the caller only has to hand over its registers when code
+ * is actually going to run.
+ *
+ * @param intr The pointer to the interpreter holding execution state.
+ * @param rec The recorder used for traces.
+ * @param block The block execution is entering.
+ * @return What to run for `block`, or ENTER_NONE if the interpreter should
+ * execute it itself.
+ */
+static CompiledEntry compiled_entry(Interpreter *intr, TraceRecorder *rec, BasicBlock *block) {
+    if (block->loop_header && intr->trace_threshold > 0 && !block->trace_failed) {
+        if (block->trace) {
+            return ENTER_TRACE;
         }
-        
-    
-    free(intr->the_stack);
+        if (++block->loop_count >= (uint64_t) intr->trace_threshold) {
+            trace_start(rec, block, NULL);
+            return ENTER_NONE;
+        }
+    }
+    if (intr->tier_threshold <= 0) {
+        return ENTER_NONE;
+    }
+
+    if (!block->code) {
+        if (block->tier_failed || ++block->exec_count < (uint64_t) intr->tier_threshold) {
+            return ENTER_NONE;
+        }
+
+        uint64_t start = intr->stats.enabled ? stats_now_ns() : 0;
+        block->code    = tier_compile(block, intr->label_map);
+        if (intr->stats.enabled) {
+            intr->stats.compile_ns += stats_now_ns() - start;
+        }
+        if (!block->code) {
+            block->tier_failed = true;
+            intr->stats.compile_failures++;
+            return ENTER_NONE;
+        }
+        intr->stats.blocks_compiled++;
+        if (intr->native && native_compile(block->code)) {
+            intr->stats.native_blocks++;
+        }
+    }
+    return ENTER_BLOCK;
+}
+
+/**
+ * @brief Runs the trace compiled for a loop header.
+ *
+ * @param intr The pointer to the interpreter holding execution state.
+ * @param rec The recorder used for side traces.
+ * @param header The loop header whose trace to run.
+ * @return The command to resume interpreting at.
+ */
+static Command *run_trace(Interpreter *intr, TraceRecorder *rec, BasicBlock *header) {
+    intr->stats.trace_entries++;
+    if (!intr->stats.enabled) {
+        return trace_execute(intr, rec, header);
+    }
+
+    uint64_t start  = stats_now_ns();
+    Command *resume = trace_execute(intr, rec, header);
+    intr->stats.trace_ns += stats_now_ns() - start;
+    return resume;
+}
+
+/**
+ * @brief Runs the compiled code of a hot block.
+ *
+ * @param intr The pointer to the interpreter holding execution state.
+ * @param block The block execution is entering, which has compiled code.
+ * @return The command to resume interpreting at. This is the leader of
+ * `block` itself if the compiled code deoptimized on its first instruction.
+ */
+static Command *run_block(Interpreter *intr, BasicBlock *block) {
+    intr->stats.tier_entries++;
+    if (!intr->stats.enabled) {
+        return tier_execute(intr, block);
+    }
+
+    uint64_t start  = stats_now_ns();
+    Command *resume = tier_execute(intr, block);
+    intr->stats.tier_ns += stats_now_ns() - start;
+    return resume;
+}
+
+/**
+ * @brief Numbers the commands so that return addresses can refer to them.
+ *
+ * @param intr The interpreter that receives the table of commands.
+ * @param commands The first command of the program.
+ * @return True on success, false if allocation failed.
+ */
+static bool index_commands(Interpreter *intr, Command *commands) {
+    int64_t count = 0;
+    for (Command *c = commands; c; c = c->next) {
+        count++;
+    }
+
+    intr->code = (Command **) malloc((size_t) (count ? count : 1) * sizeof(Command *));
+    if (!intr->code) {
+        return false;
+    }
+    for (Command *c = commands; c; c = c->next) {
+        intr->code[intr->code_length] = c;
+        c->address                    = ++intr->code_length;
+    }
+    return true;
+}
+
+/**
+ * @brief Pushes consecutive values onto the memory stack.
+ *
+ * @param regs The registers whose sp is decremented.
+ * @param values The values, stored from the lowest address up.
+ * @param count The number of values.
+ * @return True on success, false if the values do not fit between sp and the
+ * bottom of the stack.
+ */
+static bool stack_push(int64_t *regs, int64_t *values, int64_t count) {
+    int64_t sp  = regs[REG_SP];
+    int64_t top = sp - count * (int64_t) sizeof(int64_t);
+    if (sp > MEM_CAPACITY || top < STACK_BASE) {
+        return false;
+    }
+    memcpy(mem_base() + top, values, (size_t) (sp - top));
+    regs[REG_SP] = top;
+    return true;
+}
+
+/**
+ * @brief Pops consecutive values off the memory stack.
+ *
+ * @param regs The registers whose sp is incremented.
+ * @param values Receives the values, loaded from the lowest address up.
+ * @param count The number of values.
+ * @return True on success, false if fewer values than requested lie between
+ * sp and the top of the stack.
+ */
+static bool stack_pop(int64_t *regs, int64_t *values, int64_t count) {
+    int64_t sp  = regs[REG_SP];
+    int64_t end = sp + count * (int64_t) sizeof(int64_t);
+    if (sp < STACK_BASE || end > MEM_CAPACITY) {
+        return false;
+    }
+    memcpy(values, mem_base() + sp, (size_t) (end - sp));
+    regs[REG_SP] = end;
+    return true;
+}
+
+/**
+ * @brief Reads the return address at sp.
+ *
+ * @param intr The interpreter running with `return_calls`.
+ * @param return_to Set to the command the address refers to, or NULL for the
+ * end of the program.
+ * @return True on success, false if sp is outside the stack or the address
+ * does not refer to a command.
+ */
+static bool decode_return(Interpreter *intr, Command **return_to) {
+    int64_t sp      = intr->variables[REG_SP];
+    int64_t address = 0;
+    if (sp < STACK_BASE || sp > MEM_CAPACITY - (int64_t) sizeof(int64_t) ||
+        !mem_load((uint8_t *) &address, (size_t) sp, sizeof(address)) || address < 0 ||
+        address > intr->code_length) {
+        return false;
+    }
+    *return_to = address ? intr->code[address - 1] : NULL;
+    return true;
+}
+
+bool push_frame(Interpreter *intr, Command *return_to) {
+    if (intr->return_calls) {
+        int64_t address = return_to ? return_to->address : 0;
+        return stack_push(intr->variables, &address, 1);
+    }
+
+    StackEntry *st = (StackEntry *) malloc(sizeof(StackEntry));
+    if (!st) {
+        return false;
+    }
+
+    memcpy(st->variables, intr->variables, sizeof(st->variables));
+    st->memo        = NULL;
+    st->executed    = intr->executed;
+    st->command     = return_to;
+    st->next        = intr->the_stack;
+    intr->the_stack = st;
+    return true;
+}
+
+Command *pop_frame(Interpreter *intr) {
+    if (intr->return_calls) {
+        Command *return_to = NULL;
+        if (intr->variables[REG_SP] == MEM_CAPACITY) {
+            return NULL;
+        }
+        if (!decode_return(intr, &return_to)) {
+            printf("Invalid return address at sp %" PRId64 "\n", intr->variables[REG_SP]);
+            intr->had_error = true;
+            return NULL;
+        }
+        intr->variables[REG_SP] += (int64_t) sizeof(int64_t);
+        return return_to;
+    }
+
+    StackEntry *top = intr->the_stack;
+    if (!top) {
+        return NULL;
+    }
+
+    if (top->memo && intr->memo) {
+        memo_store(intr->memo, top->memo, top->variables, intr->variables, intr->is_greater,
+                   intr->is_less, intr->is_equal, intr->executed - top->executed);
+    }
+
+    // x0 carries the return value, everything else is restored
+    memcpy(&intr->variables[1], &top->variables[1], sizeof(int64_t) * (NUM_VARIABLES - 1));
+    Command *return_to = top->command;
+    intr->the_stack    = top->next;
+    free(top);
+    return return_to;
+}
+
+bool peek_frame(Interpreter *intr, Command **return_to) {
+    if (intr->return_calls) {
+        return intr->variables[REG_SP] != MEM_CAPACITY && decode_return(intr, return_to);
+    }
+    if (!intr->the_stack) {
+        return false;
     }
+    *return_to = intr->the_stack->command;
+    return true;
 }
 
-void print_interpreter_state(Interpreter *intr) {
+void print_interpreter_state(Interpreter *intr, FILE *out) {
     if (!intr) {
         return;
     }
 
-    printf("Error: %d\n", intr->had_error);
-    printf("Flags:\n");
-    printf("Is greater: %d\n", intr->is_greater);
-    printf("Is equal: %d\n", intr->is_equal);
-    printf("Is less: %d\n", intr->is_less);
+    fprintf(out, "Error: %d\n", intr->had_error);
+    fprintf(out, "Flags:\n");
+    fprintf(out, "Is greater: %d\n", intr->is_greater);
+    fprintf(out, "Is equal: %d\n", intr->is_equal);
+    fprintf(out, "Is less: %d\n", intr->is_less);
 
-    printf("\n");
+    fprintf(out, "\n");
 
-    printf("Variable values:\n");
+    fprintf(out, "Variable values:\n");
     for (size_t i = 0; i < NUM_VARIABLES; i++) {
-        printf("x%zu: %" PRId64 "", i, intr->variables[i]);
+        fprintf(out, "x%zu: %" PRId64 "", i, intr->variables[i]);
 
         if (i < NUM_VARIABLES - 1) {
-            printf(", ");
+            fprintf(out, ", ");
         }
 
         if ((i + 1) % 8 == 0) {
-            printf("\n");
+            fprintf(out, "\n");
         }
     }
+    // sp is only shown once the program has used the stack
+    if (intr->variables[REG_SP] != MEM_CAPACITY) {
+        fprintf(out, "sp: %" PRId64 "\n", intr->variables[REG_SP]);
+    }
 
-    printf("\n");
+    fprintf(out, "\n");
 }
 
 /**
@@ -443,16 +889,46 @@ static int64_t fetch_number_value(Interpreter *intr, Operand *op, bool is_im) {
     return -1;
 }
 
+bool charge_instructions(Interpreter *intr, uint64_t count) {
+    if (intr->instruction_limit == 0) {
+        return true;
+    }
+
+    intr->executed += count;
+    return intr->executed <= intr->instruction_limit;
+}
+
+bool cond_holds(Interpreter *intr, BranchCondition cond) {
+    return flags_hold(intr->is_greater, intr->is_equal, intr->is_less, cond);
+}
+
 /**
- * @brief Determines whether a given branch condition holds.
+ * @brief Evaluates a branch condition against a set of comparison flags.
  *
- * @param intr The pointer to the interpreter holding the result of the
- * comparison.
- * @param cond The condition to check.
- * @return True if the given condition holds, false otherwise.
+ * @param greater Whether the last comparison found its first operand greater.
+ * @param equal Whether the last comparison found its operands equal.
+ * @param less Whether the last comparison found its first operand less.
+ * @param cond The condition to evaluate.
+ * @return True if the branch should be taken.
  */
-static bool cond_holds(Interpreter *intr, BranchCondition cond) {
-    // STUDENT TODO: Determine whether a given condition holds using the interpreter's state
+static inline bool flags_hold(bool greater, bool equal, bool less, BranchCondition cond) {
+    switch (cond) {
+        case BRANCH_NONE:
+        case BRANCH_ALWAYS:
+            return true;
+        case BRANCH_EQUAL:
+            return equal && !greater && !less;
+        case BRANCH_NOT_EQUAL:
+            return !equal;
+        case BRANCH_GREATER:
+            return greater && !equal;
+        case BRANCH_LESS:
+            return less && !equal;
+        case BRANCH_GREATER_EQUAL:
+            return greater || equal;
+        case BRANCH_LESS_EQUAL:
+            return less || equal;
+    }
     return false;
 }
 
@@ -461,17 +937,10 @@ static bool cond_holds(Interpreter *intr, BranchCondition cond) {
  *
  * @param intr The pointer to the interpreter holding variable state.
  * @param cmd The command being processed.
+ * @param first_val The value of the command's operand.
  * @return True whether the print was successful, false otherwise.
  */
-static bool print_base(Interpreter *intr, Command *cmd) {
-
-    int64_t first_val = 0;
-    if (cmd->is_a_immediate) {
-        first_val = cmd->val_a.num_val;
-    }
-    else {
-        first_val = intr->variables[cmd->val_a.num_val];
-    }
+static bool print_base(Interpreter *intr, Command *cmd, int64_t first_val) {
 
     char base = cmd->val_b.base;
     if (base == 'd') {
@@ -489,27 +958,27 @@ static bool print_base(Interpreter *intr, Command *cmd) {
         else {
             int cutoff = 63;
             for (int i = 63; i >= 0; i--) {
-                if (first_val & (1LL << i)) {
+                if ((uint64_t) first_val & (1ULL << i)) {
                     break;
                 }
                 cutoff--;
             }
           
             for (int i = cutoff; i >= 0; i--) {
-                printf("%d", (first_val & (1LL << i) ? 1 : 0));
+                printf("%d", ((uint64_t) first_val & (1ULL << i) ? 1 : 0));
             }
         }    
         printf("\n");
     }
     else {
-        uint8_t val = 1;
-        mem_load(&val, first_val, 1);
-       
-        int i = 1;
-        while (val != '\0') {
-            printf("%c",  val);
-            mem_load(&val, first_val + i, 1);
-            i++;
+        // Stop at the terminator or the end of memory, whichever comes first
+        uint8_t val;
+        for (uint64_t i = 0; mem_load(&val, (uint64_t) first_val + i, 1) && val != '\0'; i++) {
+            if (intr->heap_debug && !heap_check((uint64_t) first_val + i, 1)) {
+                intr->had_error = true;
+                return false;
+            }
+            printf("%c", val);
         }
         printf("\n");
     }
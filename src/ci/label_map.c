@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include "label_map.h"
 #include <stdio.h>
+#include <string.h>
 
 static void          free_entry(Entry *e);
 static void          free_entries(Entry *e);
@@ -83,7 +84,7 @@ static bool entry_init(char *id, Command *command, Entry* entry) {
     
     
     // Initialize at first bucket
-    if (entry->id == NULL || entry->command == NULL) {
+    if (entry->id == NULL) {
         entry->id = id;
         entry->command = command;
         return true;
@@ -118,3 +119,45 @@ Entry *get_label(LabelMap *map, char *id) {
     unsigned long labelId = hash_function(id) % map->capacity;
     return map->entries[labelId];
 }
+
+Command *find_label(LabelMap *map, char *id) {
+    if (!map || !id) {
+        return NULL;
+    }
+
+    for (Entry *entry = get_label(map, id); entry != NULL; entry = entry->next) {
+        if (entry->id != NULL && strcmp(entry->id, id) == 0) {
+            return entry->command;
+        }
+    }
+    return NULL;
+}
+
+bool remove_label(LabelMap *map, char *id, Command *command) {
+    Entry *head = get_label(map, id);
+    for (Entry *prev = NULL, *entry = head; entry != NULL; prev = entry, entry = entry->next) {
+        if (entry->id == NULL || entry->command != command || strcmp(entry->id, id) != 0) {
+            continue;
+        }
+
+        // The first entry of a bucket lives in the bucket array, so the next
+        // one moves into its place
+        Entry *unused = entry;
+        if (prev) {
+            prev->next = entry->next;
+        } else if (entry->next) {
+            unused = entry->next;
+            free(entry->id);
+            *entry     = *unused;
+            unused->id = NULL;
+        } else {
+            free(entry->id);
+            entry->id      = NULL;
+            entry->command = NULL;
+            return true;
+        }
+        free_entry(unused);
+        return true;
+    }
+    return false;
+}
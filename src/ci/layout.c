@@ -0,0 +1,647 @@
+#include "layout.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cfg.h"
+
+/**
+ * @brief A control flow edge and how often the profile saw it followed.
+ */
+typedef struct {
+    int      from;    // Block the edge leaves.
+    int      to;      // Block the edge enters.
+    uint64_t weight;  // Times the edge was followed.
+} Edge;
+
+/**
+ * @brief A chain of blocks and where it goes in the new order.
+ */
+typedef struct {
+    int      head;  // First block of the chain.
+    uint64_t heat;  // Times the first block was entered.
+    bool     exit;  // Whether the chain ends the program.
+} Chain;
+
+/**
+ * @brief The working state of one layout.
+ */
+typedef struct {
+    Cfg       cfg;         // Blocks of the program, in source order.
+    uint64_t *heat;        // Times each block was entered.
+    uint64_t *taken;       // Times each block's final branch was taken.
+    uint64_t *fallen;      // Times each block fell through to its source successor.
+    bool     *compares;    // Whether each block contains a `cmp`.
+    bool     *flags_in;    // Whether a `cmp` has run on every path into each block.
+    int      *chain_next;  // Block chained after each block, or -1.
+    int      *chain_head;  // First block of the chain each block belongs to.
+    int      *chain_tail;  // Last block of each chain, indexed by its first block.
+    int      *order;       // Blocks in their new order.
+    char    **names;       // A label resolving to each block's leader, or NULL.
+    char    **targets;     // New destination of each block's inverted branch, or NULL.
+    Command **jumps;       // Branch to add after each block, or NULL.
+    int       exit;        // Block that ends the program by falling off it, or -1.
+} Layout;
+
+static bool            layout_init(Layout *lay, Command *commands, LabelMap *map);
+static void            layout_free(Layout *lay);
+static void            weigh_edges(Layout *lay, Command *commands, const Profile *profile);
+static void            find_defined_flags(Layout *lay);
+static BranchCondition inverse(BranchCondition cond);
+static bool            invertible(const Layout *lay, const BasicBlock *block);
+static bool            may_follow_target(const Layout *lay, const BasicBlock *block);
+static int             compare_edges(const void *a, const void *b);
+static int             compare_chains(const void *a, const void *b);
+static bool            form_chains(Layout *lay);
+static void            rotate_loops(Layout *lay);
+static uint64_t        jumps_run(const Layout *lay, const int *order);
+static bool            place_chains(Layout *lay);
+static void            name_blocks(Layout *lay, LabelMap *map);
+static char           *block_label(Layout *lay, LabelMap *map, const BasicBlock *block);
+static bool            plan_fixups(Layout *lay, LabelMap *map);
+static void            relink(Layout *lay, Command **commands, LayoutStats *stats);
+
+bool layout_apply(Command **commands, LabelMap *map, const Profile *profile, LayoutStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    Layout lay;
+    if (!layout_init(&lay, *commands, map)) {
+        layout_free(&lay);
+        printf("Could not allocate the code layout\n");
+        return false;
+    }
+    if (lay.cfg.count == 0) {
+        layout_free(&lay);
+        return true;
+    }
+
+    weigh_edges(&lay, *commands, profile);
+    find_defined_flags(&lay);
+    name_blocks(&lay, map);
+    bool ok = form_chains(&lay) && place_chains(&lay);
+    // A layout that runs more jumps than the source order is dropped
+    if (ok && jumps_run(&lay, lay.order) > jumps_run(&lay, NULL)) {
+        for (int i = 0; i < lay.cfg.count; i++) {
+            lay.order[i] = i;
+        }
+    }
+    ok = ok && plan_fixups(&lay, map);
+    if (ok) {
+        stats->blocks = lay.cfg.count;
+        relink(&lay, commands, stats);
+    } else {
+        printf("Could not allocate the code layout\n");
+    }
+    layout_free(&lay);
+    return ok;
+}
+
+/**
+ * @brief Builds the blocks of a program and allocates the layout's tables.
+ *
+ * @param lay The layout to initialize. Must be released with `layout_free`,
+ * even on failure.
+ * @param commands The first command of the program.
+ * @param map The program's labels.
+ * @return True on success, false if memory ran out.
+ */
+static bool layout_init(Layout *lay, Command *commands, LabelMap *map) {
+    memset(lay, 0, sizeof(*lay));
+    lay->exit = -1;
+    if (!cfg_build(&lay->cfg, commands, map)) {
+        return false;
+    }
+
+    size_t count    = (size_t) (lay->cfg.count ? lay->cfg.count : 1);
+    lay->heat       = (uint64_t *) calloc(count, sizeof(uint64_t));
+    lay->taken      = (uint64_t *) calloc(count, sizeof(uint64_t));
+    lay->fallen     = (uint64_t *) calloc(count, sizeof(uint64_t));
+    lay->compares   = (bool *) calloc(count, sizeof(bool));
+    lay->flags_in   = (bool *) calloc(count, sizeof(bool));
+    lay->chain_next = (int *) calloc(count, sizeof(int));
+    lay->chain_head = (int *) calloc(count, sizeof(int));
+    lay->chain_tail = (int *) calloc(count, sizeof(int));
+    lay->order      = (int *) calloc(count, sizeof(int));
+    lay->names      = (char **) calloc(count, sizeof(char *));
+    lay->targets    = (char **) calloc(count, sizeof(char *));
+    lay->jumps      = (Command **) calloc(count, sizeof(Command *));
+    return lay->heat && lay->taken && lay->fallen && lay->compares && lay->flags_in &&
+           lay->chain_next && lay->chain_head && lay->chain_tail && lay->order && lay->names &&
+           lay->targets && lay->jumps;
+}
+
+/**
+ * @brief Releases a layout, including fixups that were planned but not
+ * applied.
+ *
+ * @param lay The layout to release.
+ */
+static void layout_free(Layout *lay) {
+    for (int i = 0; i < lay->cfg.count; i++) {
+        if (lay->targets) {
+            free(lay->targets[i]);
+        }
+        if (lay->jumps) {
+            free_command(lay->jumps[i]);
+        }
+    }
+    cfg_free(&lay->cfg);
+    free(lay->heat);
+    free(lay->taken);
+    free(lay->fallen);
+    free(lay->compares);
+    free(lay->flags_in);
+    free(lay->chain_next);
+    free(lay->chain_head);
+    free(lay->chain_tail);
+    free(lay->order);
+    free(lay->names);
+    free(lay->targets);
+    free(lay->jumps);
+}
+
+/**
+ * @brief Derives how often each block was entered and left along each of its
+ * edges from the counts of its commands.
+ *
+ * A call's taken edge is not weighed: the call transfers control whether or
+ * not its target is placed next, so only its return edge can fall through.
+ *
+ * @param lay The layout.
+ * @param commands The first command of the program.
+ * @param profile Counts collected from the program.
+ */
+static void weigh_edges(Layout *lay, Command *commands, const Profile *profile) {
+    BasicBlock *block    = NULL;
+    int64_t     position = 0;
+    for (Command *cmd = commands; cmd; cmd = cmd->next, position++) {
+        uint64_t executed = profile->executed[position];
+        if (cmd->block) {
+            block                = cmd->block;
+            lay->heat[block->id] = executed;
+        }
+        if (cmd->type == CMD_CMP || cmd->type == CMD_CMP_U) {
+            lay->compares[block->id] = true;
+        }
+        if (cmd != block->last) {
+            continue;
+        }
+
+        uint64_t taken = profile->taken[position];
+        if (cmd->type == CMD_BRANCH && cmd->branch_condition == BRANCH_NONE) {
+            lay->taken[block->id] = executed;
+        } else if (cmd->type == CMD_BRANCH) {
+            lay->taken[block->id]  = taken;
+            lay->fallen[block->id] = executed - taken;
+        } else if (cmd->type != CMD_RET && cmd->type != CMD_HALT) {
+            lay->fallen[block->id] = executed;
+        }
+    }
+
+    Command *last = lay->cfg.blocks[lay->cfg.count - 1].last;
+    if (last->type != CMD_RET && last->type != CMD_HALT &&
+        !(last->type == CMD_BRANCH && last->branch_condition == BRANCH_NONE)) {
+        lay->exit = lay->cfg.count - 1;
+    }
+}
+
+/**
+ * @brief Finds the blocks every path into which runs a `cmp`.
+ *
+ * All flags are clear until the first `cmp`, so `b.gt` and `b.le` are then
+ * both false; only once a `cmp` has run is exactly one flag set and every
+ * condition the negation of its inverse. A call continues at its return edge
+ * with the flags its callee left, which a `cmp` on every path to the call
+ * already defines.
+ *
+ * @param lay The layout.
+ */
+static void find_defined_flags(Layout *lay) {
+    for (int i = 0; i < lay->cfg.count; i++) {
+        lay->flags_in[i] = i != 0;
+    }
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int i = 0; i < lay->cfg.count; i++) {
+            BasicBlock *block = &lay->cfg.blocks[i];
+            if (lay->flags_in[i] || lay->compares[i]) {
+                continue;
+            }
+            BasicBlock *successors[] = {block->taken, block->fallthrough};
+            for (int s = 0; s < 2; s++) {
+                if (successors[s] && lay->flags_in[successors[s]->id]) {
+                    lay->flags_in[successors[s]->id] = false;
+                    changed                          = true;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief Returns the condition that holds whenever the given one does not,
+ * given that a `cmp` has run.
+ *
+ * @param cond A condition other than `BRANCH_NONE` and `BRANCH_ALWAYS`.
+ * @return The inverse condition.
+ */
+static BranchCondition inverse(BranchCondition cond) {
+    switch (cond) {
+        case BRANCH_EQUAL:
+            return BRANCH_NOT_EQUAL;
+        case BRANCH_NOT_EQUAL:
+            return BRANCH_EQUAL;
+        case BRANCH_GREATER:
+            return BRANCH_LESS_EQUAL;
+        case BRANCH_LESS_EQUAL:
+            return BRANCH_GREATER;
+        case BRANCH_LESS:
+            return BRANCH_GREATER_EQUAL;
+        case BRANCH_GREATER_EQUAL:
+            return BRANCH_LESS;
+        default:
+            return cond;
+    }
+}
+
+/**
+ * @brief Determines whether a block's final conditional branch can be
+ * inverted without changing when it is taken.
+ *
+ * @param lay The layout.
+ * @param block The block.
+ * @return True if the inverse holds exactly when the condition does not.
+ */
+static bool invertible(const Layout *lay, const BasicBlock *block) {
+    switch (block->last->branch_condition) {
+        case BRANCH_EQUAL:
+        case BRANCH_NOT_EQUAL:
+            // `eq` needs the equal flag alone, which `ne` negates even before a `cmp`
+            return true;
+        case BRANCH_GREATER:
+        case BRANCH_LESS:
+        case BRANCH_GREATER_EQUAL:
+        case BRANCH_LESS_EQUAL:
+            return lay->flags_in[block->id] || lay->compares[block->id];
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief Determines whether the target of a block's final branch can be
+ * placed right after the block.
+ *
+ * @param lay The layout.
+ * @param block The block.
+ * @return True if the branch is unconditional, or conditional and invertible
+ * so that it can take the branch to its source successor instead.
+ */
+static bool may_follow_target(const Layout *lay, const BasicBlock *block) {
+    const Command *last = block->last;
+    if (last->type != CMD_BRANCH || !block->taken) {
+        return false;
+    }
+    return last->branch_condition == BRANCH_NONE ||
+           (block->fallthrough && invertible(lay, block));
+}
+
+/**
+ * @brief Orders edges by weight, heaviest first, and then by source order.
+ */
+static int compare_edges(const void *a, const void *b) {
+    const Edge *x = (const Edge *) a;
+    const Edge *y = (const Edge *) b;
+    if (x->weight != y->weight) {
+        return x->weight > y->weight ? -1 : 1;
+    }
+    if (x->from != y->from) {
+        return x->from < y->from ? -1 : 1;
+    }
+    return (x->to > y->to) - (x->to < y->to);
+}
+
+/**
+ * @brief Orders chains hottest first, keeping never-run chains in source
+ * order and the chain that ends the program last.
+ */
+static int compare_chains(const void *a, const void *b) {
+    const Chain *x = (const Chain *) a;
+    const Chain *y = (const Chain *) b;
+    if (x->exit != y->exit) {
+        return x->exit ? 1 : -1;
+    }
+    if (x->heat != y->heat) {
+        return x->heat > y->heat ? -1 : 1;
+    }
+    return (x->head > y->head) - (x->head < y->head);
+}
+
+/**
+ * @brief Joins blocks into chains along their heaviest edges.
+ *
+ * An edge joins two chains when it leaves the tail of one and enters the head
+ * of the other. The entry block always heads its chain.
+ *
+ * @param lay The layout.
+ * @return True on success, false if memory ran out.
+ */
+static bool form_chains(Layout *lay) {
+    int   count = lay->cfg.count;
+    Edge *edges = (Edge *) malloc(2 * (size_t) count * sizeof(Edge));
+    if (!edges) {
+        return false;
+    }
+
+    int edge_count = 0;
+    for (int i = 0; i < count; i++) {
+        BasicBlock *block = &lay->cfg.blocks[i];
+        if (block->fallthrough && lay->fallen[i] > 0) {
+            edges[edge_count++] = (Edge) {i, block->fallthrough->id, lay->fallen[i]};
+        }
+        if (lay->taken[i] > 0 && may_follow_target(lay, block)) {
+            edges[edge_count++] = (Edge) {i, block->taken->id, lay->taken[i]};
+        }
+        lay->chain_next[i] = -1;
+        lay->chain_head[i] = i;
+        lay->chain_tail[i] = i;
+    }
+    qsort(edges, (size_t) edge_count, sizeof(Edge), compare_edges);
+
+    for (int e = 0; e < edge_count; e++) {
+        int from = lay->chain_head[edges[e].from];
+        int to   = edges[e].to;
+        if (to == 0 || lay->chain_head[to] != to || from == to ||
+            lay->chain_tail[from] != edges[e].from) {
+            continue;
+        }
+        lay->chain_next[edges[e].from] = to;
+        lay->chain_tail[from]          = lay->chain_tail[to];
+        for (int b = to; b != -1; b = lay->chain_next[b]) {
+            lay->chain_head[b] = from;
+        }
+    }
+    free(edges);
+    rotate_loops(lay);
+    return true;
+}
+
+/**
+ * @brief Rotates chains that form a loop so they end at the conditional back
+ * edge rather than at a broken fall-through.
+ *
+ * A chain whose last block falls through to its first one needs a jump there
+ * on every trip. Joining a loop along a conditional branch only inverts it,
+ * so ending the chain at that branch instead keeps the fall-through and moves
+ * the jump to the branch's other side, when that side is followed less often.
+ *
+ * @param lay The layout.
+ */
+static void rotate_loops(Layout *lay) {
+    for (int head = 1; head < lay->cfg.count; head++) {
+        int         tail = lay->chain_tail[head];
+        BasicBlock *fall = lay->cfg.blocks[tail].fallthrough;
+        if (lay->chain_head[head] != head || !fall || fall->id != head) {
+            continue;
+        }
+
+        // The conditional branch joined into the chain that leaves least often
+        int end = -1;
+        for (int b = head; b != tail; b = lay->chain_next[b]) {
+            BasicBlock *block = &lay->cfg.blocks[b];
+            if (block->last->type == CMD_BRANCH &&
+                block->last->branch_condition != BRANCH_NONE && block->taken &&
+                block->taken->id == lay->chain_next[b] &&
+                (end < 0 || lay->fallen[b] < lay->fallen[end])) {
+                end = b;
+            }
+        }
+        if (end < 0 || lay->fallen[end] >= lay->fallen[tail]) {
+            continue;
+        }
+
+        int first              = lay->chain_next[end];
+        lay->chain_next[tail]  = head;
+        lay->chain_next[end]   = -1;
+        lay->chain_tail[first] = end;
+        for (int b = first; b != -1; b = lay->chain_next[b]) {
+            lay->chain_head[b] = first;
+        }
+    }
+}
+
+/**
+ * @brief Counts the jumps a program runs with its blocks in the given order.
+ *
+ * These are its unconditional branches, except those to the block placed
+ * next, and the branches a fixup adds after blocks whose source successor is
+ * not placed next.
+ *
+ * @param lay The layout.
+ * @param order The blocks in their new order, or NULL for the source order.
+ * @return The times the profile would have seen those jumps run.
+ */
+static uint64_t jumps_run(const Layout *lay, const int *order) {
+    uint64_t jumps = 0;
+    for (int i = 0; i < lay->cfg.count; i++) {
+        int               id    = order ? order[i] : i;
+        const BasicBlock *block = &lay->cfg.blocks[id];
+        const BasicBlock *next  = NULL;
+        if (i + 1 < lay->cfg.count) {
+            next = &lay->cfg.blocks[order ? order[i + 1] : i + 1];
+        }
+        const Command *last = block->last;
+
+        if (last->type == CMD_BRANCH && last->branch_condition == BRANCH_NONE &&
+            !(block->taken && block->taken == next && block->length > 1)) {
+            jumps += lay->taken[id];
+        }
+        if (block->fallthrough && block->fallthrough != next &&
+            !(last->type == CMD_BRANCH && block->taken == next && invertible(lay, block))) {
+            jumps += lay->fallen[id];
+        }
+    }
+    return jumps;
+}
+
+/**
+ * @brief Lays the chains out one after another: the entry chain first, then
+ * the others hottest first. The block the program falls off at its end stays
+ * last.
+ *
+ * @param lay The layout.
+ * @return True on success, false if memory ran out.
+ */
+static bool place_chains(Layout *lay) {
+    int    count  = lay->cfg.count;
+    Chain *chains = (Chain *) malloc((size_t) count * sizeof(Chain));
+    if (!chains) {
+        return false;
+    }
+
+    int chain_count = 0;
+    for (int i = 1; i < count; i++) {
+        if (lay->chain_head[i] == i) {
+            bool exit             = lay->exit >= 0 && lay->chain_head[lay->exit] == i;
+            chains[chain_count++] = (Chain) {i, lay->heat[i], exit};
+        }
+    }
+    qsort(chains, (size_t) chain_count, sizeof(Chain), compare_chains);
+
+    int placed = 0;
+    for (int c = -1; c < chain_count; c++) {
+        for (int b = c < 0 ? 0 : chains[c].head; b != -1; b = lay->chain_next[b]) {
+            if (b != lay->exit) {
+                lay->order[placed++] = b;
+            }
+        }
+    }
+    if (lay->exit >= 0) {
+        lay->order[placed++] = lay->exit;
+    }
+    free(chains);
+    return true;
+}
+
+/**
+ * @brief Finds a label for every block that has one.
+ *
+ * @param lay The layout.
+ * @param map The program's labels.
+ */
+static void name_blocks(Layout *lay, LabelMap *map) {
+    for (int i = 0; i < map->capacity; i++) {
+        for (Entry *e = map->entries[i]; e != NULL; e = e->next) {
+            if (!e->id || !e->command || !e->command->block) {
+                continue;
+            }
+            // A label defined twice resolves to its first definition only
+            int id = e->command->block->id;
+            if (!lay->names[id] && find_label(map, e->id) == e->command) {
+                lay->names[id] = e->id;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Returns a copy of a label that resolves to a block, adding one to
+ * the program if the block has none.
+ *
+ * @param lay The layout.
+ * @param map The program's labels.
+ * @param block The block.
+ * @return The label, owned by the caller, or NULL if memory ran out.
+ */
+static char *block_label(Layout *lay, LabelMap *map, const BasicBlock *block) {
+    if (!lay->names[block->id]) {
+        char *name = (char *) malloc(32);
+        if (!name) {
+            return NULL;
+        }
+        snprintf(name, 32, LAYOUT_LABEL_PREFIX "%d", block->id);
+        put_label(map, name, block->first);
+        lay->names[block->id] = name;
+    }
+
+    char *copy = (char *) malloc(strlen(lay->names[block->id]) + 1);
+    if (copy) {
+        strcpy(copy, lay->names[block->id]);
+    }
+    return copy;
+}
+
+/**
+ * @brief Decides how each block reaches its source successor in the new
+ * order, allocating every branch and destination that takes.
+ *
+ * A block falls through when its successor is placed next. Otherwise a
+ * conditional branch whose target is placed next is inverted to take the
+ * branch to the successor, and any other block is followed by a branch to it.
+ *
+ * @param lay The layout.
+ * @param map The program's labels.
+ * @return True on success, false if memory ran out.
+ */
+static bool plan_fixups(Layout *lay, LabelMap *map) {
+    for (int i = 0; i < lay->cfg.count; i++) {
+        BasicBlock *block = &lay->cfg.blocks[lay->order[i]];
+        BasicBlock *next  = i + 1 < lay->cfg.count ? &lay->cfg.blocks[lay->order[i + 1]] : NULL;
+        BasicBlock *fall  = block->fallthrough;
+        if (!fall || fall == next) {
+            continue;
+        }
+
+        char *label = block_label(lay, map, fall);
+        if (!label) {
+            return false;
+        }
+        if (block->last->type == CMD_BRANCH && block->taken == next && invertible(lay, block)) {
+            lay->targets[block->id] = label;
+            continue;
+        }
+
+        Command *jump = (Command *) calloc(1, sizeof(Command));
+        if (!jump) {
+            free(label);
+            return false;
+        }
+        jump->type                = CMD_BRANCH;
+        jump->branch_condition    = BRANCH_NONE;
+        jump->destination.str_val = label;
+        lay->jumps[block->id]     = jump;
+    }
+    return true;
+}
+
+/**
+ * @brief Links the commands of the blocks in their new order, applying the
+ * planned fixups and dropping branches to the block placed next.
+ *
+ * @param lay The layout.
+ * @param commands The first command of the program; updated.
+ * @param stats Receives what changed.
+ */
+static void relink(Layout *lay, Command **commands, LayoutStats *stats) {
+    Command **tail = commands;
+    for (int i = 0; i < lay->cfg.count; i++) {
+        BasicBlock *block = &lay->cfg.blocks[lay->order[i]];
+        BasicBlock *next  = i + 1 < lay->cfg.count ? &lay->cfg.blocks[lay->order[i + 1]] : NULL;
+        Command    *last  = block->last;
+        if (i > 0 && lay->order[i] != lay->order[i - 1] + 1) {
+            stats->blocks_moved++;
+        }
+
+        *tail = block->first;
+        for (Command *cmd = block->first; cmd != last; cmd = cmd->next) {
+            tail = &cmd->next;
+        }
+
+        if (last->type == CMD_BRANCH && last->branch_condition == BRANCH_NONE &&
+            block->taken && block->taken == next && block->length > 1) {
+            // Only a block's leader carries labels, so the branch can go
+            last->next = NULL;
+            free_command(last);
+            block->last = NULL;
+            stats->jumps_removed++;
+        } else {
+            tail = &last->next;
+        }
+
+        if (lay->targets[block->id]) {
+            free(last->destination.str_val);
+            last->destination.str_val = lay->targets[block->id];
+            last->branch_condition    = inverse(last->branch_condition);
+            lay->targets[block->id]   = NULL;
+            stats->branches_inverted++;
+        }
+        if (lay->jumps[block->id]) {
+            *tail                 = lay->jumps[block->id];
+            tail                  = &lay->jumps[block->id]->next;
+            lay->jumps[block->id] = NULL;
+            stats->jumps_inserted++;
+        }
+    }
+    *tail = NULL;
+}
@@ -2,11 +2,21 @@
 
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "token_type.h"
 
-static const char *BAD_BASE_MSG = "Either no or invalid digit in the specified base";
+/**
+ * @brief Messages carried by error tokens, indexed by the enum below.
+ */
+static const char *const error_messages[] = {
+    "Either no or invalid digit in the specified base",
+    "Unexpected character",
+    "Unterminated string",
+};
+
+enum { BAD_BASE_MSG, UNEXPECTED_CHAR_MSG, UNTERMINATED_STRING_MSG, NUM_ERROR_MESSAGES };
 
 /**
  * @brief Structure representing a keyword and its corresponding token type.
@@ -29,6 +39,9 @@ static const Keyword keywords[] = {
     {"lsl", 3, TOK_LSL},         {"lsr", 3, TOK_LSR},        {"mov", 3, TOK_MOV},
     {"orr", 3, TOK_ORR},         {"print", 5, TOK_PRINT},    {"put", 3, TOK_PUT},
     {"ret", 3, TOK_RET},         {"store", 5, TOK_STORE},    {"sub", 3, TOK_SUB},
+    {"ccall", 5, TOK_CCALL},     {"alloc", 5, TOK_ALLOC},    {"free", 4, TOK_FREE},
+    {"realloc", 7, TOK_REALLOC}, {"push", 4, TOK_PUSH},       {"pop", 3, TOK_POP},
+    {"write", 5, TOK_WRITE},     {"read", 4, TOK_READ},
 };
 
 // Calculate on the fly so you only have to modify the array
@@ -41,7 +54,7 @@ static char peek_next(Lexer *lex);
 static void skip_whitespace(Lexer *lex);
 
 static Token make_token(Lexer *lex, TokenType tok_type);
-static Token error_token(Lexer *lex, const char *message);
+static Token error_token(Lexer *lex, int message);
 
 static Token     make_ident(Lexer *lex);
 static TokenType ident_type(Lexer *lex);
@@ -55,6 +68,8 @@ static bool is_digit(char c);
 static bool is_hex(char c);
 static bool is_binary(char c);
 
+static bool token_array_reserve(TokenArray *tokens, int capacity);
+
 void lexer_init(Lexer *lex, const char *text) {
     if (!lex) {
         return;
@@ -107,13 +122,13 @@ static Token make_token(Lexer *lex, TokenType tok_type) {
  * @brief Creates an error token with the given message.
  *
  * @param lex A pointer to the lexer, the input stream.
- * @param message The error message this token should contain.
+ * @param message Index of the error message this token should contain.
  * @return The error token.
  */
-static Token error_token(Lexer *lex, const char *message) {
+static Token error_token(Lexer *lex, int message) {
     Token token;
-    token_init(&token, TOK_ERR, message, strlen(message), lex->current_line,
-               lex->current_column - 1);
+    token_init(&token, TOK_ERR, error_messages[message], strlen(error_messages[message]),
+               lex->current_line, lex->current_column - 1);
     return token;
 }
 
@@ -172,11 +187,17 @@ Token lexer_next_token(Lexer *lex) {
         return t;
     } else if (c == ':') {
         return make_token(lex, TOK_COLON);
+    } else if (c == '{') {
+        return make_token(lex, TOK_LBRACE);
+    } else if (c == '}') {
+        return make_token(lex, TOK_RBRACE);
+    } else if (c == '-') {
+        return make_token(lex, TOK_DASH);
     } else if (c == '"') {
         return make_string(lex);
     }
 
-    return error_token(lex, "Unexpected character");
+    return error_token(lex, UNEXPECTED_CHAR_MSG);
 }
 
 /**
@@ -369,7 +390,8 @@ static Token make_hex(Lexer *lex) {
  * @brief Parses a string from the input stream
  *
  * @param lex A pointer to the lexer, the input stream.
- * @return A token representing this string, excluding the quotes
+ * @return A token representing this string, excluding the quotes, or an error
+ * token if the string is not closed
  */
 static Token make_string(Lexer *lex) {
     while (peek(lex) != '"' && !is_at_end(lex)) {
@@ -381,6 +403,11 @@ static Token make_string(Lexer *lex) {
         advance(lex);
     }
 
+    // Never step past the terminator of an unclosed string
+    if (is_at_end(lex)) {
+        return error_token(lex, UNTERMINATED_STRING_MSG);
+    }
+
     // We do a hack here to avoid storing the quotes
     lex->start_position++;
     Token t = make_token(lex, TOK_STR);
@@ -399,3 +426,129 @@ void print_lexed_tokens(Lexer *lex) {
         }
     }
 }
+
+bool lexer_tokenize(Lexer *lex, TokenArray *tokens) {
+    memset(tokens, 0, sizeof(*tokens));
+    tokens->text = lex->current_position;
+
+    size_t size = strlen(lex->current_position);
+    if (size > UINT32_MAX) {
+        return false;
+    }
+
+    // Most tokens span a few characters, so this rarely has to grow
+    if (!token_array_reserve(tokens, (int) (size / 4) + 16)) {
+        return false;
+    }
+
+    for (;;) {
+        if (tokens->count == tokens->capacity &&
+            !token_array_reserve(tokens, tokens->capacity * 2)) {
+            return false;
+        }
+
+        Token    t = lexer_next_token(lex);
+        uint32_t offset;
+        if (t.type == TOK_ERR) {
+            offset = 0;
+            while (offset < NUM_ERROR_MESSAGES && error_messages[offset] != t.lexeme) {
+                offset++;
+            }
+        } else {
+            offset = (uint32_t) (t.lexeme - tokens->text);
+        }
+
+        int i              = tokens->count++;
+        tokens->types[i]   = (uint8_t) t.type;
+        tokens->offsets[i] = offset;
+        tokens->lengths[i] = (uint32_t) t.length;
+        tokens->lines[i]   = (uint32_t) t.line;
+        tokens->columns[i] = (uint32_t) t.column;
+        if (t.type == TOK_EOF) {
+            return true;
+        }
+    }
+}
+
+Token token_array_get(const TokenArray *tokens, int index) {
+    if (index >= tokens->count) {
+        index = tokens->count - 1;
+    }
+
+    Token       t;
+    TokenType   type   = (TokenType) tokens->types[index];
+    const char *lexeme = type == TOK_ERR ? error_messages[tokens->offsets[index]]
+                                         : tokens->text + tokens->offsets[index];
+    token_init(&t, type, lexeme, (int) tokens->lengths[index], (int) tokens->lines[index],
+               (int) tokens->columns[index]);
+    return t;
+}
+
+bool token_array_push(TokenArray *tokens, TokenType type, uint32_t offset, uint32_t length,
+                      uint32_t line, uint32_t column) {
+    if (tokens->count == tokens->capacity &&
+        !token_array_reserve(tokens, tokens->capacity ? tokens->capacity * 2 : 64)) {
+        return false;
+    }
+
+    int i              = tokens->count++;
+    tokens->types[i]   = (uint8_t) type;
+    tokens->offsets[i] = offset;
+    tokens->lengths[i] = length;
+    tokens->lines[i]   = line;
+    tokens->columns[i] = column;
+    return true;
+}
+
+void token_array_free(TokenArray *tokens) {
+    if (!tokens) {
+        return;
+    }
+
+    free(tokens->owned_text);
+    free(tokens->types);
+    free(tokens->offsets);
+    free(tokens->lengths);
+    free(tokens->lines);
+    free(tokens->columns);
+    memset(tokens, 0, sizeof(*tokens));
+}
+
+void print_token_array(const TokenArray *tokens) {
+    for (int i = 0; i < tokens->count; i++) {
+        Token t = token_array_get(tokens, i);
+        print_token(t);
+        if (t.type == TOK_ERR || t.type == TOK_EOF) {
+            break;
+        }
+        printf("\n");
+    }
+}
+
+/**
+ * @brief Grows every array of a token array to the given capacity.
+ *
+ * @param tokens The token array to grow.
+ * @param capacity The new capacity; must not be smaller than the current one.
+ * @return True on success, false if memory ran out. The arrays that were
+ * already grown stay valid either way.
+ */
+static bool token_array_reserve(TokenArray *tokens, int capacity) {
+    uint8_t *types = realloc(tokens->types, capacity * sizeof(uint8_t));
+    if (!types) {
+        return false;
+    }
+    tokens->types = types;
+
+    uint32_t **fields[] = {&tokens->offsets, &tokens->lengths, &tokens->lines, &tokens->columns};
+    for (size_t f = 0; f < sizeof(fields) / sizeof(fields[0]); f++) {
+        uint32_t *grown = realloc(*fields[f], capacity * sizeof(uint32_t));
+        if (!grown) {
+            return false;
+        }
+        *fields[f] = grown;
+    }
+
+    tokens->capacity = capacity;
+    return true;
+}
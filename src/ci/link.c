@@ -0,0 +1,1352 @@
+#define _XOPEN_SOURCE 700
+#include "link.h"
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "builtin.h"
+#include "macro.h"
+#include "parser.h"
+#include "token_type.h"
+
+#define OBJECT_MAGIC "CIOBJ01\n"   // Changes whenever the object layout does
+#define OBJECT_MAGIC_LENGTH 8
+#define NO_COMMAND UINT32_MAX      // Command index of an .extern symbol
+#define MODULE_LABEL_BUCKETS 64    // Label buckets used while compiling a module
+
+#define SYM_GLOBAL 1u  // Exported by .global
+#define SYM_EXTERN 2u  // Declared by .extern, defined elsewhere
+
+#define OP_A_IMMEDIATE 1u  // is_a_immediate
+#define OP_B_IMMEDIATE 2u  // is_b_immediate
+#define OP_A_STRING 4u     // is_a_string
+#define OP_B_STRING 8u     // is_b_string
+
+#define BIT(type) (1u << (type))
+// Commands whose destination, operand A or operand B names a register, unless
+// the operand is flagged immediate
+#define DEST_REGISTER                                                                        \
+    (BIT(CMD_ADD) | BIT(CMD_SUB) | BIT(CMD_AND) | BIT(CMD_EOR) | BIT(CMD_ORR) | BIT(CMD_ASR) | \
+     BIT(CMD_LSL) | BIT(CMD_LSR) | BIT(CMD_MOV) | BIT(CMD_CMP) | BIT(CMD_CMP_U) |              \
+     BIT(CMD_LOAD) | BIT(CMD_STORE) | BIT(CMD_ALLOC) | BIT(CMD_REALLOC))
+#define A_REGISTER                                                                           \
+    (BIT(CMD_ADD) | BIT(CMD_SUB) | BIT(CMD_AND) | BIT(CMD_EOR) | BIT(CMD_ORR) | BIT(CMD_ASR) | \
+     BIT(CMD_LSL) | BIT(CMD_LSR) | BIT(CMD_CMP) | BIT(CMD_CMP_U) | BIT(CMD_STORE) |            \
+     BIT(CMD_PRINT) | BIT(CMD_ALLOC) | BIT(CMD_FREE) | BIT(CMD_REALLOC) | BIT(CMD_PUSH) |      \
+     BIT(CMD_POP) | BIT(CMD_WRITE) | BIT(CMD_READ))
+#define B_REGISTER \
+    (BIT(CMD_ADD) | BIT(CMD_SUB) | BIT(CMD_AND) | BIT(CMD_EOR) | BIT(CMD_ORR) | BIT(CMD_LOAD) | \
+     BIT(CMD_PUT) | BIT(CMD_REALLOC) | BIT(CMD_PUSH) | BIT(CMD_POP) | BIT(CMD_WRITE) | \
+     BIT(CMD_READ))
+
+/**
+ * @brief A command of an object file.
+ *
+ * String operands (branch and call targets, put's string) are offsets into
+ * the object's string table.
+ */
+typedef struct {
+    uint8_t type;         // CommandType
+    int8_t  condition;    // BranchCondition
+    uint8_t flags;        // OP_* flags
+    int64_t operands[3];  // destination, val_a and val_b
+} ObjCommand;
+
+/**
+ * @brief A label an object defines or declares.
+ */
+typedef struct {
+    uint32_t name;     // Offset of the label in the string table
+    uint32_t command;  // Index of the labelled command, or NO_COMMAND
+    uint32_t flags;    // SYM_* flags
+} ObjSymbol;
+
+/**
+ * @brief A reference to a label the object does not define.
+ */
+typedef struct {
+    uint32_t command;  // Index of the referencing command
+    uint32_t name;     // Offset of the label in the string table
+} ObjReloc;
+
+/**
+ * @brief A compiled module, as stored in an object file.
+ *
+ * Objects are written in the host's byte order and are only meant to be read
+ * back on the machine that wrote them.
+ */
+typedef struct {
+    char       *source;           // Canonical path of the source, or "" if unknown
+    uint64_t    source_size;      // Size of the source when it was compiled
+    int64_t     source_mtime;     // Modification time of the source, in nanoseconds
+    ObjCommand *commands;         // Commands, in program order
+    uint32_t    command_count;    // Number of commands
+    ObjSymbol  *symbols;          // Defined and declared labels
+    uint32_t    symbol_count;     // Number of symbols
+    ObjReloc   *relocs;           // References to labels defined elsewhere
+    uint32_t    reloc_count;      // Number of relocations
+    uint32_t   *includes;         // String table offsets of included paths
+    uint32_t    include_count;    // Number of includes
+    char       *strings;          // NUL-terminated strings, back to back
+    uint32_t    string_size;      // Bytes used in `strings`
+    uint32_t    string_capacity;  // Bytes allocated for `strings`
+} Object;
+
+/**
+ * @brief A library module taking part in a link.
+ */
+typedef struct {
+    char  *path;    // Canonical path of the module
+    Object object;  // The module's compiled form
+} Module;
+
+/**
+ * @brief The state of one link.
+ */
+typedef struct {
+    const char  *main_path;  // Canonical path of the program, or NULL
+    Module      *modules;    // Library modules, in load order
+    int          count;      // Number of modules
+    int          capacity;   // Allocated slots in `modules`
+    LinkOptions *options;    // Settings and statistics
+} Link;
+
+static bool  link_error(const char *format, ...) __attribute__((format(printf, 1, 2)));
+static char *copy_string(const char *s, size_t length);
+static bool  push_string(char ***list, int *count, const char *s, size_t length);
+static int   directive_line_end(const TokenArray *tokens, int index);
+static bool  token_is(const TokenArray *tokens, int index, const char *text);
+static bool  push_import(LinkDirectives *dirs, const TokenArray *tokens, int index, int stop);
+
+static bool     load_module(Link *link, const char *path, const char *from);
+static char    *resolve_path(const char *path, const char *from);
+static char    *cache_path(const char *cache_dir, const char *canonical);
+static bool     compile_source(const char *src, const char *path, Object *obj);
+static bool     compile_commands(Command *commands, LabelMap *map, const LinkDirectives *dirs,
+                                 Object *obj);
+static bool     object_add_string(Object *obj, const char *s, uint32_t *offset);
+static bool     write_array(const void *data, size_t size, uint32_t count, FILE *file);
+static bool     object_write(const Object *obj, const char *path);
+static bool     object_read(const char *path, Object *obj);
+static bool     object_valid(const Object *obj);
+static bool     is_register(int64_t operand);
+static bool     has_label(LabelMap *map, const char *name);
+static void     object_free(Object *obj);
+static bool     is_exported(const Link *link, const LinkDirectives *dirs, const char *name,
+                            int *owner);
+static bool     check_symbols(const Link *link, const LinkDirectives *dirs, LabelMap *map);
+static bool     instantiate(const Module *module, int index, Command **tail, LabelMap *map);
+static Command *command_from_object(const Object *obj, const ObjCommand *oc,
+                                    LabelMap *locals, int index);
+static char    *local_name(const char *name, int index);
+
+bool link_collect_directives(TokenArray *tokens, LinkDirectives *dirs) {
+    memset(dirs, 0, sizeof(*dirs));
+
+    int kept = 0;
+    int i    = 0;
+    while (i < tokens->count) {
+        int  stop = directive_line_end(tokens, i);
+        bool include = token_is(tokens, i, ".include");
+        bool global  = token_is(tokens, i, ".global");
+        bool ext     = token_is(tokens, i, ".extern");
+        bool import  = token_is(tokens, i, ".import");
+        bool mode    = token_is(tokens, i, ".callmode");
+        bool nomemo  = token_is(tokens, i, ".nomemo");
+
+        if (include) {
+            if (stop != i + 2 || tokens->types[i + 1] != TOK_STR) {
+                return link_error("On line %u: expected a path after .include",
+                                  tokens->lines[i]);
+            }
+            if (!push_string(&dirs->includes, &dirs->include_count,
+                             tokens->text + tokens->offsets[i + 1], tokens->lengths[i + 1])) {
+                return link_error("Out of memory");
+            }
+        } else if (global || ext || nomemo) {
+            const char *name  = global ? ".global" : ext ? ".extern" : ".nomemo";
+            char     ***list  = global ? &dirs->globals : ext ? &dirs->externs : &dirs->nomemo;
+            int        *count = global ? &dirs->global_count
+                                       : ext ? &dirs->extern_count : &dirs->nomemo_count;
+            if (stop == i + 1) {
+                return link_error("On line %u: expected labels after %s", tokens->lines[i],
+                                  name);
+            }
+            for (int j = i + 1; j < stop; j++) {
+                if (!token_is_name((TokenType) tokens->types[j])) {
+                    return link_error("On line %u: expected a label", tokens->lines[j]);
+                }
+                if (!push_string(list, count, tokens->text + tokens->offsets[j],
+                                 tokens->lengths[j])) {
+                    return link_error("Out of memory");
+                }
+            }
+        } else if (import && !push_import(dirs, tokens, i, stop)) {
+            return false;
+        } else if (mode) {
+            bool frame = stop == i + 2 && token_is(tokens, i + 1, "frame");
+            if (!frame && (stop != i + 2 || !token_is(tokens, i + 1, "return"))) {
+                return link_error("On line %u: expected frame or return after .callmode",
+                                  tokens->lines[i]);
+            }
+            dirs->has_call_mode = true;
+            dirs->return_calls  = !frame;
+        }
+
+        // Directive lines are dropped; everything else is compacted in place
+        int next = stop < tokens->count && tokens->types[stop] == TOK_NL ? stop + 1 : stop;
+        if (!include && !global && !ext && !import && !mode && !nomemo) {
+            if (next == i) {
+                next = i + 1;  // The final TOK_EOF
+            }
+            for (int j = i; j < next; j++, kept++) {
+                tokens->types[kept]   = tokens->types[j];
+                tokens->offsets[kept] = tokens->offsets[j];
+                tokens->lengths[kept] = tokens->lengths[j];
+                tokens->lines[kept]   = tokens->lines[j];
+                tokens->columns[kept] = tokens->columns[j];
+            }
+        }
+        i = next;
+    }
+    tokens->count = kept;
+    return true;
+}
+
+bool link_directives_empty(const LinkDirectives *dirs) {
+    return dirs->include_count == 0 && dirs->global_count == 0 && dirs->extern_count == 0;
+}
+
+void link_directives_free(LinkDirectives *dirs) {
+    for (int i = 0; i < dirs->import_count; i++) {
+        free(dirs->imports[i].library);
+        free(dirs->imports[i].symbol);
+        free(dirs->imports[i].signature);
+    }
+    free(dirs->imports);
+
+    char **lists[]  = {dirs->includes, dirs->globals, dirs->externs, dirs->nomemo};
+    int    counts[] = {dirs->include_count, dirs->global_count, dirs->extern_count,
+                       dirs->nomemo_count};
+    for (int l = 0; l < 4; l++) {
+        for (int i = 0; i < counts[l]; i++) {
+            free(lists[l][i]);
+        }
+        free(lists[l]);
+    }
+    memset(dirs, 0, sizeof(*dirs));
+}
+
+bool link_program(Command **commands, LabelMap *map, const LinkDirectives *dirs,
+                  const char *path, LinkOptions *options) {
+    Link link;
+    memset(&link, 0, sizeof(link));
+    link.options     = options;
+    options->modules = 0;
+    options->cached  = 0;
+
+    char *main_path = path ? realpath(path, NULL) : NULL;
+    link.main_path  = main_path;
+
+    bool ok = true;
+    for (int i = 0; ok && i < dirs->include_count; i++) {
+        ok = load_module(&link, dirs->includes[i], path);
+    }
+    ok = ok && check_symbols(&link, dirs, map);
+
+    if (ok && link.count > 0) {
+        // The program still ends where it used to fall off its last command
+        Command **tail = commands;
+        while (*tail) {
+            tail = &(*tail)->next;
+        }
+        *tail = calloc(1, sizeof(Command));
+        if (!*tail) {
+            ok = link_error("Out of memory");
+        } else {
+            (*tail)->type             = CMD_HALT;
+            (*tail)->branch_condition = BRANCH_NONE;
+            tail                      = &(*tail)->next;
+        }
+
+        for (int m = 0; ok && m < link.count; m++) {
+            ok = instantiate(&link.modules[m], m + 1, tail, map);
+            while (*tail) {
+                tail = &(*tail)->next;
+            }
+        }
+    }
+    options->modules = link.count;
+
+    for (int m = 0; m < link.count; m++) {
+        free(link.modules[m].path);
+        object_free(&link.modules[m].object);
+    }
+    free(link.modules);
+    free(main_path);
+    return ok;
+}
+
+bool link_builtins(Command *commands) {
+    for (Command *c = commands; c; c = c->next) {
+        if (c->type != CMD_CALL || !builtin_reserved(c->destination.str_val)) {
+            continue;
+        }
+        int builtin = builtin_lookup(c->destination.str_val);
+        if (builtin < 0) {
+            return link_error("Unknown builtin %s", c->destination.str_val);
+        }
+        c->type           = CMD_BUILTIN;
+        c->val_a.num_val  = builtin;
+        c->is_a_immediate   = true;
+    }
+    return true;
+}
+
+bool link_imports(Command *commands, const LinkDirectives *dirs, const char *path,
+                  FfiTable *ffi) {
+    for (int i = 0; i < dirs->import_count; i++) {
+        const LinkImport *import = &dirs->imports[i];
+        char             *library = strchr(import->library, '/')
+                                        ? resolve_path(import->library, path)
+                                        : copy_string(import->library, strlen(import->library));
+        if (!library) {
+            return link_error("Out of memory");
+        }
+
+        const char *error;
+        bool        ok = ffi_import(ffi, library, import->symbol, import->signature, &error);
+        free(library);
+        if (!ok) {
+            return link_error("Could not import %s from %s: %s", import->symbol,
+                              import->library, error);
+        }
+    }
+
+    for (Command *c = commands; c; c = c->next) {
+        if (c->type != CMD_CCALL) {
+            continue;
+        }
+        int index = ffi_lookup(ffi, c->destination.str_val);
+        if (index < 0) {
+            return link_error("Function %s was not imported", c->destination.str_val);
+        }
+        c->val_a.num_val  = index;
+        c->is_a_immediate = true;
+    }
+    return true;
+}
+
+bool link_emit_object(const char *src, const char *path, const char *object_path) {
+    Object obj;
+    if (!compile_source(src, path, &obj)) {
+        object_free(&obj);
+        return false;
+    }
+
+    bool ok = object_write(&obj, object_path);
+    object_free(&obj);
+    if (!ok) {
+        return link_error("Could not write %s", object_path);
+    }
+    return true;
+}
+
+/**
+ * @brief Prints a linker error.
+ *
+ * @param format The printf format of the message.
+ * @return Always false.
+ */
+static bool link_error(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    printf("Linker encountered an error:\n");
+    vprintf(format, args);
+    printf("\n");
+    va_end(args);
+    return false;
+}
+
+/**
+ * @brief Copies the first characters of a string.
+ *
+ * @param s The characters to copy.
+ * @param length The number of characters.
+ * @return The NUL-terminated copy, or NULL if allocation failed.
+ */
+static char *copy_string(const char *s, size_t length) {
+    char *copy = malloc(length + 1);
+    if (!copy) {
+        return NULL;
+    }
+    memcpy(copy, s, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+/**
+ * @brief Appends a copy of a string to a list.
+ *
+ * @param list The list to extend.
+ * @param count The list's length, incremented on success.
+ * @param s The characters to copy.
+ * @param length The number of characters.
+ * @return True on success, false if allocation failed.
+ */
+static bool push_string(char ***list, int *count, const char *s, size_t length) {
+    char **grown = realloc(*list, (size_t) (*count + 1) * sizeof(char *));
+    if (!grown) {
+        return false;
+    }
+    *list = grown;
+
+    char *copy = copy_string(s, length);
+    if (!copy) {
+        return false;
+    }
+    grown[(*count)++] = copy;
+    return true;
+}
+
+/**
+ * @brief Finds the token ending the line a token is on.
+ *
+ * @param tokens The tokens to scan.
+ * @param index Index of a token of the line.
+ * @return Index of the line's TOK_NL or of the final TOK_EOF.
+ */
+static int directive_line_end(const TokenArray *tokens, int index) {
+    while (index < tokens->count && tokens->types[index] != TOK_NL &&
+           tokens->types[index] != TOK_EOF) {
+        index++;
+    }
+    return index;
+}
+
+/**
+ * @brief Determines whether a token is the identifier `text`.
+ *
+ * @param tokens The tokens.
+ * @param index Index of the token.
+ * @param text The identifier to compare with.
+ * @return True if the token spells `text`.
+ */
+static bool token_is(const TokenArray *tokens, int index, const char *text) {
+    size_t length = strlen(text);
+    return tokens->types[index] == TOK_IDENT && tokens->lengths[index] == length &&
+           memcmp(tokens->text + tokens->offsets[index], text, length) == 0;
+}
+
+/**
+ * @brief Records an .import directive.
+ *
+ * @param dirs The directives to add the import to.
+ * @param tokens The module's tokens.
+ * @param index Index of the .import token.
+ * @param stop Index of the token ending the directive's line.
+ * @return True on success, false if an error was printed.
+ */
+static bool push_import(LinkDirectives *dirs, const TokenArray *tokens, int index, int stop) {
+    int count = stop - index;
+    if ((count != 3 && count != 4) ||
+        (tokens->types[index + 1] != TOK_IDENT && tokens->types[index + 1] != TOK_STR) ||
+        !token_is_name((TokenType) tokens->types[index + 2]) ||
+        (count == 4 && tokens->types[index + 3] != TOK_IDENT &&
+         tokens->types[index + 3] != TOK_STR)) {
+        return link_error("On line %u: expected a library, a function and an optional "
+                          "signature after .import",
+                          tokens->lines[index]);
+    }
+
+    LinkImport *imports =
+        realloc(dirs->imports, (size_t) (dirs->import_count + 1) * sizeof(LinkImport));
+    if (!imports) {
+        return link_error("Out of memory");
+    }
+    dirs->imports = imports;
+
+    LinkImport *import = &imports[dirs->import_count];
+    const char *text   = tokens->text;
+    import->library    = copy_string(text + tokens->offsets[index + 1], tokens->lengths[index + 1]);
+    import->symbol     = copy_string(text + tokens->offsets[index + 2], tokens->lengths[index + 2]);
+    import->signature  = count == 4 ? copy_string(text + tokens->offsets[index + 3],
+                                                   tokens->lengths[index + 3])
+                                    : copy_string("", 0);
+    dirs->import_count++;
+    if (!import->library || !import->symbol || !import->signature) {
+        return link_error("Out of memory");
+    }
+    return true;
+}
+
+/**
+ * @brief Loads a module and, recursively, the modules it includes.
+ *
+ * Each module is loaded once, however often it is included. Modules whose
+ * name ends in `.cio` are read as object files; other modules are compiled
+ * from source unless the cache holds an up-to-date object for them.
+ *
+ * @param link The link state.
+ * @param path The path as written in the .include directive.
+ * @param from Path of the including module, or NULL.
+ * @return True on success, false if an error was printed.
+ */
+static bool load_module(Link *link, const char *path, const char *from) {
+    char *resolved = resolve_path(path, from);
+    if (!resolved) {
+        return link_error("Out of memory");
+    }
+    char *canonical = realpath(resolved, NULL);
+    free(resolved);
+    if (!canonical) {
+        return link_error("Could not open included module %s", path);
+    }
+
+    if (link->main_path && strcmp(canonical, link->main_path) == 0) {
+        free(canonical);
+        return true;
+    }
+    for (int m = 0; m < link->count; m++) {
+        if (strcmp(link->modules[m].path, canonical) == 0) {
+            free(canonical);
+            return true;
+        }
+    }
+
+    if (link->count == link->capacity) {
+        int     capacity = link->capacity ? link->capacity * 2 : 4;
+        Module *modules  = realloc(link->modules, (size_t) capacity * sizeof(Module));
+        if (!modules) {
+            free(canonical);
+            return link_error("Out of memory");
+        }
+        link->modules  = modules;
+        link->capacity = capacity;
+    }
+
+    // Registered before its includes are loaded so include cycles terminate
+    int index                    = link->count++;
+    link->modules[index].path    = canonical;
+    Object *obj                  = &link->modules[index].object;
+    memset(obj, 0, sizeof(*obj));
+
+    size_t length = strlen(canonical);
+    if (length > 4 && strcmp(canonical + length - 4, ".cio") == 0) {
+        if (!object_read(canonical, obj)) {
+            return link_error("%s is not a valid object file", path);
+        }
+    } else {
+        struct stat st;
+        if (stat(canonical, &st) != 0) {
+            return link_error("Could not open included module %s", path);
+        }
+        int64_t mtime = (int64_t) st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+
+        const char *cache_dir = link->options->cache_dir;
+        char       *cached    = cache_path(cache_dir, canonical);
+        if (cached && object_read(cached, obj) && strcmp(obj->source, canonical) == 0 &&
+            obj->source_size == (uint64_t) st.st_size && obj->source_mtime == mtime) {
+            link->options->cached++;
+        } else {
+            object_free(obj);
+            FILE *file = fopen(canonical, "rb");
+            char *src  = calloc((size_t) st.st_size + 1, 1);
+            bool  read = file && src && fread(src, 1, (size_t) st.st_size, file) ==
+                                                (size_t) st.st_size;
+            if (file) {
+                fclose(file);
+            }
+            if (!read) {
+                free(src);
+                free(cached);
+                return link_error("Could not read included module %s", path);
+            }
+
+            bool compiled = compile_source(src, canonical, obj);
+            free(src);
+            if (!compiled) {
+                free(cached);
+                return false;
+            }
+            free(obj->source);
+            obj->source       = copy_string(canonical, length);
+            obj->source_size  = (uint64_t) st.st_size;
+            obj->source_mtime = mtime;
+
+            // A missing or read-only cache only costs a recompile next time
+            if (cached && obj->source && (mkdir(cache_dir, 0777) == 0 || errno == EEXIST)) {
+                object_write(obj, cached);
+            }
+        }
+        free(cached);
+    }
+
+    for (uint32_t i = 0; i < obj->include_count; i++) {
+        // `obj` may move while the includes are loaded
+        const char *include = link->modules[index].object.strings +
+                              link->modules[index].object.includes[i];
+        char *copy = copy_string(include, strlen(include));
+        bool  ok   = copy && load_module(link, copy, link->modules[index].path);
+        free(copy);
+        if (!ok) {
+            return copy ? false : link_error("Out of memory");
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Resolves an included path relative to the including module.
+ *
+ * @param path The path as written.
+ * @param from Path of the including module, or NULL for the working directory.
+ * @return The resolved path, or NULL if allocation failed.
+ */
+static char *resolve_path(const char *path, const char *from) {
+    const char *slash = from ? strrchr(from, '/') : NULL;
+    if (path[0] == '/' || !slash) {
+        return copy_string(path, strlen(path));
+    }
+
+    size_t dir_length = (size_t) (slash - from) + 1;
+    char  *resolved   = malloc(dir_length + strlen(path) + 1);
+    if (!resolved) {
+        return NULL;
+    }
+    memcpy(resolved, from, dir_length);
+    strcpy(resolved + dir_length, path);
+    return resolved;
+}
+
+/**
+ * @brief Names the cache entry of a module.
+ *
+ * @param cache_dir The cache directory, or NULL if caching is disabled.
+ * @param canonical The canonical path of the module's source.
+ * @return The path of the cached object, or NULL.
+ */
+static char *cache_path(const char *cache_dir, const char *canonical) {
+    if (!cache_dir) {
+        return NULL;
+    }
+
+    // FNV-1a of the source path; collisions are caught by the stored path
+    uint64_t hash = 0xcbf29ce484222325u;
+    for (const char *c = canonical; *c; c++) {
+        hash = (hash ^ (uint8_t) *c) * 0x100000001b3u;
+    }
+
+    size_t length = strlen(cache_dir) + 1 + 16 + 4 + 1;
+    char  *path   = malloc(length);
+    if (path) {
+        snprintf(path, length, "%s/%016llx.cio", cache_dir, (unsigned long long) hash);
+    }
+    return path;
+}
+
+/**
+ * @brief Compiles a module's source into an object.
+ *
+ * @param src The module's source text.
+ * @param path The module's path, used in error messages.
+ * @param obj The object to fill. Must be released with `object_free`, even on
+ * failure.
+ * @return True on success, false if an error was printed.
+ */
+static bool compile_source(const char *src, const char *path, Object *obj) {
+    memset(obj, 0, sizeof(*obj));
+
+    Lexer      l;
+    TokenArray tokens;
+    lexer_init(&l, src);
+    if (!lexer_tokenize(&l, &tokens)) {
+        token_array_free(&tokens);
+        return link_error("Out of memory while lexing %s", path);
+    }
+
+    MacroError macro_error;
+    if (!expand_macros(&tokens, &macro_error)) {
+        token_array_free(&tokens);
+        return link_error("In %s, on line %u: %s", path, macro_error.line, macro_error.message);
+    }
+
+    LinkDirectives dirs;
+    if (!link_collect_directives(&tokens, &dirs)) {
+        link_directives_free(&dirs);
+        token_array_free(&tokens);
+        return false;
+    }
+
+    if (dirs.import_count > 0 || dirs.has_call_mode || dirs.nomemo_count > 0) {
+        const char *directive = dirs.has_call_mode ? ".callmode"
+                                : dirs.nomemo_count > 0 ? ".nomemo" : ".import";
+        link_directives_free(&dirs);
+        token_array_free(&tokens);
+        return link_error("In %s: %s is only allowed in the main program", path, directive);
+    }
+
+    LabelMap map;
+    if (!label_map_init(&map, MODULE_LABEL_BUCKETS)) {
+        link_directives_free(&dirs);
+        token_array_free(&tokens);
+        return link_error("Out of memory");
+    }
+
+    Parser p;
+    parser_init(&p, &tokens, &map);
+    Command *commands = parse_commands(&p);
+
+    bool ok = true;
+    if (p.had_error) {
+        printf("Parser encountered an error in %s:\n", path);
+        printf("At ");
+        print_token(p.current);
+        printf("\n");
+        ok = false;
+    }
+    token_array_free(&tokens);
+
+    ok = ok && compile_commands(commands, &map, &dirs, obj);
+    for (int i = 0; ok && i < dirs.include_count; i++) {
+        uint32_t offset;
+        uint32_t *includes = realloc(obj->includes, (obj->include_count + 1) * sizeof(uint32_t));
+        ok                 = includes && object_add_string(obj, dirs.includes[i], &offset);
+        if (includes) {
+            obj->includes = includes;
+        }
+        if (ok) {
+            obj->includes[obj->include_count++] = offset;
+        } else {
+            link_error("Out of memory");
+        }
+    }
+
+    free_command(commands);
+    label_map_free(&map);
+    link_directives_free(&dirs);
+    if (ok && !obj->source && !(obj->source = copy_string("", 0))) {
+        ok = link_error("Out of memory");
+    }
+    return ok;
+}
+
+/**
+ * @brief Compares two command pointers, for sorting.
+ */
+static int compare_commands(const void *a, const void *b) {
+    const Command *x = *(Command *const *) a;
+    const Command *y = *(Command *const *) b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Finds the index of a command in a list sorted by address.
+ *
+ * @param sorted Pairs of command pointer and program index, sorted by pointer.
+ * @param count Number of pairs.
+ * @param command The command to look up.
+ * @return The command's program index, or NO_COMMAND.
+ */
+static uint32_t command_index(Command **sorted, uint32_t count, Command *command) {
+    Command **found = bsearch(&command, sorted, count, 2 * sizeof(Command *), compare_commands);
+    return found ? (uint32_t) (uintptr_t) found[1] : NO_COMMAND;
+}
+
+/**
+ * @brief Converts a parsed module into an object.
+ *
+ * @param commands The module's commands.
+ * @param map The module's labels.
+ * @param dirs The module's directives.
+ * @param obj The object to fill.
+ * @return True on success, false if an error was printed.
+ */
+static bool compile_commands(Command *commands, LabelMap *map, const LinkDirectives *dirs,
+                             Object *obj) {
+    uint32_t count = 0;
+    for (Command *c = commands; c; c = c->next) {
+        count++;
+    }
+
+    obj->commands = calloc(count ? count : 1, sizeof(ObjCommand));
+    // Pairs of (command, index) sorted by address map labels to indices
+    Command **sorted = calloc(count ? 2 * (size_t) count : 1, sizeof(Command *));
+    if (!obj->commands || !sorted) {
+        free(sorted);
+        return link_error("Out of memory");
+    }
+
+    bool     ok = true;
+    uint32_t i  = 0;
+    for (Command *c = commands; c && ok; c = c->next, i++) {
+        ObjCommand *oc = &obj->commands[i];
+        oc->type       = (uint8_t) c->type;
+        oc->condition  = (int8_t) c->branch_condition;
+        oc->flags      = (uint8_t) ((c->is_a_immediate ? OP_A_IMMEDIATE : 0) |
+                                    (c->is_b_immediate ? OP_B_IMMEDIATE : 0) |
+                                    (c->is_a_string ? OP_A_STRING : 0) |
+                                    (c->is_b_string ? OP_B_STRING : 0));
+        oc->operands[0] = c->destination.num_val;
+        oc->operands[1] = c->val_a.num_val;
+        oc->operands[2] = c->val_b.num_val;
+
+        uint32_t offset = 0;
+        if (c->type == CMD_BRANCH || c->type == CMD_CALL || c->type == CMD_CCALL) {
+            ok              = object_add_string(obj, c->destination.str_val, &offset);
+            oc->operands[0] = offset;
+        } else if (c->type == CMD_PUT) {
+            ok              = object_add_string(obj, c->val_a.str_val, &offset);
+            oc->operands[1] = offset;
+        } else if (c->type == CMD_RET) {
+            oc->operands[0] = 0;
+        }
+
+        sorted[2 * i]     = c;
+        sorted[2 * i + 1] = (Command *) (uintptr_t) i;
+    }
+    obj->command_count = count;
+    qsort(sorted, count, 2 * sizeof(Command *), compare_commands);
+
+    // Labels; duplicates keep the first definition, as the parser does
+    for (int b = 0; ok && b < map->capacity; b++) {
+        for (Entry *e = map->entries[b]; ok && e; e = e->next) {
+            if (!e->id || find_label(map, e->id) != e->command) {
+                continue;
+            }
+            uint32_t flags = 0;
+            for (int g = 0; g < dirs->global_count; g++) {
+                if (strcmp(dirs->globals[g], e->id) == 0) {
+                    flags = SYM_GLOBAL;
+                }
+            }
+
+            ObjSymbol *symbols = realloc(obj->symbols, (obj->symbol_count + 1) * sizeof(ObjSymbol));
+            ok                 = symbols != NULL;
+            if (ok) {
+                obj->symbols     = symbols;
+                ObjSymbol *s     = &obj->symbols[obj->symbol_count++];
+                s->command       = command_index(sorted, count, e->command);
+                s->flags         = flags;
+                ok               = object_add_string(obj, e->id, &s->name);
+            }
+        }
+    }
+    free(sorted);
+    if (!ok) {
+        return link_error("Out of memory");
+    }
+
+    for (int g = 0; g < dirs->global_count; g++) {
+        if (!find_label(map, dirs->globals[g])) {
+            return link_error("Exported label %s is not defined", dirs->globals[g]);
+        }
+    }
+    for (int e = 0; ok && e < dirs->extern_count; e++) {
+        ObjSymbol *symbols = realloc(obj->symbols, (obj->symbol_count + 1) * sizeof(ObjSymbol));
+        ok                 = symbols != NULL;
+        if (ok) {
+            obj->symbols = symbols;
+            ObjSymbol *s = &obj->symbols[obj->symbol_count++];
+            s->command   = NO_COMMAND;
+            s->flags     = SYM_EXTERN;
+            ok           = object_add_string(obj, dirs->externs[e], &s->name);
+        }
+    }
+
+    // Every target the module does not define becomes a relocation
+    i = 0;
+    for (Command *c = commands; c && ok; c = c->next, i++) {
+        if ((c->type != CMD_BRANCH && c->type != CMD_CALL) ||
+            find_label(map, c->destination.str_val) ||
+            (c->type == CMD_CALL && builtin_reserved(c->destination.str_val))) {
+            continue;
+        }
+        ObjReloc *relocs = realloc(obj->relocs, (obj->reloc_count + 1) * sizeof(ObjReloc));
+        ok               = relocs != NULL;
+        if (ok) {
+            obj->relocs = relocs;
+            ObjReloc *r = &obj->relocs[obj->reloc_count++];
+            r->command  = i;
+            r->name     = (uint32_t) obj->commands[i].operands[0];
+        }
+    }
+    return ok || link_error("Out of memory");
+}
+
+/**
+ * @brief Appends a string to an object's string table.
+ *
+ * @param obj The object.
+ * @param s The string to append.
+ * @param offset Set to the string's offset on success.
+ * @return True on success, false if allocation failed.
+ */
+static bool object_add_string(Object *obj, const char *s, uint32_t *offset) {
+    size_t length = strlen(s) + 1;
+    if ((size_t) obj->string_size + length > UINT32_MAX / 2) {
+        return false;
+    }
+    if (obj->string_size + length > obj->string_capacity) {
+        uint32_t capacity = (uint32_t) ((obj->string_size + length) * 2);
+        char    *strings  = realloc(obj->strings, capacity);
+        if (!strings) {
+            return false;
+        }
+        obj->strings         = strings;
+        obj->string_capacity = capacity;
+    }
+
+    *offset = obj->string_size;
+    memcpy(obj->strings + obj->string_size, s, length);
+    obj->string_size += (uint32_t) length;
+    return true;
+}
+
+/**
+ * @brief Writes an array to a file.
+ *
+ * @param data The array; may be NULL if `count` is 0.
+ * @param size The size of one element.
+ * @param count The number of elements.
+ * @param file The file to write to.
+ * @return True if every element was written.
+ */
+static bool write_array(const void *data, size_t size, uint32_t count, FILE *file) {
+    return count == 0 || fwrite(data, size, count, file) == count;
+}
+
+/**
+ * @brief Writes an object file, replacing any existing file atomically.
+ *
+ * @param obj The object to write.
+ * @param path The file to write.
+ * @return True on success, false otherwise.
+ */
+static bool object_write(const Object *obj, const char *path) {
+    size_t length = strlen(path) + 32;
+    char  *tmp    = malloc(length);
+    if (!tmp) {
+        return false;
+    }
+    snprintf(tmp, length, "%s.%ld.tmp", path, (long) getpid());
+
+    FILE *file = fopen(tmp, "wb");
+    if (!file) {
+        free(tmp);
+        return false;
+    }
+
+    uint32_t source_length = (uint32_t) strlen(obj->source ? obj->source : "");
+    uint32_t counts[]      = {source_length,    obj->command_count, obj->symbol_count,
+                              obj->reloc_count, obj->include_count, obj->string_size};
+
+    bool ok = fwrite(OBJECT_MAGIC, 1, OBJECT_MAGIC_LENGTH, file) == OBJECT_MAGIC_LENGTH;
+    ok      = ok && fwrite(&obj->source_size, sizeof(obj->source_size), 1, file) == 1;
+    ok      = ok && fwrite(&obj->source_mtime, sizeof(obj->source_mtime), 1, file) == 1;
+    ok      = ok && fwrite(counts, sizeof(counts), 1, file) == 1;
+    ok      = ok && write_array(obj->source, 1, source_length, file);
+    ok      = ok && write_array(obj->commands, sizeof(ObjCommand), obj->command_count, file);
+    ok      = ok && write_array(obj->symbols, sizeof(ObjSymbol), obj->symbol_count, file);
+    ok      = ok && write_array(obj->relocs, sizeof(ObjReloc), obj->reloc_count, file);
+    ok      = ok && write_array(obj->includes, sizeof(uint32_t), obj->include_count, file);
+    ok      = ok && write_array(obj->strings, 1, obj->string_size, file);
+    ok      = fclose(file) == 0 && ok;
+
+    ok = ok && rename(tmp, path) == 0;
+    if (!ok) {
+        remove(tmp);
+    }
+    free(tmp);
+    return ok;
+}
+
+/**
+ * @brief Reads and validates an object file.
+ *
+ * @param path The file to read.
+ * @param obj The object to fill. Must be released with `object_free`, even on
+ * failure.
+ * @return True if the file is a well-formed object, false otherwise.
+ */
+static bool object_read(const char *path, Object *obj) {
+    memset(obj, 0, sizeof(*obj));
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+
+    char     magic[OBJECT_MAGIC_LENGTH];
+    uint32_t counts[6];
+    bool     ok = fread(magic, 1, sizeof(magic), file) == sizeof(magic) &&
+              memcmp(magic, OBJECT_MAGIC, OBJECT_MAGIC_LENGTH) == 0 &&
+              fread(&obj->source_size, sizeof(obj->source_size), 1, file) == 1 &&
+              fread(&obj->source_mtime, sizeof(obj->source_mtime), 1, file) == 1 &&
+              fread(counts, sizeof(counts), 1, file) == 1;
+
+    // Every count is checked against the file's size before allocating
+    long here = ok ? ftell(file) : 0;
+    ok        = ok && fseek(file, 0L, SEEK_END) == 0;
+    long size = ok ? ftell(file) : 0;
+    ok        = ok && fseek(file, here, SEEK_SET) == 0;
+    uint64_t needed = (uint64_t) counts[0] + (uint64_t) counts[1] * sizeof(ObjCommand) +
+                      (uint64_t) counts[2] * sizeof(ObjSymbol) +
+                      (uint64_t) counts[3] * sizeof(ObjReloc) +
+                      (uint64_t) counts[4] * sizeof(uint32_t) + counts[5];
+    ok = ok && size >= here && (uint64_t) (size - here) == needed;
+
+    if (ok) {
+        obj->command_count   = counts[1];
+        obj->symbol_count    = counts[2];
+        obj->reloc_count     = counts[3];
+        obj->include_count   = counts[4];
+        obj->string_size     = counts[5];
+        obj->string_capacity = counts[5];
+        obj->source          = calloc(counts[0] + 1, 1);
+        obj->commands        = calloc(counts[1] + 1, sizeof(ObjCommand));
+        obj->symbols         = calloc(counts[2] + 1, sizeof(ObjSymbol));
+        obj->relocs          = calloc(counts[3] + 1, sizeof(ObjReloc));
+        obj->includes        = calloc(counts[4] + 1, sizeof(uint32_t));
+        obj->strings         = calloc(counts[5] + 1, 1);
+        ok = obj->source && obj->commands && obj->symbols && obj->relocs && obj->includes &&
+             obj->strings;
+    }
+    ok = ok && fread(obj->source, 1, counts[0], file) == counts[0];
+    ok = ok && fread(obj->commands, sizeof(ObjCommand), counts[1], file) == counts[1];
+    ok = ok && fread(obj->symbols, sizeof(ObjSymbol), counts[2], file) == counts[2];
+    ok = ok && fread(obj->relocs, sizeof(ObjReloc), counts[3], file) == counts[3];
+    ok = ok && fread(obj->includes, sizeof(uint32_t), counts[4], file) == counts[4];
+    ok = ok && fread(obj->strings, 1, counts[5], file) == counts[5];
+    fclose(file);
+
+    return ok && object_valid(obj);
+}
+
+/**
+ * @brief Checks that every index and offset of an object is in range.
+ *
+ * @param obj The object to check.
+ * @return True if the object can be linked safely.
+ */
+static bool object_valid(const Object *obj) {
+    if (obj->string_size > 0 && obj->strings[obj->string_size - 1] != '\0') {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < obj->command_count; i++) {
+        const ObjCommand *oc = &obj->commands[i];
+        // Builtins are resolved after linking, so objects only hold their calls
+        if (oc->type > CMD_READ || oc->type == CMD_BUILTIN || oc->condition < BRANCH_NONE ||
+            oc->condition > BRANCH_LESS_EQUAL) {
+            return false;
+        }
+        if ((oc->type == CMD_PUSH || oc->type == CMD_POP) && oc->operands[1] > oc->operands[2]) {
+            return false;
+        }
+        if (oc->type == CMD_BRANCH || oc->type == CMD_CALL || oc->type == CMD_CCALL) {
+            if (oc->operands[0] < 0 || (uint64_t) oc->operands[0] >= obj->string_size) {
+                return false;
+            }
+        } else if (oc->type == CMD_PUT) {
+            if (oc->operands[1] < 0 || (uint64_t) oc->operands[1] >= obj->string_size) {
+                return false;
+            }
+        }
+        // Register operands index the register file directly
+        uint32_t type = 1u << oc->type;
+        if (((type & DEST_REGISTER) && !is_register(oc->operands[0])) ||
+            ((type & A_REGISTER) && !(oc->flags & OP_A_IMMEDIATE) &&
+             !is_register(oc->operands[1])) ||
+            ((type & B_REGISTER) && !(oc->flags & OP_B_IMMEDIATE) &&
+             !is_register(oc->operands[2]))) {
+            return false;
+        }
+    }
+
+    for (uint32_t i = 0; i < obj->symbol_count; i++) {
+        const ObjSymbol *s = &obj->symbols[i];
+        if (s->name >= obj->string_size ||
+            (s->command != NO_COMMAND && s->command >= obj->command_count) ||
+            (s->command == NO_COMMAND) != ((s->flags & SYM_EXTERN) != 0)) {
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < obj->reloc_count; i++) {
+        if (obj->relocs[i].command >= obj->command_count ||
+            obj->relocs[i].name >= obj->string_size) {
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < obj->include_count; i++) {
+        if (obj->includes[i] >= obj->string_size) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Determines whether an operand is a valid register number.
+ *
+ * @param operand The operand.
+ * @return True for x0 through x31 and sp.
+ */
+static bool is_register(int64_t operand) {
+    return operand >= 0 && operand <= REG_SP;
+}
+
+/**
+ * @brief Determines whether a label map defines a label.
+ *
+ * Unlike `find_label`, this also finds labels mapped to NULL.
+ *
+ * @param map The label map.
+ * @param name The label.
+ * @return True if `name` is in the map.
+ */
+static bool has_label(LabelMap *map, const char *name) {
+    for (Entry *e = get_label(map, (char *) name); e; e = e->next) {
+        if (e->id && strcmp(e->id, name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Releases the memory owned by an object.
+ *
+ * @param obj The object to release.
+ */
+static void object_free(Object *obj) {
+    free(obj->source);
+    free(obj->commands);
+    free(obj->symbols);
+    free(obj->relocs);
+    free(obj->includes);
+    free(obj->strings);
+    memset(obj, 0, sizeof(*obj));
+}
+
+/**
+ * @brief Determines whether the program or a module exports a label.
+ *
+ * @param link The link state.
+ * @param dirs The program's directives.
+ * @param name The label.
+ * @param owner Set to the exporting module's index, or -1 for the program.
+ * @return True if some module exports `name`.
+ */
+static bool is_exported(const Link *link, const LinkDirectives *dirs, const char *name,
+                        int *owner) {
+    for (int g = 0; g < dirs->global_count; g++) {
+        if (strcmp(dirs->globals[g], name) == 0) {
+            *owner = -1;
+            return true;
+        }
+    }
+    for (int m = 0; m < link->count; m++) {
+        const Object *obj = &link->modules[m].object;
+        for (uint32_t s = 0; s < obj->symbol_count; s++) {
+            if ((obj->symbols[s].flags & SYM_GLOBAL) &&
+                strcmp(obj->strings + obj->symbols[s].name, name) == 0) {
+                *owner = m;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Checks that every export is unique and every reference resolves.
+ *
+ * @param link The link state.
+ * @param dirs The program's directives.
+ * @param map The program's labels.
+ * @return True if the modules can be linked, false if an error was printed.
+ */
+static bool check_symbols(const Link *link, const LinkDirectives *dirs, LabelMap *map) {
+    for (int g = 0; g < dirs->global_count; g++) {
+        if (!find_label(map, dirs->globals[g])) {
+            return link_error("Exported label %s is not defined", dirs->globals[g]);
+        }
+    }
+
+    int owner;
+    for (int m = 0; m < link->count; m++) {
+        const Object *obj = &link->modules[m].object;
+        for (uint32_t s = 0; s < obj->symbol_count; s++) {
+            const char *name = obj->strings + obj->symbols[s].name;
+            if (obj->symbols[s].flags & SYM_GLOBAL) {
+                if (has_label(map, name)) {
+                    return link_error("Label %s exported by %s is also defined by the program",
+                                      name, link->modules[m].path);
+                }
+                if (is_exported(link, dirs, name, &owner) && owner != m) {
+                    return link_error("Label %s is exported by more than one module", name);
+                }
+            } else if ((obj->symbols[s].flags & SYM_EXTERN) &&
+                       !is_exported(link, dirs, name, &owner)) {
+                return link_error("Undefined label %s declared by %s", name,
+                                  link->modules[m].path);
+            }
+        }
+        for (uint32_t r = 0; r < obj->reloc_count; r++) {
+            const char *name = obj->strings + obj->relocs[r].name;
+            if (!is_exported(link, dirs, name, &owner)) {
+                return link_error("Undefined label %s referenced by %s", name,
+                                  link->modules[m].path);
+            }
+        }
+    }
+
+    // The program's own unresolved references still fail at run time, as
+    // they did before linking existed, unless it declared them
+    for (int e = 0; e < dirs->extern_count; e++) {
+        if (!is_exported(link, dirs, dirs->externs[e], &owner)) {
+            return link_error("Undefined label %s", dirs->externs[e]);
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Appends a module's commands to the program and registers its labels.
+ *
+ * @param module The module.
+ * @param index The module's number, used to rename its local labels.
+ * @param tail Where to link the module's first command.
+ * @param map The program's labels.
+ * @return True on success, false if an error was printed.
+ */
+static bool instantiate(const Module *module, int index, Command **tail, LabelMap *map) {
+    const Object *obj = &module->object;
+
+    Command **commands = calloc(obj->command_count + 1, sizeof(Command *));
+    LabelMap  locals;
+    if (!commands || !label_map_init(&locals, MODULE_LABEL_BUCKETS)) {
+        free(commands);
+        return link_error("Out of memory");
+    }
+
+    // Labels the module does not export only resolve inside the module
+    bool ok = true;
+    for (uint32_t s = 0; ok && s < obj->symbol_count; s++) {
+        const ObjSymbol *sym = &obj->symbols[s];
+        if (sym->flags & (SYM_GLOBAL | SYM_EXTERN)) {
+            continue;
+        }
+        const char *name = obj->strings + sym->name;
+        char       *id   = copy_string(name, strlen(name));
+        ok               = id && put_label(&locals, id, NULL);
+        if (!ok) {
+            free(id);
+        }
+    }
+
+    for (uint32_t i = 0; ok && i < obj->command_count; i++) {
+        commands[i] = command_from_object(obj, &obj->commands[i], &locals, index);
+        ok          = commands[i] != NULL;
+        if (ok) {
+            *tail = commands[i];
+            tail  = &commands[i]->next;
+        }
+    }
+
+    for (uint32_t s = 0; ok && s < obj->symbol_count; s++) {
+        const ObjSymbol *sym = &obj->symbols[s];
+        if (sym->flags & SYM_EXTERN) {
+            continue;
+        }
+        const char *name = obj->strings + sym->name;
+        char *id = (sym->flags & SYM_GLOBAL) ? copy_string(name, strlen(name))
+                                             : local_name(name, index);
+        ok       = id && put_label(map, id, commands[sym->command]);
+        if (!ok) {
+            free(id);
+        }
+    }
+
+    label_map_free(&locals);
+    free(commands);
+    return ok || link_error("Out of memory");
+}
+
+/**
+ * @brief Creates a command from its object form.
+ *
+ * @param obj The object the command belongs to.
+ * @param oc The command's object form.
+ * @param locals The module's unexported labels.
+ * @param index The module's number, used to rename its local labels.
+ * @return The command, or NULL if allocation failed.
+ */
+static Command *command_from_object(const Object *obj, const ObjCommand *oc,
+                                    LabelMap *locals, int index) {
+    Command *c = calloc(1, sizeof(Command));
+    if (!c) {
+        return NULL;
+    }
+    c->type                = (CommandType) oc->type;
+    c->branch_condition    = (BranchCondition) oc->condition;
+    c->is_a_immediate      = (oc->flags & OP_A_IMMEDIATE) != 0;
+    c->is_b_immediate      = (oc->flags & OP_B_IMMEDIATE) != 0;
+    c->is_a_string         = (oc->flags & OP_A_STRING) != 0;
+    c->is_b_string         = (oc->flags & OP_B_STRING) != 0;
+    c->destination.num_val = oc->operands[0];
+    c->val_a.num_val       = oc->operands[1];
+    c->val_b.num_val       = oc->operands[2];
+
+    if (c->type == CMD_BRANCH || c->type == CMD_CALL) {
+        char *name  = obj->strings + oc->operands[0];
+        bool  local = has_label(locals, name);
+        c->destination.str_val = local ? local_name(name, index) : copy_string(name, strlen(name));
+        if (!c->destination.str_val) {
+            free(c);
+            return NULL;
+        }
+    } else if (c->type == CMD_CCALL) {
+        // Foreign functions are global; they are bound after linking
+        const char *name       = obj->strings + oc->operands[0];
+        c->destination.str_val = copy_string(name, strlen(name));
+        if (!c->destination.str_val) {
+            free(c);
+            return NULL;
+        }
+    } else if (c->type == CMD_PUT) {
+        const char *s  = obj->strings + oc->operands[1];
+        c->val_a.str_val = copy_string(s, strlen(s));
+        if (!c->val_a.str_val) {
+            free(c);
+            return NULL;
+        }
+    } else if (c->type == CMD_RET) {
+        c->destination.str_val = NULL;
+    }
+    return c;
+}
+
+/**
+ * @brief Renames a module's unexported label.
+ *
+ * @param name The label.
+ * @param index The module's number.
+ * @return `name$index`, which no source label can spell, or NULL if
+ * allocation failed.
+ */
+static char *local_name(const char *name, int index) {
+    size_t length = strlen(name) + 16;
+    char  *id     = malloc(length);
+    if (id) {
+        snprintf(id, length, "%s$%d", name, index);
+    }
+    return id;
+}
@@ -0,0 +1,678 @@
+#include "macro.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "token_type.h"
+
+/**
+ * @brief The type and lexeme a token expands to.
+ */
+typedef struct {
+    uint8_t  type;    // TokenType of the replacement
+    uint32_t offset;  // Offset of the replacement's lexeme in the expanded text
+    uint32_t length;  // Length of the replacement's lexeme
+} TokenValue;
+
+/**
+ * @brief An identifier and the token it is replaced by.
+ */
+typedef struct {
+    uint32_t   name;    // Offset of the identifier in the expanded text
+    uint32_t   length;  // Length of the identifier
+    TokenValue value;   // What the identifier expands to
+} Binding;
+
+/**
+ * @brief The parameters and local labels visible inside one expanded body.
+ */
+typedef struct scope {
+    const struct scope *parent;    // The enclosing body for .rept, NULL for macros
+    Binding            *bindings;  // Parameters followed by local labels
+    int                 count;     // Number of bindings
+} Scope;
+
+/**
+ * @brief A macro definition, referring to the input tokens.
+ */
+typedef struct {
+    int name;         // Index of the name token
+    int params;       // Index of the first parameter token
+    int param_count;  // Number of parameters
+    int body;         // Index of the first body token
+    int body_end;     // Index of the .endm token
+} Macro;
+
+/**
+ * @brief The state of one expansion.
+ */
+typedef struct {
+    const TokenArray *in;                 // The tokens being expanded
+    TokenArray       *out;                // The expanded tokens
+    char             *text;               // Source text followed by generated label names
+    size_t            text_length;        // Bytes used in `text`
+    size_t            text_capacity;      // Bytes allocated for `text`
+    Macro            *macros;             // Defined macros
+    int               macro_count;        // Number of defined macros
+    int               macro_capacity;     // Allocated slots in `macros`
+    Binding          *constants;          // Constants defined by .equ and .set
+    int               constant_count;     // Number of defined constants
+    int               constant_capacity;  // Allocated slots in `constants`
+    int               expansions;         // Bodies expanded so far, numbers local labels
+    MacroError       *error;              // Where to report the first error
+} Expander;
+
+static bool  expand_range(Expander *exp, int start, int end, const Scope *scope, int depth);
+static bool  expand_body(Expander *exp, int body, int body_end, const Scope *parent,
+                         const Binding *params, int param_count, int depth);
+static bool  define_macro(Expander *exp, int first, int stop, int close);
+static bool  define_constant(Expander *exp, const Scope *scope, int first, int stop,
+                             bool redefine);
+static bool  repeat_body(Expander *exp, const Scope *scope, int first, int stop, int close,
+                         int depth);
+static bool  invoke_macro(Expander *exp, const Scope *scope, const Macro *macro, int first,
+                          int stop, int depth);
+static bool  has_directives(const TokenArray *tokens);
+static bool  is_directive(const Expander *exp, int index, const char *name);
+static bool  same_name(const Expander *exp, uint32_t a, uint32_t a_length, uint32_t b,
+                       uint32_t b_length);
+static int   line_end(const TokenArray *tokens, int index, int end);
+static int   find_close(const Expander *exp, int from, int end, const char *open,
+                        const char *close);
+static const Macro      *find_macro(const Expander *exp, int index);
+static const TokenValue *lookup(const Expander *exp, const Scope *scope, int index);
+static TokenValue        resolve(const Expander *exp, const Scope *scope, int index);
+static bool  emit(Expander *exp, TokenValue value, int index);
+static bool  append_text(Expander *exp, const char *text, size_t length, uint32_t *offset);
+static bool  fail(Expander *exp, int index, const char *message);
+
+bool expand_macros(TokenArray *tokens, MacroError *error) {
+    error->message = NULL;
+    error->line    = 0;
+    if (!has_directives(tokens)) {
+        return true;
+    }
+
+    TokenArray out;
+    memset(&out, 0, sizeof(out));
+
+    Expander exp;
+    memset(&exp, 0, sizeof(exp));
+    exp.in    = tokens;
+    exp.out   = &out;
+    exp.error = error;
+
+    // Expanded tokens keep their offsets, so the source is copied verbatim and
+    // generated label names are appended after it
+    size_t   source_length = strlen(tokens->text);
+    uint32_t unused;
+    bool     ok = append_text(&exp, tokens->text, source_length, &unused);
+    if (!ok) {
+        fail(&exp, 0, "Out of memory");
+    }
+
+    int eof = tokens->count - 1;
+    ok      = ok && expand_range(&exp, 0, eof, NULL, 0);
+    ok      = ok && emit(&exp, resolve(&exp, NULL, eof), eof);
+
+    free(exp.macros);
+    free(exp.constants);
+    if (!ok) {
+        free(exp.text);
+        token_array_free(&out);
+        return false;
+    }
+
+    out.text       = exp.text;
+    out.owned_text = exp.text;
+    token_array_free(tokens);
+    *tokens = out;
+    return true;
+}
+
+/**
+ * @brief Expands the lines in a range of input tokens.
+ *
+ * @param exp The expansion state.
+ * @param start Index of the first token of the first line.
+ * @param end Index one past the last token to expand.
+ * @param scope The bindings of the enclosing body, or NULL at the top level.
+ * @param depth The number of enclosing bodies.
+ * @return True on success, false if an error was reported.
+ */
+static bool expand_range(Expander *exp, int start, int end, const Scope *scope, int depth) {
+    const TokenArray *in = exp->in;
+
+    int i = start;
+    while (i < end) {
+        int stop  = line_end(in, i, end);
+        int first = i;
+
+        // A label may precede the directive or instruction on the same line
+        if (in->types[first] == TOK_IDENT && first + 1 < stop &&
+            in->types[first + 1] == TOK_COLON) {
+            if (!emit(exp, resolve(exp, scope, first), first) ||
+                !emit(exp, resolve(exp, scope, first + 1), first + 1)) {
+                return false;
+            }
+            first += 2;
+        }
+
+        if (first < stop && is_directive(exp, first, ".macro")) {
+            if (scope) {
+                return fail(exp, first, "Macros must be defined at the top level");
+            }
+            int close = find_close(exp, stop + 1, end, ".macro", ".endm");
+            if (close < 0) {
+                return fail(exp, first, "Missing .endm");
+            }
+            if (close + 1 < end && in->types[close + 1] != TOK_NL) {
+                return fail(exp, close, "Unexpected tokens after the end of the block");
+            }
+            if (!define_macro(exp, first, stop, close)) {
+                return false;
+            }
+            stop  = line_end(in, close, end);
+            first = stop;
+        } else if (first < stop && is_directive(exp, first, ".rept")) {
+            int close = find_close(exp, stop + 1, end, ".rept", ".endr");
+            if (close < 0) {
+                return fail(exp, first, "Missing .endr");
+            }
+            if (close + 1 < end && in->types[close + 1] != TOK_NL) {
+                return fail(exp, close, "Unexpected tokens after the end of the block");
+            }
+            if (!repeat_body(exp, scope, first, stop, close, depth)) {
+                return false;
+            }
+            stop  = line_end(in, close, end);
+            first = stop;
+        } else if (first < stop && (is_directive(exp, first, ".endm") ||
+                                    is_directive(exp, first, ".endr"))) {
+            return fail(exp, first, "Unmatched end of block");
+        } else if (first < stop && (is_directive(exp, first, ".equ") ||
+                                    is_directive(exp, first, ".set"))) {
+            if (!define_constant(exp, scope, first, stop, is_directive(exp, first, ".set"))) {
+                return false;
+            }
+            first = stop;
+        } else if (first < stop && find_macro(exp, first)) {
+            if (!invoke_macro(exp, scope, find_macro(exp, first), first, stop, depth)) {
+                return false;
+            }
+            first = stop;
+        }
+
+        // Whatever is left of the line, including its newline, is copied
+        for (int j = first; j <= stop && j < end; j++) {
+            if (!emit(exp, resolve(exp, scope, j), j)) {
+                return false;
+            }
+        }
+        i = stop + 1;
+    }
+    return true;
+}
+
+/**
+ * @brief Expands a macro or .rept body with fresh names for its local labels.
+ *
+ * @param exp The expansion state.
+ * @param body Index of the first body token.
+ * @param body_end Index of the token closing the body.
+ * @param parent The scope the body can see into, or NULL.
+ * @param params The parameter bindings of a macro invocation.
+ * @param param_count The number of parameter bindings.
+ * @param depth The number of enclosing bodies.
+ * @return True on success, false if an error was reported.
+ */
+static bool expand_body(Expander *exp, int body, int body_end, const Scope *parent,
+                        const Binding *params, int param_count, int depth) {
+    const TokenArray *in = exp->in;
+    if (depth >= MACRO_MAX_DEPTH) {
+        return fail(exp, body, "Macro expansion nested too deeply");
+    }
+
+    int locals = 0;
+    for (int j = body; j + 1 < body_end; j++) {
+        if (in->types[j] == TOK_IDENT && in->types[j + 1] == TOK_COLON) {
+            locals++;
+        }
+    }
+
+    Binding *bindings = malloc((size_t) (param_count + locals + 1) * sizeof(Binding));
+    if (!bindings) {
+        return fail(exp, body, "Out of memory");
+    }
+    if (param_count > 0) {
+        memcpy(bindings, params, (size_t) param_count * sizeof(Binding));
+    }
+
+    // Local labels become name@N, which no source identifier can spell
+    int id    = exp->expansions++;
+    int count = param_count;
+    for (int j = body; j + 1 < body_end; j++) {
+        if (in->types[j] != TOK_IDENT || in->types[j + 1] != TOK_COLON) {
+            continue;
+        }
+
+        char     suffix[16];
+        int      suffix_length = snprintf(suffix, sizeof(suffix), "@%d", id);
+        uint32_t offset;
+        if (!append_text(exp, exp->text + in->offsets[j], in->lengths[j], &offset) ||
+            !append_text(exp, suffix, (size_t) suffix_length, NULL)) {
+            free(bindings);
+            return fail(exp, j, "Out of memory");
+        }
+
+        Binding *b      = &bindings[count++];
+        b->name         = in->offsets[j];
+        b->length       = in->lengths[j];
+        b->value.type   = TOK_IDENT;
+        b->value.offset = offset;
+        b->value.length = in->lengths[j] + (uint32_t) suffix_length;
+    }
+
+    Scope scope = {parent, bindings, count};
+    bool  ok    = expand_range(exp, body, body_end, &scope, depth + 1);
+    free(bindings);
+    return ok;
+}
+
+/**
+ * @brief Records a macro definition.
+ *
+ * @param exp The expansion state.
+ * @param first Index of the .macro token.
+ * @param stop Index of the newline ending the .macro line.
+ * @param close Index of the matching .endm token.
+ * @return True on success, false if an error was reported.
+ */
+static bool define_macro(Expander *exp, int first, int stop, int close) {
+    const TokenArray *in = exp->in;
+    if (first + 1 >= stop || in->types[first + 1] != TOK_IDENT) {
+        return fail(exp, first, "Expected a macro name");
+    }
+    for (int j = first + 2; j < stop; j++) {
+        if (in->types[j] != TOK_IDENT) {
+            return fail(exp, j, "Macro parameters must be identifiers");
+        }
+    }
+    if (find_macro(exp, first + 1)) {
+        return fail(exp, first + 1, "Macro redefined");
+    }
+
+    if (exp->macro_count == exp->macro_capacity) {
+        int    capacity = exp->macro_capacity ? exp->macro_capacity * 2 : 8;
+        Macro *macros   = realloc(exp->macros, (size_t) capacity * sizeof(Macro));
+        if (!macros) {
+            return fail(exp, first, "Out of memory");
+        }
+        exp->macros         = macros;
+        exp->macro_capacity = capacity;
+    }
+
+    Macro *m       = &exp->macros[exp->macro_count++];
+    m->name        = first + 1;
+    m->params      = first + 2;
+    m->param_count = stop - (first + 2);
+    m->body        = stop + 1;
+    m->body_end    = close;
+    return true;
+}
+
+/**
+ * @brief Defines or redefines a constant.
+ *
+ * @param exp The expansion state.
+ * @param scope The bindings the value is resolved in.
+ * @param first Index of the .equ or .set token.
+ * @param stop Index of the newline ending the line.
+ * @param redefine Whether an existing constant may be redefined.
+ * @return True on success, false if an error was reported.
+ */
+static bool define_constant(Expander *exp, const Scope *scope, int first, int stop,
+                            bool redefine) {
+    const TokenArray *in = exp->in;
+    if (stop != first + 3 || in->types[first + 1] != TOK_IDENT) {
+        return fail(exp, first, "Expected a name and a value");
+    }
+
+    TokenValue value = resolve(exp, scope, first + 2);
+    for (int c = 0; c < exp->constant_count; c++) {
+        Binding *b = &exp->constants[c];
+        if (same_name(exp, b->name, b->length, in->offsets[first + 1], in->lengths[first + 1])) {
+            if (!redefine) {
+                return fail(exp, first + 1, "Constant redefined");
+            }
+            b->value = value;
+            return true;
+        }
+    }
+
+    if (exp->constant_count == exp->constant_capacity) {
+        int      capacity  = exp->constant_capacity ? exp->constant_capacity * 2 : 8;
+        Binding *constants = realloc(exp->constants, (size_t) capacity * sizeof(Binding));
+        if (!constants) {
+            return fail(exp, first, "Out of memory");
+        }
+        exp->constants         = constants;
+        exp->constant_capacity = capacity;
+    }
+
+    Binding *b = &exp->constants[exp->constant_count++];
+    b->name    = in->offsets[first + 1];
+    b->length  = in->lengths[first + 1];
+    b->value   = value;
+    return true;
+}
+
+/**
+ * @brief Expands a .rept block.
+ *
+ * @param exp The expansion state.
+ * @param scope The bindings of the enclosing body, or NULL.
+ * @param first Index of the .rept token.
+ * @param stop Index of the newline ending the .rept line.
+ * @param close Index of the matching .endr token.
+ * @param depth The number of enclosing bodies.
+ * @return True on success, false if an error was reported.
+ */
+static bool repeat_body(Expander *exp, const Scope *scope, int first, int stop, int close,
+                        int depth) {
+    if (stop != first + 2) {
+        return fail(exp, first, "Expected a repetition count");
+    }
+
+    TokenValue count = resolve(exp, scope, first + 1);
+    if (count.type != TOK_NUM) {
+        return fail(exp, first + 1, "Expected a repetition count");
+    }
+
+    // Numbers are NUL-free and end at a non-digit, so strtoll stops in time
+    const char *digits = exp->text + count.offset;
+    int         base   = 10;
+    if (count.length > 2 && digits[0] == '0' && (digits[1] == 'x' || digits[1] == 'b')) {
+        base = digits[1] == 'x' ? 16 : 2;
+        digits += 2;
+    }
+    char     *endptr;
+    long long times = strtoll(digits, &endptr, base);
+    if (endptr != exp->text + count.offset + count.length || times < 0 ||
+        times > MACRO_MAX_TOKENS) {
+        return fail(exp, first + 1, "Invalid repetition count");
+    }
+
+    for (long long t = 0; t < times; t++) {
+        if (!expand_body(exp, stop + 1, close, scope, NULL, 0, depth)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Replaces a macro invocation by the macro's body.
+ *
+ * @param exp The expansion state.
+ * @param scope The bindings the arguments are resolved in.
+ * @param macro The invoked macro.
+ * @param first Index of the macro name at the start of the invocation.
+ * @param stop Index of the newline ending the invocation.
+ * @param depth The number of enclosing bodies.
+ * @return True on success, false if an error was reported.
+ */
+static bool invoke_macro(Expander *exp, const Scope *scope, const Macro *macro, int first,
+                         int stop, int depth) {
+    const TokenArray *in = exp->in;
+    if (stop - (first + 1) != macro->param_count) {
+        return fail(exp, first, "Wrong number of macro arguments");
+    }
+
+    Binding params[MACRO_MAX_DEPTH];
+    if (macro->param_count > MACRO_MAX_DEPTH) {
+        return fail(exp, first, "Too many macro parameters");
+    }
+    for (int p = 0; p < macro->param_count; p++) {
+        params[p].name   = in->offsets[macro->params + p];
+        params[p].length = in->lengths[macro->params + p];
+        params[p].value  = resolve(exp, scope, first + 1 + p);
+    }
+
+    // Macro bodies only see their own parameters, not the caller's
+    return expand_body(exp, macro->body, macro->body_end, NULL, params, macro->param_count,
+                       depth);
+}
+
+/**
+ * @brief Determines whether a token array uses any directive.
+ *
+ * @param tokens The tokens to scan.
+ * @return True if an identifier starting with a period occurs.
+ */
+static bool has_directives(const TokenArray *tokens) {
+    for (int i = 0; i < tokens->count; i++) {
+        if (tokens->types[i] == TOK_IDENT && tokens->text[tokens->offsets[i]] == '.') {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Determines whether an input token is the given directive.
+ *
+ * @param exp The expansion state.
+ * @param index Index of the input token.
+ * @param name The directive, including the leading period.
+ * @return True if the token spells `name`.
+ */
+static bool is_directive(const Expander *exp, int index, const char *name) {
+    const TokenArray *in     = exp->in;
+    size_t            length = strlen(name);
+    return in->types[index] == TOK_IDENT && in->lengths[index] == length &&
+           memcmp(exp->text + in->offsets[index], name, length) == 0;
+}
+
+/**
+ * @brief Compares two identifiers of the expanded text.
+ *
+ * @return True if both identifiers are spelled the same.
+ */
+static bool same_name(const Expander *exp, uint32_t a, uint32_t a_length, uint32_t b,
+                      uint32_t b_length) {
+    return a_length == b_length && memcmp(exp->text + a, exp->text + b, a_length) == 0;
+}
+
+/**
+ * @brief Finds the newline ending the line a token is on.
+ *
+ * @param tokens The tokens to scan.
+ * @param index Index of a token of the line.
+ * @param end Index one past the last token to consider.
+ * @return Index of the newline, or `end` if the range ends first.
+ */
+static int line_end(const TokenArray *tokens, int index, int end) {
+    while (index < end && tokens->types[index] != TOK_NL) {
+        index++;
+    }
+    return index;
+}
+
+/**
+ * @brief Finds the directive closing a block, skipping nested blocks.
+ *
+ * @param exp The expansion state.
+ * @param from Index of the first token of the block's body.
+ * @param end Index one past the last token to consider.
+ * @param open The directive opening a nested block.
+ * @param close The directive closing the block.
+ * @return Index of the closing directive, or -1 if there is none.
+ */
+static int find_close(const Expander *exp, int from, int end, const char *open,
+                      const char *close) {
+    int nesting = 0;
+    for (int i = from; i < end; i = line_end(exp->in, i, end) + 1) {
+        if (is_directive(exp, i, open)) {
+            nesting++;
+        } else if (is_directive(exp, i, close) && nesting-- == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Finds the macro an input token names.
+ *
+ * @param exp The expansion state.
+ * @param index Index of the input token.
+ * @return The macro, or NULL if the token does not name one.
+ */
+static const Macro *find_macro(const Expander *exp, int index) {
+    const TokenArray *in = exp->in;
+    if (in->types[index] != TOK_IDENT) {
+        return NULL;
+    }
+    for (int m = 0; m < exp->macro_count; m++) {
+        int name = exp->macros[m].name;
+        if (same_name(exp, in->offsets[name], in->lengths[name], in->offsets[index],
+                      in->lengths[index])) {
+            return &exp->macros[m];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Looks up the replacement of an input token.
+ *
+ * Parameters and local labels of the innermost body take precedence over
+ * those of enclosing bodies, which take precedence over constants.
+ *
+ * @param exp The expansion state.
+ * @param scope The innermost body's bindings, or NULL.
+ * @param index Index of the input token.
+ * @return The replacement, or NULL if the token is not replaced.
+ */
+static const TokenValue *lookup(const Expander *exp, const Scope *scope, int index) {
+    const TokenArray *in = exp->in;
+    if (in->types[index] != TOK_IDENT) {
+        return NULL;
+    }
+
+    uint32_t name   = in->offsets[index];
+    uint32_t length = in->lengths[index];
+    for (const Scope *s = scope; s; s = s->parent) {
+        for (int b = 0; b < s->count; b++) {
+            if (same_name(exp, s->bindings[b].name, s->bindings[b].length, name, length)) {
+                return &s->bindings[b].value;
+            }
+        }
+    }
+    for (int c = 0; c < exp->constant_count; c++) {
+        if (same_name(exp, exp->constants[c].name, exp->constants[c].length, name, length)) {
+            return &exp->constants[c].value;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Returns what an input token expands to.
+ *
+ * @param exp The expansion state.
+ * @param scope The innermost body's bindings, or NULL.
+ * @param index Index of the input token.
+ * @return The token's replacement, or the token itself.
+ */
+static TokenValue resolve(const Expander *exp, const Scope *scope, int index) {
+    const TokenValue *replacement = lookup(exp, scope, index);
+    if (replacement) {
+        return *replacement;
+    }
+
+    TokenValue value = {exp->in->types[index], exp->in->offsets[index], exp->in->lengths[index]};
+    return value;
+}
+
+/**
+ * @brief Appends a token to the expansion, at the position of an input token.
+ *
+ * @param exp The expansion state.
+ * @param value The token to append.
+ * @param index Index of the input token whose line and column are used.
+ * @return True on success, false if an error was reported.
+ */
+static bool emit(Expander *exp, TokenValue value, int index) {
+    if (exp->out->count >= MACRO_MAX_TOKENS) {
+        return fail(exp, index, "Program expands to too many tokens");
+    }
+    if (!token_array_push(exp->out, (TokenType) value.type, value.offset, value.length,
+                          exp->in->lines[index], exp->in->columns[index])) {
+        return fail(exp, index, "Out of memory");
+    }
+    return true;
+}
+
+/**
+ * @brief Appends characters to the expanded text, keeping it NUL-terminated.
+ *
+ * @param exp The expansion state.
+ * @param text The characters to append; may point into the expanded text.
+ * @param length The number of characters.
+ * @param offset Set to the offset of the appended characters, unless NULL.
+ * @return True on success, false if memory ran out or the text would exceed
+ * 4 GiB.
+ */
+static bool append_text(Expander *exp, const char *text, size_t length, uint32_t *offset) {
+    if (exp->text_length + length + 1 > UINT32_MAX) {
+        return false;
+    }
+
+    if (exp->text_length + length + 1 > exp->text_capacity) {
+        size_t capacity = (exp->text_length + length + 1) * 2;
+        size_t from     = exp->text && text >= exp->text &&
+                              text < exp->text + exp->text_capacity
+                            ? (size_t) (text - exp->text)
+                            : SIZE_MAX;
+        char  *grown    = realloc(exp->text, capacity);
+        if (!grown) {
+            return false;
+        }
+        exp->text          = grown;
+        exp->text_capacity = capacity;
+        if (from != SIZE_MAX) {
+            text = grown + from;
+        }
+    }
+
+    if (offset) {
+        *offset = (uint32_t) exp->text_length;
+    }
+    memmove(exp->text + exp->text_length, text, length);
+    exp->text_length += length;
+    exp->text[exp->text_length] = '\0';
+    return true;
+}
+
+/**
+ * @brief Reports an error at an input token.
+ *
+ * Only the first error is kept.
+ *
+ * @param exp The expansion state.
+ * @param index Index of the offending input token.
+ * @param message Description of the error.
+ * @return Always false.
+ */
+static bool fail(Expander *exp, int index, const char *message) {
+    if (!exp->error->message) {
+        exp->error->message = message;
+        exp->error->line    = exp->in->lines[index];
+    }
+    return false;
+}
@@ -2,7 +2,11 @@
 #include <stdio.h>
 #include <string.h>
 
-static uint8_t mem[MEM_CAPACITY];
+static uint8_t shared[MEM_CAPACITY];  // Memory of threads that bound none
+
+// Each thread accesses the memory it bound, so that a scheduler's workers can
+// run different programs at once
+static _Thread_local uint8_t *mem = shared;
 
 static bool validate_bytes(size_t bytes);
 
@@ -18,8 +22,16 @@ static bool validate_bytes(size_t bytes) {
     return bytes == 1 || bytes == 2 || bytes == 4 || bytes == 8;
 }
 
+uint8_t *mem_base(void) {
+    return mem;
+}
+
+void mem_bind(uint8_t *memory) {
+    mem = memory ? memory : shared;
+}
+
 bool mem_load(uint8_t *destination, size_t offset, size_t bytes) {
-    if (!validate_bytes(bytes) || !destination || offset + bytes > MEM_CAPACITY) {
+    if (!validate_bytes(bytes) || !destination || offset > MEM_CAPACITY - bytes) {
         return false;
     }
 
@@ -28,7 +40,7 @@ bool mem_load(uint8_t *destination, size_t offset, size_t bytes) {
 }
 
 bool mem_store(uint8_t *source, size_t offset, size_t bytes) {
-    if (!validate_bytes(bytes) || !source || offset + bytes > MEM_CAPACITY) {
+    if (!validate_bytes(bytes) || !source || offset > MEM_CAPACITY - bytes) {
         return false;
     }
 
@@ -36,8 +48,38 @@ bool mem_store(uint8_t *source, size_t offset, size_t bytes) {
     return true;
 }
 
-void mem_print(void) {
-    printf("Memory state:\n");
+uint64_t mem_load_value(uint64_t addr, int width, bool *ok) {
+    uint64_t value = 0;
+    *ok = validate_bytes((size_t) width) && addr <= MEM_CAPACITY - (uint64_t) width;
+    if (*ok) {
+        memcpy(&value, &mem[addr], (size_t) width);
+    }
+    return value;
+}
+
+bool mem_store_value(uint64_t addr, int width, uint64_t value) {
+    if (!validate_bytes((size_t) width) || addr > MEM_CAPACITY - (uint64_t) width) {
+        return false;
+    }
+
+    memcpy(&mem[addr], &value, (size_t) width);
+    return true;
+}
+
+void mem_load_unchecked(uint8_t *destination, size_t offset, size_t bytes) {
+    memcpy(destination, &mem[offset], bytes);
+}
+
+void mem_store_unchecked(const uint8_t *source, size_t offset, size_t bytes) {
+    memcpy(&mem[offset], source, bytes);
+}
+
+void mem_reset(void) {
+    memset(mem, 0, MEM_CAPACITY);
+}
+
+void mem_print(FILE *out) {
+    fprintf(out, "Memory state:\n");
 
     // Calculate minimum hex digits needed based on capacity
     int    addr_width = 1;
@@ -52,7 +94,7 @@ void mem_print(void) {
     }
 
     if (first_modified == MEM_CAPACITY) {
-        printf("Unmodified\n");
+        fprintf(out, "Unmodified\n");
         return;
     }
 
@@ -66,16 +108,16 @@ void mem_print(void) {
     if (display_end > MEM_CAPACITY)
         display_end = MEM_CAPACITY;
 
-    printf("0x%0*zx-0x%0*zx:\n", addr_width, display_start, addr_width, display_end - 1);
+    fprintf(out, "0x%0*zx-0x%0*zx:\n", addr_width, display_start, addr_width, display_end - 1);
 
     for (size_t j = display_start; j < display_end; j += 16) {
-        printf("    0x%0*zx: ", addr_width, j);
+        fprintf(out, "    0x%0*zx: ", addr_width, j);
         for (size_t k = 0; k < 16 && j + k < display_end; k++) {
-            printf("%02x", mem[j + k]);
+            fprintf(out, "%02x", mem[j + k]);
             if ((k + 1) % 4 == 0) {
-                printf(" ");
+                fprintf(out, " ");
             }
         }
-        printf("\n");
+        fprintf(out, "\n");
     }
 }
\ No newline at end of file
@@ -0,0 +1,515 @@
+#include "memo.h"
+#include <stdlib.h>
+#include <string.h>
+#include "cfg.h"
+#include "interpreter.h"
+
+#define FLAGS_BIT ((uint64_t) 1 << NUM_REGISTERS)  // Liveness bit of the comparison flags
+
+/**
+ * @brief What the analysis knows about one called function.
+ */
+typedef struct {
+    BasicBlock *entry;     // The block the function starts at.
+    int        *body;      // Ids of the blocks it can reach before returning.
+    int         length;    // Number of entries in `body`.
+    bool        pure;      // Whether a call changes nothing but x0 and the flags.
+    uint64_t    inputs;    // Registers, and FLAGS_BIT, read before being written.
+    int         memo;      // Index of its `MemoFunction`, or -1 if not cached.
+} Function;
+
+/**
+ * @brief The state of the purity analysis of a program.
+ */
+typedef struct {
+    Cfg       cfg;          // The program's blocks.
+    LabelMap *map;          // The program's labels.
+    Function *functions;    // Every function some call targets.
+    int       count;        // Number of entries in `functions`.
+    int       capacity;     // Functions `functions` has room for.
+    int      *function_of;  // Index of the function starting at each block, or -1.
+    int      *seen;         // Last function whose body each block was added to.
+    uint64_t *live;         // Registers live on entry to each block.
+} Analysis;
+
+static int      callee(const Analysis *an, const Command *call);
+static bool     add_function(Analysis *an, BasicBlock *entry);
+static bool     allowed(const Command *cmd);
+static bool     ends_program(const BasicBlock *block);
+static bool     collect_body(Analysis *an, int f);
+static bool     calls_impure(const Analysis *an, const Function *fn);
+static void     effect(const Analysis *an, const Command *cmd, uint64_t *uses, uint64_t *defs);
+static uint64_t reg_bit(int64_t reg);
+static uint64_t live_in(const Analysis *an, const BasicBlock *block, uint64_t out);
+static uint64_t function_inputs(Analysis *an, const Function *fn);
+static void     find_inputs(Analysis *an);
+static bool     cacheable(const Function *fn);
+static bool     build_table(MemoTable *table, Analysis *an, Command *commands);
+static uint64_t hash_key(const MemoFunction *function, const int64_t *values);
+static bool     same_key(const MemoEntry *entry, const MemoFunction *function,
+                         const int64_t *values);
+
+bool memo_init(MemoTable *table, Command *commands, LabelMap *map, char *const *excluded,
+               int excluded_count) {
+    memset(table, 0, sizeof(*table));
+    for (Command *cmd = commands; cmd; cmd = cmd->next) {
+        cmd->memo = NULL;
+    }
+
+    Analysis an;
+    memset(&an, 0, sizeof(an));
+    an.map = map;
+    if (!cfg_build(&an.cfg, commands, map)) {
+        return false;
+    }
+
+    size_t count   = (size_t) an.cfg.count;
+    bool   ok      = true;
+    an.function_of = (int *) malloc((count + 1) * sizeof(int));
+    an.seen        = (int *) malloc((count + 1) * sizeof(int));
+    an.live        = (uint64_t *) calloc(count + 1, sizeof(uint64_t));
+    if (!an.function_of || !an.seen || !an.live) {
+        ok = false;
+    } else {
+        for (size_t i = 0; i < count; i++) {
+            an.function_of[i] = -1;
+            an.seen[i]        = -1;
+        }
+    }
+
+    // Every block a call targets starts a function
+    for (Command *cmd = commands; ok && cmd; cmd = cmd->next) {
+        if (cmd->type == CMD_CALL) {
+            Command *target = find_label(map, cmd->destination.str_val);
+            if (target && target->block && an.function_of[target->block->id] < 0) {
+                ok = add_function(&an, target->block);
+            }
+        }
+    }
+    for (int f = 0; ok && f < an.count; f++) {
+        ok = collect_body(&an, f);
+    }
+
+    if (ok) {
+        for (int i = 0; i < excluded_count; i++) {
+            Command *target = find_label(map, excluded[i]);
+            if (target && target->block && an.function_of[target->block->id] >= 0) {
+                an.functions[an.function_of[target->block->id]].pure = false;
+            }
+        }
+
+        // A function is only as pure as everything it calls
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (int f = 0; f < an.count; f++) {
+                if (an.functions[f].pure && calls_impure(&an, &an.functions[f])) {
+                    an.functions[f].pure = false;
+                    changed              = true;
+                }
+            }
+        }
+        find_inputs(&an);
+        ok = build_table(table, &an, commands);
+    }
+
+    for (int f = 0; f < an.count; f++) {
+        free(an.functions[f].body);
+    }
+    free(an.functions);
+    free(an.function_of);
+    free(an.seen);
+    free(an.live);
+    cfg_free(&an.cfg);
+    if (!ok) {
+        memo_free(table, commands);
+    }
+    return ok;
+}
+
+const MemoEntry *memo_lookup(MemoTable *table, const MemoFunction *function,
+                             const int64_t *regs) {
+    int64_t values[MEMO_MAX_INPUTS] = {0};
+    for (int i = 0; i < function->input_count; i++) {
+        values[i] = regs[function->inputs[i]];
+    }
+
+    table->lookups++;
+    const MemoEntry *entry = &table->entries[hash_key(function, values) & (MEMO_CAPACITY - 1)];
+    if (!same_key(entry, function, values)) {
+        return NULL;
+    }
+    table->hits++;
+    return entry;
+}
+
+void memo_store(MemoTable *table, const MemoFunction *function, const int64_t *saved,
+                const int64_t *regs, bool is_greater, bool is_less, bool is_equal,
+                uint64_t cost) {
+    int64_t values[MEMO_MAX_INPUTS] = {0};
+    for (int i = 0; i < function->input_count; i++) {
+        int r     = function->inputs[i];
+        values[i] = r == REG_SP ? regs[REG_SP] : saved[r];
+    }
+
+    MemoEntry *entry = &table->entries[hash_key(function, values) & (MEMO_CAPACITY - 1)];
+    if (entry->function && !same_key(entry, function, values)) {
+        table->evictions++;
+    }
+    entry->function = function;
+    memcpy(entry->inputs, values, sizeof(values));
+    entry->result     = regs[0];
+    entry->is_greater = is_greater;
+    entry->is_less    = is_less;
+    entry->is_equal   = is_equal;
+    entry->cost       = cost;
+}
+
+void memo_free(MemoTable *table, Command *commands) {
+    for (Command *cmd = commands; cmd; cmd = cmd->next) {
+        cmd->memo = NULL;
+    }
+    free(table->functions);
+    free(table->entries);
+    memset(table, 0, sizeof(*table));
+}
+
+/**
+ * @brief Finds the function a call enters.
+ *
+ * @return The index of the function, or -1 if the call's label is missing.
+ */
+static int callee(const Analysis *an, const Command *call) {
+    Command *target = find_label(an->map, call->destination.str_val);
+    return target && target->block ? an->function_of[target->block->id] : -1;
+}
+
+/**
+ * @brief Adds a function starting at a block, assumed pure until shown
+ * otherwise.
+ *
+ * @return False if memory ran out.
+ */
+static bool add_function(Analysis *an, BasicBlock *entry) {
+    if (an->count == an->capacity) {
+        int       capacity  = an->capacity ? an->capacity * 2 : 16;
+        Function *functions = (Function *) realloc(an->functions,
+                                                   (size_t) capacity * sizeof(Function));
+        if (!functions) {
+            return false;
+        }
+        an->functions = functions;
+        an->capacity  = capacity;
+    }
+    an->function_of[entry->id] = an->count;
+    an->functions[an->count++] = (Function) {entry, NULL, 0, true, 0, -1};
+    return true;
+}
+
+/**
+ * @brief Determines whether a pure function may run a command: it must not
+ * touch memory, the stack pointer or the outside world.
+ */
+static bool allowed(const Command *cmd) {
+    switch (cmd->type) {
+        case CMD_MOV:
+        case CMD_ADD:
+        case CMD_SUB:
+        case CMD_AND:
+        case CMD_ORR:
+        case CMD_EOR:
+        case CMD_ASR:
+        case CMD_LSL:
+        case CMD_LSR:
+            return cmd->destination.num_val != REG_SP;
+        case CMD_CMP:
+        case CMD_CMP_U:
+        case CMD_BRANCH:
+        case CMD_CALL:
+        case CMD_RET:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief Determines whether the program may end after a block: it neither
+ * returns nor always branches, and no command follows it.
+ */
+static bool ends_program(const BasicBlock *block) {
+    const Command *last = block->last;
+    if (last->type == CMD_BRANCH) {
+        return !block->taken || (!block->fallthrough && last->branch_condition != BRANCH_NONE);
+    }
+    return !block->fallthrough && last->type != CMD_RET;
+}
+
+/**
+ * @brief Collects the blocks a function can reach before it returns, and
+ * clears `pure` if any of them does something a pure function may not.
+ *
+ * The blocks of functions it calls are not part of its body.
+ *
+ * @return False if memory ran out.
+ */
+static bool collect_body(Analysis *an, int f) {
+    Function *fn    = &an->functions[f];
+    int       limit = an->cfg.count;
+    fn->body        = (int *) malloc((size_t) limit * sizeof(int));
+    if (!fn->body) {
+        return false;
+    }
+
+    fn->body[fn->length++]  = fn->entry->id;
+    an->seen[fn->entry->id] = f;
+    for (int k = 0; k < fn->length; k++) {
+        BasicBlock *block = &an->cfg.blocks[fn->body[k]];
+        Command    *cmd   = block->first;
+        for (int i = 0; i < block->length; i++, cmd = cmd->next) {
+            fn->pure = fn->pure && allowed(cmd);
+        }
+        if (ends_program(block) || (block->last->type == CMD_CALL && callee(an, block->last) < 0)) {
+            fn->pure = false;
+        }
+
+        BasicBlock *next[2] = {block->last->type == CMD_CALL ? NULL : block->taken,
+                               block->last->type == CMD_RET ? NULL : block->fallthrough};
+        for (int s = 0; s < 2; s++) {
+            if (next[s] && an->seen[next[s]->id] != f) {
+                an->seen[next[s]->id]  = f;
+                fn->body[fn->length++] = next[s]->id;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Determines whether a function calls a function that is not pure.
+ */
+static bool calls_impure(const Analysis *an, const Function *fn) {
+    for (int k = 0; k < fn->length; k++) {
+        const Command *last = an->cfg.blocks[fn->body[k]].last;
+        if (last->type == CMD_CALL && !an->functions[callee(an, last)].pure) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Computes the registers a command of a pure function reads and
+ * writes.
+ *
+ * A call reads the inputs of its callee and writes x0; it also sets the
+ * flags, unless the callee may return the flags it was called with.
+ * Returning reads x0 and the flags, which the caller receives.
+ */
+static void effect(const Analysis *an, const Command *cmd, uint64_t *uses, uint64_t *defs) {
+    *uses = 0;
+    *defs = 0;
+    switch (cmd->type) {
+        case CMD_MOV:
+            *defs = reg_bit(cmd->destination.num_val);
+            break;
+        case CMD_ADD:
+        case CMD_SUB:
+        case CMD_AND:
+        case CMD_ORR:
+        case CMD_EOR:
+            *uses = reg_bit(cmd->val_a.num_val)
+                    | (cmd->is_b_immediate ? 0 : reg_bit(cmd->val_b.num_val));
+            *defs = reg_bit(cmd->destination.num_val);
+            break;
+        case CMD_ASR:
+        case CMD_LSL:
+        case CMD_LSR:
+            *uses = reg_bit(cmd->val_a.num_val);
+            *defs = reg_bit(cmd->destination.num_val);
+            break;
+        case CMD_CMP:
+        case CMD_CMP_U:
+            *uses = reg_bit(cmd->destination.num_val)
+                    | (cmd->is_a_immediate ? 0 : reg_bit(cmd->val_a.num_val));
+            *defs = FLAGS_BIT;
+            break;
+        case CMD_BRANCH:
+            if (cmd->branch_condition != BRANCH_NONE && cmd->branch_condition != BRANCH_ALWAYS) {
+                *uses = FLAGS_BIT;
+            }
+            break;
+        case CMD_CALL: {
+            uint64_t inputs = an->functions[callee(an, cmd)].inputs;
+            *uses           = inputs;
+            *defs           = reg_bit(0) | ((inputs & FLAGS_BIT) ? 0 : FLAGS_BIT);
+            break;
+        }
+        default:
+            // ret, the only other command a pure function runs
+            *uses = reg_bit(0) | FLAGS_BIT;
+            break;
+    }
+}
+
+/**
+ * @brief Returns the liveness bit of a register.
+ */
+static uint64_t reg_bit(int64_t reg) {
+    return (uint64_t) 1 << reg;
+}
+
+/**
+ * @brief Computes what is live on entry to a block of a pure function from
+ * what is live on exit.
+ */
+static uint64_t live_in(const Analysis *an, const BasicBlock *block, uint64_t out) {
+    uint64_t       gen  = 0;
+    uint64_t       kill = 0;
+    const Command *cmd  = block->first;
+    for (int i = 0; i < block->length; i++, cmd = cmd->next) {
+        uint64_t uses;
+        uint64_t defs;
+        effect(an, cmd, &uses, &defs);
+        gen |= uses & ~kill;
+        kill |= defs;
+    }
+    return gen | (out & ~kill);
+}
+
+/**
+ * @brief Computes the registers a pure function reads before writing them,
+ * given the current inputs of the functions it calls.
+ */
+static uint64_t function_inputs(Analysis *an, const Function *fn) {
+    for (int k = 0; k < fn->length; k++) {
+        an->live[fn->body[k]] = 0;
+    }
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int k = fn->length - 1; k >= 0; k--) {
+            const BasicBlock *block = &an->cfg.blocks[fn->body[k]];
+            CommandType       type  = block->last->type;
+            uint64_t          out   = 0;
+            if (type != CMD_RET) {
+                if (type != CMD_CALL && block->taken) {
+                    out |= an->live[block->taken->id];
+                }
+                if (block->fallthrough) {
+                    out |= an->live[block->fallthrough->id];
+                }
+            }
+            uint64_t in = live_in(an, block, out);
+            if (in != an->live[block->id]) {
+                an->live[block->id] = in;
+                changed             = true;
+            }
+        }
+    }
+    return an->live[fn->entry->id];
+}
+
+/**
+ * @brief Computes the inputs of every pure function. Recursive functions
+ * depend on their own inputs, so they are recomputed until none changes.
+ */
+static void find_inputs(Analysis *an) {
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int f = 0; f < an->count; f++) {
+            Function *fn = &an->functions[f];
+            if (!fn->pure) {
+                continue;
+            }
+            uint64_t inputs = function_inputs(an, fn);
+            if (inputs != fn->inputs) {
+                fn->inputs = inputs;
+                changed    = true;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Determines whether the calls of a function can be cached: it is
+ * pure, does not read the caller's flags, and has few enough inputs to key
+ * the cache.
+ */
+static bool cacheable(const Function *fn) {
+    int inputs = 0;
+    for (int r = 0; r < NUM_REGISTERS; r++) {
+        inputs += (fn->inputs >> r) & 1;
+    }
+    return fn->pure && !(fn->inputs & FLAGS_BIT) && inputs <= MEMO_MAX_INPUTS;
+}
+
+/**
+ * @brief Allocates the cache and marks the calls of every cacheable function.
+ *
+ * @return False if memory ran out.
+ */
+static bool build_table(MemoTable *table, Analysis *an, Command *commands) {
+    table->functions = (MemoFunction *) calloc((size_t) an->count + 1, sizeof(MemoFunction));
+    table->entries   = (MemoEntry *) calloc(MEMO_CAPACITY, sizeof(MemoEntry));
+    if (!table->functions || !table->entries) {
+        return false;
+    }
+
+    for (int f = 0; f < an->count; f++) {
+        Function *fn = &an->functions[f];
+        if (!cacheable(fn)) {
+            continue;
+        }
+        MemoFunction *memo = &table->functions[table->function_count];
+        memo->id           = table->function_count;
+        for (int r = 0; r < NUM_REGISTERS; r++) {
+            if ((fn->inputs >> r) & 1) {
+                memo->inputs[memo->input_count++] = (uint8_t) r;
+            }
+        }
+        fn->memo = table->function_count++;
+    }
+
+    for (Command *cmd = commands; cmd; cmd = cmd->next) {
+        if (cmd->type == CMD_CALL) {
+            int f = callee(an, cmd);
+            if (f >= 0 && an->functions[f].memo >= 0) {
+                cmd->memo = &table->functions[an->functions[f].memo];
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Hashes a function and the values of its inputs.
+ */
+static uint64_t hash_key(const MemoFunction *function, const int64_t *values) {
+    uint64_t hash = 0x9E3779B97F4A7C15u * (uint64_t) (function->id + 1);
+    for (int i = 0; i < function->input_count; i++) {
+        hash ^= (uint64_t) values[i];
+        hash *= 0xFF51AFD7ED558CCDu;
+        hash ^= hash >> 33;
+    }
+    return hash;
+}
+
+/**
+ * @brief Determines whether a cache entry holds the result for a function
+ * and the values of its inputs.
+ */
+static bool same_key(const MemoEntry *entry, const MemoFunction *function,
+                     const int64_t *values) {
+    if (entry->function != function) {
+        return false;
+    }
+    for (int i = 0; i < function->input_count; i++) {
+        if (entry->inputs[i] != values[i]) {
+            return false;
+        }
+    }
+    return true;
+}
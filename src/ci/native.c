@@ -0,0 +1,566 @@
+#define _DEFAULT_SOURCE
+#include "native.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mem.h"
+
+#if defined(__x86_64__) && defined(__linux__)
+#include <sys/mman.h>
+
+/**
+ * @brief A precompiled fragment of x86-64 machine code with at most one hole.
+ *
+ * Generated code keeps the `Interpreter *` in rdi, so every register and flag
+ * is addressed as a 32-bit displacement from rdi. rax, rcx and rdx are used
+ * as scratch registers and the result is returned in rax.
+ */
+typedef struct {
+    uint8_t bytes[12];   // The machine code, with zeroes where the hole is.
+    uint8_t length;      // The number of bytes of machine code.
+    int8_t  hole;        // The offset of the hole, or -1 if there is none.
+    uint8_t hole_width;  // The width of the hole in bytes.
+} Stencil;
+
+// clang-format off
+static const Stencil LOAD_RAX    = {{0x48, 0x8B, 0x87}, 7, 3, 4};        // mov rax, [rdi+d32]
+static const Stencil LOAD_RCX    = {{0x48, 0x8B, 0x8F}, 7, 3, 4};        // mov rcx, [rdi+d32]
+static const Stencil LOAD_RDX    = {{0x48, 0x8B, 0x97}, 7, 3, 4};        // mov rdx, [rdi+d32]
+static const Stencil STORE_RAX   = {{0x48, 0x89, 0x87}, 7, 3, 4};        // mov [rdi+d32], rax
+static const Stencil MOV_RAX_IMM = {{0x48, 0xB8}, 10, 2, 8};             // mov rax, imm64
+static const Stencil MOV_RCX_IMM = {{0x48, 0xB9}, 10, 2, 8};             // mov rcx, imm64
+static const Stencil MOV_RDX_IMM = {{0x48, 0xBA}, 10, 2, 8};             // mov rdx, imm64
+static const Stencil MOV_ECX_IMM = {{0xB9}, 5, 1, 4};                    // mov ecx, imm32
+static const Stencil ADD_RAX_MEM = {{0x48, 0x03, 0x87}, 7, 3, 4};        // add rax, [rdi+d32]
+static const Stencil SUB_RAX_MEM = {{0x48, 0x2B, 0x87}, 7, 3, 4};        // sub rax, [rdi+d32]
+static const Stencil AND_RAX_MEM = {{0x48, 0x23, 0x87}, 7, 3, 4};        // and rax, [rdi+d32]
+static const Stencil XOR_RAX_MEM = {{0x48, 0x33, 0x87}, 7, 3, 4};        // xor rax, [rdi+d32]
+static const Stencil OR_RAX_MEM  = {{0x48, 0x0B, 0x87}, 7, 3, 4};        // or rax, [rdi+d32]
+static const Stencil CMP_RAX_MEM = {{0x48, 0x3B, 0x87}, 7, 3, 4};        // cmp rax, [rdi+d32]
+static const Stencil ADD_RAX_RCX = {{0x48, 0x01, 0xC8}, 3, -1, 0};       // add rax, rcx
+static const Stencil ADD_RAX_RDX = {{0x48, 0x01, 0xD0}, 3, -1, 0};       // add rax, rdx
+static const Stencil SUB_RAX_RCX = {{0x48, 0x29, 0xC8}, 3, -1, 0};       // sub rax, rcx
+static const Stencil CMP_RAX_RCX = {{0x48, 0x39, 0xC8}, 3, -1, 0};       // cmp rax, rcx
+static const Stencil CMP_RAX_RDX = {{0x48, 0x39, 0xD0}, 3, -1, 0};       // cmp rax, rdx
+static const Stencil SAR_RAX_CL  = {{0x48, 0xD3, 0xF8}, 3, -1, 0};       // sar rax, cl
+static const Stencil SHL_RAX_CL  = {{0x48, 0xD3, 0xE0}, 3, -1, 0};       // shl rax, cl
+static const Stencil SHR_RAX_CL  = {{0x48, 0xD3, 0xE8}, 3, -1, 0};       // shr rax, cl
+static const Stencil SETCC_MEM   = {{0x0F, 0x90, 0x87}, 7, 3, 4};        // setcc [rdi+d32]
+static const Stencil MOV_AL_MEM  = {{0x8A, 0x87}, 6, 2, 4};              // mov al, [rdi+d32]
+static const Stencil OR_AL_MEM   = {{0x0A, 0x87}, 6, 2, 4};              // or al, [rdi+d32]
+static const Stencil XOR_AL_1    = {{0x34, 0x01}, 2, -1, 0};             // xor al, 1
+static const Stencil TEST_AL_AL  = {{0x84, 0xC0}, 2, -1, 0};             // test al, al
+static const Stencil TEST_RCX    = {{0x48, 0x85, 0xC9}, 3, -1, 0};       // test rcx, rcx
+static const Stencil JCC_SHORT   = {{0x70, 0x00}, 2, 0, 1};              // jcc rel8 (cc patched)
+static const Stencil JCC_NEAR    = {{0x0F, 0x80}, 6, 1, 1};              // jcc rel32 (cc patched)
+static const Stencil RET         = {{0xC3}, 1, -1, 0};                   // ret
+static const Stencil LOAD_B      = {{0x0F, 0xB6, 0x04, 0x01}, 4, -1, 0}; // movzx eax, byte [rcx+rax]
+static const Stencil LOAD_W      = {{0x0F, 0xB7, 0x04, 0x01}, 4, -1, 0}; // movzx eax, word [rcx+rax]
+static const Stencil LOAD_D      = {{0x8B, 0x04, 0x01}, 3, -1, 0};       // mov eax, [rcx+rax]
+static const Stencil LOAD_Q      = {{0x48, 0x8B, 0x04, 0x01}, 4, -1, 0}; // mov rax, [rcx+rax]
+static const Stencil STORE_B     = {{0x88, 0x14, 0x01}, 3, -1, 0};       // mov [rcx+rax], dl
+static const Stencil STORE_W     = {{0x66, 0x89, 0x14, 0x01}, 4, -1, 0}; // mov [rcx+rax], dx
+static const Stencil STORE_D     = {{0x89, 0x14, 0x01}, 3, -1, 0};       // mov [rcx+rax], edx
+static const Stencil STORE_Q     = {{0x48, 0x89, 0x14, 0x01}, 4, -1, 0}; // mov [rcx+rax], rdx
+// clang-format on
+
+// Condition codes of x86 jcc/setcc instructions
+enum { CC_B = 0x2, CC_E = 0x4, CC_NE = 0x5, CC_BE = 0x6, CC_A = 0x7, CC_L = 0xC, CC_GE = 0xD,
+       CC_LE = 0xE, CC_G = 0xF };
+
+// Length of an exit sequence: mov rax, imm64; ret
+#define EXIT_LENGTH 11
+
+// Tag of deoptimizations, which return the instruction that failed its check
+#define EXIT_DEOPT 1u
+// Tag of exits through a guard or the end of a side trace, which return the
+// instruction they left through so the caller can follow its link
+#define EXIT_LINK 2u
+
+/**
+ * @brief A growable buffer of machine code being generated.
+ */
+typedef struct {
+    uint8_t *bytes;     // The generated code.
+    size_t   length;    // The number of bytes generated.
+    size_t   capacity;  // The capacity of `bytes`.
+    bool     failed;    // Set if an allocation failed.
+} CodeBuffer;
+
+static void     emit(CodeBuffer *buf, const Stencil *st, uint64_t hole_value);
+static void     emit_setcc(CodeBuffer *buf, int cc, size_t flag_offset);
+static void     emit_exit(CodeBuffer *buf, const Command *target);
+static void     emit_flags(CodeBuffer *buf, bool is_unsigned);
+static void     emit_branch(CodeBuffer *buf, const TierInsn *insn);
+static void     emit_condition(CodeBuffer *buf, BranchCondition cond);
+static void     emit_mem_access(CodeBuffer *buf, const TierInsn *insn, bool is_load);
+static void     emit_guard(CodeBuffer *buf, const TierInsn *insn);
+static size_t   emit_jcc_near(CodeBuffer *buf, int cc);
+static void     patch_jump(CodeBuffer *buf, size_t jump, size_t target);
+static void     emit_loop(CodeBuffer *buf, const TierInsn *insn, const TierCode *code);
+static bool     emit_insn(CodeBuffer *buf, const TierInsn *insn, const TierCode *code);
+static uint32_t reg_disp(uint8_t reg);
+
+/**
+ * @brief Copies a stencil into the buffer and patches its hole.
+ *
+ * @param buf The buffer to append to.
+ * @param st The stencil to copy.
+ * @param hole_value The value to patch into the stencil's hole.
+ */
+static void emit(CodeBuffer *buf, const Stencil *st, uint64_t hole_value) {
+    if (buf->failed) {
+        return;
+    }
+    if (buf->length + st->length > buf->capacity) {
+        size_t   capacity = buf->capacity ? buf->capacity * 2 : 256;
+        uint8_t *bytes    = (uint8_t *) realloc(buf->bytes, capacity);
+        if (!bytes) {
+            buf->failed = true;
+            return;
+        }
+        buf->bytes    = bytes;
+        buf->capacity = capacity;
+    }
+
+    uint8_t *at = buf->bytes + buf->length;
+    memcpy(at, st->bytes, st->length);
+    if (st->hole >= 0) {
+        if (st->hole_width == 1) {
+            // One-byte holes hold the condition code of the opcode byte
+            at[st->hole] |= (uint8_t) hole_value;
+        } else {
+            // x86-64 is little endian, so the low bytes of the value come first
+            memcpy(at + st->hole, &hole_value, st->hole_width);
+        }
+    }
+    buf->length += st->length;
+}
+
+/**
+ * @brief Returns the displacement of a variable from the interpreter pointer.
+ *
+ * @param reg The variable's index.
+ * @return The displacement of `variables[reg]`.
+ */
+static uint32_t reg_disp(uint8_t reg) {
+    return (uint32_t) (offsetof(Interpreter, variables) + reg * sizeof(int64_t));
+}
+
+/**
+ * @brief Emits a setcc storing a condition into one of the interpreter's flags.
+ *
+ * @param buf The buffer to append to.
+ * @param cc The condition code to store.
+ * @param flag_offset The offset of the flag within the interpreter.
+ */
+static void emit_setcc(CodeBuffer *buf, int cc, size_t flag_offset) {
+    size_t start = buf->length;
+    emit(buf, &SETCC_MEM, flag_offset);
+    if (!buf->failed) {
+        buf->bytes[start + 1] = (uint8_t) (0x90 | cc);
+    }
+}
+
+/**
+ * @brief Emits the flag updates following a comparison of rax.
+ *
+ * @param buf The buffer to append to.
+ * @param is_unsigned Whether the comparison was unsigned.
+ */
+static void emit_flags(CodeBuffer *buf, bool is_unsigned) {
+    emit_setcc(buf, is_unsigned ? CC_A : CC_G, offsetof(Interpreter, is_greater));
+    emit_setcc(buf, is_unsigned ? CC_B : CC_L, offsetof(Interpreter, is_less));
+    emit_setcc(buf, CC_E, offsetof(Interpreter, is_equal));
+}
+
+/**
+ * @brief Emits an exit sequence returning the given command.
+ *
+ * @param buf The buffer to append to.
+ * @param target The command to return.
+ */
+static void emit_exit(CodeBuffer *buf, const Command *target) {
+    emit(buf, &MOV_RAX_IMM, (uint64_t) (uintptr_t) target);
+    emit(buf, &RET, 0);
+}
+
+/**
+ * @brief Emits a branch whose condition is evaluated from the stored flags.
+ *
+ * Flags are only ever set together by a comparison, so at most one of them is
+ * set and e.g. `b.eq` only has to test `is_equal`.
+ *
+ * @param buf The buffer to append to.
+ * @param insn The branch instruction.
+ */
+static void emit_branch(CodeBuffer *buf, const TierInsn *insn) {
+    if (insn->cond == BRANCH_NONE || insn->cond == BRANCH_ALWAYS) {
+        emit_exit(buf, insn->target);
+        return;
+    }
+    emit_condition(buf, insn->cond);
+
+    // Skip the taken exit if the condition does not hold
+    emit(buf, &JCC_SHORT, CC_E);
+    if (!buf->failed) {
+        buf->bytes[buf->length - 1] = EXIT_LENGTH;
+    }
+    emit_exit(buf, insn->target);
+    emit_exit(buf, insn->next);
+}
+
+/**
+ * @brief Emits code setting the zero flag when a branch condition does not
+ * hold, evaluated from the stored flags.
+ *
+ * Flags are only ever set together by a comparison, so at most one of them is
+ * set and e.g. `b.eq` only has to test `is_equal`.
+ *
+ * @param buf The buffer to append to.
+ * @param cond The condition to evaluate; not BRANCH_NONE or BRANCH_ALWAYS.
+ */
+static void emit_condition(CodeBuffer *buf, BranchCondition cond) {
+    size_t gt = offsetof(Interpreter, is_greater);
+    size_t lt = offsetof(Interpreter, is_less);
+    size_t eq = offsetof(Interpreter, is_equal);
+
+    switch (cond) {
+        case BRANCH_NONE:
+        case BRANCH_ALWAYS:
+        case BRANCH_EQUAL:
+        case BRANCH_NOT_EQUAL:
+            emit(buf, &MOV_AL_MEM, eq);
+            if (cond == BRANCH_NOT_EQUAL) {
+                emit(buf, &XOR_AL_1, 0);
+            }
+            break;
+        case BRANCH_GREATER:
+        case BRANCH_LESS:
+            emit(buf, &MOV_AL_MEM, cond == BRANCH_GREATER ? gt : lt);
+            break;
+        case BRANCH_GREATER_EQUAL:
+        case BRANCH_LESS_EQUAL:
+            emit(buf, &MOV_AL_MEM, cond == BRANCH_GREATER_EQUAL ? gt : lt);
+            emit(buf, &OR_AL_MEM, eq);
+            break;
+    }
+    emit(buf, &TEST_AL_AL, 0);
+}
+
+/**
+ * @brief Emits a load or store, bounds-checked unless it was proven in bounds.
+ *
+ * @param buf The buffer to append to.
+ * @param insn The load or store instruction.
+ * @param is_load Whether the access is a load.
+ */
+static void emit_mem_access(CodeBuffer *buf, const TierInsn *insn, bool is_load) {
+    bool imm_addr = insn->op == TOP_LOAD_I || insn->op == TOP_STORE_I;
+    if (imm_addr) {
+        emit(buf, &MOV_RAX_IMM, (uint64_t) insn->imm);
+    } else {
+        emit(buf, &LOAD_RAX, reg_disp(insn->b));
+    }
+
+    // Deoptimize unless address <= MEM_CAPACITY - width (unsigned)
+    if (!insn->proven) {
+        emit(buf, &MOV_RDX_IMM, MEM_CAPACITY - insn->width);
+        emit(buf, &CMP_RAX_RDX, 0);
+        emit(buf, &JCC_SHORT, 0x6);  // jbe
+        if (!buf->failed) {
+            buf->bytes[buf->length - 1] = EXIT_LENGTH;
+        }
+        emit(buf, &MOV_RAX_IMM, (uint64_t) (uintptr_t) insn | EXIT_DEOPT);
+        emit(buf, &RET, 0);
+    }
+
+    emit(buf, &MOV_RCX_IMM, (uint64_t) (uintptr_t) mem_base());
+    if (is_load) {
+        const Stencil *load = insn->width == 1   ? &LOAD_B
+                              : insn->width == 2 ? &LOAD_W
+                              : insn->width == 4 ? &LOAD_D
+                                                 : &LOAD_Q;
+        emit(buf, load, 0);
+        emit(buf, &STORE_RAX, reg_disp(insn->dst));
+    } else {
+        const Stencil *store = insn->width == 1   ? &STORE_B
+                               : insn->width == 2 ? &STORE_W
+                               : insn->width == 4 ? &STORE_D
+                                                  : &STORE_Q;
+        emit(buf, &LOAD_RDX, reg_disp(insn->dst));
+        emit(buf, store, 0);
+    }
+}
+
+/**
+ * @brief Emits a trace guard, which leaves through itself when the branch it
+ * was recorded from goes the other way.
+ *
+ * Side traces are attached to guards after the code was generated, so the
+ * caller follows the guard's link, if any, rather than the code.
+ *
+ * @param buf The buffer to append to.
+ * @param insn The guard instruction.
+ */
+static void emit_guard(CodeBuffer *buf, const TierInsn *insn) {
+    if (insn->cond == BRANCH_NONE || insn->cond == BRANCH_ALWAYS) {
+        if (insn->expect) {
+            return;
+        }
+    } else {
+        emit_condition(buf, insn->cond);
+        emit(buf, &JCC_SHORT, insn->expect ? CC_NE : CC_E);
+        if (!buf->failed) {
+            buf->bytes[buf->length - 1] = EXIT_LENGTH;
+        }
+    }
+    emit(buf, &MOV_RAX_IMM, (uint64_t) (uintptr_t) insn | EXIT_LINK);
+    emit(buf, &RET, 0);
+}
+
+/**
+ * @brief Emits a jcc with a 32-bit displacement to be patched later.
+ *
+ * @param buf The buffer to append to.
+ * @param cc The condition code of the jump.
+ * @return The offset of the end of the jump, which `patch_jump` takes.
+ */
+static size_t emit_jcc_near(CodeBuffer *buf, int cc) {
+    emit(buf, &JCC_NEAR, (uint64_t) cc);
+    return buf->length;
+}
+
+/**
+ * @brief Points a jump emitted by `emit_jcc_near` at an offset in the code.
+ *
+ * @param buf The buffer holding the jump.
+ * @param jump The offset of the end of the jump.
+ * @param target The offset to jump to.
+ */
+static void patch_jump(CodeBuffer *buf, size_t jump, size_t target) {
+    if (!buf->failed) {
+        int32_t rel = (int32_t) ((int64_t) target - (int64_t) jump);
+        memcpy(buf->bytes + jump - 4, &rel, sizeof(rel));
+    }
+}
+
+/**
+ * @brief Emits the end of a trace: charges the commands of one trip against
+ * the instruction limit as `charge_instructions` does, then jumps back to the
+ * start of a root trace or leaves a side trace through the loop instruction.
+ * Past the limit, the code exits to the loop header.
+ *
+ * @param buf The buffer to append to.
+ * @param insn The loop instruction.
+ * @param code The trace being translated.
+ */
+static void emit_loop(CodeBuffer *buf, const TierInsn *insn, const TierCode *code) {
+    emit(buf, &LOAD_RCX, offsetof(Interpreter, instruction_limit));
+    emit(buf, &TEST_RCX, 0);
+    size_t unlimited = emit_jcc_near(buf, CC_E);
+    emit(buf, &LOAD_RAX, offsetof(Interpreter, executed));
+    emit(buf, &MOV_RDX_IMM, (uint64_t) insn->imm);
+    emit(buf, &ADD_RAX_RDX, 0);
+    emit(buf, &STORE_RAX, offsetof(Interpreter, executed));
+    emit(buf, &CMP_RAX_RCX, 0);
+    size_t within = emit_jcc_near(buf, CC_BE);
+    emit_exit(buf, insn->target);
+
+    // Root traces start over; side traces continue in the root trace
+    size_t again = 0;
+    if (insn->link != code) {
+        again = buf->length;
+        emit(buf, &MOV_RAX_IMM, (uint64_t) (uintptr_t) insn | EXIT_LINK);
+        emit(buf, &RET, 0);
+    }
+    patch_jump(buf, unlimited, again);
+    patch_jump(buf, within, again);
+}
+
+/**
+ * @brief Emits the machine code for a single instruction.
+ *
+ * @param buf The buffer to append to.
+ * @param insn The instruction to translate.
+ * @param code The code the instruction belongs to.
+ * @return True if the instruction has a stencil, false otherwise.
+ */
+static bool emit_insn(CodeBuffer *buf, const TierInsn *insn, const TierCode *code) {
+    switch ((TierOp) insn->op) {
+        case TOP_MOV:
+            emit(buf, &MOV_RAX_IMM, (uint64_t) insn->imm);
+            emit(buf, &STORE_RAX, reg_disp(insn->dst));
+            return true;
+        case TOP_ADD_RR:
+        case TOP_SUB_RR:
+        case TOP_AND:
+        case TOP_EOR:
+        case TOP_ORR: {
+            const Stencil *alu = insn->op == TOP_ADD_RR   ? &ADD_RAX_MEM
+                                 : insn->op == TOP_SUB_RR ? &SUB_RAX_MEM
+                                 : insn->op == TOP_AND    ? &AND_RAX_MEM
+                                 : insn->op == TOP_EOR    ? &XOR_RAX_MEM
+                                                          : &OR_RAX_MEM;
+            emit(buf, &LOAD_RAX, reg_disp(insn->a));
+            emit(buf, alu, reg_disp(insn->b));
+            emit(buf, &STORE_RAX, reg_disp(insn->dst));
+            return true;
+        }
+        case TOP_ADD_RI:
+        case TOP_SUB_RI:
+            emit(buf, &LOAD_RAX, reg_disp(insn->a));
+            emit(buf, &MOV_RCX_IMM, (uint64_t) insn->imm);
+            emit(buf, insn->op == TOP_ADD_RI ? &ADD_RAX_RCX : &SUB_RAX_RCX, 0);
+            emit(buf, &STORE_RAX, reg_disp(insn->dst));
+            return true;
+        case TOP_ASR:
+        case TOP_LSL:
+        case TOP_LSR: {
+            const Stencil *shift = insn->op == TOP_ASR   ? &SAR_RAX_CL
+                                   : insn->op == TOP_LSL ? &SHL_RAX_CL
+                                                         : &SHR_RAX_CL;
+            emit(buf, &LOAD_RAX, reg_disp(insn->a));
+            emit(buf, &MOV_ECX_IMM, (uint64_t) insn->imm);
+            emit(buf, shift, 0);
+            emit(buf, &STORE_RAX, reg_disp(insn->dst));
+            return true;
+        }
+        case TOP_CMP_RR:
+        case TOP_CMP_U_RR:
+        case TOP_CMP_BRANCH_RR:
+            emit(buf, &LOAD_RAX, reg_disp(insn->a));
+            emit(buf, &CMP_RAX_MEM, reg_disp(insn->b));
+            emit_flags(buf, insn->op == TOP_CMP_U_RR);
+            break;
+        case TOP_CMP_RI:
+        case TOP_CMP_U_RI:
+        case TOP_CMP_BRANCH_RI:
+            emit(buf, &LOAD_RAX, reg_disp(insn->a));
+            emit(buf, &MOV_RCX_IMM, (uint64_t) insn->imm);
+            emit(buf, &CMP_RAX_RCX, 0);
+            emit_flags(buf, insn->op == TOP_CMP_U_RI);
+            break;
+        case TOP_LOAD_R:
+        case TOP_LOAD_I:
+            emit_mem_access(buf, insn, true);
+            return true;
+        case TOP_STORE_R:
+        case TOP_STORE_I:
+            emit_mem_access(buf, insn, false);
+            return true;
+        case TOP_BRANCH:
+            emit_branch(buf, insn);
+            return true;
+        case TOP_EXIT:
+            emit_exit(buf, insn->target);
+            return true;
+        case TOP_GUARD:
+            emit_guard(buf, insn);
+            return true;
+        case TOP_LOOP:
+            emit_loop(buf, insn, code);
+            return true;
+        default:
+            return false;
+    }
+
+    if (insn->op == TOP_CMP_BRANCH_RR || insn->op == TOP_CMP_BRANCH_RI) {
+        // setcc leaves the comparison's flags intact, so branch on them directly
+        static const int taken_cc[] = {
+            [BRANCH_EQUAL] = CC_E,          [BRANCH_NOT_EQUAL] = CC_NE, [BRANCH_GREATER] = CC_G,
+            [BRANCH_LESS] = CC_L,           [BRANCH_GREATER_EQUAL] = CC_GE,
+            [BRANCH_LESS_EQUAL] = CC_LE,
+        };
+        if (insn->cond == BRANCH_NONE || insn->cond == BRANCH_ALWAYS) {
+            emit_exit(buf, insn->target);
+            return true;
+        }
+        emit(buf, &JCC_SHORT, taken_cc[insn->cond] ^ 1);
+        if (!buf->failed) {
+            buf->bytes[buf->length - 1] = EXIT_LENGTH;
+        }
+        emit_exit(buf, insn->target);
+        emit_exit(buf, insn->next);
+    }
+    return true;
+}
+
+bool native_available(void) {
+    return true;
+}
+
+bool native_compile(TierCode *code) {
+    CodeBuffer buf = {NULL, 0, 0, false};
+    for (int i = 0; i < code->count; i++) {
+        if (!emit_insn(&buf, &code->insns[i], code)) {
+            free(buf.bytes);
+            return false;
+        }
+    }
+    if (buf.failed) {
+        free(buf.bytes);
+        return false;
+    }
+
+    void *exec = mmap(NULL, buf.length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (exec == MAP_FAILED) {
+        free(buf.bytes);
+        return false;
+    }
+    memcpy(exec, buf.bytes, buf.length);
+    free(buf.bytes);
+    if (mprotect(exec, buf.length, PROT_READ | PROT_EXEC) != 0) {
+        munmap(exec, buf.length);
+        return false;
+    }
+
+    code->native      = exec;
+    code->native_size = buf.length;
+    return true;
+}
+
+Command *native_run(Interpreter *intr, const TierCode *code, TierInsn **exit, bool *deopt) {
+    uintptr_t (*entry)(Interpreter *);
+    // ISO C has no conversion from object to function pointers; copy the bits
+    memcpy(&entry, &code->native, sizeof(entry));
+
+    uintptr_t result = entry(intr);
+    *deopt           = (result & EXIT_DEOPT) != 0;
+    if (result & (EXIT_DEOPT | EXIT_LINK)) {
+        *exit = (TierInsn *) (result & ~(uintptr_t) (EXIT_DEOPT | EXIT_LINK));
+        return *deopt ? (*exit)->source : (*exit)->target;
+    }
+    *exit = NULL;
+    return (Command *) result;
+}
+
+void native_free(TierCode *code) {
+    if (code && code->native) {
+        munmap(code->native, code->native_size);
+        code->native      = NULL;
+        code->native_size = 0;
+    }
+}
+
+#else
+
+bool native_available(void) {
+    return false;
+}
+
+bool native_compile(TierCode *code) {
+    return false;
+}
+
+Command *native_run(Interpreter *intr, const TierCode *code, TierInsn **exit, bool *deopt) {
+    *exit  = NULL;
+    *deopt = true;
+    return NULL;
+}
+
+void native_free(TierCode *code) {
+}
+
+#endif
@@ -9,6 +9,100 @@
 #include "command_type.h"
 #include "token_type.h"
 
+#define MAX_OPERANDS 3  // Most operands any instruction takes
+
+/**
+ * @brief The kinds of operand an instruction can take.
+ */
+typedef enum {
+    OPD_REG,         // A register, x0 through x31 or sp
+    OPD_IMM,         // A number
+    OPD_REG_OR_IMM,  // A register or a number
+    OPD_BASE,        // A print base: d, x, s or b
+    OPD_LABEL,       // A label name
+    OPD_STRING,      // A string literal
+    OPD_REG_RANGE,   // A register or a braced range such as {x1-x4}, into val_a and val_b
+} OperandKind;
+
+/**
+ * @brief The command field an operand is stored in.
+ */
+typedef enum {
+    SLOT_DEST,  // destination
+    SLOT_A,     // val_a, with is_a_immediate and is_a_string
+    SLOT_B,     // val_b, with is_b_immediate and is_b_string
+} OperandSlot;
+
+/**
+ * @brief One expected operand of an instruction.
+ */
+typedef struct {
+    OperandKind kind;  // What the operand may be
+    OperandSlot slot;  // Where the parsed operand is stored
+} OperandSpec;
+
+/**
+ * @brief The syntax of one instruction and the command it parses into.
+ */
+typedef struct {
+    bool            is_instruction;          // False for tokens that do not start an instruction
+    CommandType     type;                    // The command the instruction parses into
+    BranchCondition condition;               // The branch condition, or BRANCH_NONE
+    int             operand_count;           // Number of entries in `operands`
+    OperandSpec     operands[MAX_OPERANDS];  // Expected operands, in source order
+} InstructionDef;
+
+#define REG(slot) {OPD_REG, slot}
+#define IMM(slot) {OPD_IMM, slot}
+#define REG_OR_IMM(slot) {OPD_REG_OR_IMM, slot}
+#define BASE(slot) {OPD_BASE, slot}
+#define LABEL(slot) {OPD_LABEL, slot}
+#define STRING(slot) {OPD_STRING, slot}
+#define REG_RANGE(slot) {OPD_REG_RANGE, slot}
+
+// Indexed by mnemonic; adding an instruction only takes a row here
+static const InstructionDef instructions[] = {
+    [TOK_ADD]        = {true, CMD_ADD, BRANCH_NONE, 3,
+                       {REG(SLOT_DEST), REG(SLOT_A), REG_OR_IMM(SLOT_B)}},
+    [TOK_SUB]        = {true, CMD_SUB, BRANCH_NONE, 3,
+                       {REG(SLOT_DEST), REG(SLOT_A), REG_OR_IMM(SLOT_B)}},
+    [TOK_AND]        = {true, CMD_AND, BRANCH_NONE, 3, {REG(SLOT_DEST), REG(SLOT_A), REG(SLOT_B)}},
+    [TOK_EOR]        = {true, CMD_EOR, BRANCH_NONE, 3, {REG(SLOT_DEST), REG(SLOT_A), REG(SLOT_B)}},
+    [TOK_ORR]        = {true, CMD_ORR, BRANCH_NONE, 3, {REG(SLOT_DEST), REG(SLOT_A), REG(SLOT_B)}},
+    [TOK_ASR]        = {true, CMD_ASR, BRANCH_NONE, 3, {REG(SLOT_DEST), REG(SLOT_A), IMM(SLOT_B)}},
+    [TOK_LSL]        = {true, CMD_LSL, BRANCH_NONE, 3, {REG(SLOT_DEST), REG(SLOT_A), IMM(SLOT_B)}},
+    [TOK_LSR]        = {true, CMD_LSR, BRANCH_NONE, 3, {REG(SLOT_DEST), REG(SLOT_A), IMM(SLOT_B)}},
+    [TOK_MOV]        = {true, CMD_MOV, BRANCH_NONE, 2, {REG(SLOT_DEST), IMM(SLOT_A)}},
+    [TOK_CMP]        = {true, CMD_CMP, BRANCH_NONE, 2, {REG(SLOT_DEST), REG_OR_IMM(SLOT_A)}},
+    [TOK_CMP_U]      = {true, CMD_CMP_U, BRANCH_NONE, 2, {REG(SLOT_DEST), REG_OR_IMM(SLOT_A)}},
+    [TOK_STORE]      = {true, CMD_STORE, BRANCH_NONE, 3,
+                       {REG(SLOT_DEST), REG_OR_IMM(SLOT_A), IMM(SLOT_B)}},
+    [TOK_LOAD]       = {true, CMD_LOAD, BRANCH_NONE, 3,
+                       {REG(SLOT_DEST), IMM(SLOT_A), REG_OR_IMM(SLOT_B)}},
+    [TOK_PUT]        = {true, CMD_PUT, BRANCH_NONE, 2, {STRING(SLOT_A), REG_OR_IMM(SLOT_B)}},
+    [TOK_PRINT]      = {true, CMD_PRINT, BRANCH_NONE, 2, {REG_OR_IMM(SLOT_A), BASE(SLOT_B)}},
+    [TOK_BRANCH]     = {true, CMD_BRANCH, BRANCH_NONE, 1, {LABEL(SLOT_DEST)}},
+    [TOK_BRANCH_EQ]  = {true, CMD_BRANCH, BRANCH_EQUAL, 1, {LABEL(SLOT_DEST)}},
+    [TOK_BRANCH_NEQ] = {true, CMD_BRANCH, BRANCH_NOT_EQUAL, 1, {LABEL(SLOT_DEST)}},
+    [TOK_BRANCH_GT]  = {true, CMD_BRANCH, BRANCH_GREATER, 1, {LABEL(SLOT_DEST)}},
+    [TOK_BRANCH_LT]  = {true, CMD_BRANCH, BRANCH_LESS, 1, {LABEL(SLOT_DEST)}},
+    [TOK_BRANCH_GE]  = {true, CMD_BRANCH, BRANCH_GREATER_EQUAL, 1, {LABEL(SLOT_DEST)}},
+    [TOK_BRANCH_LE]  = {true, CMD_BRANCH, BRANCH_LESS_EQUAL, 1, {LABEL(SLOT_DEST)}},
+    [TOK_CALL]       = {true, CMD_CALL, BRANCH_NONE, 1, {LABEL(SLOT_DEST)}},
+    [TOK_CCALL]      = {true, CMD_CCALL, BRANCH_NONE, 1, {LABEL(SLOT_DEST)}},
+    [TOK_RET]        = {true, CMD_RET, BRANCH_NONE, 0, {{0}}},
+    [TOK_ALLOC]      = {true, CMD_ALLOC, BRANCH_NONE, 2, {REG(SLOT_DEST), REG_OR_IMM(SLOT_A)}},
+    [TOK_FREE]       = {true, CMD_FREE, BRANCH_NONE, 1, {REG(SLOT_A)}},
+    [TOK_REALLOC]    = {true, CMD_REALLOC, BRANCH_NONE, 3,
+                       {REG(SLOT_DEST), REG(SLOT_A), REG_OR_IMM(SLOT_B)}},
+    [TOK_PUSH]       = {true, CMD_PUSH, BRANCH_NONE, 1, {REG_RANGE(SLOT_A)}},
+    [TOK_POP]        = {true, CMD_POP, BRANCH_NONE, 1, {REG_RANGE(SLOT_A)}},
+    [TOK_WRITE]      = {true, CMD_WRITE, BRANCH_NONE, 3,
+                       {IMM(SLOT_DEST), REG(SLOT_A), REG_OR_IMM(SLOT_B)}},
+    [TOK_READ]       = {true, CMD_READ, BRANCH_NONE, 3,
+                       {IMM(SLOT_DEST), REG(SLOT_A), REG_OR_IMM(SLOT_B)}},
+};
+
 static Token    advance(Parser *parser);
 static bool     consume(Parser *parser, TokenType type);
 static bool     is_at_end(Parser *parser);
@@ -20,19 +114,25 @@ static bool     parse_variable(Token token, int64_t *var_num);
 static bool     parse_number(Token token, int64_t *result);
 static bool     parse_variable_operand(Parser *parser, Operand *op);
 static bool     parse_var_or_imm(Parser *parser, Operand *op, bool *is_immediate);
+static bool     parse_register_range(Parser *parser, Command *cmd);
 static Command *parse_cmd(Parser *parser);
+static Command *parse_instruction(Parser *parser, Token token, Command *command_ptr);
+static bool     parse_operand(Parser *parser, OperandSpec spec, Command *cmd);
+static bool     parse_text(Parser *parser, Operand *op, TokenType type);
+static char    *copy_lexeme(Token token);
 
 
-void parser_init(Parser *parser, Lexer *lexer, LabelMap *map) {
+void parser_init(Parser *parser, const TokenArray *tokens, LabelMap *map) {
     if (!parser) {
         return;
     }
 
-    parser->lexer     = lexer;
+    parser->tokens    = tokens;
+    parser->position  = 0;
     parser->had_error = false;
     parser->label_map = map;
-    parser->current   = lexer_next_token(parser->lexer);
-    parser->next      = lexer_next_token(parser->lexer);
+    parser->current   = token_array_get(tokens, 0);
+    parser->next      = token_array_get(tokens, 1);
 }
 
 /**
@@ -44,8 +144,9 @@ void parser_init(Parser *parser, Lexer *lexer, LabelMap *map) {
 static Token advance(Parser *parser) {
     Token ret_token = parser->current;
     if (!is_at_end(parser)) {
+        parser->position++;
         parser->current = parser->next;
-        parser->next    = lexer_next_token(parser->lexer);
+        parser->next    = token_array_get(parser->tokens, parser->position + 1);
     }
     return ret_token;
 }
@@ -105,13 +206,13 @@ static Command *create_command(CommandType type) {
  * @brief Determines if the given token is a valid variable.
  *
  * A valid (potential) variable is a token that begins with the prefix "x",
- * followed by any other character(s).
+ * followed by any other character(s), or the stack pointer, "sp".
  *
  * @param token The token to check.
  * @return True if this token could be a variable, false otherwise.
  */
 static bool is_variable(Token token) {
-    return token.length >= 2 && token.lexeme[0] == 'x';
+    return token.length >= 2 && (token.lexeme[0] == 'x' || token.lexeme[0] == 's');
 }
 
 /**
@@ -158,11 +259,18 @@ static bool parse_base(Parser *parser, Operand *op) {
  * @return True if `var_num` was successfully modified, false otherwise.
  *
  * @note It is assumed that the token already was verified to begin with a valid
- * prefix, "x".
+ * prefix, "x", or to be "sp".
  */
 static bool parse_variable(Token token, int64_t *var_num) {
     char   *endptr;
-    
+
+    if (token.length == 2 && memcmp(token.lexeme, "sp", 2) == 0) {
+        *var_num = REG_SP;
+        return true;
+    }
+    if (token.lexeme[0] != 'x') {
+        return false;
+    }
     int64_t tempnum = strtol(token.lexeme + 1, &endptr, 10);
 
     if ((token.lexeme + token.length) != endptr || tempnum < 0 || tempnum > 31) {
@@ -243,7 +351,7 @@ static bool parse_variable_operand(Parser *parser, Operand *op) {
     bool parsed = parse_variable(cur, &op->num_val);
     int64_t val = op->num_val;
 
-    if (val < 0 || val > 31 || !parsed) {
+    if (val < 0 || val > REG_SP || !parsed) {
         return false;
     }
 
@@ -290,7 +398,7 @@ static bool parse_var_or_imm(Parser *parser, Operand *op, bool *is_immediate) {
         }
     bool parsed = parse_variable(cur, &op->num_val);
     int64_t val = op->num_val;
-    if (val < 0 || val > 31 || !parsed) {
+    if (val < 0 || val > REG_SP || !parsed) {
         return false;
     }
     *is_immediate = false;
@@ -302,6 +410,38 @@ static bool parse_var_or_imm(Parser *parser, Operand *op, bool *is_immediate) {
     return true;
 }
 
+/**
+ * @brief Parses the registers of push or pop.
+ *
+ * Either a single register, x0 through x31 or sp, or a braced range of
+ * x registers such as {x1-x4}. The first register is stored in val_a and
+ * the last in val_b. Since pop sets sp past the popped values, sp is no
+ * destination of pop.
+ *
+ * @param parser A pointer to the parser to read tokens from.
+ * @param cmd The command to fill in.
+ * @return True if the registers were parsed, false otherwise.
+ */
+static bool parse_register_range(Parser *parser, Command *cmd) {
+    if (!consume(parser, TOK_LBRACE)) {
+        if (!parse_variable_operand(parser, &cmd->val_a)) {
+            return false;
+        }
+        cmd->val_b.num_val = cmd->val_a.num_val;
+        return cmd->type != CMD_POP || cmd->val_a.num_val != REG_SP;
+    }
+
+    if (!parse_variable_operand(parser, &cmd->val_a)) {
+        return false;
+    }
+    cmd->val_b.num_val = cmd->val_a.num_val;
+    if (consume(parser, TOK_DASH) && !parse_variable_operand(parser, &cmd->val_b)) {
+        return false;
+    }
+    return consume(parser, TOK_RBRACE) && cmd->val_b.num_val < REG_SP &&
+           cmd->val_a.num_val <= cmd->val_b.num_val;
+}
+
 /**
  * @brief Skips past tokens that signal the start of a new line
  *
@@ -336,7 +476,7 @@ static bool consume_newline(Parser *parser) {
 /**
  * @brief Parses a singular command.
  *
- * Reads in the token(s) from the lexer that the parser owns and determines the
+ * Reads in the token(s) from the token array that the parser owns and determines the
  * appropriate matching command. Updates the parser->had_error if an error
  * occurs.
  *
@@ -369,18 +509,29 @@ static Command *parse_cmd(Parser *parser) {
   
    
     struct cmd *command_ptr = create_command(CMD_ADD);
+    if (!command_ptr) {
+        parser->had_error = true;
+        return NULL;
+    }
 
-    if (token.type == TOK_IDENT) { 
+    // The label is only registered once its command is known to survive
+    char *label = NULL;
+    // A keyword names a label only when a colon follows, as in `read:`
+    if (token.type == TOK_IDENT ||
+        (token_is_name(token.type) && parser->current.type == TOK_COLON)) {
         
         if (parser->current.type != TOK_COLON) {
             parser->had_error = true;
         }
 
-        char* inputString = calloc(1, token.length + 1);
-        strncpy(inputString, token.lexeme, token.length);
-        inputString[token.length] = '\0'; 
-        
-        put_label(parser->label_map, inputString, command_ptr);
+        label = calloc(1, token.length + 1);
+        if (!label) {
+            parser->had_error = true;
+            free(command_ptr);
+            return NULL;
+        }
+        strncpy(label, token.lexeme, token.length);
+        label[token.length] = '\0'; 
     
         advance(parser);
         if (parser->current.type == TOK_NL) {
@@ -397,423 +548,171 @@ static Command *parse_cmd(Parser *parser) {
             command_ptr->is_b_immediate = true;
             command_ptr->destination.num_val = 0;
             command_ptr->val_a.num_val = 0;
+            put_label(parser->label_map, label, command_ptr);
             return command_ptr;
         }
     }
-    
-    
-    
-    if (token.type == TOK_EOF) {
-        consume_newline(parser);
-        free(command_ptr);
-        return NULL;
-    }
-   
 
-    switch (token.type) {
-        
-        case TOK_ADD:
-        {
-           
-           if (!parse_variable_operand(parser, &command_ptr->destination) || 
-               !parse_variable_operand(parser, &command_ptr->val_a) || 
-               !parse_var_or_imm(parser, &command_ptr->val_b, &command_ptr->is_b_immediate) || (parser->current.type != TOK_NL 
-               && parser->current.type != TOK_EOF)) {
-
-                free(command_ptr);
-                parser->had_error = true;
-                return NULL;
-           }
-           
-           command_ptr->type = CMD_ADD;
-           return command_ptr;
-        }
-        case TOK_SUB: {
-           if (!parse_variable_operand(parser, &command_ptr->destination) || 
-               !parse_variable_operand(parser, &command_ptr->val_a) || 
-               !parse_var_or_imm(parser, &command_ptr->val_b, &command_ptr->is_b_immediate) || (parser->current.type != TOK_NL 
-               && parser->current.type != TOK_EOF)) {
-                
-                free(command_ptr);
-                parser->had_error = true;
-                return NULL;
-           }
-           
-           command_ptr->type = CMD_SUB;
-           return command_ptr;
-        }
-        case TOK_MOV:
-        {
-           if (!parse_variable_operand(parser, &command_ptr->destination) || 
-                !parse_im(parser, &command_ptr->val_a)||
-                (parser->current.type != TOK_NL  && parser->current.type != TOK_EOF)) {
-
-                free(command_ptr);    
-                parser->had_error = true;
-                return NULL;    
-           }
-
-           command_ptr->is_a_immediate = true;
-           command_ptr->type = CMD_MOV;    
-           return command_ptr;
-        }
-        case TOK_CMP: {
-            
-           if (!parse_variable_operand(parser, &command_ptr->destination) ||
-                !parse_var_or_imm(parser, &command_ptr->val_a, &command_ptr->is_a_immediate) ||
-                (parser->current.type != TOK_NL  && parser->current.type != TOK_EOF)) {
-
-                free(command_ptr);    
-                parser->had_error = true;
-                return NULL;    
-           }          
-           
-           command_ptr->type = CMD_CMP;
-           return command_ptr;
+    Command *result = parse_instruction(parser, token, command_ptr);
+    if (label) {
+        if (result) {
+            put_label(parser->label_map, label, result);
+        } else {
+            free(label);
         }
-        case TOK_CMP_U: {
-
-           if (!parse_variable_operand(parser, &command_ptr->destination) ||
-                !parse_var_or_imm(parser, &command_ptr->val_a, &command_ptr->is_a_immediate) ||
-                (parser->current.type != TOK_NL  && parser->current.type != TOK_EOF)) {
-
-                free(command_ptr);    
-                parser->had_error = true;
-                return NULL;    
-           }          
-           
-           command_ptr->type = CMD_CMP_U;   
-           return command_ptr;
-        }
-        case TOK_AND: {
-
-            if (!parse_variable_operand(parser, &command_ptr->destination) || 
-               !parse_variable_operand(parser, &command_ptr->val_a) || 
-               !parse_variable_operand(parser, &command_ptr->val_b) || (parser->current.type != TOK_NL 
-               && parser->current.type != TOK_EOF)) {
-
-                free(command_ptr);
-                parser->had_error = true;
-                return NULL;
-           }
-           
-           command_ptr->type = CMD_AND;
-           return command_ptr;
-        }
-        case TOK_EOR: {
-            if (!parse_variable_operand(parser, &command_ptr->destination) || 
-               !parse_variable_operand(parser, &command_ptr->val_a) || 
-               !parse_variable_operand(parser, &command_ptr->val_b) || (parser->current.type != TOK_NL 
-               && parser->current.type != TOK_EOF)) {
-
-                free(command_ptr);
-                parser->had_error = true;
-                return NULL;
-           }
-           
-           command_ptr->type = CMD_EOR;
-           return command_ptr;
-        }
-        case TOK_ASR: {
-            if (!parse_variable_operand(parser, &command_ptr->destination) || 
-               !parse_variable_operand(parser, &command_ptr->val_a) || 
-               !parse_im(parser, &command_ptr->val_b) || (parser->current.type != TOK_NL 
-               && parser->current.type != TOK_EOF)) {
-
-                free(command_ptr);
-                parser->had_error = true;
-                return NULL;
-           }
-           
-           command_ptr->type = CMD_ASR;
-           return command_ptr;
-        }
-        case TOK_LSL: {
-            if (!parse_variable_operand(parser, &command_ptr->destination) || 
-               !parse_variable_operand(parser, &command_ptr->val_a) || 
-               !parse_im(parser, &command_ptr->val_b) || (parser->current.type != TOK_NL 
-               && parser->current.type != TOK_EOF)) {
-
-                free(command_ptr);
-                parser->had_error = true;
-                return NULL;
-           }
-           
-           command_ptr->type = CMD_LSL;
-           return command_ptr;
-        }
-        case TOK_LSR: {
-            if (!parse_variable_operand(parser, &command_ptr->destination) || 
-               !parse_variable_operand(parser, &command_ptr->val_a) || 
-               !parse_im(parser, &command_ptr->val_b) || (parser->current.type != TOK_NL 
-               && parser->current.type != TOK_EOF)) {
-
-                free(command_ptr);
-                parser->had_error = true;
-                return NULL;
-           }
-           
-           command_ptr->type = CMD_LSR;
-           return command_ptr;
-        }
-        case TOK_ORR: {
-            if (!parse_variable_operand(parser, &command_ptr->destination) || 
-               !parse_variable_operand(parser, &command_ptr->val_a) || 
-               !parse_variable_operand(parser, &command_ptr->val_b) || (parser->current.type != TOK_NL 
-               && parser->current.type != TOK_EOF)) {
-
-                free(command_ptr);
-                parser->had_error = true;
-                return NULL;
-           }
-           
-           command_ptr->type = CMD_ORR;
-           return command_ptr;
-        }
-        case TOK_STORE: {
-             if (!parse_variable_operand(parser, &command_ptr->destination) || 
-               !parse_var_or_imm(parser, &command_ptr->val_a, &command_ptr->is_a_immediate) || 
-               !parse_im(parser, &command_ptr->val_b) || (parser->current.type != TOK_NL 
-               && parser->current.type != TOK_EOF)) {
-
-                free(command_ptr);
-                parser->had_error = true;
-                return NULL;
-           }
-           
-           command_ptr->type = CMD_STORE;
-           return command_ptr;
-        }
-        case TOK_LOAD: {
-            if (!parse_variable_operand(parser, &command_ptr->destination) || 
-               !parse_im(parser, &command_ptr->val_a) || 
-               !parse_var_or_imm(parser, &command_ptr->val_b, &command_ptr->is_b_immediate)
-               || (parser->current.type != TOK_NL 
-               && parser->current.type != TOK_EOF)) {
-
-                free(command_ptr);
-                parser->had_error = true;
-                return NULL;
-           }
-           
-           command_ptr->type = CMD_LOAD;
-           return command_ptr;
-        }
-        case TOK_PUT: {
-            Token input = advance(parser);
-        
-            if (!parse_var_or_imm(parser, &command_ptr->val_a, &command_ptr->is_a_immediate) || input.type
-                != TOK_STR) {
-                free(command_ptr);
-                parser->had_error = true;
-                return NULL;
-            }
+    }
+    return result;
+}
 
-         
-            char* inputString = calloc(1, input.length + 1);
-            strncpy(inputString, input.lexeme, input.length);  
-            inputString[input.length] = '\0';
-            command_ptr->type = CMD_PUT;
-            command_ptr->val_b.str_val = inputString;
-            return command_ptr;
-        }
-        
-        case TOK_PRINT: {
+/**
+ * @brief Copies a token's lexeme into a newly allocated string.
+ *
+ * @param token The token to copy.
+ * @return The NUL-terminated copy, or NULL if allocation failed.
+ *
+ * @note The caller is responsible for freeing the returned string.
+ */
+static char *copy_lexeme(Token token) {
+    char *copy = malloc(token.length + 1);
+    if (!copy) {
+        return NULL;
+    }
+    memcpy(copy, token.lexeme, token.length);
+    copy[token.length] = '\0';
+    return copy;
+}
 
-            if (!parse_var_or_imm(parser, &command_ptr->val_a, &command_ptr->is_a_immediate) || 
-                !parse_base(parser, &command_ptr->val_b) ||
-                (parser->current.type != TOK_NL  && parser->current.type != TOK_EOF)) {
-    
-                free(command_ptr);    
-                parser->had_error = true;
-                return NULL;    
-           }          
-           
-           command_ptr->type = CMD_PRINT; 
-           return command_ptr;
-        }
-        case TOK_BRANCH: {
-            token = advance(parser);
-        
-            if (parser->current.type != TOK_NL && parser->current.type != TOK_EOF) {
-                parser->had_error = true;
-                free(command_ptr);   
-                return NULL;
-            }
+/**
+ * @brief Parses the current token as a string-valued operand.
+ *
+ * @param parser A pointer to the parser to read tokens from.
+ * @param op A pointer to the operand to modify.
+ * @param type The token type the operand must have.
+ * @return True if the token had the right type and was copied, false
+ * otherwise.
+ */
+static bool parse_text(Parser *parser, Operand *op, TokenType type) {
+    Token cur = parser->current;
+    if (cur.type != type) {
+        return false;
+    }
 
-            command_ptr->type = CMD_BRANCH;
-            command_ptr->branch_condition = BRANCH_NONE;
-            
-            
-            char* inputString = calloc(1, token.length + 1);
-            strncpy(inputString, token.lexeme, token.length);
-            inputString[token.length] = '\0';  
-            command_ptr->destination.str_val = inputString;
-            return command_ptr;
-        }
-        case TOK_BRANCH_EQ: {
-            token = advance(parser);
-        
-            if (parser->current.type != TOK_NL && parser->current.type != TOK_EOF) {
-                parser->had_error = true;
-                free(command_ptr);   
-                return NULL;
-            }
+    op->str_val = copy_lexeme(cur);
+    if (!op->str_val) {
+        return false;
+    }
+    advance(parser);
+    return true;
+}
 
-            command_ptr->type = CMD_BRANCH;
-            command_ptr->branch_condition = BRANCH_EQUAL;
-            
-            char* inputString = calloc(1, token.length + 1);
-            strncpy(inputString, token.lexeme, token.length);
-            inputString[token.length] = '\0';  
-            command_ptr->destination.str_val = inputString;
-            return command_ptr;
-        }
-        case TOK_BRANCH_GE: {
-            token = advance(parser);
-        
-            if (parser->current.type != TOK_NL && parser->current.type != TOK_EOF) {
-                parser->had_error = true;
-                free(command_ptr);   
-                return NULL;
-            }
+/**
+ * @brief Parses one operand according to its specification.
+ *
+ * This is the only place operands are matched; every instruction's operand
+ * list is described by its row in `instructions`.
+ *
+ * @param parser A pointer to the parser to read tokens from.
+ * @param spec The kind of operand expected and the command field it fills.
+ * @param cmd The command to fill in.
+ * @return True if the current token matched and was consumed, false otherwise.
+ */
+static bool parse_operand(Parser *parser, OperandSpec spec, Command *cmd) {
+    Operand *op           = &cmd->destination;
+    bool    *is_immediate = NULL;
+    bool    *is_string    = NULL;
+    if (spec.slot == SLOT_A) {
+        op           = &cmd->val_a;
+        is_immediate = &cmd->is_a_immediate;
+        is_string    = &cmd->is_a_string;
+    } else if (spec.slot == SLOT_B) {
+        op           = &cmd->val_b;
+        is_immediate = &cmd->is_b_immediate;
+        is_string    = &cmd->is_b_string;
+    }
 
-            command_ptr->type = CMD_BRANCH;
-            command_ptr->branch_condition = BRANCH_GREATER_EQUAL;
-            
-            char* inputString = calloc(1, token.length + 1);
-            strncpy(inputString, token.lexeme, token.length);
-            inputString[token.length] = '\0';  
-            command_ptr->destination.str_val = inputString;
-            return command_ptr;
-        }
-        case TOK_BRANCH_GT: {
-            token = advance(parser);
-        
-            if (parser->current.type != TOK_NL && parser->current.type != TOK_EOF) {
-                parser->had_error = true;
-                free(command_ptr);   
-                return NULL;
+    switch (spec.kind) {
+        case OPD_REG:
+            return parse_variable_operand(parser, op);
+        case OPD_IMM:
+            if (!parse_im(parser, op)) {
+                return false;
             }
-
-            command_ptr->type = CMD_BRANCH;
-            command_ptr->branch_condition = BRANCH_GREATER;
-            
-            char* inputString = calloc(1, token.length + 1);
-            strncpy(inputString, token.lexeme, token.length);
-            inputString[token.length] = '\0';  
-            command_ptr->destination.str_val = inputString;
-            return command_ptr;
-        }
-        case TOK_BRANCH_LE: {
-            token = advance(parser);
-        
-            if (parser->current.type != TOK_NL && parser->current.type != TOK_EOF) {
-                parser->had_error = true;
-                free(command_ptr);   
-                return NULL;
+            if (is_immediate) {
+                *is_immediate = true;
             }
-
-            command_ptr->type = CMD_BRANCH;
-            command_ptr->branch_condition = BRANCH_LESS_EQUAL;
-            
-            char* inputString = calloc(1, token.length + 1);
-            strncpy(inputString, token.lexeme, token.length);
-            inputString[token.length] = '\0';  
-            command_ptr->destination.str_val = inputString;
-            return command_ptr;
-        }
-        case TOK_BRANCH_LT: {
-            token = advance(parser);
-        
-            if (parser->current.type != TOK_NL && parser->current.type != TOK_EOF) {
-                parser->had_error = true;
-                free(command_ptr);   
-                return NULL;
+            return true;
+        case OPD_REG_OR_IMM:
+            return is_immediate && parse_var_or_imm(parser, op, is_immediate);
+        case OPD_BASE:
+            return parse_base(parser, op);
+        case OPD_LABEL:
+            return token_is_name(parser->current.type) &&
+                   parse_text(parser, op, parser->current.type);
+        case OPD_STRING:
+            if (!parse_text(parser, op, TOK_STR)) {
+                return false;
             }
-
-            command_ptr->type = CMD_BRANCH;
-            command_ptr->branch_condition = BRANCH_LESS;
-            
-            char* inputString = calloc(1, token.length + 1);
-            strncpy(inputString, token.lexeme, token.length);
-            inputString[token.length] = '\0';  
-            command_ptr->destination.str_val = inputString;
-            return command_ptr;
-        }
-        case TOK_BRANCH_NEQ: {
-            token = advance(parser);
-        
-            if (parser->current.type != TOK_NL && parser->current.type != TOK_EOF) {
-                parser->had_error = true;
-                free(command_ptr);   
-                return NULL;
+            if (is_string) {
+                *is_string = true;
             }
+            return true;
+        case OPD_REG_RANGE:
+            return parse_register_range(parser, cmd);
+    }
+    return false;
+}
 
-            command_ptr->type = CMD_BRANCH;
-            command_ptr->branch_condition = BRANCH_NOT_EQUAL;
-            
-            
-          
-            char* inputString = calloc(1, token.length + 1);
-            strncpy(inputString, token.lexeme, token.length);
-            inputString[token.length] = '\0';  
-            command_ptr->destination.str_val = inputString;
-            return command_ptr;
-        }
-        case TOK_CALL: {
-    
+/**
+ * @brief Parses the operands of an instruction whose mnemonic was consumed.
+ *
+ * The mnemonic selects a row of `instructions`, whose operands are matched in
+ * order and must be followed by the end of the line. Updates the
+ * parser->had_error if an error occurs.
+ *
+ * @param parser A pointer to the parser to read tokens from.
+ * @param token The mnemonic token.
+ * @param command_ptr The command to fill in. It is freed on failure.
+ * @return `command_ptr` on success, NULL if an error occurred or the end of
+ * the input was reached.
+ */
+static Command *parse_instruction(Parser *parser, Token token, Command *command_ptr) {
+    if (token.type == TOK_EOF) {
+        consume_newline(parser);
+        free(command_ptr);
+        return NULL;
+    }
 
-            token = parser->current;
-            if ((parser->next.type != TOK_NL && parser->next.type != TOK_EOF) || token.type != TOK_IDENT) {
-                if (parser->next.type != TOK_NL && parser->next.type != TOK_EOF) {
-                    advance(parser);
-                }
-                parser->had_error = true;
-                free(command_ptr);   
-                return NULL;
-            }
-            advance(parser);
-            command_ptr->type = CMD_CALL;
-    
-            char* inputString = calloc(1, token.length + 1);
-            strncpy(inputString, token.lexeme, token.length);
-            inputString[token.length] = '\0';  
-            command_ptr->destination.str_val = inputString;
-            return command_ptr;
-        }
-        case TOK_RET: {
-            
-          
-            if (parser->current.type != TOK_NL && parser->current.type != TOK_EOF) {
-                parser->had_error = true;
-                free(command_ptr);
-                return NULL;
-            }
+    const InstructionDef *def = NULL;
+    if ((size_t) token.type < sizeof(instructions) / sizeof(instructions[0]) &&
+        instructions[token.type].is_instruction) {
+        def = &instructions[token.type];
+    }
+    if (!def) {
+        parser->had_error = true;
+        free(command_ptr);
+        return NULL;
+    }
 
-            command_ptr->type = CMD_RET;
-            char* inputString = calloc(1, token.length + 1);
-            strncpy(inputString, token.lexeme, token.length);
-            inputString[token.length] = '\0';  
-            command_ptr->destination.str_val = inputString;
-            advance(parser);
-            return command_ptr;
-        }
-        
-        default:
-        {
+    // Set first so that free_command knows which operands own strings
+    command_ptr->type             = def->type;
+    command_ptr->branch_condition = def->condition;
 
+    for (int i = 0; i < def->operand_count; i++) {
+        if (!parse_operand(parser, def->operands[i], command_ptr)) {
             parser->had_error = true;
-            free(command_ptr);
-            break;
+            free_command(command_ptr);
+            return NULL;
         }
     }
-    
+
+    if (parser->current.type != TOK_NL && parser->current.type != TOK_EOF) {
+        parser->had_error = true;
+        free_command(command_ptr);
+        return NULL;
+    }
     return command_ptr;
 }
 
-
-
 Command *parse_commands(Parser *parser) {
 
     struct cmd *command_ptr = parse_cmd(parser);
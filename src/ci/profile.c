@@ -0,0 +1,122 @@
+#include "profile.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static uint64_t fingerprint(Command *commands, int64_t *count);
+static bool     allocate_counts(Profile *profile, int64_t count);
+
+bool profile_init(Profile *profile, Command *commands) {
+    int64_t count;
+    memset(profile, 0, sizeof(*profile));
+    profile->checksum = fingerprint(commands, &count);
+    return allocate_counts(profile, count);
+}
+
+bool profile_matches(const Profile *profile, Command *commands) {
+    int64_t  count;
+    uint64_t checksum = fingerprint(commands, &count);
+    return count == profile->count && checksum == profile->checksum;
+}
+
+bool profile_write(const Profile *profile, const char *path) {
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        printf("Could not open %s for writing\n", path);
+        return false;
+    }
+
+    fprintf(file, "%s %d\n", PROFILE_MAGIC, PROFILE_VERSION);
+    fprintf(file, "%" PRId64 " %016" PRIx64 "\n", profile->count, profile->checksum);
+    for (int64_t i = 0; i < profile->count; i++) {
+        if (profile->executed[i] > 0) {
+            fprintf(file, "%" PRId64 " %" PRIu64 " %" PRIu64 "\n", i + 1, profile->executed[i],
+                    profile->taken[i]);
+        }
+    }
+
+    bool written = !ferror(file);
+    if (fclose(file) != 0 || !written) {
+        printf("Could not write %s\n", path);
+        return false;
+    }
+    return true;
+}
+
+bool profile_read(Profile *profile, const char *path) {
+    memset(profile, 0, sizeof(*profile));
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        printf("Could not open profile %s\n", path);
+        return false;
+    }
+
+    char    magic[16];
+    int     version = 0;
+    int64_t count   = 0;
+    bool    ok      = fscanf(file, "%15s %d", magic, &version) == 2 &&
+               strcmp(magic, PROFILE_MAGIC) == 0 && version == PROFILE_VERSION &&
+               fscanf(file, "%" SCNd64 " %" SCNx64, &count, &profile->checksum) == 2 &&
+               count >= 0 && allocate_counts(profile, count);
+
+    int64_t  position;
+    uint64_t executed;
+    uint64_t taken;
+    int      fields;
+    while (ok && (fields = fscanf(file, "%" SCNd64 " %" SCNu64 " %" SCNu64, &position, &executed,
+                                  &taken)) == 3) {
+        ok = position >= 1 && position <= count && taken <= executed;
+        if (ok) {
+            profile->executed[position - 1] = executed;
+            profile->taken[position - 1]    = taken;
+        }
+    }
+    ok = ok && fields == EOF;
+    fclose(file);
+
+    if (!ok) {
+        printf("Invalid profile %s\n", path);
+    }
+    return ok;
+}
+
+void profile_free(Profile *profile) {
+    free(profile->executed);
+    free(profile->taken);
+    memset(profile, 0, sizeof(*profile));
+}
+
+/**
+ * @brief Fingerprints a program by the kind of each command, with 64-bit
+ * FNV-1a.
+ *
+ * @param commands The first command of the program.
+ * @param count Set to the number of commands.
+ * @return The fingerprint.
+ */
+static uint64_t fingerprint(Command *commands, int64_t *count) {
+    uint64_t hash = 14695981039346656037ull;
+    *count        = 0;
+    for (Command *cmd = commands; cmd; cmd = cmd->next) {
+        hash = (hash ^ (uint64_t) cmd->type) * 1099511628211ull;
+        hash = (hash ^ (uint64_t) (cmd->branch_condition + 1)) * 1099511628211ull;
+        (*count)++;
+    }
+    return hash;
+}
+
+/**
+ * @brief Allocates zeroed counts for a program.
+ *
+ * @param profile The profile receiving the counts.
+ * @param count The number of commands.
+ * @return True on success, false if memory ran out.
+ */
+static bool allocate_counts(Profile *profile, int64_t count) {
+    size_t slots      = (size_t) (count ? count : 1);
+    profile->count    = count;
+    profile->executed = (uint64_t *) calloc(slots, sizeof(uint64_t));
+    profile->taken    = (uint64_t *) calloc(slots, sizeof(uint64_t));
+    return profile->executed && profile->taken;
+}
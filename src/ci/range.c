@@ -0,0 +1,685 @@
+#include "range.h"
+#include <stdlib.h>
+#include <string.h>
+#include "cfg.h"
+#include "interpreter.h"
+#include "mem.h"
+
+#define RANGE_WIDEN_DELAY 3    // Updates of a block's entry ranges before they are widened
+#define RANGE_NARROW_ROUNDS 2  // Rounds of narrowing once the ranges are stable
+
+/**
+ * @brief The values a register may hold, from `lo` to `hi` inclusive.
+ */
+typedef struct {
+    int64_t lo;  // Smallest possible value.
+    int64_t hi;  // Largest possible value.
+} Interval;
+
+/**
+ * @brief The ranges of all registers at one point of the program.
+ */
+typedef struct {
+    Interval regs[NUM_REGISTERS];  // Range of each register, followed by sp.
+    bool     reachable;            // Whether any path reaches this point.
+} RangeState;
+
+static const Interval TOP = {INT64_MIN, INT64_MAX};
+
+static Interval        constant(int64_t value);
+static Interval        add(Interval a, Interval b);
+static Interval        sub(Interval a, Interval b);
+static Interval        bitwise(CommandType type, Interval a, Interval b);
+static Interval        shift(CommandType type, Interval a, int64_t count);
+static void            forget(RangeState *state);
+static const Command  *step(const Command *cmd, const Command *cmp, RangeState *state);
+static BranchCondition negate(BranchCondition cond);
+static bool            exclude(Interval *range, Interval value);
+static bool            refine(RangeState *state, const Command *cmp, BranchCondition cond);
+static const Command  *run_block(const BasicBlock *block, RangeState *state, RangeStats *stats);
+static void            follow_edges(const BasicBlock *block, const RangeState *out,
+                                    const Command *cmp, RangeState *taken, RangeState *fall);
+static void            join(RangeState *into, const RangeState *from);
+static bool            same(const RangeState *a, const RangeState *b);
+static void            entry_state(RangeState *state);
+static int             compare_values(const void *a, const void *b);
+static int64_t        *collect_thresholds(Command *commands, int *count);
+static void            widen(Interval *range, Interval grown, const int64_t *thresholds,
+                             int count);
+static void            solve(const Cfg *cfg, RangeState *in, int *updates,
+                             const int64_t *thresholds, int threshold_count);
+static void            narrow(const Cfg *cfg, RangeState *in, RangeState *next);
+static bool            is_access(const Command *cmd);
+static bool            access_in_bounds(const Command *cmd, const RangeState *state);
+
+bool range_analyze(Command *commands, LabelMap *map, bool return_calls, RangeStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    for (Command *cmd = commands; cmd; cmd = cmd->next) {
+        cmd->in_bounds = false;
+        stats->accesses += is_access(cmd);
+    }
+
+    if (return_calls) {
+        for (Command *cmd = commands; cmd; cmd = cmd->next) {
+            cmd->in_bounds = is_access(cmd) && access_in_bounds(cmd, NULL);
+            stats->proven += cmd->in_bounds;
+        }
+        return true;
+    }
+
+    Cfg cfg;
+    if (!cfg_build(&cfg, commands, map)) {
+        return false;
+    }
+    if (cfg.count == 0) {
+        return true;
+    }
+
+    size_t      count      = (size_t) cfg.count;
+    int         thresholds = 0;
+    int64_t    *values     = collect_thresholds(commands, &thresholds);
+    RangeState *in         = (RangeState *) calloc(count, sizeof(RangeState));
+    RangeState *next       = (RangeState *) calloc(count, sizeof(RangeState));
+    int        *updates    = (int *) calloc(count, sizeof(int));
+    bool        ok         = values && in && next && updates;
+    if (ok) {
+        entry_state(&in[0]);
+        solve(&cfg, in, updates, values, thresholds);
+        for (int round = 0; round < RANGE_NARROW_ROUNDS; round++) {
+            narrow(&cfg, in, next);
+        }
+        for (int i = 0; i < cfg.count; i++) {
+            if (in[i].reachable) {
+                run_block(&cfg.blocks[i], &in[i], stats);
+            }
+        }
+    }
+
+    free(values);
+    free(in);
+    free(next);
+    free(updates);
+    cfg_free(&cfg);
+    return ok;
+}
+
+/**
+ * @brief Returns the range holding exactly one value.
+ */
+static Interval constant(int64_t value) {
+    return (Interval) {value, value};
+}
+
+/**
+ * @brief Adds two ranges; a sum that may wrap could be anything.
+ */
+static Interval add(Interval a, Interval b) {
+    if ((b.hi > 0 && a.hi > INT64_MAX - b.hi) || (b.lo < 0 && a.lo < INT64_MIN - b.lo)) {
+        return TOP;
+    }
+    return (Interval) {a.lo + b.lo, a.hi + b.hi};
+}
+
+/**
+ * @brief Subtracts two ranges; a difference that may wrap could be anything.
+ */
+static Interval sub(Interval a, Interval b) {
+    if ((b.lo < 0 && a.hi > INT64_MAX + b.lo) || (b.hi > 0 && a.lo < INT64_MIN + b.hi)) {
+        return TOP;
+    }
+    return (Interval) {a.lo - b.hi, a.hi - b.lo};
+}
+
+/**
+ * @brief Computes the range of `and`, `orr` or `eor` of two ranges.
+ *
+ * Only non-negative operands bound the result: `and` cannot exceed either of
+ * them, and `orr` and `eor` cannot set a bit above the highest of both.
+ */
+static Interval bitwise(CommandType type, Interval a, Interval b) {
+    if (a.lo == a.hi && b.lo == b.hi) {
+        int64_t value = type == CMD_AND ? a.lo & b.lo : type == CMD_ORR ? a.lo | b.lo : a.lo ^ b.lo;
+        return constant(value);
+    }
+    if (type == CMD_AND) {
+        if (a.lo >= 0 && b.lo >= 0) {
+            return (Interval) {0, a.hi < b.hi ? a.hi : b.hi};
+        }
+        if (a.lo >= 0 || b.lo >= 0) {
+            return (Interval) {0, a.lo >= 0 ? a.hi : b.hi};
+        }
+        return TOP;
+    }
+    if (a.lo < 0 || b.lo < 0) {
+        return TOP;
+    }
+    uint64_t bits = (uint64_t) (a.hi > b.hi ? a.hi : b.hi);
+    for (int s = 1; s < 64; s <<= 1) {
+        bits |= bits >> s;
+    }
+    return (Interval) {0, (int64_t) bits};
+}
+
+/**
+ * @brief Computes the range of `asr`, `lsl` or `lsr` of a range by a
+ * constant count.
+ */
+static Interval shift(CommandType type, Interval a, int64_t count) {
+    switch (type) {
+        case CMD_ASR:
+            return (Interval) {a.lo >> count, a.hi >> count};
+        case CMD_LSR:
+            if (a.lo >= 0) {
+                return (Interval) {a.lo >> count, a.hi >> count};
+            }
+            return count == 0 ? a : (Interval) {0, (int64_t) (UINT64_MAX >> count)};
+        default:
+            if (a.lo >= 0 && a.hi <= (INT64_MAX >> count)) {
+                return (Interval) {a.lo << count, a.hi << count};
+            }
+            return TOP;
+    }
+}
+
+/**
+ * @brief Gives up on the range of every register.
+ */
+static void forget(RangeState *state) {
+    for (int r = 0; r < NUM_REGISTERS; r++) {
+        state->regs[r] = TOP;
+    }
+}
+
+/**
+ * @brief Applies one command to the ranges of the registers it writes.
+ *
+ * @param cmd The command.
+ * @param cmp The latest `cmp` whose registers have not been written since,
+ * or NULL.
+ * @param state The ranges before the command; updated to those after it.
+ * @return The latest `cmp` whose registers have not been written after
+ * `cmd`, or NULL.
+ */
+static const Command *step(const Command *cmd, const Command *cmp, RangeState *state) {
+    Interval *regs = state->regs;
+    int64_t   dst  = cmd->destination.num_val;
+    switch (cmd->type) {
+        case CMD_CMP:
+        case CMD_CMP_U:
+            return cmd;
+        case CMD_PRINT:
+        case CMD_STORE:
+        case CMD_PUT:
+        case CMD_FREE:
+        case CMD_BRANCH:
+        case CMD_CALL:
+        case CMD_RET:
+            // Registers are left alone; a call's effects are applied on its edges
+            return cmp;
+        case CMD_MOV:
+            regs[dst] = constant(cmd->val_a.num_val);
+            break;
+        case CMD_ADD:
+        case CMD_SUB: {
+            Interval b = cmd->is_b_immediate ? constant(cmd->val_b.num_val) : regs[cmd->val_b.num_val];
+            regs[dst]  = cmd->type == CMD_ADD ? add(regs[cmd->val_a.num_val], b)
+                                              : sub(regs[cmd->val_a.num_val], b);
+            break;
+        }
+        case CMD_AND:
+        case CMD_ORR:
+        case CMD_EOR:
+            regs[dst] = bitwise(cmd->type, regs[cmd->val_a.num_val], regs[cmd->val_b.num_val]);
+            break;
+        case CMD_ASR:
+        case CMD_LSL:
+        case CMD_LSR:
+            regs[dst] = shift(cmd->type, regs[cmd->val_a.num_val], cmd->val_b.num_val & 63);
+            break;
+        case CMD_LOAD: {
+            // Narrow loads zero-extend
+            int64_t bytes = cmd->val_a.num_val;
+            regs[dst]     = bytes >= 1 && bytes < 8 ? (Interval) {0, (INT64_C(1) << (8 * bytes)) - 1}
+                                                    : TOP;
+            break;
+        }
+        case CMD_ALLOC:
+        case CMD_REALLOC:
+            regs[dst] = TOP;
+            break;
+        case CMD_PUSH:
+        case CMD_POP: {
+            int64_t  first = cmd->val_a.num_val;
+            int64_t  last  = cmd->val_b.num_val;
+            Interval bytes = constant((last - first + 1) * (int64_t) sizeof(int64_t));
+            for (int64_t r = first; cmd->type == CMD_POP && r <= last; r++) {
+                regs[r] = TOP;
+            }
+            regs[REG_SP] = cmd->type == CMD_PUSH ? sub(regs[REG_SP], bytes) : add(regs[REG_SP], bytes);
+            break;
+        }
+        default:
+            // Builtins, foreign calls and I/O may write any register
+            forget(state);
+            break;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Returns the condition that holds right after a `cmp` exactly when
+ * the given one does not.
+ */
+static BranchCondition negate(BranchCondition cond) {
+    switch (cond) {
+        case BRANCH_EQUAL:
+            return BRANCH_NOT_EQUAL;
+        case BRANCH_NOT_EQUAL:
+            return BRANCH_EQUAL;
+        case BRANCH_GREATER:
+            return BRANCH_LESS_EQUAL;
+        case BRANCH_LESS_EQUAL:
+            return BRANCH_GREATER;
+        case BRANCH_LESS:
+            return BRANCH_GREATER_EQUAL;
+        case BRANCH_GREATER_EQUAL:
+            return BRANCH_LESS;
+        default:
+            return cond;
+    }
+}
+
+/**
+ * @brief Removes a single value from a range where it is an end point.
+ *
+ * @param range The range to shrink.
+ * @param value The value to remove; ignored unless it is a single value.
+ * @return False if the range held nothing but the value.
+ */
+static bool exclude(Interval *range, Interval value) {
+    if (value.lo != value.hi) {
+        return true;
+    }
+    if (range->lo == value.lo && range->hi == value.lo) {
+        return false;
+    }
+    if (range->lo == value.lo) {
+        range->lo++;
+    } else if (range->hi == value.lo) {
+        range->hi--;
+    }
+    return true;
+}
+
+/**
+ * @brief Narrows the registers a `cmp` compared to the values for which a
+ * branch condition holds.
+ *
+ * @param state The ranges after the `cmp`; narrowed.
+ * @param cmp The `cmp`.
+ * @param cond The condition known to hold.
+ * @return False if the condition cannot hold, so the edge is never taken.
+ */
+static bool refine(RangeState *state, const Command *cmp, BranchCondition cond) {
+    int64_t  a_reg = cmp->destination.num_val;
+    int64_t  b_reg = cmp->is_a_immediate ? -1 : cmp->val_a.num_val;
+    Interval x     = state->regs[a_reg];
+    Interval y     = b_reg < 0 ? constant(cmp->val_a.num_val) : state->regs[b_reg];
+    if (b_reg == a_reg || (cmp->type == CMD_CMP_U && (x.lo < 0 || y.lo < 0))) {
+        // Unsigned order matches signed order only for non-negative values
+        return true;
+    }
+
+    Interval nx = x;
+    Interval ny = y;
+    switch (cond) {
+        case BRANCH_EQUAL:
+            nx.lo = ny.lo = x.lo > y.lo ? x.lo : y.lo;
+            nx.hi = ny.hi = x.hi < y.hi ? x.hi : y.hi;
+            break;
+        case BRANCH_NOT_EQUAL:
+            if (!exclude(&nx, y) || !exclude(&ny, x)) {
+                return false;
+            }
+            break;
+        case BRANCH_LESS:
+        case BRANCH_LESS_EQUAL: {
+            // x < y is x <= y - 1, and y > x is y >= x + 1
+            int64_t strict = cond == BRANCH_LESS;
+            if (strict && (y.hi == INT64_MIN || x.lo == INT64_MAX)) {
+                return false;
+            }
+            nx.hi = x.hi < y.hi - strict ? x.hi : y.hi - strict;
+            ny.lo = y.lo > x.lo + strict ? y.lo : x.lo + strict;
+            break;
+        }
+        case BRANCH_GREATER:
+        case BRANCH_GREATER_EQUAL: {
+            int64_t strict = cond == BRANCH_GREATER;
+            if (strict && (y.lo == INT64_MAX || x.hi == INT64_MIN)) {
+                return false;
+            }
+            nx.lo = x.lo > y.lo + strict ? x.lo : y.lo + strict;
+            ny.hi = y.hi < x.hi - strict ? y.hi : x.hi - strict;
+            break;
+        }
+        default:
+            return true;
+    }
+    if (nx.lo > nx.hi || ny.lo > ny.hi) {
+        return false;
+    }
+
+    state->regs[a_reg] = nx;
+    if (b_reg >= 0) {
+        state->regs[b_reg] = ny;
+    }
+    return true;
+}
+
+/**
+ * @brief Applies the commands of a block to the ranges at its start.
+ *
+ * @param block The block.
+ * @param state The ranges at the start of the block; updated to those at its
+ * end.
+ * @param stats If not NULL, the accesses of the block are marked by whether
+ * they are in bounds and counted here.
+ * @return The `cmp` the block's final branch tests, or NULL if its registers
+ * were written since or there is none.
+ */
+static const Command *run_block(const BasicBlock *block, RangeState *state, RangeStats *stats) {
+    const Command *cmp = NULL;
+    Command       *cmd = block->first;
+    for (int i = 0; i < block->length; i++, cmd = cmd->next) {
+        if (stats && is_access(cmd)) {
+            cmd->in_bounds = access_in_bounds(cmd, state);
+            stats->proven += cmd->in_bounds;
+        }
+        cmp = step(cmd, cmp, state);
+    }
+    return cmp;
+}
+
+/**
+ * @brief Computes the ranges along the edges leaving a block.
+ *
+ * @param block The block.
+ * @param out The ranges at the end of the block.
+ * @param cmp The `cmp` the block's final branch tests, or NULL.
+ * @param taken Receives the ranges when the final branch or call is taken.
+ * @param fall Receives the ranges when the block falls through or a call
+ * returns.
+ */
+static void follow_edges(const BasicBlock *block, const RangeState *out, const Command *cmp,
+                         RangeState *taken, RangeState *fall) {
+    const Command *last = block->last;
+    *taken              = *out;
+    *fall               = *out;
+    if (last->type == CMD_CALL) {
+        // Returning restores every register but x0 and sp
+        fall->regs[0]      = TOP;
+        fall->regs[REG_SP] = TOP;
+    } else if (last->type == CMD_BRANCH && cmp && last->branch_condition != BRANCH_NONE &&
+               last->branch_condition != BRANCH_ALWAYS) {
+        taken->reachable = refine(taken, cmp, last->branch_condition);
+        fall->reachable  = refine(fall, cmp, negate(last->branch_condition));
+    }
+}
+
+/**
+ * @brief Widens the ranges at a point to also cover another set of ranges.
+ */
+static void join(RangeState *into, const RangeState *from) {
+    if (!from->reachable) {
+        return;
+    }
+    if (!into->reachable) {
+        *into = *from;
+        return;
+    }
+    for (int r = 0; r < NUM_REGISTERS; r++) {
+        into->regs[r].lo = from->regs[r].lo < into->regs[r].lo ? from->regs[r].lo : into->regs[r].lo;
+        into->regs[r].hi = from->regs[r].hi > into->regs[r].hi ? from->regs[r].hi : into->regs[r].hi;
+    }
+}
+
+/**
+ * @brief Determines whether two sets of ranges are equal.
+ */
+static bool same(const RangeState *a, const RangeState *b) {
+    if (a->reachable != b->reachable) {
+        return false;
+    }
+    for (int r = 0; a->reachable && r < NUM_REGISTERS; r++) {
+        if (a->regs[r].lo != b->regs[r].lo || a->regs[r].hi != b->regs[r].hi) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Sets the ranges at the start of a run: every register is cleared
+ * and the stack is empty.
+ */
+static void entry_state(RangeState *state) {
+    for (int r = 0; r < NUM_REGISTERS; r++) {
+        state->regs[r] = constant(0);
+    }
+    state->regs[REG_SP] = constant(MEM_CAPACITY);
+    state->reachable    = true;
+}
+
+/**
+ * @brief Orders values for `qsort`.
+ */
+static int compare_values(const void *a, const void *b) {
+    int64_t x = *(const int64_t *) a;
+    int64_t y = *(const int64_t *) b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Collects the values growing bounds are widened to before they are
+ * given up: the constants the program compares with and their neighbours,
+ * and the ends of memory.
+ *
+ * @param commands The first command of the program.
+ * @param count Set to the number of values.
+ * @return The values in ascending order, or NULL if memory ran out.
+ */
+static int64_t *collect_thresholds(Command *commands, int *count) {
+    int capacity = 2;
+    for (Command *cmd = commands; cmd; cmd = cmd->next) {
+        capacity += (cmd->type == CMD_CMP || cmd->type == CMD_CMP_U) ? 3 : 0;
+    }
+    int64_t *values = (int64_t *) malloc((size_t) capacity * sizeof(int64_t));
+    if (!values) {
+        return NULL;
+    }
+
+    int n       = 0;
+    values[n++] = 0;
+    values[n++] = MEM_CAPACITY;
+    for (Command *cmd = commands; cmd; cmd = cmd->next) {
+        if ((cmd->type == CMD_CMP || cmd->type == CMD_CMP_U) && cmd->is_a_immediate) {
+            int64_t c   = cmd->val_a.num_val;
+            values[n++] = c;
+            values[n++] = c > INT64_MIN ? c - 1 : c;
+            values[n++] = c < INT64_MAX ? c + 1 : c;
+        }
+    }
+    qsort(values, (size_t) n, sizeof(int64_t), compare_values);
+    *count = n;
+    return values;
+}
+
+/**
+ * @brief Widens the bounds of a range that keep growing to the next
+ * threshold, or to the limit of the type past the last one.
+ *
+ * @param range The range before the update; widened.
+ * @param grown The range after the update, which covers `range`.
+ * @param thresholds The thresholds in ascending order.
+ * @param count The number of thresholds.
+ */
+static void widen(Interval *range, Interval grown, const int64_t *thresholds, int count) {
+    if (grown.lo < range->lo) {
+        range->lo = INT64_MIN;
+        for (int t = count - 1; t >= 0; t--) {
+            if (thresholds[t] <= grown.lo) {
+                range->lo = thresholds[t];
+                break;
+            }
+        }
+    }
+    if (grown.hi > range->hi) {
+        range->hi = INT64_MAX;
+        for (int t = 0; t < count; t++) {
+            if (thresholds[t] >= grown.hi) {
+                range->hi = thresholds[t];
+                break;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Propagates ranges through the blocks until they are stable.
+ *
+ * A block whose entry ranges keep growing has the growing bounds widened to
+ * thresholds and finally to the limits of the type, which bounds the number
+ * of rounds.
+ *
+ * @param cfg The blocks of the program.
+ * @param in The ranges at the start of each block; the entry block's must be
+ * set.
+ * @param updates Zeroed scratch space, one counter per block.
+ * @param thresholds The values bounds are widened to, in ascending order.
+ * @param threshold_count The number of thresholds.
+ */
+static void solve(const Cfg *cfg, RangeState *in, int *updates, const int64_t *thresholds,
+                  int threshold_count) {
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int i = 0; i < cfg->count; i++) {
+            if (!in[i].reachable) {
+                continue;
+            }
+
+            BasicBlock    *block = &cfg->blocks[i];
+            RangeState     out   = in[i];
+            const Command *cmp   = run_block(block, &out, NULL);
+            RangeState     edges[2];
+            BasicBlock    *successors[2] = {block->taken, block->fallthrough};
+            follow_edges(block, &out, cmp, &edges[0], &edges[1]);
+
+            for (int e = 0; e < 2; e++) {
+                if (!successors[e] || !edges[e].reachable) {
+                    continue;
+                }
+                RangeState *target = &in[successors[e]->id];
+                RangeState  joined = *target;
+                join(&joined, &edges[e]);
+                if (same(&joined, target)) {
+                    continue;
+                }
+                if (target->reachable && updates[successors[e]->id]++ >= RANGE_WIDEN_DELAY) {
+                    for (int r = 0; r < NUM_REGISTERS; r++) {
+                        widen(&target->regs[r], joined.regs[r], thresholds, threshold_count);
+                    }
+                } else {
+                    *target = joined;
+                }
+                changed = true;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Recovers bounds lost to widening by propagating the stable ranges
+ * once more.
+ *
+ * Every bound widened to a limit of the type takes the bound the blocks'
+ * predecessors now imply; all other bounds only grow, so the result still
+ * covers every run.
+ *
+ * @param cfg The blocks of the program.
+ * @param in The stable ranges at the start of each block; narrowed.
+ * @param next Scratch space, one state per block.
+ */
+static void narrow(const Cfg *cfg, RangeState *in, RangeState *next) {
+    memset(next, 0, (size_t) cfg->count * sizeof(RangeState));
+    entry_state(&next[0]);
+    for (int i = 0; i < cfg->count; i++) {
+        if (!in[i].reachable) {
+            continue;
+        }
+
+        BasicBlock    *block = &cfg->blocks[i];
+        RangeState     out   = in[i];
+        const Command *cmp   = run_block(block, &out, NULL);
+        RangeState     edges[2];
+        BasicBlock    *successors[2] = {block->taken, block->fallthrough};
+        follow_edges(block, &out, cmp, &edges[0], &edges[1]);
+        for (int e = 0; e < 2; e++) {
+            if (successors[e]) {
+                join(&next[successors[e]->id], &edges[e]);
+            }
+        }
+    }
+
+    for (int i = 0; i < cfg->count; i++) {
+        for (int r = 0; in[i].reachable && next[i].reachable && r < NUM_REGISTERS; r++) {
+            Interval *old = &in[i].regs[r];
+            Interval  now = next[i].regs[r];
+            old->lo       = old->lo == INT64_MIN || now.lo < old->lo ? now.lo : old->lo;
+            old->hi       = old->hi == INT64_MAX || now.hi > old->hi ? now.hi : old->hi;
+        }
+        in[i].reachable = next[i].reachable;
+    }
+}
+
+/**
+ * @brief Determines whether a command accesses memory at an operand address.
+ */
+static bool is_access(const Command *cmd) {
+    return cmd->type == CMD_LOAD || cmd->type == CMD_STORE || cmd->type == CMD_PUT;
+}
+
+/**
+ * @brief Determines whether an access lies within memory for every value its
+ * address operand may have.
+ *
+ * @param cmd The load, store or put.
+ * @param state The ranges before the access, or NULL if they are unknown.
+ * @return True if the access is in bounds and has a valid width.
+ */
+static bool access_in_bounds(const Command *cmd, const RangeState *state) {
+    int64_t bytes;
+    bool    immediate;
+    int64_t operand;
+    if (cmd->type == CMD_LOAD) {
+        bytes     = cmd->val_a.num_val;
+        immediate = cmd->is_b_immediate;
+        operand   = cmd->val_b.num_val;
+    } else if (cmd->type == CMD_STORE) {
+        bytes     = cmd->val_b.num_val;
+        immediate = cmd->is_a_immediate;
+        operand   = cmd->val_a.num_val;
+    } else {
+        // The string is stored with its terminator
+        bytes     = (int64_t) strlen(cmd->val_a.str_val) + 1;
+        immediate = cmd->is_b_immediate;
+        operand   = cmd->val_b.num_val;
+    }
+    if (cmd->type != CMD_PUT && bytes != 1 && bytes != 2 && bytes != 4 && bytes != 8) {
+        return false;
+    }
+
+    Interval address = immediate ? constant(operand) : state ? state->regs[operand] : TOP;
+    return bytes <= MEM_CAPACITY && address.lo >= 0 && address.hi <= MEM_CAPACITY - bytes;
+}
@@ -0,0 +1,238 @@
+#define _POSIX_C_SOURCE 200809L
+#include "scheduler.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define SCHED_IDLE_NS 50000  // How long a worker that found nothing to run waits
+
+/**
+ * @brief The programs waiting for one worker, first to run first.
+ */
+typedef struct {
+    pthread_mutex_t lock;  // Held while the queue is read or changed.
+    SchedProgram   *head;  // The program to run next, or NULL if the queue is empty.
+    SchedProgram   *tail;  // The program that was queued last.
+} RunQueue;
+
+/**
+ * @brief State shared by the workers of one `sched_run`.
+ */
+typedef struct {
+    RunQueue  *queues;     // One run queue per worker.
+    int        workers;    // Number of workers.
+    uint64_t   slice;      // Commands a program of priority 1 runs per turn.
+    atomic_int remaining;  // Programs that have not stopped yet.
+} Scheduler;
+
+/**
+ * @brief What a worker thread is started with.
+ */
+typedef struct {
+    Scheduler *scheduler;  // The scheduler the worker belongs to.
+    int        id;         // Index of the worker's run queue.
+} Worker;
+
+static void         *run_worker(void *arg);
+static void          run_turn(Worker *worker, SchedProgram *program);
+static void          enqueue(RunQueue *queue, SchedProgram *program);
+static SchedProgram *dequeue(RunQueue *queue);
+static SchedProgram *steal(Scheduler *scheduler, int thief);
+static uint64_t      thread_cpu_ns(void);
+
+void sched_program_init(SchedProgram *program, Command *commands, LabelMap *map, int priority,
+                        bool heap_debug) {
+    memset(program, 0, sizeof(*program));
+    interpreter_init(&program->intr, map);
+    program->intr.tier_threshold  = 0;
+    program->intr.trace_threshold = 0;
+    program->intr.heap_debug      = heap_debug;
+    program->commands             = commands;
+    program->priority             = priority;
+    program->worker               = -1;
+
+    heap_bind(&program->heap);
+    heap_reset(heap_debug);
+    heap_bind(NULL);
+}
+
+bool sched_run(SchedProgram **programs, int count, int workers, uint64_t slice) {
+    Scheduler scheduler;
+    scheduler.queues  = calloc((size_t) workers, sizeof(RunQueue));
+    scheduler.workers = workers;
+    scheduler.slice   = slice;
+    atomic_init(&scheduler.remaining, count);
+    Worker    *pool    = calloc((size_t) workers, sizeof(Worker));
+    pthread_t *threads = calloc((size_t) workers, sizeof(pthread_t));
+    bool      *started = calloc((size_t) workers, sizeof(bool));
+    if (!scheduler.queues || !pool || !threads || !started) {
+        printf("Could not allocate the scheduler\n");
+        free(scheduler.queues);
+        free(pool);
+        free(threads);
+        free(started);
+        return false;
+    }
+
+    for (int i = 0; i < workers; i++) {
+        pthread_mutex_init(&scheduler.queues[i].lock, NULL);
+        pool[i].scheduler = &scheduler;
+        pool[i].id        = i;
+    }
+    for (int i = 0; i < count; i++) {
+        enqueue(&scheduler.queues[i % workers], programs[i]);
+    }
+
+    // The calling thread is the first worker; the programs dealt to workers
+    // that fail to start are stolen by the others
+    bool all_started = true;
+    for (int i = 1; i < workers; i++) {
+        started[i] = pthread_create(&threads[i], NULL, run_worker, &pool[i]) == 0;
+        all_started = all_started && started[i];
+    }
+    if (!all_started) {
+        printf("Could not start every worker thread\n");
+    }
+    run_worker(&pool[0]);
+    for (int i = 1; i < workers; i++) {
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        }
+    }
+
+    for (int i = 0; i < workers; i++) {
+        pthread_mutex_destroy(&scheduler.queues[i].lock);
+    }
+    free(scheduler.queues);
+    free(pool);
+    free(threads);
+    free(started);
+    return all_started;
+}
+
+/**
+ * @brief Runs programs from the worker's queue, or stolen from others, until
+ * every program has stopped.
+ *
+ * @param arg The `Worker`.
+ * @return NULL.
+ */
+static void *run_worker(void *arg) {
+    Worker    *worker    = arg;
+    Scheduler *scheduler = worker->scheduler;
+    RunQueue  *own       = &scheduler->queues[worker->id];
+
+    while (atomic_load(&scheduler->remaining) > 0) {
+        SchedProgram *program = dequeue(own);
+        if (!program) {
+            program = steal(scheduler, worker->id);
+        }
+        if (!program) {
+            // Every program left is running on another worker
+            struct timespec idle = {0, SCHED_IDLE_NS};
+            nanosleep(&idle, NULL);
+            continue;
+        }
+
+        run_turn(worker, program);
+        if (program->intr.resume) {
+            enqueue(own, program);
+        } else {
+            atomic_fetch_sub(&scheduler->remaining, 1);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Runs a program for one turn on the calling worker, in its own memory
+ * and heap.
+ *
+ * @param worker The worker running the program.
+ * @param program The program.
+ */
+static void run_turn(Worker *worker, SchedProgram *program) {
+    if (program->worker >= 0 && program->worker != worker->id) {
+        program->migrations++;
+    }
+    program->worker     = worker->id;
+    program->intr.slice = worker->scheduler->slice * (uint64_t) program->priority;
+
+    mem_bind(program->memory);
+    heap_bind(&program->heap);
+    uint64_t start = thread_cpu_ns();
+    interpret(&program->intr, program->commands);
+    program->cpu_ns += thread_cpu_ns() - start;
+    program->turns++;
+    heap_bind(NULL);
+    mem_bind(NULL);
+}
+
+/**
+ * @brief Puts a program at the tail of a run queue.
+ *
+ * @param queue The run queue.
+ * @param program The program; it must not be in any queue.
+ */
+static void enqueue(RunQueue *queue, SchedProgram *program) {
+    program->next = NULL;
+    pthread_mutex_lock(&queue->lock);
+    if (queue->tail) {
+        queue->tail->next = program;
+    } else {
+        queue->head = program;
+    }
+    queue->tail = program;
+    pthread_mutex_unlock(&queue->lock);
+}
+
+/**
+ * @brief Takes the program at the head of a run queue.
+ *
+ * @param queue The run queue.
+ * @return The program, or NULL if the queue is empty.
+ */
+static SchedProgram *dequeue(RunQueue *queue) {
+    pthread_mutex_lock(&queue->lock);
+    SchedProgram *program = queue->head;
+    if (program) {
+        queue->head = program->next;
+        if (!queue->head) {
+            queue->tail = NULL;
+        }
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return program;
+}
+
+/**
+ * @brief Takes the program that has waited longest in another worker's run
+ * queue, trying the workers after the thief first.
+ *
+ * @param scheduler The scheduler.
+ * @param thief The worker looking for a program.
+ * @return The program, or NULL if every other queue is empty.
+ */
+static SchedProgram *steal(Scheduler *scheduler, int thief) {
+    for (int i = 1; i < scheduler->workers; i++) {
+        SchedProgram *program = dequeue(&scheduler->queues[(thief + i) % scheduler->workers]);
+        if (program) {
+            return program;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Returns the CPU time the calling thread has used.
+ *
+ * @return The time in nanoseconds.
+ */
+static uint64_t thread_cpu_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
@@ -0,0 +1,229 @@
+#include "state.h"
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STATE_CHUNK 16  // Granularity of the memory ranges in JSON states
+
+_Static_assert(sizeof(StateImage) ==
+                   16 + NUM_REGISTERS * sizeof(int64_t) + MEM_CAPACITY * sizeof(uint8_t),
+               "StateImage must not contain padding");
+
+/**
+ * @brief A growing buffer that a state is serialized into.
+ */
+typedef struct {
+    char  *data;      // The serialized bytes
+    size_t length;    // Number of bytes used
+    size_t capacity;  // Number of bytes allocated
+    bool   failed;    // Set once an allocation failed; later appends do nothing
+} StateBuffer;
+
+static bool reserve(StateBuffer *buf, size_t extra);
+static bool append(StateBuffer *buf, const char *format, ...);
+static void append_hex(StateBuffer *buf, const uint8_t *bytes, size_t count);
+static void serialize_json(StateBuffer *buf, const Interpreter *intr);
+static bool write_buffer(const char *data, size_t length, const char *path);
+
+bool state_parse_format(const char *name, StateFormat *format) {
+    static const char *const names[] = {[STATE_TEXT] = "text", [STATE_JSON] = "json",
+                                        [STATE_BIN] = "bin"};
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (strcmp(name, names[i]) == 0) {
+            *format = (StateFormat) i;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Makes room in a buffer for more bytes and a terminating NUL.
+ *
+ * @param buf The buffer.
+ * @param extra The number of bytes to make room for.
+ * @return True on success, false if the buffer could not grow.
+ */
+static bool reserve(StateBuffer *buf, size_t extra) {
+    if (buf->failed) {
+        return false;
+    }
+    if (buf->length + extra + 1 <= buf->capacity) {
+        return true;
+    }
+
+    size_t capacity = buf->capacity ? buf->capacity : 4096;
+    while (buf->length + extra + 1 > capacity) {
+        capacity *= 2;
+    }
+    char *data = realloc(buf->data, capacity);
+    if (!data) {
+        buf->failed = true;
+        return false;
+    }
+    buf->data     = data;
+    buf->capacity = capacity;
+    return true;
+}
+
+/**
+ * @brief Appends formatted text to a buffer.
+ *
+ * @param buf The buffer.
+ * @param format The printf format.
+ * @return True on success, false if the buffer could not grow.
+ */
+static bool append(StateBuffer *buf, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int needed = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+    if (needed < 0) {
+        buf->failed = true;
+        return false;
+    }
+    if (!reserve(buf, (size_t) needed)) {
+        return false;
+    }
+
+    va_start(args, format);
+    vsnprintf(buf->data + buf->length, buf->capacity - buf->length, format, args);
+    va_end(args);
+    buf->length += (size_t) needed;
+    return true;
+}
+
+/**
+ * @brief Appends bytes to a buffer as lowercase hex digits, two per byte.
+ *
+ * @param buf The buffer.
+ * @param bytes The bytes to encode.
+ * @param count The number of bytes.
+ */
+static void append_hex(StateBuffer *buf, const uint8_t *bytes, size_t count) {
+    static const char digits[] = "0123456789abcdef";
+    if (!reserve(buf, 2 * count)) {
+        return;
+    }
+
+    char *out = buf->data + buf->length;
+    for (size_t i = 0; i < count; i++) {
+        out[2 * i]     = digits[bytes[i] >> 4];
+        out[2 * i + 1] = digits[bytes[i] & 0xf];
+    }
+    buf->length += 2 * count;
+    buf->data[buf->length] = '\0';
+}
+
+/**
+ * @brief Serializes the state as a single-line JSON object.
+ *
+ * Memory is listed as ranges of 16-byte chunks holding at least one nonzero
+ * byte; adjacent chunks form one range.
+ *
+ * @param buf The buffer to append to.
+ * @param intr The interpreter that ran the program.
+ */
+static void serialize_json(StateBuffer *buf, const Interpreter *intr) {
+    append(buf, "{\"error\":%s,\"flags\":{\"greater\":%s,\"equal\":%s,\"less\":%s},\"registers\":[",
+           intr->had_error ? "true" : "false", intr->is_greater ? "true" : "false",
+           intr->is_equal ? "true" : "false", intr->is_less ? "true" : "false");
+    for (int i = 0; i < NUM_VARIABLES; i++) {
+        append(buf, i ? ",%" PRId64 : "%" PRId64, intr->variables[i]);
+    }
+    append(buf, "],\"sp\":%" PRId64 ",\"memory\":[", intr->variables[REG_SP]);
+
+    const uint8_t *mem   = mem_base();
+    bool           first = true;
+    for (size_t start = 0; start < MEM_CAPACITY; start += STATE_CHUNK) {
+        size_t end = start;
+        while (end < MEM_CAPACITY) {
+            size_t k = 0;
+            while (k < STATE_CHUNK && mem[end + k] == 0) {
+                k++;
+            }
+            if (k == STATE_CHUNK) {
+                break;
+            }
+            end += STATE_CHUNK;
+        }
+        if (end == start) {
+            continue;
+        }
+
+        append(buf, "%s{\"address\":%zu,\"hex\":\"", first ? "" : ",", start);
+        append_hex(buf, mem + start, end - start);
+        append(buf, "\"}");
+        first = false;
+        start = end;
+    }
+    append(buf, "]}\n");
+}
+
+/**
+ * @brief Writes a serialized state with a single call.
+ *
+ * @param data The bytes to write.
+ * @param length The number of bytes.
+ * @param path The file to write, or NULL for standard output.
+ * @return True on success, false if an error was printed.
+ */
+static bool write_buffer(const char *data, size_t length, const char *path) {
+    FILE *out = path ? fopen(path, "wb") : stdout;
+    if (!out) {
+        printf("Could not open %s for the state\n", path);
+        return false;
+    }
+
+    // Flushing what the program printed first lets the state leave in one write
+    fflush(out);
+    bool ok = fwrite(data, 1, length, out) == length;
+    ok      = (path ? fclose(out) : fflush(out)) == 0 && ok;
+    if (!ok) {
+        printf("Could not write the state to %s\n", path ? path : "standard output");
+    }
+    return ok;
+}
+
+bool state_export(Interpreter *intr, StateFormat format, const char *path) {
+    if (format == STATE_TEXT) {
+        FILE *out = path ? fopen(path, "w") : stdout;
+        if (!out) {
+            printf("Could not open %s for the state\n", path);
+            return false;
+        }
+        print_interpreter_state(intr, out);
+        mem_print(out);
+        return !path || fclose(out) == 0;
+    }
+
+    if (format == STATE_BIN) {
+        StateImage *image = calloc(1, sizeof(StateImage));
+        if (!image) {
+            printf("Could not allocate the state\n");
+            return false;
+        }
+        memcpy(image->magic, STATE_MAGIC, sizeof(image->magic));
+        image->version     = STATE_VERSION;
+        image->memory_size = MEM_CAPACITY;
+        image->flags |= intr->had_error ? STATE_FLAG_ERROR : 0;
+        image->flags |= intr->is_greater ? STATE_FLAG_GREATER : 0;
+        image->flags |= intr->is_equal ? STATE_FLAG_EQUAL : 0;
+        image->flags |= intr->is_less ? STATE_FLAG_LESS : 0;
+        memcpy(image->registers, intr->variables, sizeof(image->registers));
+        memcpy(image->memory, mem_base(), sizeof(image->memory));
+        bool ok = write_buffer((const char *) image, sizeof(StateImage), path);
+        free(image);
+        return ok;
+    }
+
+    StateBuffer buf = {NULL, 0, 0, false};
+    serialize_json(&buf, intr);
+    bool ok = !buf.failed && write_buffer(buf.data, buf.length, path);
+    if (buf.failed) {
+        printf("Could not allocate the state\n");
+    }
+    free(buf.data);
+    return ok;
+}
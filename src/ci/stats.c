@@ -0,0 +1,41 @@
+#define _POSIX_C_SOURCE 199309L
+#include "stats.h"
+#include <inttypes.h>
+#include <time.h>
+
+uint64_t stats_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+void print_exec_stats(const ExecStats *stats, FILE *out) {
+    if (!stats) {
+        return;
+    }
+
+    uint64_t in_tier   = stats->tier_ns + stats->trace_ns + stats->compile_ns;
+    uint64_t interp_ns = stats->total_ns > in_tier ? stats->total_ns - in_tier : 0;
+
+    fprintf(out, "Execution stats:\n");
+    fprintf(out, "Blocks compiled: %" PRIu64 " (%" PRIu64 " native)\n", stats->blocks_compiled,
+            stats->native_blocks);
+    fprintf(out, "Compile failures: %" PRIu64 "\n", stats->compile_failures);
+    fprintf(out, "Tier transitions: %" PRIu64 " up, %" PRIu64 " down (%" PRIu64 " deopts)\n",
+            stats->tier_entries, stats->tier_exits, stats->deopts);
+    fprintf(out, "Time in interpreter: %.3f ms\n", interp_ns / 1e6);
+    fprintf(out, "Time in compiled tier: %.3f ms\n", stats->tier_ns / 1e6);
+    fprintf(out,
+            "Traces compiled: %" PRIu64 " (%" PRIu64 " side traces, %" PRIu64 " aborted, %" PRIu64
+            " native)\n",
+            stats->traces_compiled, stats->side_traces, stats->trace_aborts, stats->native_traces);
+    fprintf(out, "Trace entries: %" PRIu64 " (%" PRIu64 " guard exits)\n", stats->trace_entries,
+            stats->guard_exits);
+    fprintf(out, "Time in traces: %.3f ms\n", stats->trace_ns / 1e6);
+    fprintf(out, "Time compiling: %.3f ms\n", stats->compile_ns / 1e6);
+    if (stats->mem_accesses > 0) {
+        fprintf(out, "Bounds checks eliminated: %" PRIu64 " of %" PRIu64 " (%.1f%%)\n",
+                stats->checks_elided, stats->mem_accesses,
+                100.0 * (double) stats->checks_elided / (double) stats->mem_accesses);
+    }
+}
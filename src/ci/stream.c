@@ -0,0 +1,66 @@
+#define _POSIX_C_SOURCE 200809L
+#include "stream.h"
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <unistd.h>
+#include "heap.h"
+#include "mem.h"
+
+static bool range_valid(Interpreter *intr, const char *operation, uint64_t address,
+                        int64_t length);
+
+/**
+ * @brief Checks the memory range of a write or read.
+ *
+ * @param intr The interpreter executing the instruction.
+ * @param operation The instruction, for the error message.
+ * @param address The first byte of the range.
+ * @param length The number of bytes in the range.
+ * @return True if the whole range is accessible, false if an error was
+ * printed.
+ */
+static bool range_valid(Interpreter *intr, const char *operation, uint64_t address,
+                        int64_t length) {
+    if (length < 0 || address > MEM_CAPACITY || (uint64_t) length > MEM_CAPACITY - address) {
+        printf("Cannot %s %" PRId64 " bytes at address %" PRIu64 ": out of bounds\n", operation,
+               length, address);
+        return false;
+    }
+    return !intr->heap_debug || heap_check(address, (uint64_t) length);
+}
+
+bool stream_write(Interpreter *intr, int64_t fd, uint64_t address, int64_t length) {
+    FILE *out = fd == STREAM_STDOUT ? stdout : fd == STREAM_STDERR ? stderr : NULL;
+    if (!out) {
+        printf("Cannot write to file descriptor %" PRId64 "\n", fd);
+        return false;
+    }
+    if (!range_valid(intr, "write", address, length)) {
+        return false;
+    }
+
+    if (out == stderr) {
+        fflush(stdout);
+    }
+    intr->variables[0] = (int64_t) fwrite(mem_base() + address, 1, (size_t) length, out);
+    return true;
+}
+
+bool stream_read(Interpreter *intr, int64_t fd, uint64_t address, int64_t length) {
+    if (fd != STREAM_STDIN) {
+        printf("Cannot read from file descriptor %" PRId64 "\n", fd);
+        return false;
+    }
+    if (!range_valid(intr, "read", address, length)) {
+        return false;
+    }
+
+    fflush(stdout);
+    ssize_t count;
+    do {
+        count = read(STDIN_FILENO, mem_base() + address, (size_t) length);
+    } while (count < 0 && errno == EINTR);
+    intr->variables[0] = count < 0 ? -1 : (int64_t) count;
+    return true;
+}
@@ -0,0 +1,389 @@
+#include "tier.h"
+#include <stdlib.h>
+#include "builtin.h"
+#include "command_type.h"
+#include "mem.h"
+#include "native.h"
+
+static bool valid_width(int64_t bytes);
+static bool fuse_cmp_branch(TierInsn *cmp, const TierInsn *branch);
+static void set_flags(Interpreter *intr, bool greater, bool less);
+
+/**
+ * @brief Determines whether the given access width is valid for memory
+ * operations.
+ *
+ * @param bytes The width to check.
+ * @return True if the width is 1, 2, 4 or 8, false otherwise.
+ */
+static bool valid_width(int64_t bytes) {
+    return bytes == 1 || bytes == 2 || bytes == 4 || bytes == 8;
+}
+
+bool tier_lower(Command *cmd, LabelMap *map, TierInsn *insn) {
+    insn->source = cmd;
+    insn->dst    = (uint8_t) cmd->destination.num_val;
+    insn->a      = (uint8_t) cmd->val_a.num_val;
+    insn->b      = (uint8_t) cmd->val_b.num_val;
+    insn->next   = cmd->next;
+
+    switch (cmd->type) {
+        case CMD_MOV:
+            insn->op  = TOP_MOV;
+            insn->imm = cmd->val_a.num_val;
+            return true;
+        case CMD_ADD:
+        case CMD_SUB:
+            if (cmd->is_b_immediate) {
+                insn->op  = cmd->type == CMD_ADD ? TOP_ADD_RI : TOP_SUB_RI;
+                insn->imm = cmd->val_b.num_val;
+            } else {
+                insn->op = cmd->type == CMD_ADD ? TOP_ADD_RR : TOP_SUB_RR;
+            }
+            return true;
+        case CMD_AND:
+            insn->op = TOP_AND;
+            return true;
+        case CMD_EOR:
+            insn->op = TOP_EOR;
+            return true;
+        case CMD_ORR:
+            insn->op = TOP_ORR;
+            return true;
+        case CMD_ASR:
+        case CMD_LSL:
+        case CMD_LSR:
+            insn->op  = cmd->type == CMD_ASR ? TOP_ASR : cmd->type == CMD_LSL ? TOP_LSL : TOP_LSR;
+            insn->imm = cmd->val_b.num_val & 63;  // Shift counts wrap like the hardware's
+            return true;
+        case CMD_CMP:
+        case CMD_CMP_U:
+            // cmp compares the destination register against operand A
+            insn->a = (uint8_t) cmd->destination.num_val;
+            if (cmd->is_a_immediate) {
+                insn->op  = cmd->type == CMD_CMP ? TOP_CMP_RI : TOP_CMP_U_RI;
+                insn->imm = cmd->val_a.num_val;
+            } else {
+                insn->op = cmd->type == CMD_CMP ? TOP_CMP_RR : TOP_CMP_U_RR;
+                insn->b  = (uint8_t) cmd->val_a.num_val;
+            }
+            return true;
+        case CMD_LOAD:
+            if (!valid_width(cmd->val_a.num_val)) {
+                return false;
+            }
+            insn->width  = (uint8_t) cmd->val_a.num_val;
+            insn->op     = cmd->is_b_immediate ? TOP_LOAD_I : TOP_LOAD_R;
+            insn->imm    = cmd->val_b.num_val;
+            insn->proven = cmd->in_bounds;
+            return true;
+        case CMD_STORE:
+            if (!valid_width(cmd->val_b.num_val)) {
+                return false;
+            }
+            insn->width  = (uint8_t) cmd->val_b.num_val;
+            insn->op     = cmd->is_a_immediate ? TOP_STORE_I : TOP_STORE_R;
+            insn->imm    = cmd->val_a.num_val;
+            insn->b      = (uint8_t) cmd->val_a.num_val;
+            insn->proven = cmd->in_bounds;
+            return true;
+        case CMD_BUILTIN:
+            insn->op  = TOP_BUILTIN;
+            insn->imm = cmd->val_a.num_val;
+            return true;
+        case CMD_BRANCH:
+            insn->target = find_label(map, cmd->destination.str_val);
+            if (!insn->target) {
+                return false;
+            }
+            insn->op   = TOP_BRANCH;
+            insn->cond = cmd->branch_condition;
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief Fuses a comparison with the branch that follows it.
+ *
+ * @param cmp The comparison instruction, rewritten in place on success.
+ * @param branch The branch instruction following the comparison.
+ * @return True if the two were fused into `cmp`, false otherwise.
+ */
+static bool fuse_cmp_branch(TierInsn *cmp, const TierInsn *branch) {
+    if (branch->op != TOP_BRANCH || (cmp->op != TOP_CMP_RR && cmp->op != TOP_CMP_RI)) {
+        return false;
+    }
+
+    cmp->op     = cmp->op == TOP_CMP_RR ? TOP_CMP_BRANCH_RR : TOP_CMP_BRANCH_RI;
+    cmp->cond   = branch->cond;
+    cmp->target = branch->target;
+    cmp->next   = branch->next;
+    return true;
+}
+
+TierCode *tier_compile(BasicBlock *block, LabelMap *map) {
+    if (!block) {
+        return NULL;
+    }
+
+    TierCode *code = (TierCode *) calloc(1, sizeof(TierCode));
+    if (!code) {
+        return NULL;
+    }
+    code->insns = (TierInsn *) calloc(block->length + 1, sizeof(TierInsn));
+    if (!code->insns) {
+        free(code);
+        return NULL;
+    }
+
+    Command *cmd  = block->first;
+    Command *exit = block->last->next;
+    int      n    = 0;
+    int      i    = 0;
+    for (; i < block->length; i++, cmd = cmd->next) {
+        TierInsn insn = {0};
+        insn.before   = (uint32_t) i;
+        if (!tier_lower(cmd, map, &insn)) {
+            exit = cmd;
+            break;
+        }
+        if (n > 0 && fuse_cmp_branch(&code->insns[n - 1], &insn)) {
+            continue;
+        }
+        code->insns[n++] = insn;
+    }
+
+    if (n == 0) {
+        tier_free(code);
+        return NULL;
+    }
+
+    TierInsn *last = &code->insns[n - 1];
+    if (last->op != TOP_BRANCH && last->op != TOP_CMP_BRANCH_RR && last->op != TOP_CMP_BRANCH_RI) {
+        code->insns[n].op     = TOP_EXIT;
+        code->insns[n].target = exit;
+        code->insns[n].source = exit;
+        n++;
+    }
+    code->count    = n;
+    code->commands = i;
+    return code;
+}
+
+void tier_free(TierCode *code) {
+    while (code) {
+        TierCode *chained = code->chain;
+        native_free(code);
+        free(code->insns);
+        free(code);
+        code = chained;
+    }
+}
+
+/**
+ * @brief Sets the comparison flags of the interpreter.
+ *
+ * @param intr The interpreter to update.
+ * @param greater Whether the left operand compared greater.
+ * @param less Whether the left operand compared less.
+ */
+static void set_flags(Interpreter *intr, bool greater, bool less) {
+    intr->is_greater = greater;
+    intr->is_less    = less;
+    intr->is_equal   = !greater && !less;
+}
+
+Command *tier_run(Interpreter *intr, TierInsn *ip, TierInsn **exit, bool *deopt) {
+    int64_t *regs = intr->variables;
+
+    *deopt = false;
+    for (;;) {
+        TierInsn *insn = ip++;
+        switch ((TierOp) insn->op) {
+            case TOP_MOV:
+                regs[insn->dst] = insn->imm;
+                break;
+            case TOP_ADD_RR:
+                regs[insn->dst] = (int64_t) ((uint64_t) regs[insn->a] + (uint64_t) regs[insn->b]);
+                break;
+            case TOP_ADD_RI:
+                regs[insn->dst] = (int64_t) ((uint64_t) regs[insn->a] + (uint64_t) insn->imm);
+                break;
+            case TOP_SUB_RR:
+                regs[insn->dst] = (int64_t) ((uint64_t) regs[insn->a] - (uint64_t) regs[insn->b]);
+                break;
+            case TOP_SUB_RI:
+                regs[insn->dst] = (int64_t) ((uint64_t) regs[insn->a] - (uint64_t) insn->imm);
+                break;
+            case TOP_AND:
+                regs[insn->dst] = regs[insn->a] & regs[insn->b];
+                break;
+            case TOP_EOR:
+                regs[insn->dst] = regs[insn->a] ^ regs[insn->b];
+                break;
+            case TOP_ORR:
+                regs[insn->dst] = regs[insn->a] | regs[insn->b];
+                break;
+            case TOP_ASR:
+                regs[insn->dst] = regs[insn->a] >> insn->imm;
+                break;
+            case TOP_LSL:
+                regs[insn->dst] = (int64_t) ((uint64_t) regs[insn->a] << insn->imm);
+                break;
+            case TOP_LSR:
+                regs[insn->dst] = (int64_t) ((uint64_t) regs[insn->a] >> insn->imm);
+                break;
+            case TOP_CMP_RR:
+                set_flags(intr, regs[insn->a] > regs[insn->b], regs[insn->a] < regs[insn->b]);
+                break;
+            case TOP_CMP_RI:
+                set_flags(intr, regs[insn->a] > insn->imm, regs[insn->a] < insn->imm);
+                break;
+            case TOP_CMP_U_RR:
+                set_flags(intr, (uint64_t) regs[insn->a] > (uint64_t) regs[insn->b],
+                          (uint64_t) regs[insn->a] < (uint64_t) regs[insn->b]);
+                break;
+            case TOP_CMP_U_RI:
+                set_flags(intr, (uint64_t) regs[insn->a] > (uint64_t) insn->imm,
+                          (uint64_t) regs[insn->a] < (uint64_t) insn->imm);
+                break;
+            case TOP_LOAD_R:
+            case TOP_LOAD_I: {
+                uint64_t addr  = insn->op == TOP_LOAD_I ? (uint64_t) insn->imm : (uint64_t) regs[insn->b];
+                uint64_t value = 0;
+                bool     ok    = true;
+                if (insn->proven) {
+                    mem_load_unchecked((uint8_t *) &value, addr, insn->width);
+                } else {
+                    value = mem_load_value(addr, insn->width, &ok);
+                }
+                if (!ok) {
+                    *exit  = insn;
+                    *deopt = true;
+                    return insn->source;
+                }
+                regs[insn->dst] = (int64_t) value;
+                break;
+            }
+            case TOP_STORE_R:
+            case TOP_STORE_I: {
+                uint64_t addr  = insn->op == TOP_STORE_I ? (uint64_t) insn->imm : (uint64_t) regs[insn->b];
+                int64_t  value = regs[insn->dst];
+                if (insn->proven) {
+                    mem_store_unchecked((uint8_t *) &value, addr, insn->width);
+                } else if (!mem_store_value(addr, insn->width, (uint64_t) value)) {
+                    *exit  = insn;
+                    *deopt = true;
+                    return insn->source;
+                }
+                break;
+            }
+            case TOP_CMP_BRANCH_RR:
+                set_flags(intr, regs[insn->a] > regs[insn->b], regs[insn->a] < regs[insn->b]);
+                *exit = insn;
+                return cond_holds(intr, insn->cond) ? insn->target : insn->next;
+            case TOP_CMP_BRANCH_RI:
+                set_flags(intr, regs[insn->a] > insn->imm, regs[insn->a] < insn->imm);
+                *exit = insn;
+                return cond_holds(intr, insn->cond) ? insn->target : insn->next;
+            case TOP_BRANCH:
+                *exit = insn;
+                return cond_holds(intr, insn->cond) ? insn->target : insn->next;
+            case TOP_EXIT:
+                *exit = insn;
+                return insn->target;
+            case TOP_GUARD:
+                if (cond_holds(intr, insn->cond) != insn->expect) {
+                    // The loop charges whole trips; this one ends at the guard
+                    bool charged = charge_instructions(intr, (uint64_t) insn->imm);
+                    if (insn->link && charged) {
+                        ip = insn->link->insns;
+                        break;
+                    }
+                    *exit = insn;
+                    return insn->target;
+                }
+                break;
+            case TOP_CALL:
+                if (!push_frame(intr, insn->target)) {
+                    *exit  = insn;
+                    *deopt = true;
+                    return insn->source;
+                }
+                break;
+            case TOP_BUILTIN:
+                // A failed builtin changed nothing, so the interpreter can rerun it
+                if (!builtin_run(intr, (int) insn->imm)) {
+                    *exit  = insn;
+                    *deopt = true;
+                    return insn->source;
+                }
+                break;
+            case TOP_RET: {
+                Command *return_to;
+                if (!peek_frame(intr, &return_to) || return_to != insn->target) {
+                    *exit  = insn;
+                    *deopt = true;
+                    return insn->source;
+                }
+                // The block is charged once it ends, but a memoized call's
+                // cost must include the commands it has run so far
+                uint64_t uncharged = intr->instruction_limit ? insn->before + 1u : 0;
+                intr->executed += uncharged;
+                pop_frame(intr);
+                intr->executed -= uncharged;
+                break;
+            }
+            case TOP_LOOP:
+                if (!charge_instructions(intr, (uint64_t) insn->imm)) {
+                    *exit = insn;
+                    return insn->target;
+                }
+                ip = insn->link->insns;
+                break;
+        }
+    }
+}
+
+Command *tier_execute(Interpreter *intr, BasicBlock *block) {
+    Command *entry = block->first;
+    Command *next;
+    // The interpreter counted the entry command, which the first block charges again
+    if (intr->instruction_limit) {
+        intr->executed--;
+    }
+    for (;;) {
+        TierInsn *exit;
+        bool      deopt;
+        next = block->code->native ? native_run(intr, block->code, &exit, &deopt)
+                                   : tier_run(intr, block->code->insns, &exit, &deopt);
+
+        // The interpreter reruns, and counts, the command that deoptimized
+        if (deopt) {
+            if (!charge_instructions(intr, exit->before)) {
+                intr->had_error = true;
+            }
+            intr->stats.deopts++;
+            break;
+        }
+        if (!charge_instructions(intr, (uint64_t) block->code->commands)) {
+            intr->had_error = true;
+            break;
+        }
+        // Loop headers go back to the interpreter, which counts them for tracing
+        if (!next || !next->block || !next->block->code ||
+            (next->block->loop_header && intr->trace_threshold > 0 &&
+             !next->block->trace_failed)) {
+            break;
+        }
+        block = next->block;
+    }
+    // Resuming at the entry, the interpreter runs it without counting it again
+    if (intr->instruction_limit && next == entry) {
+        intr->executed++;
+    }
+    intr->stats.tier_exits++;
+    return next;
+}
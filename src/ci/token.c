@@ -29,3 +29,20 @@ void print_token(Token tok) {
     printf("Token length: %d\n", tok.length);
     printf("Line: %d:%d\n", tok.line, tok.column);
 }
+
+bool token_is_name(TokenType type) {
+    switch (type) {
+        case TOK_COLON:
+        case TOK_EOF:
+        case TOK_ERR:
+        case TOK_NL:
+        case TOK_NUM:
+        case TOK_STR:
+        case TOK_LBRACE:
+        case TOK_RBRACE:
+        case TOK_DASH:
+            return false;
+        default:
+            return true;
+    }
+}
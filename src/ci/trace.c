@@ -0,0 +1,233 @@
+#include "trace.h"
+#include <stdlib.h>
+#include "command_type.h"
+#include "native.h"
+
+static TierCode *compile_trace(TraceRecorder *rec, LabelMap *map);
+static bool      lower_traced(Command *cmd, Command *after, int count, LabelMap *map,
+                              TierInsn *insn, bool *emitted);
+static void      abort_recording(TraceRecorder *rec, Interpreter *intr);
+
+void trace_recorder_init(TraceRecorder *rec) {
+    rec->active   = false;
+    rec->header   = NULL;
+    rec->guard    = NULL;
+    rec->commands = NULL;
+    rec->length   = 0;
+    rec->capacity = 0;
+}
+
+void trace_recorder_free(TraceRecorder *rec) {
+    free(rec->commands);
+    trace_recorder_init(rec);
+}
+
+void trace_start(TraceRecorder *rec, BasicBlock *header, TierInsn *guard) {
+    rec->active = true;
+    rec->header = header;
+    rec->guard  = guard;
+    rec->length = 0;
+}
+
+/**
+ * @brief Lowers a recorded command given the command executed after it.
+ *
+ * @param cmd The recorded command.
+ * @param after The command that was executed after `cmd`.
+ * @param count The number of commands recorded up to and including `cmd`,
+ * which a guard charges when it fails.
+ * @param map The label map used to resolve branch targets.
+ * @param insn The instruction to fill in.
+ * @param emitted Set to false if the command needs no instruction, such as an
+ * unconditional branch.
+ * @return True if the command was lowered, false if the trace cannot be
+ * compiled.
+ */
+static bool lower_traced(Command *cmd, Command *after, int count, LabelMap *map,
+                         TierInsn *insn, bool *emitted) {
+    *emitted    = true;
+    insn->source = cmd;
+
+    switch (cmd->type) {
+        case CMD_BRANCH: {
+            Command *target = find_label(map, cmd->destination.str_val);
+            if (!target) {
+                return false;
+            }
+            if (cmd->branch_condition == BRANCH_NONE || target == cmd->next) {
+                *emitted = false;
+                return true;
+            }
+            insn->op     = TOP_GUARD;
+            insn->imm    = count;
+            insn->cond   = cmd->branch_condition;
+            insn->expect = after == target;
+            insn->target = insn->expect ? cmd->next : target;
+            return true;
+        }
+        case CMD_CALL:
+            // Memoized calls stay in the interpreter, which looks up their results
+            if (cmd->memo || find_label(map, cmd->destination.str_val) != after) {
+                return false;
+            }
+            insn->op     = TOP_CALL;
+            insn->target = cmd->next;
+            return true;
+        case CMD_RET:
+            insn->op     = TOP_RET;
+            insn->target = after;
+            return true;
+        default:
+            return tier_lower(cmd, map, insn);
+    }
+}
+
+/**
+ * @brief Compiles the recorded path into a linear trace.
+ *
+ * @param rec The recorder holding a closed recording.
+ * @param map The label map used to resolve branch targets.
+ * @return The compiled trace, or NULL if it could not be compiled.
+ */
+static TierCode *compile_trace(TraceRecorder *rec, LabelMap *map) {
+    TierCode *code = (TierCode *) calloc(1, sizeof(TierCode));
+    if (!code) {
+        return NULL;
+    }
+    code->insns = (TierInsn *) calloc(rec->length + 1, sizeof(TierInsn));
+    if (!code->insns) {
+        free(code);
+        return NULL;
+    }
+
+    int n = 0;
+    for (int i = 0; i < rec->length; i++) {
+        Command *cmd   = rec->commands[i];
+        Command *after = (i + 1 < rec->length) ? rec->commands[i + 1] : rec->header->first;
+        bool     emitted;
+
+        code->insns[n].before = (uint32_t) i;
+        if (!lower_traced(cmd, after, i + 1, map, &code->insns[n], &emitted)) {
+            tier_free(code);
+            return NULL;
+        }
+        n += emitted;
+    }
+
+    // Root traces loop onto themselves, side traces continue in the root trace
+    code->insns[n].op     = TOP_LOOP;
+    code->insns[n].link   = rec->guard ? rec->header->trace : code;
+    code->insns[n].target = rec->header->first;
+    code->insns[n].imm    = rec->length;
+    code->count         = n + 1;
+    return code;
+}
+
+/**
+ * @brief Abandons the current recording.
+ *
+ * @param rec The recorder to stop.
+ * @param intr The interpreter collecting statistics.
+ */
+static void abort_recording(TraceRecorder *rec, Interpreter *intr) {
+    if (!rec->guard) {
+        rec->header->trace_failed = true;
+    }
+    rec->active = false;
+    intr->stats.trace_aborts++;
+}
+
+bool trace_record(TraceRecorder *rec, Interpreter *intr, Command *cmd) {
+    if (rec->length > 0 && cmd == rec->header->first) {
+        uint64_t  start = intr->stats.enabled ? stats_now_ns() : 0;
+        TierCode *code  = compile_trace(rec, intr->label_map);
+        if (intr->stats.enabled) {
+            intr->stats.compile_ns += stats_now_ns() - start;
+        }
+        if (!code) {
+            abort_recording(rec, intr);
+            return false;
+        }
+
+        if (intr->native && native_compile(code)) {
+            intr->stats.native_traces++;
+        }
+        if (rec->guard) {
+            TierCode *root     = rec->header->trace;
+            code->chain        = root->chain;
+            root->chain        = code;
+            rec->guard->link   = code;
+            intr->stats.side_traces++;
+        } else {
+            rec->header->trace = code;
+            intr->stats.traces_compiled++;
+        }
+        rec->active = false;
+        return true;
+    }
+
+    if (cmd->type == CMD_PRINT || cmd->type == CMD_PUT || cmd->type == CMD_ERR ||
+        rec->length >= TRACE_MAX_LENGTH) {
+        abort_recording(rec, intr);
+        return false;
+    }
+
+    if (rec->length == rec->capacity) {
+        int       capacity = rec->capacity ? rec->capacity * 2 : 64;
+        Command **commands = (Command **) realloc(rec->commands, capacity * sizeof(Command *));
+        if (!commands) {
+            abort_recording(rec, intr);
+            return false;
+        }
+        rec->commands = commands;
+        rec->capacity = capacity;
+    }
+    rec->commands[rec->length++] = cmd;
+    return false;
+}
+
+Command *trace_execute(Interpreter *intr, TraceRecorder *rec, BasicBlock *header) {
+    TierCode *code = header->trace;
+    TierInsn *exit;
+    bool      deopt;
+    Command  *next = NULL;
+    // The interpreter counted the header, which the first trip charges again
+    if (intr->instruction_limit) {
+        intr->executed--;
+    }
+    // Native code leaves to the caller to follow the links to side traces and
+    // back to the root trace, which tier_run follows itself
+    for (;;) {
+        if (!code->native) {
+            next = tier_run(intr, code->insns, &exit, &deopt);
+            break;
+        }
+        next = native_run(intr, code, &exit, &deopt);
+        // tier_run charges the part of a trip before a failing guard itself
+        if (deopt || !exit ||
+            (exit->op == TOP_GUARD && !charge_instructions(intr, (uint64_t) exit->imm)) ||
+            !exit->link) {
+            break;
+        }
+        code = exit->link;
+    }
+    // The trip is charged up to the command that deoptimized, which the
+    // interpreter reruns
+    if (deopt && !charge_instructions(intr, exit->before)) {
+        intr->had_error = true;
+    }
+    // Resuming at the header, the interpreter runs it without counting it again
+    if (intr->instruction_limit && next == header->first) {
+        intr->executed++;
+    }
+
+    if (deopt) {
+        intr->stats.deopts++;
+    } else if (exit && exit->op == TOP_GUARD) {
+        intr->stats.guard_exits++;
+        if (++exit->exits == TRACE_SIDE_THRESHOLD && !rec->active && next) {
+            trace_start(rec, header, exit);
+        }
+    }
+    return next;
+}
@@ -0,0 +1,107 @@
+#define _POSIX_C_SOURCE 200809L
+#include "watch.h"
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#define WATCH_EVENTS (IN_CLOSE_WRITE | IN_MOVED_TO)
+
+static bool read_events(FileWatch *watch, bool *changed);
+
+bool watch_init(FileWatch *watch, const char *path) {
+    const char *slash = strrchr(path, '/');
+    const char *name  = slash ? slash + 1 : path;
+    size_t      dir   = slash ? (size_t) (slash - path) : 0;
+    char       *copy  = (char *) malloc(strlen(path) + 2);
+
+    watch->fd   = -1;
+    watch->name = NULL;
+    if (!copy) {
+        printf("Could not allocate the watch\n");
+        return false;
+    }
+
+    // The directory part of `path`, with "/" and "." for the root and no part
+    if (slash) {
+        memcpy(copy, path, dir ? dir : 1);
+        copy[dir ? dir : 1] = '\0';
+    } else {
+        strcpy(copy, ".");
+    }
+
+    watch->fd = inotify_init1(IN_CLOEXEC);
+    if (watch->fd < 0 || inotify_add_watch(watch->fd, copy, WATCH_EVENTS) < 0) {
+        printf("Could not watch %s: %s\n", copy, strerror(errno));
+        free(copy);
+        watch_free(watch);
+        return false;
+    }
+
+    // The name is kept in the same allocation
+    memmove(copy, name, strlen(name) + 1);
+    watch->name = copy;
+    return true;
+}
+
+bool watch_next(FileWatch *watch) {
+    bool changed = false;
+    while (!changed) {
+        if (!read_events(watch, &changed)) {
+            return false;
+        }
+    }
+
+    // Let the writer finish before the file is read
+    struct pollfd pfd = {watch->fd, POLLIN, 0};
+    for (;;) {
+        int ready = poll(&pfd, 1, WATCH_SETTLE_MS);
+        if (ready == 0) {
+            return true;
+        }
+        if ((ready < 0 && errno != EINTR) || (ready > 0 && !read_events(watch, &changed))) {
+            return false;
+        }
+    }
+}
+
+void watch_free(FileWatch *watch) {
+    if (watch->fd >= 0) {
+        close(watch->fd);
+    }
+    free(watch->name);
+    watch->fd   = -1;
+    watch->name = NULL;
+}
+
+/**
+ * @brief Reads one batch of inotify events, blocking until there is one.
+ *
+ * @param watch The watch.
+ * @param changed Set if an event concerns the watched file.
+ * @return True on success, false if reading failed.
+ */
+static bool read_events(FileWatch *watch, bool *changed) {
+    _Alignas(struct inotify_event) char buffer[4096];
+    ssize_t                             length = read(watch->fd, buffer, sizeof(buffer));
+    if (length < 0) {
+        if (errno == EINTR) {
+            return true;
+        }
+        printf("Could not read file events: %s\n", strerror(errno));
+        return false;
+    }
+
+    for (ssize_t at = 0; at < length;) {
+        const struct inotify_event *event = (const struct inotify_event *) (buffer + at);
+        if (event->len > 0 && strcmp(event->name, watch->name) == 0) {
+            *changed = true;
+        }
+        at += (ssize_t) (sizeof(struct inotify_event) + event->len);
+    }
+    return true;
+}
@@ -0,0 +1,14 @@
+// Simple tests for the .equ and .set directives.
+.equ SIZE, 16
+.equ BASE, 0x100
+.set STEP, 2
+mov x0, SIZE
+add x1, x0, BASE
+add x2, x1, STEP
+.set STEP, 5
+add x3, x2, STEP
+// Correct: 16, 272, 274, 279
+print x0 d
+print x1 d
+print x2 d
+print x3 d
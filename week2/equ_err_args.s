@@ -0,0 +1,2 @@
+.equ SIZE
+mov x0, SIZE
@@ -0,0 +1,3 @@
+.equ SIZE, 16
+.equ SIZE, 32
+mov x0, SIZE
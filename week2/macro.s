@@ -0,0 +1,24 @@
+// Simple tests for the .macro directive.
+.macro double reg
+    add reg, reg, reg
+.endm
+
+.macro count_down reg, times
+    mov reg, times
+again:
+    sub reg, reg, 1
+    cmp reg, 0
+    b.gt again
+.endm
+
+mov x1, 21
+double x1
+// Correct: 42
+print x1 d
+
+// Each expansion gets its own `again` label
+count_down x2, 3
+count_down x3, 5
+// Correct: 0, 0
+print x2 d
+print x3 d
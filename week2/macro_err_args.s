@@ -0,0 +1,5 @@
+.macro double reg
+    add reg, reg, reg
+.endm
+mov x1, 21
+double x1, x2
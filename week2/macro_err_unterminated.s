@@ -0,0 +1,4 @@
+.macro double reg
+    add reg, reg, reg
+mov x1, 21
+double x1
@@ -0,0 +1,13 @@
+// Simple tests for the .rept directive.
+mov x0, 0
+.rept 4
+    add x0, x0, 3
+.endr
+// Correct: 12
+print x0 d
+
+.rept 0
+    mov x0, 0
+.endr
+// Correct: 12
+print x0 d
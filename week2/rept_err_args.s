@@ -0,0 +1,3 @@
+.rept x1
+    add x0, x0, 1
+.endr
@@ -0,0 +1,2 @@
+.rept 3
+    add x0, x0, 1
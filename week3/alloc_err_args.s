@@ -0,0 +1 @@
+alloc x1
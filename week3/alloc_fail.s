@@ -0,0 +1,4 @@
+// An allocation larger than the heap fails and returns 0.
+alloc x1, 100000
+// Correct: 0
+print x1 d
@@ -0,0 +1,19 @@
+// Simple tests for the alloc and free instructions.
+alloc x1, 16
+mov x0, 24
+alloc x2, x0
+put "heap", x1
+print x1 s
+
+// A freed block of the same size class is handed out again
+free x1
+alloc x3, 16
+cmp x1, x3
+// Correct: 1
+mov x4, 0
+b.ne different
+mov x4, 1
+different:
+print x4 d
+free x2
+free x3
@@ -0,0 +1,2 @@
+mov x1, 8
+free x1
@@ -0,0 +1,5 @@
+// Simple tests for the read instruction; an empty read needs no input.
+mov x1, 0x40
+read 0, x1, 0
+// Correct: 0
+print x0 d
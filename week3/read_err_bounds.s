@@ -0,0 +1,2 @@
+mov x1, 1024
+read 0, x1, 1
@@ -0,0 +1,2 @@
+mov x1, 0
+read 1, x1, 4
@@ -0,0 +1,8 @@
+// Simple tests for the realloc instruction.
+alloc x1, 8
+put "grow", x1
+realloc x2, x1, 64
+// Correct: grow
+print x2 s
+realloc x3, x2, 4
+free x3
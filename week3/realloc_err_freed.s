@@ -0,0 +1,3 @@
+alloc x1, 16
+free x1
+realloc x2, x1, 32
@@ -0,0 +1,8 @@
+// Simple tests for the write instruction.
+put "Hello, world!
+", 0x40
+mov x1, 0x40
+write 1, x1, 14
+// Nothing is written for an empty range
+write 1, x1, 0
+write 2, x1, 14
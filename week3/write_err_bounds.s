@@ -0,0 +1,2 @@
+mov x1, 1020
+write 1, x1, 8
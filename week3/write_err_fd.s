@@ -0,0 +1,3 @@
+put "Hello", 0
+mov x1, 0
+write 7, x1, 5
@@ -0,0 +1,2 @@
+.callmode fast
+mov x1, 1
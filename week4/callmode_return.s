@@ -0,0 +1,17 @@
+// Calls push only their return address under .callmode return, so
+// registers the callee changes stay changed.
+.callmode return
+mov x1, 20
+call double
+// Correct: 40
+print x1 d
+b end
+
+double:
+    push x2
+    add x2, x1, 0
+    add x1, x1, x2
+    pop x2
+    ret
+
+end:
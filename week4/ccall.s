@@ -0,0 +1,7 @@
+// Calls strlen from the C library on a string in memory.
+.import "libc.so.6" strlen "s"
+mov x0, 64
+put "hello", x0
+ccall strlen
+// Correct: 5
+print x0 d
@@ -0,0 +1,6 @@
+// The buffer argument runs past the end of memory.
+.import "libc.so.6" memset "p2ii"
+mov x0, 64
+mov x1, 0
+mov x2, 0x7fffffff
+ccall memset
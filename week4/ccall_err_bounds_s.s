@@ -0,0 +1,4 @@
+// The string argument starts outside of memory.
+.import "libc.so.6" strlen "s"
+mov x0, 0x7fffffff
+ccall strlen
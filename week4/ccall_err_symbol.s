@@ -0,0 +1,3 @@
+// The library has no function of this name.
+.import "libc.so.6" no_such_function
+ccall no_such_function
@@ -0,0 +1 @@
+ccall strlen
@@ -0,0 +1,2 @@
+.extern triple
+call triple
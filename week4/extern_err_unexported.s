@@ -0,0 +1,3 @@
+.include "include_module.s"
+.extern step
+call step
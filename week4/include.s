@@ -0,0 +1,19 @@
+// Links include_module.s and calls the function it exports.
+.include "include_module.s"
+.extern triple
+.callmode return
+mov x1, 5
+call triple
+// Correct: 16
+print x1 d
+call step
+// Correct: 116
+print x1 d
+b end
+
+step:
+    add x1, x1, 100
+    ret
+
+end:
+    mov x0, 0
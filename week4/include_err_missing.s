@@ -0,0 +1,2 @@
+.include "missing_module.s"
+mov x1, 1
@@ -0,0 +1,11 @@
+// A function at the end of the program ends it by falling off, as it does
+// when nothing is included: the included module must not run and the call
+// must not return.
+.include "include_module.s"
+mov x1, 9
+call f
+// Correct: nothing is printed
+print x1 d
+
+f:
+    add x1, x1, 1
@@ -0,0 +1,12 @@
+// A module for include.s. Run on its own, it returns with an empty stack.
+.global triple
+triple:
+    add x2, x1, x1
+    add x1, x1, x2
+    call step
+    ret
+
+// Not exported, so include.s may define its own step
+step:
+    add x1, x1, 1
+    ret
@@ -0,0 +1,28 @@
+// Mnemonics are only reserved at the start of an instruction, so they still
+// name labels.
+mov x0, 5
+b read
+mov x0, 7
+read:
+// Correct: 5
+print x0 d
+call write
+call free
+call sp
+b pop
+alloc:
+mov x0, 7
+ccall:
+mov x0, 8
+write:
+add x0, x0, 1
+ret
+free:
+add x0, x0, 10
+ret
+sp:
+add x0, x0, 100
+ret
+pop:
+// Correct: 116
+print x0 d
@@ -0,0 +1 @@
+pop {x30-sp}
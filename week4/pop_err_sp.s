@@ -0,0 +1,4 @@
+// pop sets sp past the popped value, so it cannot pop into sp.
+mov x1, 100
+push x1
+pop sp
@@ -0,0 +1 @@
+pop x1
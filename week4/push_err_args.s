@@ -0,0 +1 @@
+push {x4-x1}
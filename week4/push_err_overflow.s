@@ -0,0 +1,3 @@
+loop:
+    push x1
+    b loop
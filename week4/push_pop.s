@@ -0,0 +1,24 @@
+// Simple tests for the push and pop instructions.
+mov x1, 11
+mov x2, 22
+push x1
+push x2
+pop x1
+pop x2
+// Correct: 22, 11
+print x1 d
+print x2 d
+
+// Ranges are pushed in order and popped in reverse
+mov x3, 3
+mov x4, 4
+mov x5, 5
+push {x3-x5}
+mov x3, 0
+mov x4, 0
+mov x5, 0
+pop {x3-x5}
+// Correct: 3, 4, 5
+print x3 d
+print x4 d
+print x5 d